@@ -0,0 +1,110 @@
+#ifndef ADMINSOCKET_HPP
+#define ADMINSOCKET_HPP
+
+#include <cstddef>
+#include <poll.h>
+#include <stdint.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+class Server;
+
+// Concurrent admin connections; further ones wait in the listen backlog
+#define ADMIN_MAX_SESSIONS 8
+// A request line longer than this is answered with the help text
+#define ADMIN_MAX_REQUEST  256
+// Client slots visited per session and loop iteration by the listing jobs
+#define ADMIN_SLICE		   1024
+// Generation pauses while this many bytes wait to be written
+#define ADMIN_OUTPUT_HIGH  (64u * 1024u)
+// Entries reported by "top"
+#define ADMIN_TOP_COUNT	   20
+
+/**
+ * @brief Optional Unix-domain socket for operators and scrapers.
+ *
+ * Served from the server's own poll loop: appendPollfds() adds the listener
+ * and the sessions after the client pollfds, serve() handles their events.
+ * Every connection sends one request line and receives one plain-text reply,
+ * then the socket is closed:
+ *
+ *   metrics  Prometheus text exposition of the Metrics registry
+ *   queues   "fd nick sendq recvq" for every client
+ *   top      the ADMIN_TOP_COUNT clients that sent the most lines
+ *   stalls   recent slow loop iterations with phase, fd and command
+ *   heavy    top clients by lines, channels by bytes out, IPs by connects
+ *   help     this list
+ *
+ * "GET /<request> HTTP/1.x" is accepted as well and answered with a minimal
+ * HTTP/1.0 header, so `curl --unix-socket` works.
+ *
+ * Listings walk the client slab ADMIN_SLICE slots per iteration and stop
+ * generating while ADMIN_OUTPUT_HIGH bytes are unsent, so a slow reader or a
+ * huge client list never holds up client traffic. All sockets are
+ * non-blocking.
+ */
+class AdminSocket {
+  public:
+	AdminSocket();
+	AdminSocket(const AdminSocket &other);
+	AdminSocket &operator=(const AdminSocket &other);
+	virtual ~AdminSocket();
+
+	/**
+	 * @brief Bind and listen on path, replacing a stale socket file.
+	 * @throws std::runtime_error if the socket cannot be set up.
+	 */
+	void open(const std::string &path);
+	/** @brief Close the listener and every session, unlink the path. */
+	void close();
+	bool isOpen() const;
+
+	/** @brief Append the listener and session pollfds to target. */
+	void appendPollfds(std::vector<struct pollfd> &target) const;
+	/**
+	 * @brief Handle the events of the entries appendPollfds() added.
+	 * @param polled Poll result; the admin entries start at first.
+	 */
+	void serve(const std::vector<struct pollfd> &polled, std::size_t first,
+			   Server &server);
+
+  private:
+	enum Job {
+		JOB_READ,	// waiting for the request line
+		JOB_QUEUES,
+		JOB_TOP,
+		JOB_DONE	// reply complete, close once written
+	};
+
+	struct Session {
+		int			fd;
+		Job			job;
+		std::string request;
+		std::string output;
+		std::size_t written;	// bytes of output already sent
+		std::size_t cursor;		// next client slot of a listing
+		// (lines, fd) min-heap of the best talkers seen so far
+		std::vector<std::pair<uint32_t, int> > top;
+	};
+
+	int					 listenFd_;
+	std::string			 path_;
+	std::vector<Session> sessions_;
+
+	void acceptSessions_();
+	// false once the peer is gone or sent garbage
+	bool readRequest_(Session &session, Server &server);
+	void startJob_(Session &session, const std::string &request,
+				   Server &server);
+	void advanceJob_(Session &session, Server &server);
+	// false on a fatal write error
+	bool flush_(Session &session);
+
+	static void writeMetrics_(std::string &out, Server &server);
+	static void writeStalls_(std::string &out, Server &server);
+	static void writeHeavy_(std::string &out, Server &server);
+	static void writeTop_(Session &session, Server &server);
+};
+
+#endif // ADMINSOCKET_HPP
@@ -0,0 +1,101 @@
+#ifndef ADMISSIONCONTROL_HPP
+#define ADMISSIONCONTROL_HPP
+
+#include <cstddef>
+#include <ctime>
+#include <netinet/in.h>
+#include <stdint.h>
+#include <vector>
+
+// Bucket count of a fresh table; always a power of two
+#define ADMISSION_MIN_BUCKETS	 64
+// Connect rates are measured over this sliding window
+#define ADMISSION_WINDOW_SECONDS 10
+// Subnets sharing the per-subnet cap: IPv4 /24, IPv6 /64 (of the 128-bit,
+// v4-mapped address)
+#define ADMISSION_V4_PREFIX		 (96 + 24)
+#define ADMISSION_V6_PREFIX		 64
+
+enum AdmissionVerdict {
+	ADMISSION_ADMIT,
+	ADMISSION_IP_LIMIT,		// too many open connections from the address
+	ADMISSION_SUBNET_LIMIT,	// too many open connections from the subnet
+	ADMISSION_RATE_LIMIT	// the address connects too often
+};
+
+/**
+ * @brief Per-address connection caps and connect-rate limits.
+ *
+ * admit() is asked before a freshly accepted socket becomes a Client, and
+ * every admitted address is handed back through release() when the client
+ * goes away. Addresses and subnets are kept in one open-addressing table
+ * (linear probing, load factor at most 1/2) keyed on the binary address, so
+ * neither step formats or allocates anything per connection.
+ *
+ * Connect rates use a sliding window approximated from two fixed
+ * ADMISSION_WINDOW_SECONDS windows: the previous window's count is weighted
+ * by how much of it still overlaps the sliding one. Refused attempts count
+ * too, so a reconnect storm stays refused until it calms down.
+ *
+ * Loopback addresses are never limited. A limit of 0 disables that check.
+ * Entries without open connections are dropped by expire() once their rate
+ * windows ran out.
+ */
+class AdmissionControl {
+  public:
+	AdmissionControl();
+	AdmissionControl(const AdmissionControl &other);
+	AdmissionControl &operator=(const AdmissionControl &other);
+	virtual ~AdmissionControl();
+
+	/**
+	 * @param perIp Open connections allowed per address.
+	 * @param perSubnet Open connections allowed per subnet.
+	 * @param connectRate Connects allowed per address and window.
+	 */
+	void			 setLimits(unsigned perIp, unsigned perSubnet,
+							   unsigned connectRate);
+	/** @brief Count a connect attempt; ADMISSION_ADMIT reserves a slot. */
+	AdmissionVerdict admit(const struct in6_addr &address, time_t now);
+	/** @brief Give back the slot of an admitted connection. */
+	void			 release(const struct in6_addr &address);
+	/** @brief Reserve a slot without checking, for inherited connections. */
+	void			 adopt(const struct in6_addr &address);
+	/** @brief Drop idle entries, at most once per window. */
+	void			 expire(time_t now);
+	/** @brief Addresses and subnets currently tracked. */
+	std::size_t		 size() const;
+
+	/** @brief Reason sent to refused clients. */
+	static const char *reason(AdmissionVerdict verdict);
+
+  private:
+	struct Entry {
+		struct in6_addr address;	// masked to prefix
+		unsigned char	prefix;		// 0 marks an empty bucket
+		uint32_t		hash;
+		uint32_t		connections;
+		time_t			windowStart;
+		uint32_t		current;	// attempts in the window at windowStart
+		uint32_t		previous;	// attempts in the window before it
+		Entry();
+	};
+
+	// Bucket holding (address, prefix), or the empty one where it would go
+	std::size_t probe_(const struct in6_addr &address, unsigned char prefix,
+					   uint32_t hash) const;
+	Entry	   &entry_(const struct in6_addr &address, unsigned char prefix);
+	Entry	   *find_(const struct in6_addr &address, unsigned char prefix);
+	void		rehash_(std::size_t bucketCount, time_t now);
+	// Count one attempt; returns the attempts within the sliding window
+	static uint32_t countAttempt_(Entry &entry, time_t now);
+
+	std::vector<Entry> buckets_;
+	std::size_t		   size_;
+	unsigned		   perIp_;
+	unsigned		   perSubnet_;
+	unsigned		   connectRate_;
+	time_t			   lastExpire_;
+};
+
+#endif // ADMISSIONCONTROL_HPP
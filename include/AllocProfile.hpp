@@ -0,0 +1,78 @@
+#ifndef ALLOCPROFILE_HPP
+#define ALLOCPROFILE_HPP
+
+// Allocation profiler hooks. Built with -DALLOC_PROFILE (see `make profile`)
+// the operator new override in tester/memcheckAllocator.cpp charges every
+// allocation made by the event-loop thread to the current phase and
+// command (other threads' allocations are not counted); otherwise all
+// macros below compile to nothing, like debug().
+
+// Event-loop phases allocations are attributed to
+enum AllocPhase {
+	ALLOC_PHASE_LOOP,		// poll bookkeeping and anything not listed below
+	ALLOC_PHASE_ACCEPT,
+	ALLOC_PHASE_RECV,
+	ALLOC_PHASE_PARSE,
+	ALLOC_PHASE_EXECUTE,
+	ALLOC_PHASE_SERIALIZE,	// Message::toString, also when nested in execute
+	ALLOC_PHASE_DRAIN,
+	ALLOC_PHASE_HOUSEKEEPING,	// closes, dead fds, buffer reclamation
+	ALLOC_PHASE_COUNT
+};
+
+#ifdef ALLOC_PROFILE
+# include <ostream>
+
+AllocPhase	allocProfilePhase();
+void		allocProfileSetPhase(AllocPhase phase);
+const char	*allocProfileCommand();
+// name is copied into a fixed table; no allocation happens
+void		allocProfileSetCommand(const char *name);
+// Sorted table (bytes, descending) of every phase/command pair seen so far
+void		allocProfileDump(std::ostream &out);
+// Async-signal-safe request for a dump at the next allocProfilePoll()
+void		allocProfileRequestDump();
+void		allocProfilePoll(std::ostream &out);
+
+// Sets the phase (or command) for the enclosing scope, restoring the
+// previous one on exit so nested scopes attribute correctly.
+class AllocProfilePhaseScope {
+	public:
+		explicit AllocProfilePhaseScope(AllocPhase phase)
+			: saved_(allocProfilePhase()) { allocProfileSetPhase(phase); }
+		~AllocProfilePhaseScope() { allocProfileSetPhase(saved_); }
+	private:
+		AllocPhase	saved_;
+		AllocProfilePhaseScope(const AllocProfilePhaseScope &);
+		AllocProfilePhaseScope &operator=(const AllocProfilePhaseScope &);
+};
+
+class AllocProfileCommandScope {
+	public:
+		explicit AllocProfileCommandScope(const char *name)
+			: saved_(allocProfileCommand()) { allocProfileSetCommand(name); }
+		~AllocProfileCommandScope() { allocProfileSetCommand(saved_); }
+	private:
+		const char	*saved_;
+		AllocProfileCommandScope(const AllocProfileCommandScope &);
+		AllocProfileCommandScope &operator=(const AllocProfileCommandScope &);
+};
+
+# define ALLOC_PROFILE_CONCAT_(a, b) a##b
+# define ALLOC_PROFILE_CONCAT(a, b) ALLOC_PROFILE_CONCAT_(a, b)
+# define ALLOC_PROFILE_PHASE(phase) \
+	AllocProfilePhaseScope ALLOC_PROFILE_CONCAT(allocPhaseScope_, __LINE__)(phase)
+# define ALLOC_PROFILE_COMMAND(name) \
+	AllocProfileCommandScope ALLOC_PROFILE_CONCAT(allocCommandScope_, __LINE__)(name)
+# define ALLOC_PROFILE_DUMP(out) allocProfileDump(out)
+# define ALLOC_PROFILE_REQUEST_DUMP() allocProfileRequestDump()
+# define ALLOC_PROFILE_POLL(out) allocProfilePoll(out)
+#else
+# define ALLOC_PROFILE_PHASE(phase) (void(0))
+# define ALLOC_PROFILE_COMMAND(name) (void(0))
+# define ALLOC_PROFILE_DUMP(out) (void(0))
+# define ALLOC_PROFILE_REQUEST_DUMP() (void(0))
+# define ALLOC_PROFILE_POLL(out) (void(0))
+#endif
+
+#endif // !ALLOCPROFILE_HPP
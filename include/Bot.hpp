@@ -13,7 +13,9 @@ public:
 	virtual ~Bot();
 
 	// Establish a non-blocking connection; returns true if a socket was
-	// created and either connected or connection is in progress.
+	// created and either connected or connection is in progress. A host
+	// starting with '/' is the path of the server's Unix-domain socket
+	// (--unix-socket); port is ignored then.
 	bool connect();
 	void login();
 	// Initiate graceful disconnect: queue QUIT, stop reading, and wait for
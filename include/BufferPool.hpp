@@ -0,0 +1,50 @@
+#ifndef BUFFERPOOL_HPP
+#define BUFFERPOOL_HPP
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Released buffers are kept for reuse up to this many...
+#define BUFFERPOOL_MAX_BUFFERS	1024
+// ...and only if their capacity is at most this; bigger ones are freed.
+#define BUFFERPOOL_MAX_CAPACITY 4096
+
+/**
+ * @brief Shared free list of connection buffers with byte accounting.
+ *
+ * Clients acquire a receive buffer when a partial line arrives and release
+ * it once the line is complete. Released buffers keep their capacity and are
+ * handed out again, so steady traffic does not hit the allocator, while
+ * shrink() lets the reclamation pass return pooled memory under pressure.
+ *
+ * The pool also tracks the capacity of buffers currently handed out; owners
+ * report growth with resized() so inUseBytes() stays exact without scans.
+ */
+class BufferPool {
+  public:
+	BufferPool();
+	BufferPool(const BufferPool &other);
+	BufferPool &operator=(const BufferPool &other);
+	virtual ~BufferPool();
+
+	/** @brief Get an empty buffer, reusing a pooled one when available. */
+	std::string *acquire();
+	/** @brief Return a buffer obtained from acquire(). NULL is ignored. */
+	void		 release(std::string *buffer);
+	/** @brief Record a capacity change of a buffer that is handed out. */
+	void		 resized(std::size_t oldCapacity, std::size_t newCapacity);
+	/** @brief Free pooled buffers until at most maxBuffers remain. */
+	void		 shrink(std::size_t maxBuffers);
+
+	std::size_t pooledCount() const;
+	std::size_t pooledBytes() const;
+	std::size_t inUseBytes() const;
+
+  private:
+	std::vector<std::string *> free_;
+	std::size_t				   pooledBytes_;
+	std::size_t				   inUseBytes_;
+};
+
+#endif // BUFFERPOOL_HPP
@@ -11,11 +11,14 @@ private:
 	std::string data_;
 	std::string caseMappedData_;
 
+public:
 	// Static helper methods for case mapping
 	static char toCaseMapped(char c);
 	static std::string toCaseMappedString(const std::string& str);
+	// Compare/hash under the case mapping without building mapped copies
+	static bool equalsCaseMapped(const std::string& a, const std::string& b);
+	static unsigned long hashCaseMapped(const std::string& str);
 
-public:
 	CaseMappedString();
 	CaseMappedString(const std::string& str);
 	CaseMappedString(const char* str);
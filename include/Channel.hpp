@@ -4,18 +4,47 @@
 #include <string>
 #include <set>
 #include <map>
+#include <vector>
 #include <ctime>
 
+#include "FloodControl.hpp"
+#include "MaskList.hpp"
+#include "MessageHistory.hpp"
+
+// RPL_NAMREPLY lines, CRLF included, never exceed this (RFC 1459 2.3)
+#define NAMES_LINE_MAX 512
+
 class Message;
 class Client;
 class MessageQueueManager;
+class Metrics;
+class StateWriter;
+class StateReader;
 
 class Channel {
+	public:
+		// One member: where its lines go, and what is cached about it
+		struct Membership {
+			int			fd;
+			// masksVersion_ banned was worked out for; 0 is never
+			unsigned	banCheckedAt;
+			bool		banned;
+			// lines posted, for +f
+			RateWindow	flood;
+			// the namesChunks_ entry holding this member's name
+			unsigned	namesChunk;
+			Membership();
+			explicit Membership(int fd);
+		};
+		typedef std::map<std::string, Membership> Members;
+
 	private:
 		MessageQueueManager			&mqr_;
+		// broadcasts are charged to HEAVY_CHANNEL_BYTES, if set
+		static Metrics				*metrics_;
 		std::string					 name_;
 		// we could also use the unique fd ?
-		std::map<std::string, int>	members_;
+		Members						members_;
 		//(quicker search) if is not empty, is invite only channel
 		std::set<std::string>		whiteList_;
 		std::set<std::string>		operators_;
@@ -30,6 +59,41 @@ class Channel {
 		// privileges such as halfop or operator status in
 		// order to change the topic of a channel
 		bool						isTopicProtected_;
+		// Pre-rendered RPL_NAMREPLY payloads "@op nick ...", each short enough
+		// for a NAMES_LINE_MAX line. Kept in sync by the member/operator
+		// setters, so NAMES never walks members_; each Membership knows its
+		// chunk, so an update only touches that one. Every chunk but the
+		// last is kept at least half full (see namesRepack_).
+		std::vector<std::string>	namesChunks_;
+		std::string::size_type		namesChunkBudget_;
+		// PRIVMSG and NOTICE lines, for CHATHISTORY
+		MessageHistory				history_;
+		// RPL_LIST payload "<channel> <count> :<topic>", rendered by LIST
+		// and reused until the member count or the topic changes
+		mutable std::string			listEntry_;
+		mutable size_t				listEntryCount_;
+		// +b, +e and +I; masksVersion_ moves on with every change to them,
+		// which invalidates the verdicts cached in members_
+		MaskList					bans_;
+		MaskList					exceptions_;
+		MaskList					inviteExceptions_;
+		unsigned					masksVersion_;
+		// +f, and the lines all members posted under it
+		FloodLimit					floodLimit_;
+		RateWindow					flood_;
+
+		void	namesAdd_(const std::string &nickname, bool isOperator);
+		bool	namesFind_(const std::string &nickname, size_t &chunk,
+						   std::string::size_type &pos) const;
+		void	namesRemove_(const std::string &nickname);
+		void	namesRepack_(size_t chunk);
+		// Point the members named in chunk at it
+		void	namesIndex_(size_t chunk);
+		void	namesSetOperator_(const std::string &nickname, bool isOperator);
+		void	namesRename_(const std::string &oldNick, const std::string &newNick);
+		// Queue wire to all members except senderNickname
+		void	broadcastWire_(const std::string &senderNickname,
+							   const std::string &wire) const;
 
 	public:
 	// Channel(std::vector<std::string> members, std::set<std::string>
@@ -37,13 +101,17 @@ class Channel {
 	// std::string password, int userLimit);
 	Channel(const std::string &name, const Client &sender,
 			MessageQueueManager &queueManager);
+	// Rebuild a channel saved by saveState() in the previous process
+	Channel(MessageQueueManager &queueManager, StateReader &in);
 	Channel(const Channel &other);
 	Channel &operator=(const Channel &other);
 	virtual ~Channel();
 
+	static void setMetrics(Metrics &metrics);
+
 		// Getters => necessary or only Utils??
 		const	std::string					&getName() const;
-		const	std::map<std::string, int>	&getMembers() const;
+		const	Members						&getMembers() const;
 		const	std::set<std::string>		&getWhiteList() const;
 		const	std::set<std::string>		&getOperators() const;
 		const	std::string 				&getTopic() const;
@@ -52,11 +120,15 @@ class Channel {
 		const	time_t						&getCreationTime() const;
 		const 	std::string 				&getTopicWho() const;
 		const 	time_t 						&getTopicTime() const;
+		const	std::vector<std::string>	&getNamesChunks() const;
+		const	std::string					&getListEntry() const;
 
 		// Setters => necessary or only Utils and full constructor??
 		void setTopic(const std::string &topic);
 		void setTopicWho(const std::string &topicWho);
 		void setTopicTime();
+		void setTopicTime(time_t topicTime);
+		void setCreationTime(time_t creationTime);
 		void setPassword(const std::string &password);
 		void setUserLimit(int limit);
 		void changeNick(const std::string &oldNick, const std::string &newNick);
@@ -65,10 +137,22 @@ class Channel {
 	void broadcastMsg(const std::string &senderNickname,
 						const Message		&message) const;
 	void broadcastMsg(const Client &sender, const Message &message) const;
+	// Same, then keep the line in the history, without copying it again
+	void broadcastAndRecord(const Client &sender, const Message &message);
+	const MessageHistory &getHistory() const;
+	// Restored from the journal: serve what it said before (see MessageHistory)
+	void keepEarlierHistory();
+	// Destroyed for good: its history file goes too
+	void discardHistory();
+	// Queue RPL_NAMREPLY (353) lines and RPL_ENDOFNAMES (366) to client
+	void sendNames(const Client &client) const;
+	// Live upgrade (see Handoff)
+	void saveState(StateWriter &out) const;
 
 		void addMember(const Client* client);
 		void removeMember(const std::string &nickname);
 		bool isMember(const std::string &nickname) const;
+		bool isEmpty() const;
 
 		void addToWhiteList(const std::string &nickname);
 		void removeFromWhiteList(const std::string &nickname);
@@ -80,6 +164,24 @@ class Channel {
 
 		void setInviteOnly(bool value);
 		void setTopicProtected(bool value);
+		// 'b', 'e' or 'I'; NULL for any other mode
+		const MaskList *getMaskList(char mode) const;
+		// false if the mask is listed already or the list is full
+		bool addMask(char mode, const std::string &mask,
+					 const std::string &setter, time_t setAt);
+		bool removeMask(char mode, const std::string &mask);
+		// matches a ban and no exception
+		bool isBanned(const Client &client) const;
+		// same for a member, answered from its membership once worked out
+		bool isBannedMember(const Client &member);
+		bool isInviteException(const Client &client) const;
+
+		const FloodLimit &getFloodLimit() const;
+		void setFloodLimit(const FloodLimit &limit);
+		// +f check of a line sender is about to post, before it is
+		// serialized; a line that passes is counted
+		FloodVerdict admitLine(const Client &sender, time_t now);
+
 		bool checkKey(const std::string& key) const;
 		bool isInviteOnly() const;
 		bool isTopicProtected() const;
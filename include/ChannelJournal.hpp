@@ -0,0 +1,146 @@
+#ifndef CHANNELJOURNAL_HPP
+#define CHANNELJOURNAL_HPP
+
+#include <pthread.h>
+#include <stdint.h>
+#include <string>
+
+#include "ChannelSnapshot.hpp"
+
+// Files kept in the state directory
+#define JOURNAL_FILE		  "channels.journal"
+#define SNAPSHOT_FILE		  "channels.snapshot"
+// The journal is folded into a new snapshot once it grew past this
+#define JOURNAL_COMPACT_BYTES (1u << 20)
+
+class Channel;
+
+// Kinds of journal entries; each sets a field, so replaying one twice is
+// harmless
+enum JournalOp {
+	JOURNAL_CREATE = 1,		// who: creator's hostmask, number: creation time
+	JOURNAL_TOPIC,			// text, who, number: time set
+	JOURNAL_INVITE_ONLY,	// number: 0 or 1
+	JOURNAL_TOPIC_PROTECTED,// number: 0 or 1
+	JOURNAL_KEY,			// text, empty to remove
+	JOURNAL_LIMIT,			// number, 0 to remove
+	JOURNAL_OPERATOR,		// who: hostmask, number: 1 = +o, 0 = -o
+	JOURNAL_INVITE,			// who: hostmask, number: 1 = invited, 0 = used
+	JOURNAL_MASK,			// text: list mode and mask, who: setter,
+							// number: time set, 0 to remove
+	JOURNAL_FLOOD,			// text: +f parameter, empty to remove
+	JOURNAL_DESTROY			// the channel emptied: forget its state
+};
+
+/**
+ * @brief Crash-safe record of channel state, for a fast restart.
+ *
+ * Every TOPIC, MODE and INVITE that changes a channel, and the channel
+ * emptying (which forgets it), is appended to JOURNAL_FILE as one framed
+ * entry (length, FNV-1a checksum, sequence number, operation). The loop thread only encodes the entry into a buffer;
+ * a writer thread takes the whole buffer, writes it and calls fdatasync
+ * once per batch, so a burst of changes costs one sync.
+ *
+ * Past JOURNAL_COMPACT_BYTES the loop hands the writer a copy of every
+ * channel changed since the last snapshot; the writer merges it into a new
+ * SNAPSHOT_FILE (see ChannelSnapshot) and empties the journal, and tick()
+ * switches to the new mapping. Startup maps the snapshot and replays at
+ * most one journal's worth of entries, whatever the number of channels.
+ *
+ * A torn entry at the end of the journal (crash mid-write) is cut off on
+ * open. Entries already covered by the snapshot (crash between rename and
+ * truncation) are skipped by sequence number.
+ */
+class ChannelJournal {
+  public:
+	ChannelJournal();
+	virtual ~ChannelJournal();
+
+	/**
+	 * @brief Load the state kept in dir and start the writer thread.
+	 * @throws std::runtime_error if the directory is unusable or already
+	 *         used by another server.
+	 */
+	void open(const std::string &dir);
+	/** @brief Flush what is queued, stop the writer and release the files. */
+	void close();
+	bool isOpen() const;
+	/** @brief Saved state of a channel; false if there is none. */
+	bool find(const std::string &name, ChannelState &out) const;
+
+	// Operators and invitations are kept as case-mapped nick!user@host
+	// (see Client::getHostmask); taking one away drops every hostmask of
+	// the nickname
+	void created(const Channel &channel, const std::string &creator);
+	void topicChanged(const Channel &channel);
+	/** @param argument key, limit or hostmask, for modes that take one */
+	void modeChanged(const std::string &channel, char mode, bool on,
+					 const std::string &argument);
+	/** @param on false once the invitation got its holder in */
+	void invited(const std::string &channel, const std::string &hostmask,
+				 bool on);
+	/** @param mode 'b', 'e' or 'I' */
+	void maskChanged(const std::string &channel, char mode, bool on,
+					 const MaskList::Entry &mask);
+	/** @brief The last member left; shutdown and crashes do not count. */
+	void destroyed(const std::string &channel);
+
+	/** @brief Start or finish a compaction; call once per loop iteration. */
+	void tick();
+
+  private:
+	struct Entry {
+		uint64_t	seq;
+		uint8_t		op;
+		std::string channel;
+		std::string text;
+		std::string who;
+		uint64_t	number;
+		Entry();
+	};
+
+	std::string		 dir_;
+	int				 journalFd_;
+	ChannelSnapshot	 snapshot_;
+	// channels changed since snapshot_ was written
+	ChannelStateMap	 changes_;
+	uint64_t		 seq_;
+	// bytes queued for the journal since the last compaction started
+	std::size_t		 journalBytes_;
+
+	// shared with the writer, under lock_
+	pthread_t		 thread_;
+	bool			 running_;
+	pthread_mutex_t	 lock_;
+	pthread_cond_t	 wake_;
+	bool			 stopRequested_;
+	std::string		 pending_;
+	// compaction handed to the writer: the first compactOffset_ bytes of
+	// pending_ precede it in the journal, the rest go to the emptied one
+	bool			 compactRequested_;
+	ChannelStateMap	 compactChanges_;
+	uint64_t		 compactSeq_;
+	std::size_t		 compactOffset_;
+	bool			 compacted_;
+	bool			 compactOk_;
+	// loop thread only: a compaction is between request and tick()
+	bool			 compacting_;
+	// writer only: a write error was reported
+	bool			 failed_;
+
+	ChannelJournal(const ChannelJournal &other);
+	ChannelJournal &operator=(const ChannelJournal &other);
+
+	// Number, apply and queue entry
+	void		  record_(Entry &entry);
+	// Entry into the state of its channel; false for an unknown op
+	bool		  apply_(const Entry &entry);
+	ChannelState &state_(const std::string &name);
+	std::size_t	  replay_();
+	static void	  encode_(const Entry &entry, std::string &out);
+	static void	 *run_(void *self);
+	void		  write_(const char *data, std::size_t length);
+	bool		  compact_(const ChannelStateMap &changes, uint64_t seq);
+};
+
+#endif // CHANNELJOURNAL_HPP
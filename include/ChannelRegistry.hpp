@@ -0,0 +1,75 @@
+#ifndef CHANNELREGISTRY_HPP
+#define CHANNELREGISTRY_HPP
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "Channel.hpp"
+#include "Slab.hpp"
+
+// Bucket count of a fresh registry; always a power of two
+#define CHANNELREGISTRY_MIN_BUCKETS 16
+
+/**
+ * @brief Hash table of live channels keyed by the case-mapped channel name.
+ *
+ * "#Foo" and "#foo" name the same channel (see CaseMappedString). Channels
+ * are stored in a Slab, so a Channel* stays valid until that channel is
+ * erased and freed slots are reused by later channels instead of growing the
+ * heap. Lookups go through an open-addressing index (linear probing, load
+ * factor at most 1/2, backward-shift deletion) holding the name hash and the
+ * slab handle.
+ *
+ * Empty channels are not kept: callers removing members call eraseIfEmpty()
+ * so the registry only ever holds channels with at least one member.
+ *
+ * Iteration is done by slot like Slab: at(i) for i < slotCount() returns the
+ * channel or NULL. Erasing the channel at the current slot is allowed.
+ */
+class ChannelRegistry {
+  public:
+	ChannelRegistry();
+	ChannelRegistry(const ChannelRegistry &other);
+	ChannelRegistry &operator=(const ChannelRegistry &other);
+	virtual ~ChannelRegistry();
+
+	/** @brief Channel named name under the case mapping, or NULL. */
+	Channel		  *find(const std::string &name);
+	const Channel *find(const std::string &name) const;
+	/**
+	 * @brief Store a copy of channel, whose name must not be registered yet.
+	 * @return The stored channel.
+	 */
+	Channel		  *insert(const Channel &channel);
+	/** @brief Destroy the named channel; unknown names are ignored. */
+	void		   erase(const std::string &name);
+	/**
+	 * @brief Destroy channel if its last member left.
+	 * @return true if it was destroyed; channel must not be used afterwards.
+	 */
+	bool		   eraseIfEmpty(Channel &channel);
+
+	/** @brief Number of live channels. */
+	std::size_t	   size() const;
+	bool		   empty() const;
+	std::size_t	   slotCount() const;
+	Channel		  *at(std::size_t slot);
+	const Channel *at(std::size_t slot) const;
+
+  private:
+	struct Bucket {
+		unsigned long hash;
+		SlabHandle	  channel; // null marks an empty bucket
+		Bucket() : hash(0), channel() {}
+	};
+
+	// Bucket holding name, or the empty bucket where it would be inserted
+	std::size_t probe_(const std::string &name, unsigned long hash) const;
+	void		rehash_(std::size_t bucketCount);
+
+	Slab<Channel>		channels_;
+	std::vector<Bucket> buckets_;
+};
+
+#endif // CHANNELREGISTRY_HPP
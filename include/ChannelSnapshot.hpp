@@ -0,0 +1,128 @@
+#ifndef CHANNELSNAPSHOT_HPP
+#define CHANNELSNAPSHOT_HPP
+
+#include <cstddef>
+#include <ctime>
+#include <map>
+#include <set>
+#include <stdint.h>
+#include <string>
+
+#include "MaskList.hpp"
+
+class StateWriter;
+class StateReader;
+
+// First word of a snapshot file; the version changes with the record layout
+#define SNAPSHOT_MAGIC	 0x49524353u	// "IRCS"
+#define SNAPSHOT_VERSION 1u
+
+/**
+ * @brief What survives a restart of one channel: the state set by TOPIC,
+ *        MODE and INVITE, not its members.
+ *
+ * operators holds the case-mapped nick!user@host of the clients given +o
+ * (the creator included) and not taken -o since; invited those invited and
+ * not joined since. The +b/+e/+I lists
+ * and +f come last in a record; records written before they existed end
+ * earlier and load without them.
+ */
+struct ChannelState {
+	std::string			  name;
+	std::string			  topic;
+	std::string			  topicWho;
+	time_t				  topicTime;
+	time_t				  creationTime;
+	std::string			  key;
+	int					  limit;
+	bool				  inviteOnly;
+	bool				  topicProtected;
+	std::set<std::string> operators;
+	std::set<std::string> invited;
+	MaskList			  bans;
+	MaskList			  exceptions;
+	MaskList			  inviteExceptions;
+	// +f parameter, empty if unset
+	std::string			  flood;
+	// journal sequence of the last change; not stored in snapshots
+	uint64_t			  seq;
+	// forgotten since: a journal tombstone, which snapshots leave out
+	bool				  destroyed;
+
+	ChannelState();
+	void save(StateWriter &out) const;
+	void load(StateReader &in);
+	// 'b', 'e' or 'I'; NULL for any other mode
+	const MaskList *maskList(char mode) const;
+	MaskList		 *maskList(char mode);
+};
+
+// Keyed by the case-mapped channel name
+typedef std::map<std::string, ChannelState> ChannelStateMap;
+
+/**
+ * @brief Read-only, memory-mapped image of every saved channel.
+ *
+ * Layout: a header (magic, version, journal sequence it covers, record
+ * count), an index of (name hash, offset, length) sorted by hash, then the
+ * records written by ChannelState::save(). open() only maps the file and
+ * checks the header, so it costs the same for ten channels or a million;
+ * find() binary-searches the index and decodes the one record it hits.
+ *
+ * write() builds a new file next to the target and renames it over, after
+ * an fsync of both the file and the directory, so a crash leaves either the
+ * old or the new snapshot in place.
+ */
+class ChannelSnapshot {
+  public:
+	ChannelSnapshot();
+	virtual ~ChannelSnapshot();
+
+	/**
+	 * @brief Map path; a missing file is an empty snapshot.
+	 * @throws std::runtime_error if the file exists but is not a snapshot.
+	 */
+	void		open(const std::string &path);
+	void		close();
+	/** @brief Journal sequence number folded into this snapshot. */
+	uint64_t	seq() const;
+	std::size_t count() const;
+	/** @return false if no channel of that name was saved. */
+	bool		find(const std::string &name, ChannelState &out) const;
+
+	/**
+	 * @brief Write base with changes applied over it as the snapshot at
+	 *        path, covering the journal up to seq.
+	 * @return false on any I/O error; the old file is left alone then.
+	 */
+	static bool write(const std::string &path, const ChannelSnapshot &base,
+					  const ChannelStateMap &changes, uint64_t seq);
+
+  private:
+	struct Header {
+		uint32_t magic;
+		uint32_t version;
+		uint64_t seq;
+		uint64_t count;
+	};
+	struct IndexEntry {
+		uint64_t hash;
+		uint64_t offset;
+		uint32_t length;
+		uint32_t reserved;
+	};
+
+	const char		 *data_;
+	std::size_t		  size_;
+	const IndexEntry *index_;
+	std::size_t		  count_;
+	uint64_t		  seq_;
+
+	ChannelSnapshot(const ChannelSnapshot &other);
+	ChannelSnapshot &operator=(const ChannelSnapshot &other);
+
+	// Bytes of the record at index i, or false if it points outside the file
+	bool record_(std::size_t i, std::string &out) const;
+};
+
+#endif // CHANNELSNAPSHOT_HPP
@@ -4,40 +4,97 @@
 #include "CaseMappedString.hpp"
 #include "Message.hpp"
 #include "MessageType.hpp"
+#include "FixedString.hpp"
+#include "Slab.hpp"
 #include <cstdio>
+#include <ctime>
+#include <netinet/in.h>
+#include <stdint.h>
+#include <sys/socket.h>
 #include <string>
 #include <vector>
 
 class Server;
 class Channel;
 class MessageQueueManager;
+class BufferPool;
+class StateWriter;
+class StateReader;
 
+// Stable reference to a Client stored in the Server's client slab.
+typedef SlabHandle ClientHandle;
+
+// Identifier limits advertised to clients. Longer nicknames are rejected,
+// longer user/real names are truncated (https://modern.ircdocs.horse/#user-message)
+#define NICKLEN 30
+#define USERLEN 18
+#define REALLEN 50
+// Upper bound for sizeof(Client); checked at compile time in Client.cpp so
+// layout changes that grow every idle connection are noticed.
+#define CLIENT_SIZE_BUDGET 160
+
+/*
+ * Connection state is laid out hot/cold: the fields touched by every
+ * broadcast, lookup and recv (socket, flags, nickname, receive buffer) come
+ * first, the ones only read when building a prefix or WHO reply follow.
+ * Identifiers are stored inline and the peer address stays binary, so an idle
+ * registered connection never owns heap memory.
+ */
 class   Client
 {
 	private:
-		MessageQueueManager	&mqr_;
-		int					registrationLevel_;
+		// hot
 		int					socket_;
-		CaseMappedString	nickname_;
-		std::string			username_;
-		std::string			realname_;
-		std::string			rawMessage_;
-		std::string			IP_;
+		unsigned char		registrationLevel_;
+		// set once the client is scheduled for close; it stays in the slab
+		// until its outbound queue drained but is no longer addressable
+		bool				closing_;
+		unsigned char		addressFamily_;
+		FixedString<NICKLEN>	nickname_;
+		// partial inbound line; only held while one is pending, taken
+		// from and returned to the shared BufferPool
+		std::string			*rawMessage_;
+		// last time input arrived, drives idle buffer trimming
+		time_t				lastActivity_;
+		// complete lines received, ranks top talkers on the admin socket
+		uint32_t			linesReceived_;
+		// cold
+		FixedString<USERLEN>	username_;
+		FixedString<REALLEN>	realname_;
+		struct in6_addr		address_;
+		// SO_PEERCRED uid of a Unix-domain peer, -1 for network peers
+		long				peerUid_;
+
+		static MessageQueueManager	*queueManager_;
+		static BufferPool			*bufferPool_;
+
+		std::string	*acquireBuffer_() const;
+		void		releaseBuffer_(std::string *buffer) const;
 
   public:
-	Client(MessageQueueManager &queueManager, bool passResolved);
+	Client(bool passResolved);
 	Client(const Client &other);
 	Client &operator=(const Client &other);
-	virtual ~Client();
+	~Client();
+
+	// All clients share the server's outbound queue manager
+	static void setQueueManager(MessageQueueManager &queueManager);
+	// Receive buffers come from this pool; without one they use plain new
+	static void setBufferPool(BufferPool &bufferPool);
 
 	bool operator==(const std::string nickname);
 	bool operator==(const Client &other);
 
-		const std::string		&getNickname() const;
-		const std::string		&getUsername() const;
-		const std::string		&getRealname() const;
+		std::string				getNickname() const;
+		std::string				getUsername() const;
+		std::string				getRealname() const;
 		const std::string		&getRawMessage() const;
-		const std::string		&getIP() const;
+		// textual form of the peer address, formatted on demand
+		std::string				getIP() const;
+		// case-mapped nick!user@host for ban matching; formatted on demand,
+		// as Client has no room left for it (channels cache the verdicts)
+		std::string				getHostmask() const;
+		const struct in6_addr	&getAddress() const;
 
 		void	incrementRegistrationLevel(void);
 		int		getRegistrationLevel(void) const;
@@ -48,11 +105,25 @@ class   Client
 		void	setRealname(const std::string &realname);
 		void	setRawMessage(const std::string &rawMessage);
 		void	setSocket(int socket);
-		void	setIP(const std::string &IP);
+		// stores the peer address in binary form; IPv4 is kept v4-mapped
+		void	setAddress(const struct sockaddr_storage &address);
+		// kernel-verified uid of a Unix-domain peer; shows as its host
+		void	setPeerUid(long uid);
+		long	getPeerUid() const;
 
 		bool	isAuthenticated()	const;
+		bool	isClosing()			const;
+		void	markClosing();
 		void	appendRawMessage(const char partialMessage[BUFSIZ], size_t length);
 		void	clearMessage();
+		void	touch(time_t now);
+		time_t	getLastActivity() const;
+		void	countLine();
+		uint32_t	getLinesReceived() const;
+		// shrinks the receive buffer to its content; returns bytes freed
+		size_t	trimBuffers();
+		// drops the first length bytes of the pending inbound data
+		void	consumeRawMessage(size_t length);
 		void	sendMessage(Message toSend) const;
 		void 	sendCmdValidation(const Message inMessage) const;
 		void	sendCmdValidation(const Message inMessage, const Channel &channel) const;
@@ -66,7 +137,11 @@ class   Client
 		//send to fd stuff
 		void	sendToFd(const std::string &string, int fd) const;
 		void	sendMessageToFd(Message msg, int fd) const;
-		void	welcome(const Server &server);
+		void	welcome(Server &server);
+		// Live upgrade (see Handoff); the Server carries the closing flag
+		// and the outbound queue
+		void	saveState(StateWriter &out) const;
+		void	loadState(StateReader &in);
 };
 
 #endif
@@ -0,0 +1,65 @@
+#ifndef FIXEDSTRING_HPP
+#define FIXEDSTRING_HPP
+
+#include <cstddef>
+#include <cstring>
+#include <string>
+
+/**
+ * @brief Inline, fixed-capacity string of at most N bytes.
+ *
+ * Stores its characters inside the object (no heap allocation), which keeps
+ * per-connection records compact. Assigning a longer value truncates it to N
+ * bytes; callers that must reject overlong input check the length first.
+ */
+template <std::size_t N> class FixedString {
+  public:
+	FixedString() : length_(0) { data_[0] = '\0'; }
+	FixedString(const std::string &str) : length_(0) { assign(str); }
+	FixedString(const FixedString &other) : length_(0) { *this = other; }
+
+	FixedString &operator=(const FixedString &other) {
+		if (this != &other) {
+			length_ = other.length_;
+			std::memcpy(data_, other.data_, length_ + 1u);
+		}
+		return *this;
+	}
+
+	FixedString &operator=(const std::string &str) {
+		assign(str);
+		return *this;
+	}
+
+	~FixedString() {}
+
+	void assign(const std::string &str) {
+		std::size_t len = str.size() < N ? str.size() : N;
+		std::memcpy(data_, str.data(), len);
+		data_[len] = '\0';
+		length_	   = static_cast<unsigned char>(len);
+	}
+
+	std::string str() const { return std::string(data_, length_); }
+	const char *c_str() const { return data_; }
+	std::size_t size() const { return length_; }
+	bool		empty() const { return length_ == 0; }
+	void		clear() {
+		   length_	= 0;
+		   data_[0] = '\0';
+	}
+	static std::size_t capacity() { return N; }
+
+	bool operator==(const std::string &str) const {
+		return str.size() == length_ &&
+			   std::memcmp(data_, str.data(), length_) == 0;
+	}
+	bool operator!=(const std::string &str) const { return !(*this == str); }
+
+  private:
+	// length fits in one byte; the capacity is meant for short identifiers
+	unsigned char length_;
+	char		  data_[N + 1];
+};
+
+#endif // FIXEDSTRING_HPP
@@ -0,0 +1,79 @@
+#ifndef FLOODCONTROL_HPP
+#define FLOODCONTROL_HPP
+
+#include <ctime>
+#include <stdint.h>
+#include <string>
+
+// Bounds of a +f setting; counts saturate at 16 bits
+#define FLOOD_MAX_LINES	  60000
+#define FLOOD_MAX_SECONDS 3600
+
+/**
+ * @brief Lines seen over a sliding window, in eight bytes.
+ *
+ * Keeps the count of the current fixed window and of the one before it;
+ * the rate over the last `seconds` is the current count plus the share of
+ * the previous count the sliding window still overlaps. That is the usual
+ * two-bucket approximation of a true sliding log, without keeping one
+ * timestamp per line.
+ */
+class RateWindow {
+  public:
+	RateWindow();
+	RateWindow(const RateWindow &other);
+	RateWindow &operator=(const RateWindow &other);
+	~RateWindow();
+
+	/** @brief Estimated lines in the `seconds` before now. */
+	unsigned rate(time_t now, unsigned seconds);
+	void	 count(time_t now, unsigned seconds);
+
+  private:
+	uint32_t start_; // beginning of the current window
+	uint16_t current_;
+	uint16_t previous_;
+
+	void roll_(time_t now, unsigned seconds);
+};
+
+// What happens to a member going past the per-member limit
+enum FloodAction {
+	FLOOD_DROP,		// the excess lines are discarded silently
+	FLOOD_THROTTLE, // the excess lines are refused with a 404, and count,
+					// so only slowing down lets the member through again
+	FLOOD_KICK		// the member is kicked
+};
+
+// What became of one line checked against +f
+enum FloodVerdict {
+	FLOOD_PASSED,
+	FLOOD_DROPPED,	// discard it without a word
+	FLOOD_REFUSED,	// discard it and tell the sender
+	FLOOD_KICKED	// discard it and kick the sender
+};
+
+/**
+ * @brief Channel mode +f: "<lines>:<seconds>[,<channel lines>][,<action>]".
+ *
+ * lines is what one member may post per seconds, channel lines what all
+ * members together may (0 for no channel limit), action one of drop,
+ * throttle (the default) and kick. memberLines == 0 means +f is unset.
+ * Past the channel limit lines are dropped or refused, never kicked:
+ * nobody in particular is to blame.
+ */
+struct FloodLimit {
+	unsigned	memberLines;
+	unsigned	channelLines;
+	unsigned	seconds;
+	FloodAction action;
+
+	FloodLimit();
+	bool		isSet() const;
+	/** @brief false, leaving this unchanged, if text is no valid +f. */
+	bool		parse(const std::string &text);
+	// The +f parameter, as parse() reads it; empty when unset
+	std::string toString() const;
+};
+
+#endif // FLOODCONTROL_HPP
@@ -0,0 +1,39 @@
+#ifndef GLOBMASK_HPP
+#define GLOBMASK_HPP
+
+#include <string>
+#include <vector>
+
+/**
+ * @brief IRC wildcard pattern ('*' any run, '?' any one character), compiled
+ *        once and then matched against many strings.
+ *
+ * Compiling case-maps the pattern and splits it at the stars, so matching
+ * is a prefix check, a suffix check and a left-to-right search for each
+ * piece in between: no backtracking and no allocation per candidate.
+ * Comparison follows the server's case mapping (see CaseMappedString).
+ */
+class GlobMask {
+  public:
+	GlobMask();
+	explicit GlobMask(const std::string &pattern);
+	GlobMask(const GlobMask &other);
+	GlobMask &operator=(const GlobMask &other);
+	virtual ~GlobMask();
+
+	const std::string &pattern() const;
+	/** @brief true if the pattern has no wildcard, so it names one string. */
+	bool			   isLiteral() const;
+	bool			   matches(const std::string &text) const;
+
+  private:
+	std::string				 pattern_;
+	// case-mapped pattern cut at each '*'; a single piece means no star
+	std::vector<std::string> pieces_;
+	bool					 literal_;
+
+	static bool pieceAt_(const std::string &piece, const std::string &text,
+						 std::string::size_type pos);
+};
+
+#endif // GLOBMASK_HPP
@@ -0,0 +1,91 @@
+#ifndef HANDOFF_HPP
+#define HANDOFF_HPP
+
+#include <cstddef>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// First word of a handoff; the version changes with the state layout
+#define HANDOFF_MAGIC			 0x49524355u	// "IRCU"
+#define HANDOFF_VERSION			 7u
+// Descriptors per SCM_RIGHTS message (the kernel caps it at 253)
+#define HANDOFF_FDS_PER_MESSAGE	 200
+// Either side gives up on a silent peer after this long
+#define HANDOFF_TIMEOUT_SECONDS	 5
+
+/**
+ * @brief Appends fixed-width integers and length-prefixed strings to a
+ *        byte buffer, in host byte order (both ends run on the same host).
+ */
+class StateWriter {
+  public:
+	StateWriter();
+	StateWriter(const StateWriter &other);
+	StateWriter &operator=(const StateWriter &other);
+	virtual ~StateWriter();
+
+	void			   u8(uint8_t value);
+	void			   u32(uint32_t value);
+	void			   u64(uint64_t value);
+	void			   str(const std::string &value);
+	void			   bytes(const void *data, std::size_t length);
+	const std::string &data() const;
+
+  private:
+	std::string data_;
+};
+
+/**
+ * @brief Reads back what a StateWriter wrote.
+ * @throws std::runtime_error when the buffer ends early.
+ */
+class StateReader {
+  public:
+	explicit StateReader(const std::string &data);
+	StateReader(const StateReader &other);
+	virtual ~StateReader();
+
+	uint8_t		u8();
+	uint32_t	u32();
+	uint64_t	u64();
+	std::string str();
+	void		bytes(void *data, std::size_t length);
+	bool		atEnd() const;
+
+  private:
+	const std::string &data_;
+	std::size_t		   offset_;
+
+	StateReader &operator=(const StateReader &other);
+};
+
+/**
+ * @brief Moves a state blob and a set of descriptors over a connected Unix
+ *        stream socket for a live upgrade.
+ *
+ * Wire format: magic, version, descriptor count and blob length, then the
+ * blob, then the descriptors in SCM_RIGHTS messages of at most
+ * HANDOFF_FDS_PER_MESSAGE, each carrying one filler byte. Descriptors arrive
+ * in the order they were sent. The receiver acknowledges with one byte once
+ * it took over (see acknowledge()).
+ */
+class Handoff {
+  public:
+	/** @brief Bound every blocking call on socket by HANDOFF_TIMEOUT_SECONDS. */
+	static void setTimeouts(int socket);
+	/** @return false on any error or timeout. */
+	static bool send(int socket, const std::string &state,
+					 const std::vector<int> &fds);
+	/** @throws std::runtime_error on any error, mismatch or timeout. */
+	static void receive(int socket, std::string &state, std::vector<int> &fds);
+	/** @brief Tell the sender the new process is serving. */
+	static void acknowledge(int socket);
+	/** @return true if the peer acknowledged in time. */
+	static bool awaitAcknowledge(int socket);
+
+  private:
+	Handoff();
+};
+
+#endif // HANDOFF_HPP
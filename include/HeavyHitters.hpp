@@ -0,0 +1,63 @@
+#ifndef HEAVYHITTERS_HPP
+#define HEAVYHITTERS_HPP
+
+#include <cstddef>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// Count-min sketch rows and counters per row (power of two)
+#define HEAVY_DEPTH 4
+#define HEAVY_WIDTH 1024
+// Keys tracked by name in the top list
+#define HEAVY_TOP	16
+
+/**
+ * @brief Streaming top-K of a keyed counter without per-key storage.
+ *
+ * add() bumps HEAVY_DEPTH counters of a count-min sketch and reads the
+ * key's estimate back as their minimum, which never undercounts and
+ * overcounts by about total/HEAVY_WIDTH. Keys whose estimate beats the
+ * smallest of the HEAVY_TOP tracked ones replace it in a min-heap; only
+ * those carry a label. Every update costs HEAVY_DEPTH + HEAVY_TOP steps at
+ * most, whatever the number of distinct keys.
+ *
+ * decay() halves all counts, so the list follows recent traffic rather than
+ * the whole uptime.
+ */
+class HeavyHitters {
+  public:
+	struct Entry {
+		uint64_t	key;
+		uint64_t	estimate;
+		std::string label;
+	};
+
+	HeavyHitters();
+	HeavyHitters(const HeavyHitters &other);
+	HeavyHitters &operator=(const HeavyHitters &other);
+	virtual ~HeavyHitters();
+
+	/**
+	 * @brief Account amount to key.
+	 * @return true if key just entered the top list; name it with setLabel().
+	 */
+	bool		add(uint64_t key, uint64_t amount = 1);
+	void		setLabel(uint64_t key, const std::string &label);
+	/** @brief Halve every counter and estimate. */
+	void		decay();
+	/** @brief The tracked keys, largest estimate first. */
+	std::vector<Entry> top() const;
+	/** @brief Sum of everything added since the last decay() halving. */
+	uint64_t	total() const;
+
+  private:
+	uint64_t		   counters_[HEAVY_DEPTH][HEAVY_WIDTH];
+	std::vector<Entry> heap_;	// min-heap on estimate
+	uint64_t		   total_;
+
+	void		siftDown_(std::size_t index);
+	std::size_t find_(uint64_t key) const;
+};
+
+#endif // HEAVYHITTERS_HPP
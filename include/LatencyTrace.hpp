@@ -0,0 +1,70 @@
+#ifndef LATENCYTRACE_HPP
+#define LATENCYTRACE_HPP
+
+// Hot-path latency tracing. Built with -DLATENCY_TRACE (see `make trace`)
+// every inbound line is timestamped at recv, after parsing and after
+// execution, and every reply it causes at enqueue and when its last byte is
+// handed to send(2). The intervals land in per-command log-bucketed
+// histograms held in static memory. Otherwise all macros below compile to
+// nothing and MessageQueue carries no stamps.
+
+#include <stdint.h>
+
+// Intervals recorded for each command, all relative to the recv timestamp
+// except LATENCY_STAGE_SEND
+enum LatencyStage {
+	LATENCY_STAGE_PARSE,	// recv -> Message parsed
+	LATENCY_STAGE_EXECUTE,	// recv -> Command::execute returned
+	LATENCY_STAGE_ENQUEUE,	// recv -> reply queued, once per recipient
+	LATENCY_STAGE_SEND,		// queued -> last byte written
+	LATENCY_STAGE_TOTAL,	// recv -> last byte written
+	LATENCY_STAGE_COUNT
+};
+
+#ifdef LATENCY_TRACE
+# include <ostream>
+
+// Origin of a queued payload; recvUsec is 0 when no inbound line caused it
+struct LatencyStamp {
+	uint64_t recvUsec;
+	uint64_t enqueueUsec;
+	unsigned command;
+};
+
+// Monotonic microseconds
+uint64_t		latencyTraceNow();
+// A recv(2) returned data; the lines it completes share this timestamp
+void			latencyTraceRecv();
+// The current line parsed as command type; name is copied into a fixed table
+void			latencyTraceParsed(const char *type);
+void			latencyTraceExecuted();
+// The current line is done; payloads queued from now on are not attributed
+void			latencyTraceEnd();
+// Records the enqueue interval and returns the stamp to keep with the payload
+LatencyStamp	latencyTraceEnqueued();
+void			latencyTraceSent(const LatencyStamp &stamp);
+// One line per command and stage: count, mean and p50/p90/p99/p99.9/max in
+// microseconds. The format is stable so snapshots of two builds can be diffed
+void			latencyTraceDump(std::ostream &out);
+// Async-signal-safe request for a dump at the next latencyTracePoll()
+void			latencyTraceRequestDump();
+void			latencyTracePoll(std::ostream &out);
+
+# define LATENCY_TRACE_RECV() latencyTraceRecv()
+# define LATENCY_TRACE_PARSED(type) latencyTraceParsed(type)
+# define LATENCY_TRACE_EXECUTED() latencyTraceExecuted()
+# define LATENCY_TRACE_END() latencyTraceEnd()
+# define LATENCY_TRACE_DUMP(out) latencyTraceDump(out)
+# define LATENCY_TRACE_REQUEST_DUMP() latencyTraceRequestDump()
+# define LATENCY_TRACE_POLL(out) latencyTracePoll(out)
+#else
+# define LATENCY_TRACE_RECV() (void(0))
+# define LATENCY_TRACE_PARSED(type) (void(0))
+# define LATENCY_TRACE_EXECUTED() (void(0))
+# define LATENCY_TRACE_END() (void(0))
+# define LATENCY_TRACE_DUMP(out) (void(0))
+# define LATENCY_TRACE_REQUEST_DUMP() (void(0))
+# define LATENCY_TRACE_POLL(out) (void(0))
+#endif
+
+#endif // !LATENCYTRACE_HPP
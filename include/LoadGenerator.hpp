@@ -0,0 +1,156 @@
+#ifndef LOADGENERATOR_HPP
+#define LOADGENERATOR_HPP
+
+#include "MessageQueueManager.hpp"
+#include <csignal>
+#include <poll.h>
+#include <stdint.h>
+#include <sys/socket.h>
+#include <map>
+#include <string>
+#include <vector>
+
+// Connections handshaking at once; keep below the server's --backlog
+#define BENCH_DEFAULT_INFLIGHT 8
+// Latency samples kept for the percentiles (reservoir sampled beyond that)
+#define BENCH_MAX_SAMPLES	   (1u << 20)
+// Prefix of the trailing parameter of every timed PRIVMSG
+#define BENCH_PAYLOAD_TAG	   "bench"
+
+// Actions of a traffic mix, picked by weight for every scheduled message
+enum BenchAction {
+	BENCH_CHANNEL_CHAT,
+	BENCH_PRIVATE_CHAT,
+	BENCH_NICK_CHURN,
+	BENCH_QUIT,
+	BENCH_ACTION_COUNT
+};
+
+/**
+ * @brief Settings of one ircbench run, filled from --name=value options.
+ */
+struct BenchConfig {
+	std::string	   host;
+	unsigned short port;
+	std::string	   password;
+	unsigned	   clients;
+	unsigned	   channels;
+	unsigned	   duration;  // seconds of traffic after the ramp-up
+	unsigned	   rate;	  // scheduled actions per second, 0 = unthrottled
+	unsigned	   inflight;  // concurrent handshakes during ramp-up
+	unsigned	   weights[BENCH_ACTION_COUNT];
+	unsigned	   payload;	  // padding bytes appended to chat messages
+
+	BenchConfig();
+
+	/**
+	 * @brief Apply one "--name=value" option.
+	 * @return false if the option is unknown or its value is malformed.
+	 */
+	bool			   parseOption(const std::string &option);
+	/** @brief Lines describing the accepted options, for the usage text. */
+	static const char *usage();
+
+  private:
+	bool parseMix_(const std::string &mix);
+};
+
+/**
+ * @brief Single-process IRC load generator.
+ *
+ * Drives BenchConfig::clients connections from one poll loop; outbound lines
+ * go through a shared MessageQueueManager, inbound lines are split on CRLF
+ * and parsed with Message. Every connection registers, joins one of the
+ * bench channels and then takes part in the scripted mix.
+ *
+ * Chat messages carry "bench <sender> <seq> <sent-usec>" in their payload.
+ * Receivers compute the delivery latency from the monotonic timestamp (the
+ * clock is shared, everything runs in this process) and check that the
+ * sequence numbers of each sender arrive in order.
+ */
+class LoadGenerator {
+  public:
+	explicit LoadGenerator(const BenchConfig &config);
+	virtual ~LoadGenerator();
+
+	/** @brief Ramp up, run the mix for the configured duration and report.
+	 *  @return false if the server could not be resolved or the ramp-up
+	 *          stalled. */
+	bool run();
+	/** @brief Async-signal-safe: end the traffic phase early and report. */
+	static void requestStop();
+
+  private:
+	enum ConnState {
+		CONN_CLOSED,
+		CONN_CONNECTING,
+		CONN_REGISTERING,
+		CONN_JOINING,
+		CONN_READY,
+		CONN_QUITTING
+	};
+
+	struct Conn {
+		int			  fd;
+		ConnState	  state;
+		unsigned	  channel;
+		unsigned	  nickGeneration;
+		unsigned	  sentSeq;
+		uint64_t	  connectStart;
+		std::string	  nick;
+		std::string	  rx;
+		// last sequence number seen per sender index, for ordering checks
+		std::map<unsigned, unsigned> lastSeq;
+	};
+
+	struct Stats {
+		unsigned long connects;
+		unsigned long connectFailures;
+		unsigned long sent[BENCH_ACTION_COUNT];
+		unsigned long delivered;
+		unsigned long outOfOrder;
+		unsigned long errors;		// error numerics and dropped connections
+		unsigned long noSuchNick;	// private chat raced a nick change or quit
+		uint64_t	  connectUsecTotal;
+		uint64_t	  rampStart;
+		uint64_t	  rampEnd;
+		uint64_t	  trafficStart;
+		uint64_t	  trafficEnd;
+	};
+
+	const BenchConfig	  config_;
+	struct sockaddr_storage address_;
+	socklen_t			  addressLen_;
+	MessageQueueManager	  queues_;
+	std::vector<Conn>	  conns_;
+	std::vector<int>	  connByFd_;
+	std::vector<uint32_t> samples_;
+	unsigned long		  samplesSeen_;
+	unsigned long		  scheduled_;
+	unsigned long		  random_;
+	Stats				  stats_;
+
+	static volatile sig_atomic_t stopRequested_;
+
+	LoadGenerator(const LoadGenerator &other);
+	LoadGenerator &operator=(const LoadGenerator &other);
+
+	static uint64_t nowUsec();
+	unsigned long	nextRandom_();
+	bool			resolve_();
+	bool			rampUp_();
+
+	bool openConnection_(unsigned index);
+	void closeConnection_(unsigned index, bool reconnect);
+	void sendLine_(Conn &conn, const std::string &line);
+	void pollOnce_(int timeoutMs);
+	void readFrom_(unsigned index);
+	void handleLine_(unsigned index, const std::string &line);
+	void recordDelivery_(Conn &receiver, const std::string &payload);
+	void scheduleTraffic_(uint64_t now);
+	void performAction_(unsigned index, BenchAction action);
+	unsigned countInState_(ConnState state) const;
+	void report_() const;
+};
+
+#endif // LOADGENERATOR_HPP
@@ -0,0 +1,77 @@
+#ifndef LOOPWATCHDOG_HPP
+#define LOOPWATCHDOG_HPP
+
+#include <pthread.h>
+#include <stdint.h>
+
+#include "Metrics.hpp"
+
+/**
+ * @brief Per-phase loop timing and stall detection.
+ *
+ * The event loop calls enter() at every phase boundary, idle() right before
+ * poll(2) and setFd()/setCommand() while serving a client. Time between two
+ * calls is charged to the phase in Metrics; an iteration runs from the first
+ * enter() after poll to the next idle() and is recorded in the loop
+ * histogram.
+ *
+ * With a non-zero budget start() spawns a thread that samples the loop every
+ * budget/2. An iteration running longer than the budget is logged to stderr
+ * while it is still stuck, together with the phase, client fd and command,
+ * so hangs show up even if the loop never returns. When the iteration ends
+ * it is recorded as a LoopStall; iterations the thread missed fall back to
+ * their slowest phase.
+ *
+ * The loop publishes its position through volatile fields written only by
+ * the loop thread; the watchdog may read a torn command name, which only
+ * affects the diagnostic.
+ */
+class LoopWatchdog {
+  public:
+	explicit LoopWatchdog(Metrics &metrics);
+	virtual ~LoopWatchdog();
+
+	/** @brief Start the watchdog thread; budgetUsec 0 only times phases. */
+	void start(uint64_t budgetUsec);
+	/** @brief Join the watchdog thread, if running. */
+	void stop();
+
+	void enter(LoopPhase phase);
+	/** @brief End the iteration; the loop is about to block in poll(2). */
+	void idle();
+	void setFd(int fd);
+	/** @brief name is copied and cut to METRICS_COMMAND_LEN. */
+	void setCommand(const char *name);
+
+  private:
+	Metrics					  &metrics_;
+	uint64_t				   budgetUsec_;
+	pthread_t				   thread_;
+	bool					   running_;
+	volatile bool			   stopRequested_;
+
+	// published by the loop thread
+	volatile uint64_t		   iterationStart_;	// 0 while in poll
+	volatile unsigned long	   generation_;		// iterations finished
+	volatile LoopPhase		   phase_;
+	volatile int			   fd_;
+	volatile char			   command_[METRICS_COMMAND_LEN + 1];
+	// loop thread only
+	uint64_t				   phaseStart_;
+	LoopPhase				   slowestPhase_;
+	uint64_t				   slowestUsec_;
+
+	// written by the watchdog, taken by idle() under captureLock_
+	pthread_mutex_t			   captureLock_;
+	LoopStall				   capture_;
+	unsigned long			   captureGeneration_;
+	bool					   captured_;
+
+	LoopWatchdog(const LoopWatchdog &other);
+	LoopWatchdog &operator=(const LoopWatchdog &other);
+
+	static void *run_(void *self);
+	void		 check_();
+};
+
+#endif // LOOPWATCHDOG_HPP
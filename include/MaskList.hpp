@@ -0,0 +1,100 @@
+#ifndef MASKLIST_HPP
+#define MASKLIST_HPP
+
+#include <ctime>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "GlobMask.hpp"
+
+// Entries one channel list (+b, +e or +I) holds at most
+#define MASKLIST_LIMIT 4096
+
+class StateWriter;
+class StateReader;
+
+/**
+ * @brief A channel's ban (+b), ban exception (+e) or invite exception (+I)
+ *        list: nick!user@host glob masks, matched against a client's
+ *        hostmask as a whole.
+ *
+ * Every mask is compiled once (see GlobMask) and filed under the most
+ * selective literal part it has, so a check only runs the masks that could
+ * match instead of the whole list:
+ *   - no wildcard at all			the exact set
+ *   - literal host					byHost_["1.2.3.4"]
+ *   - host "literal*"				byHostPrefix_["10.0."], cut at a '.' or ':'
+ *   - host "*literal"				byHostSuffix_[".example.org"], from a '.'
+ *   - literal nickname				byNick_["spammer"]
+ *   - anything else				wild_, the only part scanned in full
+ * A check looks the client's host, nickname, and the host's prefixes and
+ * suffixes at each separator up in those maps, which stays cheap with
+ * thousands of bans as long as they are of the usual *!*@host kinds.
+ *
+ * Keys are case-mapped; entries keep the mask as it was set, with who set
+ * it and when, for the RPL_BANLIST family.
+ */
+class MaskList {
+  public:
+	struct Entry {
+		std::string mask;
+		std::string setter;
+		time_t		setAt;
+		Entry();
+		Entry(const std::string &mask, const std::string &setter, time_t setAt);
+	};
+	// keyed by the case-mapped mask, so listing is in a stable order
+	typedef std::map<std::string, Entry> Entries;
+
+	MaskList();
+	MaskList(const MaskList &other);
+	MaskList &operator=(const MaskList &other);
+	virtual ~MaskList();
+
+	/** @brief "nick", "user@host", "nick!user" and the like as nick!user@host. */
+	static std::string normalize(const std::string &mask);
+
+	/**
+	 * @brief Add mask, which must be normalized.
+	 * @return false if it is listed already or the list is full.
+	 */
+	bool		   add(const std::string &mask, const std::string &setter,
+					   time_t setAt);
+	/** @brief Remove mask; false if it was not listed. */
+	bool		   remove(const std::string &mask);
+	/** @param hostmask case-mapped nick!user@host (see Client::getHostmask) */
+	bool		   matches(const std::string &hostmask) const;
+	bool		   full() const;
+	std::size_t	   size() const;
+	bool		   empty() const;
+	const Entries &entries() const;
+
+	// Live upgrade (see Handoff)
+	void saveState(StateWriter &out) const;
+	void loadState(StateReader &in);
+
+  private:
+	typedef std::map<std::string, std::vector<GlobMask> > Buckets;
+
+	Entries				  entries_;
+	std::set<std::string> exact_;
+	Buckets				  byHost_;
+	Buckets				  byHostPrefix_;
+	Buckets				  byHostSuffix_;
+	Buckets				  byNick_;
+	std::vector<GlobMask> wild_;
+
+	// Where a mask is filed, see above
+	enum Kind { EXACT, HOST, HOST_PREFIX, HOST_SUFFIX, NICK, WILD };
+
+	// Kind of a case-mapped mask, and its key in that bucket map
+	static Kind classify_(const std::string &mapped, std::string &key);
+	Buckets	   *buckets_(Kind kind);
+	static bool anyMatch_(const Buckets &buckets, const std::string &key,
+						  const std::string &hostmask);
+	void		clear_();
+};
+
+#endif // MASKLIST_HPP
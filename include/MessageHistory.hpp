@@ -0,0 +1,121 @@
+#ifndef MESSAGEHISTORY_HPP
+#define MESSAGEHISTORY_HPP
+
+#include <cstddef>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+class StateWriter;
+class StateReader;
+
+// Bytes per line in the on-disk tier; longer lines are cut and re-terminated
+#define HISTORY_SLOT_SIZE 1024
+// First word of a history file; the version changes with the layout
+#define HISTORY_MAGIC	  0x49524348u	// "IRCH"
+#define HISTORY_VERSION	  1u
+
+/** @brief One line of channel history, as it went out on the wire. */
+struct HistoryLine {
+	uint64_t	seq;	// per channel, from 1; 0 marks an empty slot
+	uint64_t	timeMs;	// wall clock, milliseconds since the epoch
+	std::string wire;	// ":nick!user@host PRIVMSG #chan :text\r\n"
+	HistoryLine();
+};
+
+/**
+ * @brief Bounded history of the PRIVMSG and NOTICE lines of one channel.
+ *
+ * Lines are numbered per channel and kept in a ring of `length` slots (see
+ * configure()) indexed by seq % length, so lookups by number cost O(1) and
+ * nothing is ever shifted. record() takes the broadcast's own serialized
+ * line by swapping it into its slot, so the history holds no second copy.
+ *
+ * With a directory set, every line is also written through to a
+ * memory-mapped file of `diskLength` fixed-size slots per channel, which
+ * keeps older lines than the ring and survives the channel being destroyed
+ * or the server restarting; numbering continues where the file stopped.
+ * Lines an earlier incarnation of the channel left there are not served,
+ * since whoever creates it again need not be entitled to them, unless
+ * keepEarlier() says the channel's state was restored.
+ * At most `diskChannels` files are mapped at once; channels past that keep
+ * their history in memory only until one is unmapped. A channel destroyed
+ * for good removes its file (discard()).
+ * Only the header is read when the channel is created; the file is mapped
+ * on first use and unmapped with the channel.
+ *
+ * Times are non-decreasing in seq, so seqAfter() is a binary search.
+ */
+class MessageHistory {
+  public:
+	MessageHistory();
+	explicit MessageHistory(const std::string &channel);
+	MessageHistory(const MessageHistory &other);
+	MessageHistory &operator=(const MessageHistory &other);
+	virtual ~MessageHistory();
+
+	/**
+	 * @param length Lines kept in memory per channel, 0 = no history.
+	 * @param dir Directory of the on-disk tier, empty = memory only.
+	 * @param diskLength Lines kept on disk per channel.
+	 * @param diskChannels Channels with a file mapped at a time.
+	 */
+	static void		   configure(std::size_t length, const std::string &dir,
+								 std::size_t diskLength, std::size_t diskChannels);
+	/** @brief Names of the channels with a file in the directory. */
+	static void		   diskChannels(std::vector<std::string> &out);
+	static bool		   enabled();
+
+	/** @brief Append wire as the next line; wire is left with junk. */
+	void			   record(std::string &wire);
+	/** @brief Oldest line still available, 0 if there is none. */
+	uint64_t		   first() const;
+	/** @brief Newest line, 0 if there never was one. */
+	uint64_t		   last() const;
+	/** @brief Serve the lines left on disk before this channel existed. */
+	void			   keepEarlier();
+	/** @brief The channel is gone for good: remove its file. */
+	void			   discard();
+	/** @return false if line seq is gone or never existed. */
+	bool			   line(uint64_t seq, HistoryLine &out) const;
+	/** @brief First available line sent after timeMs, last() + 1 if none. */
+	uint64_t		   seqAfter(uint64_t timeMs) const;
+
+	// Live upgrade (see Handoff); the disk tier is simply mapped again
+	void			   saveState(StateWriter &out) const;
+	void			   loadState(StateReader &in);
+
+	/** @brief Wall clock in milliseconds. */
+	static uint64_t	   nowMs();
+
+  private:
+	std::string				 channel_;
+	// allocated on the first record()
+	std::vector<HistoryLine> ring_;
+	uint64_t				 last_;
+	// lines up to base_ predate this channel (or this process) and are not
+	// served, see keepEarlier()
+	uint64_t				 base_;
+	// disk tier, mapped on first use (hence mutable)
+	mutable char			*map_;
+	mutable std::size_t		 mapSize_;
+	mutable bool			 diskFailed_;
+
+	static std::size_t		 length_;
+	static std::string		 dir_;
+	static std::size_t		 diskLength_;
+	static std::size_t		 diskChannels_;
+	// files mapped right now, across all channels
+	static std::size_t		 mapped_;
+
+	std::string path_() const;
+	// Numbering left in the channel's file by an earlier incarnation
+	void		readLast_();
+	// Map the channel's file, creating it if needed; false if there is no
+	// disk tier or it is unusable
+	bool		disk_() const;
+	void		unmap_();
+	uint64_t	time_(uint64_t seq) const;
+};
+
+#endif // MESSAGEHISTORY_HPP
@@ -1,11 +1,15 @@
 #ifndef MESSAGEQUEUE_HPP
 #define MESSAGEQUEUE_HPP
 
+#include "LatencyTrace.hpp"
 #include <deque>
 #include <string>
 
 /**
  * @brief A queue of messages which tracks the total byte size.
+ *
+ * With LATENCY_TRACE every part carries the LatencyStamp of its enqueue and
+ * reports it once its last byte was removed by removeBytesFromFront().
  */
 class MessageQueue {
   public:
@@ -22,10 +26,17 @@ class MessageQueue {
 	void			   popFront();
 	void			   removeBytesFromFront(size_t n);
 	void			   clear();
+	// Append every pending byte, in order, to out
+	void			   appendTo(std::string &out) const;
+	// Release spare capacity (partially sent front part, deque blocks)
+	void			   shrinkToFit();
 
   private:
 	std::deque<std::string> parts_;
 	size_t					totalBytes_;
+#ifdef LATENCY_TRACE
+	std::deque<LatencyStamp> stamps_;
+#endif
 };
 
 #endif // MESSAGEQUEUE_HPP
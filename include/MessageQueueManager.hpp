@@ -137,11 +137,46 @@ class MessageQueueManager {
 	 * @brief Check if any dead fds are pending retrieval via takeDeadFds().
 	 */
 	bool			 hasDeadFds() const;
+	/**
+	 * @brief Total bytes queued across all tracked sockets.
+	 *
+	 * Maintained incrementally on every enqueue, partial send and removal.
+	 */
+	std::size_t		 queuedBytes() const;
+	/** @brief Bytes queued for fd; 0 when it has no backlog. O(log N). */
+	std::size_t		 queuedBytes(int fd) const;
+	/**
+	 * @brief Release spare capacity held by the queue of fd.
+	 *
+	 * Queues keep the capacity of their largest burst; this trims it to the
+	 * bytes still pending. No-op when fd has no backlog.
+	 */
+	void			 trim(int fd);
+	/**
+	 * @brief Copy of the bytes still queued for fd, oldest first; empty when
+	 * fd has no backlog. Used to carry output across a live upgrade.
+	 */
+	std::string		 pendingData(int fd) const;
+	/**
+	 * @brief Queue data saved by pendingData() in another process.
+	 *
+	 * Like send() without echoing the bytes to stdout.
+	 */
+	void			 restore(int fd, const std::string &data);
+	/** @brief Shrink the manager's own bookkeeping vectors. */
+	void			 shrinkToFit();
+	/** @brief Bytes written to sockets since construction. */
+	std::size_t		 bytesSent() const;
+	/** @brief Sockets marked dead for exceeding MAX_BACKLOG_SIZE. */
+	std::size_t		 overflowCount() const;
 
   private:
 	std::vector<struct pollfd> pfds_;
 	std::vector<MessageQueue>  queues_;
 	std::vector<int>		   deadFds_;
+	std::size_t				   queuedBytes_;
+	std::size_t				   bytesSent_;
+	std::size_t				   overflowCount_;
 
 	/**
 	 * @brief Find fd in the sorted pfds_.
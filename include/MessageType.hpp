@@ -43,7 +43,33 @@ enum MessageType {
 	ERR_USERNOTINCHANNEL,
 	RPL_NOTOPIC,
 	ERR_CHANNELISFULL,
-	RPL_TOPICWHOTIME
+	RPL_TOPICWHOTIME,
+	RPL_STATSCOMMANDS,
+	RPL_ENDOFSTATS,
+	RPL_STATSUPTIME,
+	RPL_STATSDEBUG,
+	RPL_LUSERCLIENT,
+	RPL_LUSERUNKNOWN,
+	RPL_LUSERCHANNELS,
+	RPL_LUSERME,
+	RPL_LOCALUSERS,
+	RPL_GLOBALUSERS,
+	RPL_MONONLINE,
+	RPL_MONOFFLINE,
+	RPL_MONLIST,
+	RPL_ENDOFMONLIST,
+	ERR_MONLISTFULL,
+	RPL_WHOREPLY,
+	RPL_ENDOFWHO,
+	RPL_WHOISUSER,
+	RPL_WHOISSERVER,
+	RPL_WHOISCHANNELS,
+	RPL_ENDOFWHOIS,
+	RPL_TRYAGAIN,
+	ERR_BANNEDFROMCHAN,
+	ERR_BANLISTFULL,
+	ERR_CANNOTSENDFLOOD,
+	ERR_INVALIDMODEPARAM
 };
 
 struct IrcErrorInfo
@@ -0,0 +1,151 @@
+#ifndef METRICS_HPP
+#define METRICS_HPP
+
+#include <cstddef>
+#include <ctime>
+#include <map>
+#include <stdint.h>
+#include <string>
+
+#include "HeavyHitters.hpp"
+
+// Distinct command names counted; further names are counted as "(other)"
+#define METRICS_MAX_COMMAND_TYPES 64
+// Loop iteration histogram: finite upper bounds (usec) plus one +Inf bucket
+#define METRICS_LOOP_BUCKETS	  10
+// Stalls kept (see LoopWatchdog)
+#define METRICS_STALL_HISTORY	  32
+// Command names in stall records are cut to this length
+#define METRICS_COMMAND_LEN		  15
+// Heavy-hitter counts are halved this often
+#define METRICS_HEAVY_DECAY_SECONDS 60
+
+// Monotonic totals since startup
+enum MetricCounter {
+	METRIC_CONNECTIONS,
+	METRIC_REGISTRATIONS,
+	METRIC_DISCONNECTIONS,
+	METRIC_LINES_IN,
+	METRIC_BYTES_IN,
+	METRIC_BYTES_OUT,
+	METRIC_SENDQ_KILLS,
+	METRIC_ADMISSION_REFUSED,
+	METRIC_LOOP_ITERATIONS,
+	METRIC_LOOP_USEC,
+	METRIC_COUNTER_COUNT
+};
+
+// Current values
+enum MetricGauge {
+	METRIC_CLIENTS,
+	METRIC_USERS,
+	METRIC_USERS_MAX,
+	METRIC_CHANNELS,
+	METRIC_QUEUED_BYTES,
+	METRIC_PENDING_CLOSES,
+	METRIC_LINES_PER_SEC,	// lines received during the last full second
+	METRIC_LOOP_USEC_MAX,	// slowest loop iteration during the last second
+	METRIC_GAUGE_COUNT
+};
+
+// Steps of one event-loop iteration, in order; LOOP_PHASE_POLL is the time
+// spent blocked in poll(2) between iterations
+enum LoopPhase {
+	LOOP_PHASE_POLL,
+	LOOP_PHASE_PREPARE,	// building the pollfd set
+	LOOP_PHASE_ADMIN,
+	LOOP_PHASE_CLOSES,
+	LOOP_PHASE_DRAIN,
+	LOOP_PHASE_POLLIN,
+	LOOP_PHASE_DEAD_FDS,
+	LOOP_PHASE_ACCEPT,
+	LOOP_PHASE_RECLAIM,
+	LOOP_PHASE_COUNT
+};
+
+// Streaming top lists for flood attribution
+enum HeavyKind {
+	HEAVY_CLIENT_LINES,		// lines received, per connection
+	HEAVY_CHANNEL_BYTES,	// bytes queued by channel broadcasts
+	HEAVY_IP_CONNECTS,		// accepted connections, per address
+	HEAVY_KIND_COUNT
+};
+
+// One event-loop iteration that exceeded the stall budget
+struct LoopStall {
+	time_t	  when;
+	uint64_t  usec;
+	LoopPhase phase;	// where it was stuck, or its slowest phase
+	int		  fd;		// client being served, -1 if none
+	char	  command[METRICS_COMMAND_LEN + 1];
+};
+
+/**
+ * @brief Always-on server statistics.
+ *
+ * Counters and gauges are plain array slots updated where the event happens,
+ * so reading any of them (STATS, LUSERS) never walks clients or channels.
+ * Per-second gauges roll over in tick(), which the event loop calls once per
+ * iteration.
+ */
+class Metrics {
+  public:
+	Metrics();
+	Metrics(const Metrics &other);
+	Metrics &operator=(const Metrics &other);
+	virtual ~Metrics();
+
+	void		add(MetricCounter counter, uint64_t amount = 1);
+	void		set(MetricCounter counter, uint64_t value);
+	uint64_t	get(MetricCounter counter) const;
+	void		set(MetricGauge gauge, uint64_t value);
+	void		increment(MetricGauge gauge);
+	void		decrement(MetricGauge gauge);
+	uint64_t	get(MetricGauge gauge) const;
+
+	/** @brief Count one executed command line of the given type. */
+	void		countCommand(const std::string &type);
+	const std::map<std::string, uint64_t> &commandCounts() const;
+
+	/** @brief Account one event-loop iteration that took usec. */
+	void		recordLoop(uint64_t usec);
+	/** @brief Iterations that took at most loopBucketBound(i) usec (not
+	 *  cumulative); the last bucket has no bound. */
+	uint64_t	loopBucket(std::size_t i) const;
+	static uint64_t loopBucketBound(std::size_t i);
+	/** @brief Account usec spent in phase. */
+	void		addPhase(LoopPhase phase, uint64_t usec);
+	uint64_t	phaseUsec(LoopPhase phase) const;
+	void		recordStall(const LoopStall &stall);
+	/** @brief Recent stalls, at most METRICS_STALL_HISTORY, oldest first. */
+	std::size_t stallCount() const;
+	const LoopStall &stall(std::size_t i) const;
+	HeavyHitters	   &heavy(HeavyKind kind);
+	const HeavyHitters &heavy(HeavyKind kind) const;
+	/** @brief Roll the per-second gauges once the second changes and decay
+	 *  the heavy hitters every METRICS_HEAVY_DECAY_SECONDS. */
+	void		tick(time_t now);
+
+	static const char *name(MetricCounter counter);
+	static const char *name(MetricGauge gauge);
+	static const char *name(LoopPhase phase);
+	static const char *name(HeavyKind kind);
+	/** @brief Monotonic clock in microseconds. */
+	static uint64_t	   nowUsec();
+
+  private:
+	uint64_t						counters_[METRIC_COUNTER_COUNT];
+	uint64_t						gauges_[METRIC_GAUGE_COUNT];
+	std::map<std::string, uint64_t> commands_;
+	uint64_t						loopBuckets_[METRICS_LOOP_BUCKETS];
+	uint64_t						phaseUsec_[LOOP_PHASE_COUNT];
+	LoopStall						stalls_[METRICS_STALL_HISTORY];
+	std::size_t						stallsTotal_;	// ring write position
+	time_t							second_;
+	uint64_t						secondLines_;	// METRIC_LINES_IN at second_
+	uint64_t						secondLoopMax_;
+	HeavyHitters					heavy_[HEAVY_KIND_COUNT];
+	time_t							lastDecay_;
+};
+
+#endif // METRICS_HPP
@@ -0,0 +1,58 @@
+#ifndef MONITORREGISTRY_HPP
+#define MONITORREGISTRY_HPP
+
+#include <cstddef>
+#include <map>
+#include <string>
+#include <vector>
+
+class StateWriter;
+class StateReader;
+
+// Nicknames one client may monitor; MONITOR + past it fails with 734
+#define MONITOR_LIMIT 100
+
+/**
+ * @brief Who MONITORs whom, indexed both ways.
+ *
+ * The reverse index maps a case-mapped nickname to the sockets of the clients
+ * watching it, so a registration, NICK change or quit costs one lookup and
+ * reaches only those clients, however many are connected. The forward index
+ * keeps each client's own list (nicknames as it spelled them) for
+ * MONITOR L, - and C, and for dropping it when the client goes away.
+ *
+ * Each list holds at most MONITOR_LIMIT nicknames, so the whole registry is
+ * bounded by MONITOR_LIMIT entries per client.
+ */
+class MonitorRegistry {
+  public:
+	// Nicknames watched by one client: case-mapped -> as given
+	typedef std::map<std::string, std::string> WatchList;
+
+	MonitorRegistry();
+	MonitorRegistry(const MonitorRegistry &other);
+	MonitorRegistry &operator=(const MonitorRegistry &other);
+	virtual ~MonitorRegistry();
+
+	/** @return false if fd's list is full; watching twice is harmless. */
+	bool			   watch(int fd, const std::string &nickname);
+	void			   unwatch(int fd, const std::string &nickname);
+	/** @brief Empty fd's list (MONITOR C, or the client left). */
+	void			   clear(int fd);
+	/** @brief fd's list, NULL if it is empty. */
+	const WatchList	  *list(int fd) const;
+	/** @brief Sockets watching nickname, NULL if there are none. */
+	const std::vector<int> *watchers(const std::string &nickname) const;
+
+	// Live upgrade (see Handoff); sockets keep their numbers
+	void			   saveState(StateWriter &out) const;
+	void			   loadState(StateReader &in);
+
+  private:
+	std::map<int, WatchList>					lists_;
+	std::map<std::string, std::vector<int> >	watchers_;
+
+	void	unwatchMapped_(int fd, const std::string &mapped);
+};
+
+#endif // MONITORREGISTRY_HPP
@@ -0,0 +1,58 @@
+#ifndef NICKINDEX_HPP
+#define NICKINDEX_HPP
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "Client.hpp"
+#include "Slab.hpp"
+
+// Bucket count of a fresh index; always a power of two
+#define NICKINDEX_MIN_BUCKETS 64
+
+/**
+ * @brief Hash index of the nicknames in use, case-mapped, to their clients.
+ *
+ * Same layout as ChannelRegistry (linear probing, load factor at most 1/2,
+ * backward-shift deletion), but the clients stay in the Server's slab: a
+ * bucket only holds the nickname hash and the client handle, and probing
+ * compares against the client's current nickname. Every call therefore
+ * takes that slab, and a client must be erased before its nickname changes
+ * and inserted again after.
+ *
+ * Holds every client that set a nickname and is not closing, registered or
+ * not, since both keep the nickname from being taken.
+ */
+class NickIndex {
+  public:
+	NickIndex();
+	NickIndex(const NickIndex &other);
+	NickIndex &operator=(const NickIndex &other);
+	virtual ~NickIndex();
+
+	/** @brief Client using nickname under the case mapping, or a null handle. */
+	ClientHandle find(const Slab<Client> &clients, const std::string &nickname) const;
+	/** @brief Index client under its current nickname, unless that is taken. */
+	void		 insert(const Slab<Client> &clients, ClientHandle client);
+	/** @brief Drop client's current nickname if it is indexed to client. */
+	void		 erase(const Slab<Client> &clients, ClientHandle client);
+	std::size_t	 size() const;
+
+  private:
+	struct Bucket {
+		unsigned long hash;
+		ClientHandle  client; // null marks an empty bucket
+		Bucket() : hash(0), client() {}
+	};
+
+	// Bucket holding nickname, or the empty bucket where it would go
+	std::size_t probe_(const Slab<Client> &clients, const std::string &nickname,
+					   unsigned long hash) const;
+	void		rehash_(std::size_t bucketCount);
+
+	std::vector<Bucket> buckets_;
+	std::size_t			size_;
+};
+
+#endif // NICKINDEX_HPP
@@ -0,0 +1,52 @@
+#ifndef REPLYSTREAM_HPP
+#define REPLYSTREAM_HPP
+
+#include <string>
+
+#include "MessageQueueManager.hpp"
+
+class Server;
+
+// Streamed replies one client may have queued; more are refused
+#define STREAMS_PER_CLIENT	8
+// A stream only adds to a send queue holding less than this
+#define STREAM_QUEUE_BUDGET (MAX_BACKLOG_SIZE / 2)
+
+enum StreamState {
+	STREAM_DONE,	// finished, the stream can be destroyed
+	STREAM_BLOCKED,	// the send queue is full; resume once it drained
+	STREAM_MORE		// stopped to let the loop breathe; resume right away
+};
+
+/**
+ * @brief A reply too large to queue at once (a history replay, a query over the
+ *        whole user table), produced a chunk per loop iteration.
+ *
+ * The Server owns the streams (see Server::startStream) and calls pump()
+ * right after the send queues drained, so a stream tops its client's queue
+ * up to STREAM_QUEUE_BUDGET and never trips the MAX_BACKLOG_SIZE kill. A
+ * stream that stops for any other reason (a slice of a long scan) returns
+ * STREAM_MORE and the loop polls without sleeping until it is done. A
+ * client's streams run one after the other, in the order they started;
+ * streams of a client that left are destroyed unfinished.
+ */
+class ReplyStream {
+  public:
+	explicit ReplyStream(int fd);
+	virtual ~ReplyStream();
+
+	int					fd() const;
+	virtual StreamState pump(Server &server) = 0;
+
+  protected:
+	const int fd_;
+
+	bool hasRoom(Server &server) const;
+	void send(Server &server, const std::string &line) const;
+
+  private:
+	ReplyStream(const ReplyStream &other);
+	ReplyStream &operator=(const ReplyStream &other);
+};
+
+#endif // REPLYSTREAM_HPP
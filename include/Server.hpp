@@ -1,28 +1,42 @@
 #ifndef SERVER_HPP
 #define SERVER_HPP
 
+#include <csignal>
 #include <ctime>
 #include <map>
 #include <string>
 #include <vector>
 
+#include "AdminSocket.hpp"
+#include "AdmissionControl.hpp"
+#include "BufferPool.hpp"
+#include "ChannelJournal.hpp"
+#include "ChannelRegistry.hpp"
+#include "Handoff.hpp"
+#include "LoopWatchdog.hpp"
 #include "Client.hpp"
 #include "MessageQueueManager.hpp"
+#include "Metrics.hpp"
+#include "MonitorRegistry.hpp"
+#include "NickIndex.hpp"
+#include "ReplyStream.hpp"
+#include "ServerConfig.hpp"
+#include "Slab.hpp"
 
-#define BACKLOG							   10
 #define TIMEOUT							   100 // = /1000 to seconds waiting for events
 #define HOSTNAME						   "AspenWood"
 #define VERSION							   "AspenIrc-0.0"
 #define AVAILABLEUSERMODES				   ""
 #define AVAILABLECHANNELMODES			   "it"
-#define AVAILABLECHANNELMODESWITHPARAMETER "k,o,l"
-
-class	Channel;
+#define AVAILABLECHANNELMODESWITHPARAMETER "b,e,I,k,o,l,f"
+// Client slots visited by one reclamation slice (see reclaimIdleBuffers)
+#define RECLAIM_SLICE					   4096
 
 class	Server {
 	public:
 		virtual ~Server();
-		Server( int port, std::string password );
+		Server( int port, std::string password,
+				const ServerConfig &config = ServerConfig() );
 
 		Server(const Server& other);
 		Server& operator=( const Server& other );
@@ -34,6 +48,10 @@ class	Server {
 		const std::string	&getPassword( void ) const;
 		// ?
 		bool		clientNickExists(CaseMappedString& toCheck);
+		// Unix-domain peer running as the server's uid: registers without PASS
+		static bool	isTrustedPeer(const Client &client);
+		// Non-throwing: returns NULL if no open Client uses that nickname
+		Client		*findClientByNick(const std::string &nickname);
 		void		broadcastMsg(const Message &message) const;
 		void		broadcastErrorMessage(MessageType type, std::string args[], int size);
 		void		broadcastErrorMessage(MessageType type, std::vector<std::string>& args);
@@ -43,61 +61,170 @@ class	Server {
 		void		quitClient(const Client &quitter, const std::string &message);
 		void		quitClient(const Client &quitter,  const Message &msg);
 		const char					   *getTimeCreatedHumanReadable() const;
+		time_t							getTimeCreated() const;
+		// Counters and gauges; queue and channel gauges are synced on access
+		Metrics						   &getMetrics(void);
 		// everything is exposed :
-		std::vector<Client>			   &getClients(void);
-		std::map<std::string, Channel> &getChannels(void);
+		Slab<Client>				   &getClients(void);
+		ChannelRegistry				   &getChannels(void);
+		// Saved channel state; not open without --state-dir
+		ChannelJournal				   &getChannelJournal(void);
+		MonitorRegistry				   &getMonitors(void);
+		// Tell the clients MONITORing nickname that it came online as client,
+		// or went offline if client is NULL
+		void							notifyMonitors(const std::string &nickname,
+													   const Client *client);
 		// Utils
+		// Case-insensitive lookup; NULL if no such channel
 		Channel						   *mapChannel(const std::string &channelName);
+		// Drop nickname from the channel and destroy the channel once empty.
+		// Returns true if it was destroyed (channel is dangling then).
+		bool							removeFromChannel(Channel &channel,
+														  const std::string &nickname);
+		// Add client to channel (its creator is in already) and to the
+		// channel list of its fd
+		void							addToChannel(Channel &channel,
+													 const Client &client);
+		// Names of the channels the client on fd is in, in join order
+		const std::vector<std::string> &channelsOf(int fd);
+		// Take over stream and run it for its client (see ReplyStream);
+		// false, with stream destroyed, if the client has
+		// STREAMS_PER_CLIENT streams going already
+		bool							startStream(ReplyStream *stream);
+		// Give client a new nickname, keeping the nick index in step
+		void							setNickname(Client &client,
+													const std::string &nickname);
 		MessageQueueManager			   &getMessageQueueManager();
 		// Return index in pollFds_ for a given fd, or -1 if not found
 		int								pollFdIndexFromFd(int fd) const;
-		// Return index in clients_ for a given fd, or -1 if not found
-		int								clientIndexFromFd(int fd) const;
+		// Return the handle of the Client on fd, or a null handle
+		ClientHandle					clientHandleFromFd(int fd) const;
 		// Non-throwing: returns NULL if no Client matches fd
 		Client						   *tryClientFromFd(int fd);
+		// Non-throwing: returns NULL if the handle is null or stale
+		Client						   *tryClientFromHandle(ClientHandle handle);
 
 	private:
+		// Per-fd bookkeeping so fd lookups never scan clients_ or pollFds_
+		struct FdEntry {
+			ClientHandle	client;
+			int				pollIndex;
+			bool			listening;
+			// channelsOf(fd), so nothing walks the registry for one client
+			std::vector<std::string>	channels;
+			FdEntry() : client(), pollIndex(-1), listening(false), channels() {}
+		};
+
+		// A stream and the client it answers
+		struct StreamEntry {
+			ClientHandle	client;
+			ReplyStream		*stream;
+		};
+
 		Server(void);
 		// Getters and setters
 		int			getPort(void) const;
-		int	 		getServerSocket(void) const;
-		void		setServerSocket(int serverSocketFd);
 		void		addPollFd(const int fd, const short events, const short revents);
+		void		removePollFd(int fd);
+		FdEntry		&fdEntry(int fd);
 
-		void		handleNewConnection(const struct pollfd &polled);
+		void		handleNewConnection(const std::vector<struct pollfd> &polled);
 		void		handlePollIn(const std::vector<struct pollfd> &polled);
 		void		createListeningSocket(void);
+		// Listener on config_.unixSocket; the path is removed again with it
+		void		createUnixListener(void);
+		// Take over a listening socket opened by whoever started us
+		void		adoptListeningSocket(int fd);
+		void		addListener(int fd);
+		void		removeListener(int fd);
 		void		serverInit(void);
-		void		acceptConnection();
+		void		acceptConnection(int listener);
 		void		processPollIn(struct pollfd request);
 		// Immediately and irrevocably remove and close the client on fd.
 		void		removeClient(int fd);
-		// Mark a client for deferred close after its outbound queue drains.
+		// Flag a client as closing; it is closed once its outbound queue drains.
 		void		schedulePendingClose(int fd);
+		// A registered client is leaving: its watchers see it go offline and
+		// its own MONITOR list is dropped
+		void		leaveMonitors(const Client &client);
 		// Process any scheduled pending closes that are now safe to close.
 		void		processPendingCloses(const std::vector<struct pollfd> &polled);
 		bool		isPendingCloseFd(int fd) const;
 		// Handle MessageQueueManager dead fds cleanup
 		void		handleDeadFds();
+		// Trim buffers of idle clients, a slice of the slab per call
+		void		reclaimIdleBuffers(void);
+		// Run every client's current stream; called right after the queues
+		// drained
+		void		pumpStreams(void);
+		// Receive, pooled and queued outbound bytes; checked against the budget
+		size_t		bufferedBytes(void) const;
 		static void signalHandler(int signum);
+		// Self-pipe written by signalHandler so a stop request wakes poll(2)
+		void		openWakePipe(void);
+		void		readWakePipe(void);
+		// Remove the history files no saved channel will serve again
+		void		expireHistory(void);
+		// false once the loop should end: stopped and drained, drain deadline
+		// passed, or a second stop signal
+		bool		keepServing(void);
+		// Stop accepting, send every client a closing ERROR and schedule it
+		// for close once its queue drained
+		void		startDrain(void);
+		// Live upgrade on SIGHUP: re-execute the binary and hand it the
+		// listener, the clients and the channels (see Handoff). true once
+		// the new process took over; false leaves this one serving.
+		bool		upgrade(void);
+		void		saveState(StateWriter &out, std::vector<int> &fds) const;
+		// Counterpart of upgrade() in the new process; returns the handoff
+		// socket, still to be acknowledged
+		int			restoreFromHandoff(void);
 		void		makeMessage(Client &client);
+		// Charge lines to the client's HEAVY_CLIENT_LINES entry
+		void		countClientLines(const Client &client, uint64_t lines);
 		void		executeIncomingCommandMessage(Client			&sender,
 												  const std::string &rawMessage);
 		Message		buildErrorMessage(MessageType			   type,
 									  std::vector<std::string> messageParams) const;
 		// void		quitClient(const Client &quitter,  const Message &msg);
 
+		const ServerConfig			   config_;
 		const std::string			   name_;
 		const int					   port_;
 		const std::string			   password_;
-		int							   serverSocket_;
+		// Sockets accepted from, in pollFds_ (flagged in fdTable_) like
+		// the clients
+		std::vector<int>			   listeners_;
+		// the one of listeners_ bound to config_.unixSocket, or -1
+		int							   unixListener_;
 		static bool					   running_;
+		static volatile sig_atomic_t   stopSignals_;
+		static volatile sig_atomic_t   upgradeRequested_;
+		static int					   wakePipe_[2];
 		std::vector<struct pollfd>	   pollFds_;
-		std::vector<Client>			   clients_;
-		std::map<std::string, Channel> channels_;
+		Slab<Client>				   clients_;
+		NickIndex					   nicks_;
+		std::vector<FdEntry>		   fdTable_;
+		ChannelRegistry				   channels_;
 		const time_t				   timeCreated_;
 		MessageQueueManager			   messageQueueManager_;
-		std::vector<Client>			   pendingCloseClients_;
+		// fds of closing clients, waiting for their backlog to drain
+		std::vector<int>			   pendingCloseFds_;
+		BufferPool					   bufferPool_;
+		// next slot of clients_ visited by reclaimIdleBuffers
+		size_t						   reclaimCursor_;
+		time_t						   lastReclaim_;
+		Metrics						   metrics_;
+		AdminSocket					   admin_;
+		LoopWatchdog				   watchdog_;
+		AdmissionControl			   admission_;
+		ChannelJournal				   journal_;
+		std::vector<StreamEntry>	   streams_;
+		// a stream stopped with work left: poll without sleeping
+		bool						   streamsBusy_;
+		MonitorRegistry				   monitors_;
+		bool						   draining_;
+		time_t						   drainDeadline_;
 };
 
 #endif // !SERVER_HPP
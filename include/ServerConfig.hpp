@@ -0,0 +1,91 @@
+#ifndef SERVERCONFIG_HPP
+#define SERVERCONFIG_HPP
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Defaults, overridable with --<option>=<value> after <port> <password>
+#define DEFAULT_IDLE_TRIM_SECONDS 60
+#define DEFAULT_MEMORY_BUDGET	  (64u * 1024u * 1024u)
+#define DEFAULT_STALL_BUDGET_MS	  50
+#define DEFAULT_MAX_PER_IP		  16
+#define DEFAULT_MAX_PER_SUBNET	  64
+#define DEFAULT_CONNECT_RATE	  20	// per ADMISSION_WINDOW_SECONDS
+#define DEFAULT_ACCEPTS_PER_LOOP  64
+#define DEFAULT_BACKLOG			  128
+#define DEFAULT_DRAIN_SECONDS	  10
+#define DEFAULT_HISTORY_LENGTH	  128
+#define DEFAULT_HISTORY_DISK	  8192
+#define DEFAULT_HISTORY_FILES	  1024
+
+/**
+ * @brief Tunables of a Server instance.
+ *
+ * Every field has a compiled-in default; main() overrides them from command
+ * line options of the form --name=value (see parseOption()).
+ */
+struct ServerConfig {
+	// Buffers of clients idle for this many seconds are trimmed (--idle-trim)
+	int			idleTrimSeconds;
+	// Buffered bytes above which trimming ignores idleness (--memory-budget)
+	std::size_t memoryBudget;
+	// Unix socket path of the admin interface, empty = off (--admin-socket)
+	std::string adminSocket;
+	// Loop iterations longer than this are reported, 0 = no watchdog
+	// (--stall-budget, milliseconds)
+	unsigned	stallBudgetMs;
+	// Admission caps, 0 = unlimited; loopback is exempt (--max-per-ip,
+	// --max-per-subnet, --connect-rate per 10 s)
+	unsigned	maxPerIp;
+	unsigned	maxPerSubnet;
+	unsigned	connectRate;
+	// Connections accepted per loop iteration before serving clients again
+	// (--accepts-per-loop)
+	unsigned	acceptsPerLoop;
+	// listen(2) backlog of the client listener (--backlog)
+	int			backlog;
+	// On shutdown, flush queued output for at most this long, 0 = close
+	// right away (--drain-timeout, seconds)
+	unsigned	drainSeconds;
+	// Listening sockets inherited from a supervisor (--listen-fd, may be
+	// repeated, or LISTEN_FDS); when set, <port> is not bound
+	std::vector<int> listenFds;
+	// Also accept on a Unix-domain socket at this path, empty = off
+	// (--unix-socket); peers running as the server's uid need no PASS
+	std::string unixSocket;
+	// Directory keeping channel topics, modes and invites across restarts,
+	// empty = nothing is saved (--state-dir)
+	std::string stateDir;
+	// Lines of channel history kept in memory for CHATHISTORY, 0 = none
+	// (--history-length); with --history-dir, --history-disk-length more
+	// are kept on disk per channel and survive restarts, for at most
+	// --history-disk-channels channels at a time
+	std::size_t historyLength;
+	std::string historyDir;
+	std::size_t historyDiskLength;
+	std::size_t historyDiskChannels;
+	// Set by a server handing over on SIGHUP: take listener, clients and
+	// channels from this socket instead of binding (--upgrade-fd)
+	int			upgradeFd;
+	// The full command line, re-executed on SIGHUP
+	std::vector<std::string> arguments;
+
+	ServerConfig();
+
+	/**
+	 * @brief Apply one "--name=value" option.
+	 * @return false if the option is unknown or its value is malformed.
+	 */
+	bool parseOption(const std::string &option);
+	/**
+	 * @brief Adopt sockets passed with the systemd LISTEN_FDS convention
+	 * (fds 3 onwards, LISTEN_PID naming this process), unless --listen-fd
+	 * was given. The variables are removed so children do not see them.
+	 */
+	void inheritListenFds();
+	/** @brief Lines describing the accepted options, for the usage text. */
+	static const char *usage();
+};
+
+#endif // SERVERCONFIG_HPP
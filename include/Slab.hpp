@@ -0,0 +1,172 @@
+#ifndef SLAB_HPP
+#define SLAB_HPP
+
+#include <cstddef>
+#include <new>
+#include <vector>
+
+/**
+ * @brief Lightweight reference to a record stored in a Slab.
+ *
+ * A handle names a slot index plus the generation the slot had when the
+ * record was inserted. Releasing a record bumps the slot generation, so stale
+ * handles resolve to NULL instead of silently pointing at the next occupant.
+ * Generation 0 is never handed out and marks the null handle.
+ */
+struct SlabHandle {
+	unsigned int index;
+	unsigned int generation;
+
+	SlabHandle() : index(0), generation(0) {}
+	SlabHandle(unsigned int i, unsigned int g) : index(i), generation(g) {}
+
+	bool isNull() const { return generation == 0; }
+	bool operator==(const SlabHandle &other) const {
+		return index == other.index && generation == other.generation;
+	}
+	bool operator!=(const SlabHandle &other) const { return !(*this == other); }
+};
+
+/**
+ * @brief Arena of fixed-address records with free-list reuse.
+ *
+ * Records live in chunks of ChunkSize slots that are never moved or freed
+ * while the slab is alive, so a T* obtained from get() stays valid until that
+ * record is erased, no matter how many other records are inserted or removed.
+ * Freed slots are pushed on a LIFO free list and reused by later inserts,
+ * which keeps churn from growing the arena.
+ *
+ * Iteration is done by slot: for (i = 0; i < slotCount(); ++i) at(i) returns
+ * the record or NULL for a free slot.
+ */
+template <typename T, std::size_t ChunkSize = 256> class Slab {
+  public:
+	Slab() : size_(0) {}
+
+	Slab(const Slab &other) : size_(0) { *this = other; }
+
+	// Copies every live record into the same slot index so that handles
+	// taken from other resolve to the matching copy in this slab.
+	Slab &operator=(const Slab &other) {
+		if (this == &other)
+			return *this;
+		clear();
+		reserveSlots_(other.slotCount());
+		generations_ = other.generations_;
+		live_		 = other.live_;
+		freeList_	 = other.freeList_;
+		for (std::size_t i = 0; i < other.slotCount(); ++i) {
+			if (other.live_[i])
+				new (slotPtr_(i)) T(*other.slotPtr_(i));
+		}
+		size_ = other.size_;
+		return *this;
+	}
+
+	virtual ~Slab() {
+		clear();
+		for (std::size_t c = 0; c < chunks_.size(); ++c)
+			::operator delete(chunks_[c]);
+	}
+
+	/** @brief Copy value into a free slot and return its handle. */
+	SlabHandle insert(const T &value) {
+		std::size_t slot;
+		if (!freeList_.empty()) {
+			slot = freeList_.back();
+			freeList_.pop_back();
+		} else {
+			slot = slotCount();
+			reserveSlots_(slot + 1);
+			generations_.push_back(0);
+			live_.push_back(false);
+		}
+		new (slotPtr_(slot)) T(value);
+		if (++generations_[slot] == 0) // skip the null generation on wrap
+			generations_[slot] = 1;
+		live_[slot] = true;
+		++size_;
+		return SlabHandle(static_cast<unsigned int>(slot), generations_[slot]);
+	}
+
+	/** @brief Destroy the record named by h. No-op for stale handles. */
+	void erase(SlabHandle h) {
+		if (!get(h))
+			return;
+		slotPtr_(h.index)->~T();
+		live_[h.index] = false;
+		freeList_.push_back(h.index);
+		--size_;
+	}
+
+	/** @brief Resolve a handle; NULL when it is null or stale. */
+	T *get(SlabHandle h) {
+		if (h.isNull() || h.index >= slotCount() || !live_[h.index] ||
+			generations_[h.index] != h.generation)
+			return NULL;
+		return slotPtr_(h.index);
+	}
+
+	const T *get(SlabHandle h) const {
+		return const_cast<Slab *>(this)->get(h);
+	}
+
+	/** @brief Record at slot, or NULL if the slot is free. */
+	T *at(std::size_t slot) {
+		if (slot >= slotCount() || !live_[slot])
+			return NULL;
+		return slotPtr_(slot);
+	}
+
+	const T *at(std::size_t slot) const {
+		return const_cast<Slab *>(this)->at(slot);
+	}
+
+	/** @brief Current handle for a live slot (null handle if free). */
+	SlabHandle handleAt(std::size_t slot) const {
+		if (slot >= slotCount() || !live_[slot])
+			return SlabHandle();
+		return SlabHandle(static_cast<unsigned int>(slot), generations_[slot]);
+	}
+
+	/** @brief Number of live records. */
+	std::size_t size() const { return size_; }
+	bool		empty() const { return size_ == 0; }
+	/** @brief Upper bound for slot iteration (live and free slots). */
+	std::size_t slotCount() const { return generations_.size(); }
+
+	/** @brief Destroy all records. Chunks are kept for reuse. */
+	void clear() {
+		for (std::size_t i = 0; i < slotCount(); ++i) {
+			if (live_[i]) {
+				slotPtr_(i)->~T();
+				live_[i] = false;
+			}
+		}
+		freeList_.clear();
+		for (std::size_t i = slotCount(); i > 0; --i)
+			freeList_.push_back(static_cast<unsigned int>(i - 1));
+		size_ = 0;
+	}
+
+  private:
+	std::vector<void *>		  chunks_;
+	std::vector<unsigned int> generations_;
+	std::vector<bool>		  live_;
+	std::vector<unsigned int> freeList_;
+	std::size_t				  size_;
+
+	T *slotPtr_(std::size_t slot) const {
+		char *chunk = static_cast<char *>(chunks_[slot / ChunkSize]);
+		return reinterpret_cast<T *>(chunk + (slot % ChunkSize) * sizeof(T));
+	}
+
+	// ::operator new returns memory aligned for any fundamental type, and
+	// sizeof(T) is a multiple of T's alignment, so every slot is aligned.
+	void reserveSlots_(std::size_t slots) {
+		while (chunks_.size() * ChunkSize < slots)
+			chunks_.push_back(::operator new(ChunkSize * sizeof(T)));
+	}
+};
+
+#endif // SLAB_HPP
@@ -0,0 +1,56 @@
+#ifndef CHATHISTORYCOMMAND_HPP
+#define CHATHISTORYCOMMAND_HPP
+
+#include "../Command.hpp"
+#include "../Channel.hpp"
+#include "../ReplyStream.hpp"
+
+// Lines one CHATHISTORY request returns at most
+#define CHATHISTORY_LIMIT 100
+
+class ChathistoryCommand : public Command{
+	public:
+		virtual ~ChathistoryCommand();
+
+		ChathistoryCommand(const ChathistoryCommand &copy);
+		ChathistoryCommand& operator=( const ChathistoryCommand &assign );
+
+		ChathistoryCommand(const Message& msg);
+		void			execute(Server& server, Client& sender);
+		static Command*	fromMessage(const Message& message);
+	private:
+		ChathistoryCommand( void );
+
+		// A msgid= or timestamp= reference as a position between lines:
+		// lines before it end at `before` (excluded), lines after it start
+		// at `after`
+		struct Reference {
+			uint64_t	before;
+			uint64_t	after;
+		};
+
+		static bool	parseReference(const std::string &text,
+								   const MessageHistory &history, Reference &out);
+		static bool	parseLimit(const std::string &text, uint64_t &out);
+		void		fail(Client &sender, const std::string &code,
+						 const std::string &argument, const std::string &reason) const;
+};
+
+// Lines [from, to) of a channel's history, oldest first, in a chathistory
+// BATCH; a channel destroyed meanwhile ends the batch early
+class HistoryStream : public ReplyStream {
+	public:
+		HistoryStream(int fd, const std::string &channel, uint64_t from, uint64_t to);
+		virtual ~HistoryStream();
+		virtual StreamState	pump(Server &server);
+	private:
+		const std::string		channel_;
+		uint64_t				next_;
+		const uint64_t			end_;
+		std::string				batch_;
+		bool					started_;
+		// batch references are unique per server
+		static unsigned long	batches_;
+};
+
+#endif
@@ -12,5 +12,8 @@ public:
 protected:
 	void sendValidationMessages(Client& sender, Channel& channel);
 	void sendValidationMessages_353_366(Client& sender, Channel& channel);
+	// Apply what --state-dir kept of a channel to its new incarnation
+	static void restoreChannel(Channel& channel, const ChannelState& saved,
+							   const Client& restorer);
 };
 #endif
@@ -0,0 +1,66 @@
+#ifndef LISTCOMMAND_HPP
+#define LISTCOMMAND_HPP
+
+#include <ctime>
+#include <vector>
+
+#include "../Command.hpp"
+#include "../Channel.hpp"
+#include "../GlobMask.hpp"
+#include "../ReplyStream.hpp"
+
+// Channel registry slots a LIST visits per loop iteration
+#define LIST_SLICE	4096
+
+// The ELIST conditions of one LIST: a channel is listed if it passes all the
+// bounds, matches one of the masks (any, if there are none) and none of the
+// excluded masks. A zero time bound is unset.
+struct ListFilter {
+	size_t					moreUsersThan;	// U: >n
+	size_t					fewerUsersThan;	// U: <n
+	time_t					createdAfter;	// C: <n minutes ago
+	time_t					createdBefore;	// C: >n minutes ago
+	time_t					topicAfter;		// T: <n minutes ago
+	time_t					topicBefore;	// T: >n minutes ago
+	std::vector<GlobMask>	masks;			// M
+	std::vector<GlobMask>	excluded;		// N: !mask
+
+	ListFilter();
+	bool	parse(const std::string &condition, time_t now);
+	bool	matches(const Channel &channel) const;
+	// Every mask names one channel, so they can be looked up directly
+	bool	namesOnly() const;
+};
+
+class ListCommand : public Command{
+	public:
+		virtual ~ListCommand();
+
+		ListCommand(const ListCommand &copy);
+		ListCommand& operator=( const ListCommand &assign );
+
+		ListCommand(const Message& msg);
+		void			execute(Server& server, Client& sender);
+		static Command*	fromMessage(const Message& message);
+	private:
+		ListCommand( void );
+};
+
+// 321, a 322 line per channel passing the filter, then 323. The walk goes
+// over the channel registry by slot, so channels created or dropped
+// meanwhile are safe; each 322 reuses the channel's cached list entry.
+class ListStream : public ReplyStream {
+	public:
+		ListStream(int fd, const std::string &requester, const ListFilter &filter);
+		virtual ~ListStream();
+		virtual StreamState	pump(Server &server);
+	private:
+		const std::string	requester_;
+		// ":server 322 requester ", ahead of every list entry
+		const std::string	prefix_;
+		const ListFilter	filter_;
+		size_t				cursor_;
+		bool				started_;
+};
+
+#endif
@@ -0,0 +1,20 @@
+#ifndef LUSERSCOMMAND_HPP
+#define LUSERSCOMMAND_HPP
+
+#include "../Command.hpp"
+
+class LusersCommand : public Command{
+	public:
+		virtual ~LusersCommand();
+
+		LusersCommand(const LusersCommand &copy);
+		LusersCommand& operator=( const LusersCommand &assign );
+
+		LusersCommand(const Message& msg);
+		void			execute(Server& server, Client& sender);
+		static Command*	fromMessage(const Message& message);
+	private:
+		LusersCommand( void );
+};
+
+#endif
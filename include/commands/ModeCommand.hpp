@@ -3,6 +3,7 @@
 
 #include "../Command.hpp"
 #include "../Channel.hpp"
+#include "../ReplyStream.hpp"
 
 class ModeCommand : public Command{
 	public:
@@ -18,9 +19,33 @@ class ModeCommand : public Command{
 		ModeCommand( void );
 		void	userMode(Server& server, Client& sender);
 		void	channelMode(Server& server, Client& sender);
-		void processChannelModes(Client &sender, const std::string& modestring,
+		void processChannelModes(Server &server, Client &sender,
+						 const std::string& modestring,
 						 const std::vector<std::string>& parameters,
-						 Channel* channel);
+						 Channel* channel, std::vector<std::string> &applied);
+		// mask is normalized; false if nothing changed
+		bool	updateMask(Server &server, Client &sender, Channel &channel,
+						   char mode, bool addMode, const std::string &mask);
+		void	listMasks(Server &server, Client &sender, const Channel &channel,
+						  char mode);
+};
+
+// A +b, +e or +I list: 367, 348 or 346 lines, then the matching end
+// numeric. Resumes after the last mask sent, so masks added or removed
+// meanwhile are safe.
+class MaskListStream : public ReplyStream {
+	public:
+		MaskListStream(int fd, const std::string &requester,
+					   const std::string &channel, char mode);
+		virtual ~MaskListStream();
+		virtual StreamState	pump(Server &server);
+	private:
+		const std::string	requester_;
+		const std::string	channel_;
+		const char			mode_;
+		// case-mapped key of the last mask sent
+		std::string			last_;
+		bool				started_;
 };
 
 #endif
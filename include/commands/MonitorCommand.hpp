@@ -0,0 +1,31 @@
+#ifndef MONITORCOMMAND_HPP
+#define MONITORCOMMAND_HPP
+
+#include "../Command.hpp"
+
+// Longest comma-separated target list put in one 730-732 reply
+#define MONITOR_REPLY_TARGETS 400
+
+class MonitorCommand : public Command{
+	public:
+		virtual ~MonitorCommand();
+
+		MonitorCommand(const MonitorCommand &copy);
+		MonitorCommand& operator=( const MonitorCommand &assign );
+
+		MonitorCommand(const Message& msg);
+		void			execute(Server& server, Client& sender);
+		static Command*	fromMessage(const Message& message);
+	private:
+		MonitorCommand( void );
+
+		void	add(Server& server, Client& sender, const std::string &targets);
+		void	remove(Server& server, Client& sender, const std::string &targets);
+		void	list(Server& server, Client& sender);
+		void	status(Server& server, Client& sender);
+		// Send targets as replies of type, several per line
+		static void	sendTargets(Client& sender, MessageType type,
+								const std::vector<std::string> &targets);
+};
+
+#endif
@@ -0,0 +1,13 @@
+#ifndef NAMESCOMMAND_HPP
+#define NAMESCOMMAND_HPP
+
+#include "../commands/JoinCommand.hpp"
+#include "../Channel.hpp"
+
+class NamesCommand : public JoinCommand {
+public:
+	NamesCommand(const Message& msg);
+	void			execute(Server& server, Client& sender);
+	static Command*	fromMessage(const Message& message);
+};
+#endif
@@ -0,0 +1,22 @@
+
+#ifndef PARTCOMMAND_HPP
+#define PARTCOMMAND_HPP
+
+#include "../Command.hpp"
+#include "../Channel.hpp"
+
+class PartCommand : public Command{
+	public:
+		virtual ~PartCommand();
+
+		PartCommand(const PartCommand &copy);
+		PartCommand& operator=( const PartCommand &assign );
+
+		PartCommand(const Message& msg);
+		void			execute(Server& server, Client& sender);
+		static Command*	fromMessage(const Message& message);
+	private:
+		PartCommand( void );
+};
+
+#endif
@@ -3,6 +3,8 @@
 
 #include "../Command.hpp"
 
+class Channel;
+
 class PrivmsgCommand : public Command {
 public:
 	PrivmsgCommand(const Message& msg);
@@ -10,6 +12,7 @@ public:
 	static Command*	fromMessage(const Message& message);
 private:
 		void	privmsgRecipient(std::string recipient, Server& server, Client& sender);
+		void	floodKick(Server& server, Channel& channel, const Client& sender);
 };
 
 #endif
@@ -0,0 +1,20 @@
+#ifndef STATSCOMMAND_HPP
+#define STATSCOMMAND_HPP
+
+#include "../Command.hpp"
+
+class StatsCommand : public Command{
+	public:
+		virtual ~StatsCommand();
+
+		StatsCommand(const StatsCommand &copy);
+		StatsCommand& operator=( const StatsCommand &assign );
+
+		StatsCommand(const Message& msg);
+		void			execute(Server& server, Client& sender);
+		static Command*	fromMessage(const Message& message);
+	private:
+		StatsCommand( void );
+};
+
+#endif
@@ -1,13 +1,59 @@
 #ifndef WHOCOMMAND_HPP
 #define WHOCOMMAND_HPP
 
-#include "../commands/JoinCommand.hpp"
+#include "../Command.hpp"
 #include "../Channel.hpp"
+#include "../GlobMask.hpp"
+#include "../ReplyStream.hpp"
 
-class WhoCommand : public JoinCommand {
-public:
-	WhoCommand(const Message& msg);
-	void			execute(Server& server, Client& sender);
-	static Command*	fromMessage(const Message& message);
+// 352 lines a WHO over a mask returns at most
+#define WHO_MAX_RESULTS 500
+// Client slots or channel members a WHO visits per loop iteration
+#define WHO_SLICE		4096
+
+class WhoCommand : public Command{
+	public:
+		virtual ~WhoCommand();
+
+		WhoCommand(const WhoCommand &copy);
+		WhoCommand& operator=( const WhoCommand &assign );
+
+		WhoCommand(const Message& msg);
+		void			execute(Server& server, Client& sender);
+		static Command*	fromMessage(const Message& message);
+
+		// RPL_WHOREPLY (352) about client, for requester
+		static Message	whoReply(const std::string &requester, const std::string &channel,
+								 const Client &client, bool isOperator);
+	private:
+		WhoCommand( void );
 };
+
+// The 352 lines of one WHO, then 315: either the members of a channel or
+// the registered clients whose nickname, username or host matches a mask.
+// Both walks resume where the last slice stopped, so clients joining,
+// leaving or renaming meanwhile are safe.
+class WhoStream : public ReplyStream {
+	public:
+		WhoStream(int fd, const std::string &requester, const std::string &channel);
+		WhoStream(int fd, const std::string &requester, const GlobMask &mask);
+		virtual ~WhoStream();
+		virtual StreamState	pump(Server &server);
+	private:
+		const std::string	requester_;
+		// empty for a mask query
+		const std::string	channel_;
+		const GlobMask		mask_;
+		// channel walk: resume after this nickname
+		std::string			lastMember_;
+		// mask walk: next slot of the client slab
+		size_t				cursor_;
+		size_t				found_;
+		bool				started_;
+
+		// false once the walk is over
+		bool	pumpChannel_(Server &server, size_t &budget);
+		bool	pumpMask_(Server &server, size_t &budget);
+};
+
 #endif
@@ -0,0 +1,53 @@
+#ifndef WHOISCOMMAND_HPP
+#define WHOISCOMMAND_HPP
+
+#include <vector>
+
+#include "../Command.hpp"
+#include "../ReplyStream.hpp"
+
+// Nicknames one WHOIS answers; the rest of the list is ignored
+#define WHOIS_TARGETS		 10
+// Longest channel list put in one 319 reply
+#define WHOIS_CHANNELS_LINE	 400
+// Channels of its target a WHOIS lists per loop iteration
+#define WHOIS_SLICE			 4096
+
+class WhoisCommand : public Command{
+	public:
+		virtual ~WhoisCommand();
+
+		WhoisCommand(const WhoisCommand &copy);
+		WhoisCommand& operator=( const WhoisCommand &assign );
+
+		WhoisCommand(const Message& msg);
+		void			execute(Server& server, Client& sender);
+		static Command*	fromMessage(const Message& message);
+	private:
+		WhoisCommand( void );
+};
+
+// 311, 319, 312 and 318 for each nickname, or 401 and 318. Channels are not
+// indexed per member, so 319 walks the channel registry by slot, a slice
+// per loop iteration; channels joined or left meanwhile may or may not be
+// listed.
+class WhoisStream : public ReplyStream {
+	public:
+		WhoisStream(int fd, const std::vector<std::string> &nicknames);
+		virtual ~WhoisStream();
+		virtual StreamState	pump(Server &server);
+	private:
+		const std::vector<std::string>	nicknames_;
+		// the nickname being answered, its name as the 311 gave it, and
+		// the next of its channels to list
+		size_t							current_;
+		std::string						name_;
+		size_t							cursor_;
+		// 319 being filled
+		std::string						channels_;
+
+		// false once the nickname was answered in full
+		bool	pumpTarget_(Server &server, const Client &sender, size_t &budget);
+};
+
+#endif
@@ -0,0 +1,384 @@
+#include "../include/AdminSocket.hpp"
+#include "../include/Debug.hpp"
+#include "../include/IrcUtils.hpp"
+#include "../include/Metrics.hpp"
+#include "../include/Server.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <functional>
+#include <map>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+typedef std::pair<uint32_t, int>				 TopEntry;
+typedef std::greater<std::pair<uint32_t, int> > TopOrder;
+
+AdminSocket::AdminSocket() : listenFd_(-1) {
+	debug("AdminSocket default constructor called");
+}
+
+AdminSocket::AdminSocket(const AdminSocket &other)
+	: listenFd_(other.listenFd_), path_(other.path_),
+	  sessions_(other.sessions_) {}
+
+AdminSocket &AdminSocket::operator=(const AdminSocket &other) {
+	if (this != &other) {
+		listenFd_ = other.listenFd_;
+		path_	  = other.path_;
+		sessions_ = other.sessions_;
+	}
+	return *this;
+}
+
+// Sockets are released by close(), like the Server's own sockets
+AdminSocket::~AdminSocket() { debug("AdminSocket destructor called"); }
+
+void AdminSocket::open(const std::string &path) {
+	struct sockaddr_un address;
+	std::memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	if (path.empty() || path.size() >= sizeof(address.sun_path))
+		throw std::runtime_error("[Admin] socket path too long");
+	std::memcpy(address.sun_path, path.c_str(), path.size());
+
+	// only a leftover socket may be replaced, never a regular file
+	struct stat st;
+	if (lstat(path.c_str(), &st) == 0) {
+		if (!S_ISSOCK(st.st_mode))
+			throw std::runtime_error("[Admin] path exists and is no socket");
+		unlink(path.c_str());
+	}
+	listenFd_ = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0);
+	if (listenFd_ == -1)
+		throw std::runtime_error("[Admin] socket error");
+	if (bind(listenFd_, reinterpret_cast<struct sockaddr *>(&address),
+			 sizeof(address)) == -1 ||
+		chmod(path.c_str(), 0600) == -1 ||
+		listen(listenFd_, ADMIN_MAX_SESSIONS) == -1) {
+		::close(listenFd_);
+		listenFd_ = -1;
+		throw std::runtime_error("[Admin] bind/listen error");
+	}
+	path_ = path;
+}
+
+void AdminSocket::close() {
+	for (std::size_t i = 0; i < sessions_.size(); ++i)
+		::close(sessions_[i].fd);
+	sessions_.clear();
+	if (listenFd_ == -1)
+		return;
+	::close(listenFd_);
+	listenFd_ = -1;
+	unlink(path_.c_str());
+}
+
+bool AdminSocket::isOpen() const { return listenFd_ != -1; }
+
+void AdminSocket::appendPollfds(std::vector<struct pollfd> &target) const {
+	if (listenFd_ == -1)
+		return;
+	struct pollfd entry = {listenFd_, 0, 0};
+	if (sessions_.size() < ADMIN_MAX_SESSIONS)
+		entry.events = POLLIN;
+	target.push_back(entry);
+	for (std::size_t i = 0; i < sessions_.size(); ++i) {
+		const Session &session = sessions_[i];
+		entry.fd			   = session.fd;
+		entry.events		   = session.job == JOB_READ ? POLLIN : 0;
+		// listings also ask for POLLOUT to be woken again right away
+		if (session.written < session.output.size() ||
+			session.job == JOB_QUEUES || session.job == JOB_TOP)
+			entry.events |= POLLOUT;
+		target.push_back(entry);
+	}
+}
+
+void AdminSocket::serve(const std::vector<struct pollfd> &polled,
+						std::size_t first, Server &server) {
+	if (listenFd_ == -1 || first >= polled.size())
+		return;
+	const std::size_t count =
+		std::min(sessions_.size(), polled.size() - first - 1);
+	for (std::size_t i = 0; i < count; ++i) {
+		Session				&session = sessions_[i];
+		const short			 revents = polled[first + 1 + i].revents;
+		bool				 alive	 = !(revents & (POLLERR | POLLNVAL));
+		if (alive && session.job == JOB_READ && (revents & (POLLIN | POLLHUP)))
+			alive = readRequest_(session, server);
+		if (alive)
+			advanceJob_(session, server);
+		if (alive && (revents & POLLOUT))
+			alive = flush_(session);
+		if (alive && session.job == JOB_DONE &&
+			session.written == session.output.size())
+			alive = false;
+		if (!alive) {
+			::close(session.fd);
+			session.fd = -1;
+		}
+	}
+	std::size_t kept = 0;
+	for (std::size_t i = 0; i < sessions_.size(); ++i) {
+		if (sessions_[i].fd == -1)
+			continue;
+		if (kept != i)
+			sessions_[kept] = sessions_[i];
+		++kept;
+	}
+	sessions_.resize(kept);
+	if (polled[first].revents & POLLIN)
+		acceptSessions_();
+}
+
+void AdminSocket::acceptSessions_() {
+	while (sessions_.size() < ADMIN_MAX_SESSIONS) {
+		const int fd = accept(listenFd_, NULL, NULL);
+		if (fd == -1) {
+			if (errno == EINTR)
+				continue;
+			break; // EAGAIN or an error; the listener stays usable
+		}
+		Session session;
+		session.fd		= fd;
+		session.job		= JOB_READ;
+		session.written = 0;
+		session.cursor	= 0;
+		sessions_.push_back(session);
+		// the listener's O_NONBLOCK is not inherited
+		int flags = fcntl(fd, F_GETFL, 0);
+		if (flags != -1)
+			fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+	}
+}
+
+bool AdminSocket::readRequest_(Session &session, Server &server) {
+	char	buffer[512];
+	ssize_t n = recv(session.fd, buffer, sizeof(buffer), MSG_DONTWAIT);
+	if (n < 0)
+		return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+	if (n > 0)
+		session.request.append(buffer, static_cast<std::size_t>(n));
+	std::string::size_type end = session.request.find('\n');
+	if (end == std::string::npos) {
+		if (session.request.size() > ADMIN_MAX_REQUEST)
+			end = 0; // garbage; answer with the help text
+		else if (n == 0 && !session.request.empty())
+			end = session.request.size(); // peer shut down after the line
+		else
+			return n > 0;
+	}
+	std::string line = session.request.substr(0, end);
+	if (!line.empty() && line[line.size() - 1] == '\r')
+		line.erase(line.size() - 1);
+	std::string().swap(session.request);
+	startJob_(session, line, server);
+	return true;
+}
+
+void AdminSocket::startJob_(Session &session, const std::string &request,
+							Server &server) {
+	std::string name = request;
+	bool		http = false;
+	if (name.compare(0, 4, "GET ") == 0) {
+		http = true;
+		name = name.substr(4, name.find(' ', 4) - 4);
+		if (!name.empty() && name[0] == '/')
+			name.erase(0, 1);
+	}
+	const bool known = name == "metrics" || name == "queues" ||
+					   name == "top" || name == "stalls" || name == "heavy";
+	if (http)
+		session.output += std::string("HTTP/1.0 ") +
+						  (known ? "200 OK" : "404 Not Found") +
+						  "\r\nContent-Type: text/plain; version=0.0.4"
+						  "\r\nConnection: close\r\n\r\n";
+	session.job	   = JOB_DONE;
+	session.cursor = 0;
+	if (name == "metrics")
+		writeMetrics_(session.output, server);
+	else if (name == "stalls")
+		writeStalls_(session.output, server);
+	else if (name == "heavy")
+		writeHeavy_(session.output, server);
+	else if (name == "queues") {
+		session.output += "# fd nick sendq_bytes recvq_bytes\n";
+		session.job = JOB_QUEUES;
+	} else if (name == "top") {
+		session.top.clear();
+		session.job = JOB_TOP;
+	} else
+		session.output += "requests: metrics queues top stalls heavy help\n";
+}
+
+void AdminSocket::advanceJob_(Session &session, Server &server) {
+	if (session.job != JOB_QUEUES && session.job != JOB_TOP)
+		return;
+	if (session.output.size() - session.written >= ADMIN_OUTPUT_HIGH)
+		return;
+	Slab<Client>		&clients = server.getClients();
+	MessageQueueManager &queues	 = server.getMessageQueueManager();
+	const std::size_t	 slots	 = clients.slotCount();
+	const std::size_t	 end	 = std::min(session.cursor + ADMIN_SLICE, slots);
+	for (; session.cursor < end; ++session.cursor) {
+		const Client *client = clients.at(session.cursor);
+		if (!client)
+			continue;
+		const int fd = client->getSocket();
+		if (session.job == JOB_QUEUES) {
+			const std::string nick = client->getNickname();
+			session.output += toString(fd) + " " + (nick.empty() ? "*" : nick) +
+							  " " + toString(queues.queuedBytes(fd)) + " " +
+							  toString(client->getRawMessage().size()) + "\n";
+			continue;
+		}
+		const TopEntry entry(client->getLinesReceived(), fd);
+		if (session.top.size() < ADMIN_TOP_COUNT) {
+			session.top.push_back(entry);
+			std::push_heap(session.top.begin(), session.top.end(), TopOrder());
+		} else if (entry.first > session.top.front().first) {
+			std::pop_heap(session.top.begin(), session.top.end(), TopOrder());
+			session.top.back() = entry;
+			std::push_heap(session.top.begin(), session.top.end(), TopOrder());
+		}
+	}
+	if (session.cursor < slots)
+		return;
+	if (session.job == JOB_TOP)
+		writeTop_(session, server);
+	session.job = JOB_DONE;
+}
+
+bool AdminSocket::flush_(Session &session) {
+	while (session.written < session.output.size()) {
+		const ssize_t n =
+			send(session.fd, session.output.data() + session.written,
+				 session.output.size() - session.written,
+				 MSG_NOSIGNAL | MSG_DONTWAIT);
+		if (n > 0) {
+			session.written += static_cast<std::size_t>(n);
+			continue;
+		}
+		if (n < 0 && errno == EINTR)
+			continue;
+		return n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+	}
+	std::string().swap(session.output);
+	session.written = 0;
+	return true;
+}
+
+// Label values are client-supplied command names
+static std::string escapeLabel(const std::string &value) {
+	std::string out;
+	for (std::size_t i = 0; i < value.size(); ++i) {
+		if (value[i] == '\\' || value[i] == '"')
+			out += '\\';
+		if (value[i] == '\n')
+			out += "\\n";
+		else
+			out += value[i];
+	}
+	return out;
+}
+
+static std::string seconds(uint64_t usec) {
+	char buffer[32];
+	std::snprintf(buffer, sizeof(buffer), "%g",
+				  static_cast<double>(usec) / 1000000.0);
+	return buffer;
+}
+
+void AdminSocket::writeMetrics_(std::string &out, Server &server) {
+	const Metrics &metrics = server.getMetrics();
+	for (int i = 0; i < METRIC_COUNTER_COUNT; ++i) {
+		const MetricCounter counter = static_cast<MetricCounter>(i);
+		const std::string	name	= std::string("ircserv_") +
+								  Metrics::name(counter) + "_total";
+		out += "# TYPE " + name + " counter\n" + name + " " +
+			   toString(metrics.get(counter)) + "\n";
+	}
+	for (int i = 0; i < METRIC_GAUGE_COUNT; ++i) {
+		const MetricGauge gauge = static_cast<MetricGauge>(i);
+		const std::string name	= std::string("ircserv_") + Metrics::name(gauge);
+		out += "# TYPE " + name + " gauge\n" + name + " " +
+			   toString(metrics.get(gauge)) + "\n";
+	}
+	out += "# TYPE ircserv_commands_total counter\n";
+	const std::map<std::string, uint64_t> &commands = metrics.commandCounts();
+	for (std::map<std::string, uint64_t>::const_iterator it = commands.begin();
+		 it != commands.end(); ++it)
+		out += "ircserv_commands_total{command=\"" + escapeLabel(it->first) +
+			   "\"} " + toString(it->second) + "\n";
+	out += "# TYPE ircserv_loop_duration_seconds histogram\n";
+	uint64_t cumulative = 0;
+	for (std::size_t i = 0; i < METRICS_LOOP_BUCKETS; ++i) {
+		cumulative += metrics.loopBucket(i);
+		const std::string le = i + 1 < METRICS_LOOP_BUCKETS
+								   ? seconds(Metrics::loopBucketBound(i))
+								   : std::string("+Inf");
+		out += "ircserv_loop_duration_seconds_bucket{le=\"" + le + "\"} " +
+			   toString(cumulative) + "\n";
+	}
+	out += "ircserv_loop_duration_seconds_sum " +
+		   seconds(metrics.get(METRIC_LOOP_USEC)) + "\n" +
+		   "ircserv_loop_duration_seconds_count " +
+		   toString(metrics.get(METRIC_LOOP_ITERATIONS)) + "\n";
+	out += "# TYPE ircserv_loop_phase_seconds_total counter\n";
+	for (int i = 0; i < LOOP_PHASE_COUNT; ++i) {
+		const LoopPhase phase = static_cast<LoopPhase>(i);
+		out += std::string("ircserv_loop_phase_seconds_total{phase=\"") +
+			   Metrics::name(phase) + "\"} " +
+			   seconds(metrics.phaseUsec(phase)) + "\n";
+	}
+}
+
+void AdminSocket::writeStalls_(std::string &out, Server &server) {
+	const Metrics &metrics = server.getMetrics();
+	out += "# unix_time usec phase fd command\n";
+	for (std::size_t i = 0; i < metrics.stallCount(); ++i) {
+		const LoopStall &stall = metrics.stall(i);
+		out += toString(stall.when) + " " + toString(stall.usec) + " " +
+			   Metrics::name(stall.phase) + " " + toString(stall.fd) + " " +
+			   (stall.command[0] ? stall.command : "-") + "\n";
+	}
+}
+
+void AdminSocket::writeHeavy_(std::string &out, Server &server) {
+	const Metrics &metrics = server.getMetrics();
+	for (int i = 0; i < HEAVY_KIND_COUNT; ++i) {
+		const HeavyKind		kind  = static_cast<HeavyKind>(i);
+		const HeavyHitters &heavy = metrics.heavy(kind);
+		out += std::string("# ") + Metrics::name(kind) + " total " +
+			   toString(heavy.total()) + "\n";
+		const std::vector<HeavyHitters::Entry> top = heavy.top();
+		for (std::size_t j = 0; j < top.size(); ++j)
+			out += toString(top[j].estimate) + " " + top[j].label + "\n";
+	}
+}
+
+void AdminSocket::writeTop_(Session &session, Server &server) {
+	std::sort_heap(session.top.begin(), session.top.end(), TopOrder());
+	session.output += "# lines fd nick\n";
+	for (std::size_t i = 0; i < session.top.size(); ++i) {
+		const Client *client = server.tryClientFromFd(session.top[i].second);
+		if (!client)
+			continue;
+		const std::string nick = client->getNickname();
+		session.output += toString(session.top[i].first) + " " +
+						  toString(session.top[i].second) + " " +
+						  (nick.empty() ? "*" : nick) + "\n";
+	}
+	std::vector<TopEntry>().swap(session.top);
+}
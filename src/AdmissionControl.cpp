@@ -0,0 +1,222 @@
+#include "../include/AdmissionControl.hpp"
+#include "../include/Debug.hpp"
+
+#include <cstring>
+
+AdmissionControl::Entry::Entry()
+	: prefix(0), hash(0), connections(0), windowStart(0), current(0),
+	  previous(0) {
+	std::memset(&address, 0, sizeof(address));
+}
+
+// Zero every bit after the first prefix bits
+static struct in6_addr maskAddress(const struct in6_addr &address,
+								   unsigned char		  prefix) {
+	struct in6_addr masked = address;
+	for (unsigned i = 0; i < sizeof(masked.s6_addr); ++i) {
+		const unsigned bit = i * 8;
+		if (bit >= prefix)
+			masked.s6_addr[i] = 0;
+		else if (bit + 8 > prefix)
+			masked.s6_addr[i] &= static_cast<unsigned char>(0xff << (bit + 8 - prefix));
+	}
+	return masked;
+}
+
+// 32-bit FNV-1a over the address bytes and the prefix length
+static uint32_t hashAddress(const struct in6_addr &address,
+							unsigned char		   prefix) {
+	uint32_t hash = 2166136261u;
+	for (unsigned i = 0; i < sizeof(address.s6_addr); ++i) {
+		hash ^= address.s6_addr[i];
+		hash *= 16777619u;
+	}
+	hash ^= prefix;
+	return hash * 16777619u;
+}
+
+static bool isLoopback(const struct in6_addr &address) {
+	if (IN6_IS_ADDR_V4MAPPED(&address))
+		return address.s6_addr[12] == 127;
+	return IN6_IS_ADDR_LOOPBACK(&address);
+}
+
+static unsigned char subnetPrefix(const struct in6_addr &address) {
+	return IN6_IS_ADDR_V4MAPPED(&address) ? ADMISSION_V4_PREFIX
+										  : ADMISSION_V6_PREFIX;
+}
+
+AdmissionControl::AdmissionControl()
+	: buckets_(ADMISSION_MIN_BUCKETS), size_(0), perIp_(0), perSubnet_(0),
+	  connectRate_(0), lastExpire_(0) {
+	debug("AdmissionControl default constructor called");
+}
+
+AdmissionControl::AdmissionControl(const AdmissionControl &other)
+	: buckets_(other.buckets_), size_(other.size_), perIp_(other.perIp_),
+	  perSubnet_(other.perSubnet_), connectRate_(other.connectRate_),
+	  lastExpire_(other.lastExpire_) {}
+
+AdmissionControl &AdmissionControl::operator=(const AdmissionControl &other) {
+	if (this != &other) {
+		buckets_	 = other.buckets_;
+		size_		 = other.size_;
+		perIp_		 = other.perIp_;
+		perSubnet_	 = other.perSubnet_;
+		connectRate_ = other.connectRate_;
+		lastExpire_	 = other.lastExpire_;
+	}
+	return *this;
+}
+
+AdmissionControl::~AdmissionControl() {
+	debug("AdmissionControl destructor called");
+}
+
+void AdmissionControl::setLimits(unsigned perIp, unsigned perSubnet,
+								 unsigned connectRate) {
+	perIp_		 = perIp;
+	perSubnet_	 = perSubnet;
+	connectRate_ = connectRate;
+}
+
+AdmissionVerdict AdmissionControl::admit(const struct in6_addr &address,
+										 time_t					now) {
+	if (isLoopback(address))
+		return ADMISSION_ADMIT;
+	// room for both entries up front, so the references below stay valid
+	if ((size_ + 2) * 2 > buckets_.size())
+		rehash_(buckets_.size() * 2, 0);
+	Entry &ip = entry_(address, 128);
+	if (connectRate_ && countAttempt_(ip, now) > connectRate_)
+		return ADMISSION_RATE_LIMIT;
+	if (perIp_ && ip.connections >= perIp_)
+		return ADMISSION_IP_LIMIT;
+	const unsigned char prefix = subnetPrefix(address);
+	Entry &subnet = entry_(maskAddress(address, prefix), prefix);
+	if (perSubnet_ && subnet.connections >= perSubnet_)
+		return ADMISSION_SUBNET_LIMIT;
+	++ip.connections;
+	++subnet.connections;
+	return ADMISSION_ADMIT;
+}
+
+void AdmissionControl::release(const struct in6_addr &address) {
+	if (isLoopback(address))
+		return;
+	Entry *ip = find_(address, 128);
+	if (ip && ip->connections)
+		--ip->connections;
+	const unsigned char prefix = subnetPrefix(address);
+	Entry *subnet = find_(maskAddress(address, prefix), prefix);
+	if (subnet && subnet->connections)
+		--subnet->connections;
+}
+
+void AdmissionControl::adopt(const struct in6_addr &address) {
+	if (isLoopback(address))
+		return;
+	if ((size_ + 2) * 2 > buckets_.size())
+		rehash_(buckets_.size() * 2, 0);
+	++entry_(address, 128).connections;
+	const unsigned char prefix = subnetPrefix(address);
+	++entry_(maskAddress(address, prefix), prefix).connections;
+}
+
+void AdmissionControl::expire(time_t now) {
+	if (now - lastExpire_ < ADMISSION_WINDOW_SECONDS)
+		return;
+	lastExpire_ = now;
+	std::size_t bucketCount = ADMISSION_MIN_BUCKETS;
+	while (bucketCount < size_ * 4 && bucketCount < buckets_.size())
+		bucketCount *= 2;
+	rehash_(bucketCount, now);
+}
+
+std::size_t AdmissionControl::size() const { return size_; }
+
+const char *AdmissionControl::reason(AdmissionVerdict verdict) {
+	switch (verdict) {
+	case ADMISSION_IP_LIMIT:
+		return "Too many connections from your host";
+	case ADMISSION_SUBNET_LIMIT:
+		return "Too many connections from your network";
+	case ADMISSION_RATE_LIMIT:
+		return "Reconnecting too fast, try again later";
+	default:
+		return "";
+	}
+}
+
+std::size_t AdmissionControl::probe_(const struct in6_addr &address,
+									 unsigned char prefix, uint32_t hash) const {
+	const std::size_t mask = buckets_.size() - 1;
+	std::size_t		  i	   = hash & mask;
+	while (buckets_[i].prefix) {
+		if (buckets_[i].hash == hash && buckets_[i].prefix == prefix &&
+			std::memcmp(&buckets_[i].address, &address, sizeof(address)) == 0)
+			return i;
+		i = (i + 1) & mask;
+	}
+	return i;
+}
+
+// Callers make sure a new entry fits without rehashing
+AdmissionControl::Entry &AdmissionControl::entry_(const struct in6_addr &address,
+												  unsigned char prefix) {
+	const uint32_t hash	 = hashAddress(address, prefix);
+	Entry		  &entry = buckets_[probe_(address, prefix, hash)];
+	if (!entry.prefix) {
+		entry.address = address;
+		entry.prefix  = prefix;
+		entry.hash	  = hash;
+		++size_;
+	}
+	return entry;
+}
+
+AdmissionControl::Entry *AdmissionControl::find_(const struct in6_addr &address,
+												 unsigned char prefix) {
+	Entry &entry =
+		buckets_[probe_(address, prefix, hashAddress(address, prefix))];
+	return entry.prefix ? &entry : NULL;
+}
+
+// Moves the entries into bucketCount buckets; with now set, entries without
+// connections whose rate windows ran out are left behind
+void AdmissionControl::rehash_(std::size_t bucketCount, time_t now) {
+	std::vector<Entry> old(bucketCount);
+	old.swap(buckets_);
+	const std::size_t mask = buckets_.size() - 1;
+	size_				   = 0;
+	for (std::size_t b = 0; b < old.size(); ++b) {
+		if (!old[b].prefix)
+			continue;
+		if (now && !old[b].connections &&
+			now - old[b].windowStart >= 2 * ADMISSION_WINDOW_SECONDS)
+			continue;
+		std::size_t i = old[b].hash & mask;
+		while (buckets_[i].prefix)
+			i = (i + 1) & mask;
+		buckets_[i] = old[b];
+		++size_;
+	}
+}
+
+uint32_t AdmissionControl::countAttempt_(Entry &entry, time_t now) {
+	const time_t elapsed = now - entry.windowStart;
+	if (elapsed < 0 || elapsed >= 2 * ADMISSION_WINDOW_SECONDS) {
+		entry.previous	  = 0;
+		entry.current	  = 0;
+		entry.windowStart = now;
+	} else if (elapsed >= ADMISSION_WINDOW_SECONDS) {
+		entry.previous = entry.current;
+		entry.current  = 0;
+		entry.windowStart += ADMISSION_WINDOW_SECONDS;
+	}
+	++entry.current;
+	const time_t overlap =
+		ADMISSION_WINDOW_SECONDS - (now - entry.windowStart);
+	return entry.current + static_cast<uint32_t>(
+							   entry.previous * overlap / ADMISSION_WINDOW_SECONDS);
+}
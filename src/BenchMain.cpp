@@ -0,0 +1,36 @@
+#include "../include/LoadGenerator.hpp"
+#include <csignal>
+#include <cstring>
+#include <exception>
+#include <iostream>
+#include <errno.h>
+
+static void benchSignalHandler(int signum) {
+	(void)signum;
+	LoadGenerator::requestStop();
+}
+
+int bench_main(int argc, char *argv[]) {
+	BenchConfig	config;
+	for (int i = 1; i < argc; ++i) {
+		if (!config.parseOption(argv[i])) {
+			std::cerr << "Usage: ./ircbench [options]" << std::endl
+					  << BenchConfig::usage();
+			return 1;
+		}
+	}
+	// The shared queue code echoes every outbound line on std::cout; the
+	// report is printed with stdio and stays visible.
+	std::cout.setstate(std::ios::failbit);
+	std::signal(SIGPIPE, SIG_IGN);
+	std::signal(SIGINT, benchSignalHandler);
+	try {
+		LoadGenerator	bench(config);
+		if (!bench.run())
+			return 1;
+	} catch (std::exception &e) {
+		std::cerr << e.what() << ": " << (errno) << std::endl;
+		return 1;
+	}
+	return 0;
+}
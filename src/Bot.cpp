@@ -7,6 +7,7 @@
 #include <netdb.h>
 #include <poll.h>
 #include <sys/socket.h>
+#include <sys/un.h>
 #include <unistd.h>
 #include <vector>
 #include "../include/Message.hpp"
@@ -59,7 +60,38 @@ void Bot::sendPart(const std::string &channel, const std::string &reason) {
     sendRaw("PART " + channel + " :" + reason);
 }
 
+// Local servers skip the TCP stack entirely
+static int connectUnix(const std::string &path, bool &connecting) {
+  struct sockaddr_un address;
+  std::memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  if (path.size() >= sizeof(address.sun_path))
+    return -1;
+  std::memcpy(address.sun_path, path.c_str(), path.size());
+  int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0);
+  if (fd == -1)
+    return -1;
+  // Unix-domain connects complete at once or fail (EAGAIN: backlog full)
+  if (::connect(fd, reinterpret_cast<struct sockaddr *>(&address),
+                sizeof(address)) == -1) {
+    close(fd);
+    return -1;
+  }
+  connecting = false;
+  return fd;
+}
+
 bool Bot::connect() {
+  if (!host_.empty() && host_[0] == '/') {
+    const int fd = connectUnix(host_, connecting_);
+    if (fd == -1) {
+      std::cout << "connect() failed: " << (errno) << std::endl;
+      return false;
+    }
+    this->socket_ = fd;
+    std::cout << "Connected socket " << fd << " to " << host_ << std::endl;
+    return true;
+  }
   struct addrinfo hints;
   struct addrinfo *res = 0, *p = 0;
   int fd = -1;
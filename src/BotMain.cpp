@@ -1,16 +1,24 @@
 #include "../include/PollBot.hpp"
+#include <cstdlib>
 #include <cstring>
+#include <string>
 #include <exception>
 #include <iostream>
 #include <errno.h>
 
 
+// Usage: ./ircbot [host | /unix/socket/path] [port] [password]
 int bot_main(int argc, char *argv[]) {
-	// TODO optional args: <host> <port> <password> <nickname> <username> <realname> [auto-join channels...]
-	(void)argc;
-	(void)argv;
+	// TODO optional args: <nickname> <username> <realname> [auto-join channels...]
+	const std::string	host = argc > 1 ? argv[1] : "127.0.0.1";
+	const int			port = argc > 2 ? std::atoi(argv[2]) : 6667;
+	const std::string	password = argc > 3 ? argv[3] : "password";
+	if (port <= 0 || port > 65535) {
+		std::cerr << "Usage: ./ircbot [host | /unix/socket/path] [port] [password]" << std::endl;
+		return 1;
+	}
 	try {
-	PollBot	bot("127.0.0.1", 6667, "password", "PollBot", "PollUser", "Poll Bot");
+	PollBot	bot(host, static_cast<unsigned short>(port), password, "PollBot", "PollUser", "Poll Bot");
 	if (bot.connect()) {
 		bot.login();
 		bot.run();
@@ -0,0 +1,80 @@
+#include "../include/BufferPool.hpp"
+#include "../include/Debug.hpp"
+
+BufferPool::BufferPool() : pooledBytes_(0), inUseBytes_(0) {
+	debug("BufferPool default constructor called");
+}
+
+// Pooled buffers are owned, so copies get their own (empty) buffers
+BufferPool::BufferPool(const BufferPool &other)
+	: pooledBytes_(0), inUseBytes_(0) {
+	*this = other;
+}
+
+BufferPool &BufferPool::operator=(const BufferPool &other) {
+	if (this != &other) {
+		shrink(0);
+		for (std::size_t i = 0; i < other.free_.size(); ++i) {
+			std::string *copy = new std::string();
+			copy->reserve(other.free_[i]->capacity());
+			pooledBytes_ += copy->capacity();
+			free_.push_back(copy);
+		}
+		inUseBytes_ = other.inUseBytes_;
+	}
+	return *this;
+}
+
+BufferPool::~BufferPool() {
+	debug("BufferPool destructor called");
+	shrink(0);
+}
+
+std::string *BufferPool::acquire() {
+	std::string *buffer;
+	if (free_.empty())
+		buffer = new std::string();
+	else {
+		buffer = free_.back();
+		free_.pop_back();
+		pooledBytes_ -= buffer->capacity();
+	}
+	inUseBytes_ += buffer->capacity();
+	return buffer;
+}
+
+void BufferPool::release(std::string *buffer) {
+	if (!buffer)
+		return;
+	const std::size_t capacity = buffer->capacity();
+	inUseBytes_ -= (capacity < inUseBytes_) ? capacity : inUseBytes_;
+	if (free_.size() >= BUFFERPOOL_MAX_BUFFERS ||
+		capacity > BUFFERPOOL_MAX_CAPACITY) {
+		delete buffer;
+		return;
+	}
+	buffer->clear();
+	pooledBytes_ += capacity;
+	free_.push_back(buffer);
+}
+
+void BufferPool::resized(std::size_t oldCapacity, std::size_t newCapacity) {
+	inUseBytes_ += newCapacity;
+	inUseBytes_ -= (oldCapacity < inUseBytes_) ? oldCapacity : inUseBytes_;
+}
+
+void BufferPool::shrink(std::size_t maxBuffers) {
+	while (free_.size() > maxBuffers) {
+		pooledBytes_ -= free_.back()->capacity();
+		delete free_.back();
+		free_.pop_back();
+	}
+	if (free_.empty())
+		std::vector<std::string *>().swap(free_);
+}
+
+std::size_t BufferPool::pooledCount() const { return free_.size(); }
+
+std::size_t BufferPool::pooledBytes() const { return pooledBytes_; }
+
+std::size_t BufferPool::inUseBytes() const { return inUseBytes_; }
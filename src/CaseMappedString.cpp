@@ -39,6 +39,31 @@ std::string CaseMappedString::toCaseMappedString(const std::string& str)
 	return result;
 }
 
+bool CaseMappedString::equalsCaseMapped(const std::string& a, const std::string& b)
+{
+	if (a.size() != b.size())
+		return false;
+	for (size_t i = 0; i < a.size(); ++i)
+	{
+		if (toCaseMapped(a[i]) != toCaseMapped(b[i]))
+			return false;
+	}
+	return true;
+}
+
+// 32-bit FNV-1a over the case-mapped bytes
+unsigned long CaseMappedString::hashCaseMapped(const std::string& str)
+{
+	unsigned long hash = 2166136261ul;
+
+	for (std::string::const_iterator it = str.begin(); it != str.end(); ++it)
+	{
+		hash ^= static_cast<unsigned char>(toCaseMapped(*it));
+		hash = (hash * 16777619ul) & 0xfffffffful;
+	}
+	return hash;
+}
+
 CaseMappedString::CaseMappedString() : data_(""), caseMappedData_("")
 {
 
@@ -1,16 +1,73 @@
 #include "../include/Channel.hpp"
+#include "../include/CaseMappedString.hpp"
 #include "../include/Client.hpp"
+#include "../include/Handoff.hpp"
 #include "../include/Message.hpp"
 #include "../include/MessageQueueManager.hpp"
+#include "../include/MessageType.hpp"
+#include "../include/Metrics.hpp"
+#include "../include/Server.hpp"
+#include <cstring>
 #include <ctime>
+#include <sstream>
+
+Metrics	*Channel::metrics_ = NULL;
+
+// Room left for names in ":<server> 353 <nick> = <channel> :<names>\r\n".
+// Absurdly long channel names still get one name per line.
+static std::string::size_type namesChunkBudget(const std::string &channelName)
+{
+	const std::string::size_type fixed =
+		std::strlen(":" HOSTNAME " 353 ") + NICKLEN + std::strlen(" = ") +
+		channelName.size() + std::strlen(" :\r\n");
+	if (fixed + NICKLEN + 1 > NAMES_LINE_MAX)
+		return (NICKLEN + 1);
+	return (NAMES_LINE_MAX - fixed);
+}
 
 Channel::Channel(const std::string &name, const Client &op,
 				 MessageQueueManager &queueManager)
 	: mqr_(queueManager), name_(name), members_(), whiteList_(), operators_(),
 	  topic_(""), topicWho_(""), topicTime_(0), creationTime_(std::time(NULL)), password_(""), userLimit_(0), isInviteOnly_(false),
-	  isTopicProtected_(false) {
-	members_[op.getNickname()] = op.getSocket();
+	  isTopicProtected_(false), namesChunks_(),
+	  namesChunkBudget_(namesChunkBudget(name)), history_(name),
+	  listEntry_(), listEntryCount_(0), masksVersion_(1) {
+	members_[op.getNickname()] = Membership(op.getSocket());
 	operators_.insert(op.getNickname());
+	namesAdd_(op.getNickname(), true);
+}
+
+Channel::Channel(MessageQueueManager &queueManager, StateReader &in)
+	: mqr_(queueManager), name_(in.str()), topicTime_(0), creationTime_(0),
+	  userLimit_(0), isInviteOnly_(false), isTopicProtected_(false),
+	  namesChunkBudget_(namesChunkBudget(name_)), history_(name_),
+	  listEntry_(), listEntryCount_(0), masksVersion_(1) {
+	for (uint32_t count = in.u32(); count; --count) {
+		const std::string nickname = in.str();
+		members_[nickname] = Membership(static_cast<int>(in.u32()));
+	}
+	for (uint32_t count = in.u32(); count; --count)
+		operators_.insert(in.str());
+	for (uint32_t count = in.u32(); count; --count)
+		whiteList_.insert(in.str());
+	for (uint32_t count = in.u32(); count; --count)
+	{
+		namesChunks_.push_back(in.str());
+		namesIndex_(namesChunks_.size() - 1);
+	}
+	topic_ = in.str();
+	topicWho_ = in.str();
+	topicTime_ = static_cast<time_t>(in.u64());
+	creationTime_ = static_cast<time_t>(in.u64());
+	password_ = in.str();
+	userLimit_ = static_cast<int>(in.u32());
+	isInviteOnly_ = in.u8() != 0;
+	isTopicProtected_ = in.u8() != 0;
+	bans_.loadState(in);
+	exceptions_.loadState(in);
+	inviteExceptions_.loadState(in);
+	floodLimit_.parse(in.str());
+	history_.loadState(in);
 }
 
 Channel::Channel(const Channel &other) : mqr_(other.mqr_) { *this = other; }
@@ -30,6 +87,17 @@ Channel &Channel::operator=(const Channel &other) {
 		this->userLimit_		= other.userLimit_;
 		this->isInviteOnly_		= other.isInviteOnly_;
 		this->isTopicProtected_	= other.isTopicProtected_;
+		this->namesChunks_		= other.namesChunks_;
+		this->namesChunkBudget_	= other.namesChunkBudget_;
+		this->history_			= other.history_;
+		this->listEntry_		= other.listEntry_;
+		this->listEntryCount_	= other.listEntryCount_;
+		this->bans_				= other.bans_;
+		this->exceptions_		= other.exceptions_;
+		this->inviteExceptions_	= other.inviteExceptions_;
+		this->masksVersion_		= other.masksVersion_;
+		this->floodLimit_		= other.floodLimit_;
+		this->flood_			= other.flood_;
 	}
 	return *this;
 }
@@ -37,13 +105,24 @@ Channel &Channel::operator=(const Channel &other) {
 Channel::~Channel()
 {}
 
+void Channel::setMetrics(Metrics &metrics)
+{
+	metrics_ = &metrics;
+}
+
 // Getters
 const	std::string &Channel::getName() const
 {
 	return name_;
 }
 
-const	std::map<std::string, int> &Channel::getMembers() const
+Channel::Membership::Membership()
+	: fd(-1), banCheckedAt(0), banned(false), flood(), namesChunk(0) {}
+
+Channel::Membership::Membership(int fd)
+	: fd(fd), banCheckedAt(0), banned(false), flood(), namesChunk(0) {}
+
+const	Channel::Members &Channel::getMembers() const
 {
 	return members_;
 }
@@ -87,10 +166,28 @@ const time_t &Channel::getTopicTime() const
 {
 	return topicTime_;
 }
+
+const std::vector<std::string> &Channel::getNamesChunks() const
+{
+	return namesChunks_;
+}
+const std::string &Channel::getListEntry() const
+{
+	if (listEntry_.empty() || listEntryCount_ != members_.size())
+	{
+		std::ostringstream entry;
+		entry << name_ << " " << members_.size() << " :" << topic_;
+		listEntry_ = entry.str();
+		listEntryCount_ = members_.size();
+	}
+	return listEntry_;
+}
+
 // Setters
 void Channel::setTopic(const std::string &topic)
 {
 	topic_ = topic;
+	listEntry_.clear();
 }
 
 void Channel::setTopicWho(const std::string &topicWho)
@@ -103,6 +200,16 @@ void Channel::setTopicTime()
 	topicTime_ = std::time(NULL);
 }
 
+void Channel::setTopicTime(time_t topicTime)
+{
+	topicTime_ = topicTime;
+}
+
+void Channel::setCreationTime(time_t creationTime)
+{
+	creationTime_ = creationTime;
+}
+
 void Channel::setPassword(const std::string &password)
 {
 	password_ = password;
@@ -113,21 +220,304 @@ void Channel::setUserLimit(int limit)
 	userLimit_ = limit;
 }
 
-void Channel::broadcastMsg(const std::string &senderNickname,
-						   const Message	 &message) const {
-	const std::string wire = message.toString();
-	for (std::map<std::string, int>::const_iterator memberIt = members_.begin();
+void Channel::broadcastWire_(const std::string &senderNickname,
+							 const std::string &wire) const {
+	std::size_t sent = 0;
+	for (Members::const_iterator memberIt = members_.begin();
 		 memberIt != members_.end(); ++memberIt) {
 		if (memberIt->first == senderNickname)
 			continue;
-		mqr_.send(memberIt->second, wire);
+		mqr_.send(memberIt->second.fd, wire);
+		++sent;
+	}
+	if (metrics_ && sent) {
+		HeavyHitters  &heavy = metrics_->heavy(HEAVY_CHANNEL_BYTES);
+		const uint64_t key	 = CaseMappedString::hashCaseMapped(name_);
+		if (heavy.add(key, static_cast<uint64_t>(wire.size()) * sent))
+			heavy.setLabel(key, name_);
 	}
 }
 
+void Channel::broadcastMsg(const std::string &senderNickname,
+						   const Message	 &message) const {
+	broadcastWire_(senderNickname, message.toString());
+}
 void Channel::broadcastMsg(const Client &sender, const Message &message) const {
 	broadcastMsg(sender.getNickname(), message);
 }
 
+void Channel::broadcastAndRecord(const Client &sender, const Message &message) {
+	std::string wire = message.toString();
+	broadcastWire_(sender.getNickname(), wire);
+	history_.record(wire);
+}
+
+const MessageHistory &Channel::getHistory() const { return history_; }
+
+void Channel::keepEarlierHistory() { history_.keepEarlier(); }
+
+void Channel::discardHistory() { history_.discard(); }
+
+void Channel::sendNames(const Client &client) const {
+	const std::string head =
+		":" HOSTNAME " 353 " + client.getNickname() + " = " + name_ + " :";
+	for (std::vector<std::string>::const_iterator chunk = namesChunks_.begin();
+		 chunk != namesChunks_.end(); ++chunk)
+		mqr_.send(client.getSocket(), head + *chunk + "\r\n");
+	client.sendErrorMessage(RPL_ENDOFNAMES, client.getNickname(), name_);
+}
+
+// Appends to the last chunk, or opens a new one when it is full
+void Channel::namesAdd_(const std::string &nickname, bool isOperator)
+{
+	const std::string	token = (isOperator ? "@" : "") + nickname;
+	if (namesChunks_.empty() ||
+		namesChunks_.back().size() + 1 + token.size() > namesChunkBudget_)
+		namesChunks_.push_back(std::string());
+	std::string	&names = namesChunks_.back();
+	if (!names.empty())
+		names += ' ';
+	names += token;
+	Members::iterator member = members_.find(nickname);
+	if (member != members_.end())
+		member->second.namesChunk = static_cast<unsigned>(namesChunks_.size() - 1);
+}
+
+// Locates the "nick" or "@nick" token of nickname in the chunk its
+// membership points at; pos is its first byte
+bool Channel::namesFind_(const std::string &nickname, size_t &chunk,
+						 std::string::size_type &pos) const
+{
+	Members::const_iterator member = members_.find(nickname);
+	if (member == members_.end() || member->second.namesChunk >= namesChunks_.size())
+		return (false);
+	chunk = member->second.namesChunk;
+	const std::string &names = namesChunks_[chunk];
+	for (pos = 0; pos < names.size();)
+	{
+		std::string::size_type end = names.find(' ', pos);
+		if (end == std::string::npos)
+			end = names.size();
+		const std::string::size_type nameStart = pos + (names[pos] == '@');
+		if (end - nameStart == nickname.size() &&
+			names.compare(nameStart, nickname.size(), nickname) == 0)
+			return (true);
+		pos = end + 1;
+	}
+	return (false);
+}
+
+// Call before the member leaves members_
+void Channel::namesRemove_(const std::string &nickname)
+{
+	size_t					chunk;
+	std::string::size_type	pos;
+	if (!namesFind_(nickname, chunk, pos))
+		return;
+	std::string				&names = namesChunks_[chunk];
+	std::string::size_type	end = names.find(' ', pos);
+	if (end != std::string::npos)
+		names.erase(pos, end + 1 - pos);	// token and the space after it
+	else if (pos > 0)
+		names.erase(pos - 1);				// last token and the space before it
+	else
+		names.clear();
+	namesRepack_(chunk);
+}
+
+// A chunk that fell below half its budget takes names off the end of the
+// last chunk until it is half full again; one left empty is replaced by
+// the last chunk. Only the names moved are re-indexed, so a departure
+// costs a chunk or two however large the channel is.
+void Channel::namesRepack_(size_t chunk)
+{
+	while (chunk + 1 < namesChunks_.size() &&
+		   namesChunks_[chunk].size() < namesChunkBudget_ / 2)
+	{
+		std::string						&last = namesChunks_.back();
+		const std::string::size_type	space = last.rfind(' ');
+		const std::string				token =
+			space == std::string::npos ? last : last.substr(space + 1);
+		std::string						&names = namesChunks_[chunk];
+		if (names.size() + 1 + token.size() > namesChunkBudget_)
+			break;
+		if (!names.empty())
+			names += ' ';
+		names += token;
+		last.erase(space == std::string::npos ? 0 : space);
+		Members::iterator member = members_.find(token.substr(token[0] == '@'));
+		if (member != members_.end())
+			member->second.namesChunk = static_cast<unsigned>(chunk);
+		if (last.empty())
+			namesChunks_.pop_back();
+	}
+	if (chunk < namesChunks_.size() && namesChunks_[chunk].empty())
+	{
+		namesChunks_[chunk].swap(namesChunks_.back());
+		namesChunks_.pop_back();
+		if (chunk < namesChunks_.size())
+			namesIndex_(chunk);
+	}
+}
+
+void Channel::namesIndex_(size_t chunk)
+{
+	std::istringstream	names(namesChunks_[chunk]);
+	std::string			token;
+	while (names >> token)
+	{
+		Members::iterator member = members_.find(token.substr(token[0] == '@'));
+		if (member != members_.end())
+			member->second.namesChunk = static_cast<unsigned>(chunk);
+	}
+}
+
+void Channel::namesSetOperator_(const std::string &nickname, bool isOperator)
+{
+	size_t					chunk;
+	std::string::size_type	pos;
+	if (!namesFind_(nickname, chunk, pos))
+		return;
+	std::string	&names = namesChunks_[chunk];
+	if ((names[pos] == '@') == isOperator)
+		return;
+	if (!isOperator)
+	{
+		names.erase(pos, 1);
+		namesRepack_(chunk);
+	}
+	else if (names.size() + 1 <= namesChunkBudget_)
+		names.insert(pos, 1, '@');
+	else
+	{
+		namesRemove_(nickname);
+		namesAdd_(nickname, true);
+	}
+}
+
+void Channel::namesRename_(const std::string &oldNick, const std::string &newNick)
+{
+	size_t					chunk;
+	std::string::size_type	pos;
+	if (!namesFind_(oldNick, chunk, pos))
+		return;
+	std::string	&names = namesChunks_[chunk];
+	const bool	op = (names[pos] == '@');
+	if (names.size() - oldNick.size() + newNick.size() <= namesChunkBudget_)
+	{
+		names.replace(pos + op, oldNick.size(), newNick);
+		namesRepack_(chunk);
+	}
+	else
+	{
+		namesRemove_(oldNick);
+		namesAdd_(newNick, op);
+	}
+}
+
+const MaskList *Channel::getMaskList(char mode) const
+{
+	switch (mode)
+	{
+		case 'b':
+			return &bans_;
+		case 'e':
+			return &exceptions_;
+		case 'I':
+			return &inviteExceptions_;
+		default:
+			return NULL;
+	}
+}
+
+bool Channel::addMask(char mode, const std::string &mask,
+					  const std::string &setter, time_t setAt)
+{
+	MaskList *list = const_cast<MaskList *>(getMaskList(mode));
+	if (!list || !list->add(mask, setter, setAt))
+		return false;
+	++masksVersion_;
+	return true;
+}
+
+bool Channel::removeMask(char mode, const std::string &mask)
+{
+	MaskList *list = const_cast<MaskList *>(getMaskList(mode));
+	if (!list || !list->remove(mask))
+		return false;
+	++masksVersion_;
+	return true;
+}
+
+bool Channel::isBanned(const Client &client) const
+{
+	if (bans_.empty())
+		return false;
+	const std::string hostmask = client.getHostmask();
+	return bans_.matches(hostmask) && !exceptions_.matches(hostmask);
+}
+
+// A member is only matched again after a list or its nickname changed, so
+// channel PRIVMSG costs one lookup however long the lists are
+bool Channel::isBannedMember(const Client &member)
+{
+	if (bans_.empty())
+		return false;
+	Members::iterator it = members_.find(member.getNickname());
+	if (it == members_.end())
+		return isBanned(member);
+	if (it->second.banCheckedAt != masksVersion_)
+	{
+		it->second.banned = isBanned(member);
+		it->second.banCheckedAt = masksVersion_;
+	}
+	return it->second.banned;
+}
+
+bool Channel::isInviteException(const Client &client) const
+{
+	return !inviteExceptions_.empty()
+		&& inviteExceptions_.matches(client.getHostmask());
+}
+
+const FloodLimit &Channel::getFloodLimit() const
+{
+	return floodLimit_;
+}
+
+void Channel::setFloodLimit(const FloodLimit &limit)
+{
+	floodLimit_ = limit;
+}
+
+// Operators are never limited. A member over its limit gets the +f action;
+// the channel limit only ever refuses, as nobody in particular is to blame.
+FloodVerdict Channel::admitLine(const Client &sender, time_t now)
+{
+	if (!floodLimit_.isSet())
+		return FLOOD_PASSED;
+	const std::string nickname = sender.getNickname();
+	Members::iterator it = members_.find(nickname);
+	if (it == members_.end() || isOperator(nickname))
+		return FLOOD_PASSED;
+	const unsigned	seconds = floodLimit_.seconds;
+	RateWindow		&member = it->second.flood;
+	if (member.rate(now, seconds) >= floodLimit_.memberLines)
+	{
+		if (floodLimit_.action == FLOOD_DROP)
+			return FLOOD_DROPPED;
+		if (floodLimit_.action == FLOOD_KICK)
+			return FLOOD_KICKED;
+		member.count(now, seconds);
+		return FLOOD_REFUSED;
+	}
+	if (floodLimit_.channelLines && flood_.rate(now, seconds) >= floodLimit_.channelLines)
+		return (floodLimit_.action == FLOOD_DROP ? FLOOD_DROPPED : FLOOD_REFUSED);
+	member.count(now, seconds);
+	flood_.count(now, seconds);
+	return FLOOD_PASSED;
+}
+
 bool Channel::checkKey(const std::string& key) const
 {
 	if (password_.empty())
@@ -163,19 +553,23 @@ bool Channel::isWhiteListed(const std::string &nickname) const
 void Channel::addMember(const Client* client)
 {
 	const std::string nickname = client->getNickname();
-	for (std::map<std::string, int>::const_iterator it = members_.begin(); it != members_.end(); ++it)
+	for (Members::const_iterator it = members_.begin(); it != members_.end(); ++it)
 	{
 		if (it->first == nickname)
 			return;
 	}
-	members_[nickname] = client->getSocket();
+	members_[nickname] = Membership(client->getSocket());
+	namesAdd_(nickname, isOperator(nickname));
 }
 
 void Channel::removeMember(const std::string &nickname)
 {
-	std::map<std::string, int>::iterator foundMemberIt = members_.find(nickname);
+	Members::iterator foundMemberIt = members_.find(nickname);
 	if (foundMemberIt != members_.end())
+	{
+		namesRemove_(nickname);
 		members_.erase(foundMemberIt);
+	}
 }
 
 bool Channel::isMember(const std::string &nickname) const
@@ -185,14 +579,22 @@ bool Channel::isMember(const std::string &nickname) const
 	return (false);
 }
 
+bool Channel::isEmpty() const
+{
+	return (members_.empty());
+}
+
 void	Channel::addOperator(const std::string &nickname)
 {
 	operators_.insert(nickname);
+	if (isMember(nickname))
+		namesSetOperator_(nickname, true);
 }
 
 void	Channel::removeOperator(const std::string &nickname)
 {
-	operators_.erase(nickname);
+	if (operators_.erase(nickname) && isMember(nickname))
+		namesSetOperator_(nickname, false);
 }
 
 bool	Channel::isOperator(const std::string &nickname) const
@@ -215,12 +617,18 @@ void	Channel::setTopicProtected(bool value)
 // change nickname in members, whiteList, operators
 void Channel::changeNick(const std::string &oldNick, const std::string &newNick)
 {
-	std::map<std::string, int>::iterator foundMemberIt = members_.find(oldNick);
-	if (foundMemberIt != members_.end())
+	Members::iterator foundMemberIt = members_.find(oldNick);
+	if (foundMemberIt != members_.end() && oldNick != newNick)
 	{
-		int socket = foundMemberIt->second;
+		// the new nickname may match other bans; the +f count stays, or
+		// renaming would reset it
+		Membership membership(foundMemberIt->second.fd);
+		membership.flood = foundMemberIt->second.flood;
+		membership.namesChunk = foundMemberIt->second.namesChunk;
+		members_[newNick] = membership;
+		// both entries are there while the names are redone
+		namesRename_(oldNick, newNick);
 		members_.erase(foundMemberIt);
-		members_[newNick] = socket;
 	}
 	std::set<std::string>::iterator foundWhiteListIt = whiteList_.find(oldNick);
 	if (foundWhiteListIt != whiteList_.end())
@@ -235,3 +643,40 @@ void Channel::changeNick(const std::string &oldNick, const std::string &newNick)
 		operators_.insert(newNick);
 	}
 }
+
+void Channel::saveState(StateWriter &out) const
+{
+	out.str(name_);
+	out.u32(static_cast<uint32_t>(members_.size()));
+	for (Members::const_iterator it = members_.begin();
+		 it != members_.end(); ++it)
+	{
+		out.str(it->first);
+		out.u32(static_cast<uint32_t>(it->second.fd));
+	}
+	out.u32(static_cast<uint32_t>(operators_.size()));
+	for (std::set<std::string>::const_iterator it = operators_.begin();
+		 it != operators_.end(); ++it)
+		out.str(*it);
+	out.u32(static_cast<uint32_t>(whiteList_.size()));
+	for (std::set<std::string>::const_iterator it = whiteList_.begin();
+		 it != whiteList_.end(); ++it)
+		out.str(*it);
+	// the chunks as they are, so NAMES keeps its order
+	out.u32(static_cast<uint32_t>(namesChunks_.size()));
+	for (size_t i = 0; i < namesChunks_.size(); ++i)
+		out.str(namesChunks_[i]);
+	out.str(topic_);
+	out.str(topicWho_);
+	out.u64(static_cast<uint64_t>(topicTime_));
+	out.u64(static_cast<uint64_t>(creationTime_));
+	out.str(password_);
+	out.u32(static_cast<uint32_t>(userLimit_));
+	out.u8(isInviteOnly_);
+	out.u8(isTopicProtected_);
+	bans_.saveState(out);
+	exceptions_.saveState(out);
+	inviteExceptions_.saveState(out);
+	out.str(floodLimit_.toString());
+	history_.saveState(out);
+}
@@ -0,0 +1,479 @@
+#include "../include/ChannelJournal.hpp"
+#include "../include/CaseMappedString.hpp"
+#include "../include/Channel.hpp"
+#include "../include/Debug.hpp"
+#include "../include/Handoff.hpp"
+#include "../include/Metrics.hpp"
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <stdexcept>
+#include <sys/file.h>
+#include <unistd.h>
+
+// Frame of a journal entry: payload length and its checksum
+struct JournalFrame {
+	uint32_t length;
+	uint32_t checksum;
+};
+
+// 32-bit FNV-1a
+static uint32_t checksum(const char *data, std::size_t length) {
+	uint32_t hash = 2166136261u;
+	for (std::size_t i = 0; i < length; ++i) {
+		hash ^= static_cast<unsigned char>(data[i]);
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+ChannelJournal::Entry::Entry() : seq(0), op(0), number(0) {}
+
+ChannelJournal::ChannelJournal()
+	: journalFd_(-1), seq_(0), journalBytes_(0), thread_(), running_(false),
+	  stopRequested_(false), compactRequested_(false), compactSeq_(0),
+	  compactOffset_(0), compacted_(false), compactOk_(false),
+	  compacting_(false), failed_(false) {
+	debug("ChannelJournal constructor called");
+	pthread_mutex_init(&lock_, NULL);
+	pthread_cond_init(&wake_, NULL);
+}
+
+ChannelJournal::~ChannelJournal() {
+	debug("ChannelJournal destructor called");
+	close();
+	pthread_cond_destroy(&wake_);
+	pthread_mutex_destroy(&lock_);
+}
+
+void ChannelJournal::open(const std::string &dir) {
+	close();
+	const uint64_t	  start = Metrics::nowUsec();
+	const std::string path	= dir + "/" JOURNAL_FILE;
+	journalFd_ = ::open(path.c_str(), O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0600);
+	if (journalFd_ == -1)
+		throw std::runtime_error("[Journal] cannot open " + path);
+	if (flock(journalFd_, LOCK_EX | LOCK_NB) == -1) {
+		::close(journalFd_);
+		journalFd_ = -1;
+		throw std::runtime_error("[Journal] " + dir + " is used by another server");
+	}
+	try {
+		snapshot_.open(dir + "/" SNAPSHOT_FILE);
+	} catch (std::exception &) {
+		::close(journalFd_);
+		journalFd_ = -1;
+		throw;
+	}
+	dir_ = dir;
+	seq_ = snapshot_.seq();
+	const std::size_t replayed = replay_();
+	stopRequested_ = false;
+	failed_		   = false;
+	running_ = pthread_create(&thread_, NULL, &ChannelJournal::run_, this) == 0;
+	if (!running_)
+		std::cerr << "[Journal] could not start thread, writing inline" << std::endl;
+	std::cout << BLUE << "state dir: " << dir << " (" << snapshot_.count()
+			  << " saved channels, " << replayed << " journal entries replayed in "
+			  << (Metrics::nowUsec() - start) / 1000 << " ms)" << RESET
+			  << std::endl;
+}
+
+void ChannelJournal::close() {
+	if (running_) {
+		pthread_mutex_lock(&lock_);
+		stopRequested_ = true;
+		pthread_cond_signal(&wake_);
+		pthread_mutex_unlock(&lock_);
+		pthread_join(thread_, NULL);
+		running_ = false;
+	}
+	if (journalFd_ != -1)
+		::close(journalFd_);
+	journalFd_ = -1;
+	snapshot_.close();
+	changes_.clear();
+	compactChanges_.clear();
+	pending_.clear();
+	seq_			  = 0;
+	journalBytes_	  = 0;
+	compactRequested_ = false;
+	compacted_		  = false;
+	compacting_		  = false;
+}
+
+bool ChannelJournal::isOpen() const { return journalFd_ != -1; }
+
+bool ChannelJournal::find(const std::string &name, ChannelState &out) const {
+	if (journalFd_ == -1)
+		return false;
+	ChannelStateMap::const_iterator it =
+		changes_.find(CaseMappedString::toCaseMappedString(name));
+	if (it != changes_.end()) {
+		if (it->second.destroyed)
+			return false;
+		out = it->second;
+		return true;
+	}
+	return snapshot_.find(name, out);
+}
+
+void ChannelJournal::created(const Channel &channel, const std::string &creator) {
+	Entry entry;
+	entry.op	  = JOURNAL_CREATE;
+	entry.channel = channel.getName();
+	entry.who	  = creator;
+	entry.number  = static_cast<uint64_t>(channel.getCreationTime());
+	record_(entry);
+}
+
+void ChannelJournal::topicChanged(const Channel &channel) {
+	Entry entry;
+	entry.op	  = JOURNAL_TOPIC;
+	entry.channel = channel.getName();
+	entry.text	  = channel.getTopic();
+	entry.who	  = channel.getTopicWho();
+	entry.number  = static_cast<uint64_t>(channel.getTopicTime());
+	record_(entry);
+}
+
+void ChannelJournal::modeChanged(const std::string &channel, char mode, bool on,
+								 const std::string &argument) {
+	Entry entry;
+	entry.channel = channel;
+	entry.number  = on;
+	switch (mode) {
+	case 'i':
+		entry.op = JOURNAL_INVITE_ONLY;
+		break;
+	case 't':
+		entry.op = JOURNAL_TOPIC_PROTECTED;
+		break;
+	case 'k':
+		entry.op   = JOURNAL_KEY;
+		entry.text = on ? argument : "";
+		break;
+	case 'l':
+		entry.op	 = JOURNAL_LIMIT;
+		entry.number = on ? std::strtoul(argument.c_str(), NULL, 10) : 0;
+		break;
+	case 'o':
+		entry.op  = JOURNAL_OPERATOR;
+		entry.who = argument;
+		break;
+	case 'f':
+		entry.op   = JOURNAL_FLOOD;
+		entry.text = on ? argument : "";
+		break;
+	default:
+		return;
+	}
+	record_(entry);
+}
+
+void ChannelJournal::invited(const std::string &channel,
+							 const std::string &hostmask, bool on) {
+	Entry entry;
+	entry.op	  = JOURNAL_INVITE;
+	entry.channel = channel;
+	entry.who	  = hostmask;
+	entry.number  = on;
+	record_(entry);
+}
+
+void ChannelJournal::maskChanged(const std::string &channel, char mode,
+								 bool on, const MaskList::Entry &mask) {
+	Entry entry;
+	entry.op	  = JOURNAL_MASK;
+	entry.channel = channel;
+	entry.text	  = std::string(1, mode) + mask.mask;
+	entry.who	  = mask.setter;
+	entry.number  = on ? static_cast<uint64_t>(mask.setAt) : 0;
+	record_(entry);
+}
+
+void ChannelJournal::destroyed(const std::string &channel) {
+	Entry entry;
+	entry.op	  = JOURNAL_DESTROY;
+	entry.channel = channel;
+	record_(entry);
+}
+
+void ChannelJournal::tick() {
+	if (journalFd_ == -1 || !running_)
+		return;
+	if (compacting_) {
+		pthread_mutex_lock(&lock_);
+		const bool done = compacted_;
+		const bool ok	= compactOk_;
+		compacted_		= false;
+		pthread_mutex_unlock(&lock_);
+		if (!done)
+			return;
+		compacting_ = false;
+		if (!ok)
+			return;
+		try {
+			snapshot_.open(dir_ + "/" SNAPSHOT_FILE);
+		} catch (std::exception &e) {
+			std::cerr << e.what() << std::endl;
+		}
+		// what the new snapshot holds; later changes stay
+		for (ChannelStateMap::iterator it = changes_.begin(); it != changes_.end();) {
+			if (it->second.seq <= compactSeq_)
+				changes_.erase(it++);
+			else
+				++it;
+		}
+		return;
+	}
+	if (journalBytes_ < JOURNAL_COMPACT_BYTES)
+		return;
+	pthread_mutex_lock(&lock_);
+	compactChanges_	  = changes_;
+	compactSeq_		  = seq_;
+	compactOffset_	  = pending_.size();
+	compactRequested_ = true;
+	pthread_cond_signal(&wake_);
+	pthread_mutex_unlock(&lock_);
+	compacting_	  = true;
+	journalBytes_ = 0;
+}
+
+void ChannelJournal::record_(Entry &entry) {
+	if (journalFd_ == -1)
+		return;
+	entry.seq = ++seq_;
+	apply_(entry);
+	std::string frame;
+	encode_(entry, frame);
+	journalBytes_ += frame.size();
+	if (!running_) {
+		write_(frame.data(), frame.size());
+		return;
+	}
+	pthread_mutex_lock(&lock_);
+	pending_.append(frame);
+	pthread_cond_signal(&wake_);
+	pthread_mutex_unlock(&lock_);
+}
+
+ChannelState &ChannelJournal::state_(const std::string &name) {
+	const std::string		  key = CaseMappedString::toCaseMappedString(name);
+	ChannelStateMap::iterator it  = changes_.find(key);
+	if (it != changes_.end())
+		return it->second;
+	ChannelState &state = changes_[key];
+	if (!snapshot_.find(name, state))
+		state.name = name;
+	return state;
+}
+
+// Drops the hostmasks of the nickname hostmask starts with
+static void eraseNickname(std::set<std::string> &hostmasks,
+						  const std::string &hostmask) {
+	const std::string nickname = hostmask.substr(0, hostmask.find('!')) + "!";
+	std::set<std::string>::iterator it = hostmasks.lower_bound(nickname);
+	while (it != hostmasks.end() && it->compare(0, nickname.size(), nickname) == 0)
+		hostmasks.erase(it++);
+}
+
+bool ChannelJournal::apply_(const Entry &entry) {
+	if (entry.op < JOURNAL_CREATE || entry.op > JOURNAL_DESTROY)
+		return false;
+	ChannelState &state = state_(entry.channel);
+	state.seq			= entry.seq;
+	state.destroyed		= false;
+	switch (entry.op) {
+	case JOURNAL_CREATE:
+		state.creationTime = static_cast<time_t>(entry.number);
+		state.operators.insert(entry.who);
+		break;
+	case JOURNAL_TOPIC:
+		state.topic		= entry.text;
+		state.topicWho	= entry.who;
+		state.topicTime = static_cast<time_t>(entry.number);
+		break;
+	case JOURNAL_INVITE_ONLY:
+		state.inviteOnly = entry.number != 0;
+		break;
+	case JOURNAL_TOPIC_PROTECTED:
+		state.topicProtected = entry.number != 0;
+		break;
+	case JOURNAL_KEY:
+		state.key = entry.text;
+		break;
+	case JOURNAL_LIMIT:
+		state.limit = static_cast<int>(entry.number);
+		break;
+	case JOURNAL_OPERATOR:
+		if (entry.number)
+			state.operators.insert(entry.who);
+		else
+			eraseNickname(state.operators, entry.who);
+		break;
+	case JOURNAL_INVITE:
+		if (entry.number)
+			state.invited.insert(entry.who);
+		else
+			eraseNickname(state.invited, entry.who);
+		break;
+	case JOURNAL_MASK: {
+		MaskList *list = entry.text.empty() ? NULL : state.maskList(entry.text[0]);
+		if (!list)
+			break;
+		if (entry.number)
+			list->add(entry.text.substr(1), entry.who,
+					  static_cast<time_t>(entry.number));
+		else
+			list->remove(entry.text.substr(1));
+		break;
+	}
+	case JOURNAL_FLOOD:
+		state.flood = entry.text;
+		break;
+	case JOURNAL_DESTROY: {
+		// kept as a tombstone until the next snapshot leaves it out
+		const std::string name = state.name;
+		state				   = ChannelState();
+		state.name			   = name;
+		state.seq			   = entry.seq;
+		state.destroyed		   = true;
+		break;
+	}
+	}
+	return true;
+}
+
+// Applies the entries the snapshot does not cover and cuts off a torn tail
+std::size_t ChannelJournal::replay_() {
+	std::string data;
+	char		buffer[65536];
+	ssize_t		n;
+	lseek(journalFd_, 0, SEEK_SET);
+	while ((n = read(journalFd_, buffer, sizeof(buffer))) > 0 ||
+		   (n == -1 && errno == EINTR))
+		if (n > 0)
+			data.append(buffer, static_cast<std::size_t>(n));
+	std::size_t offset	 = 0;
+	std::size_t replayed = 0;
+	while (data.size() - offset >= sizeof(JournalFrame)) {
+		JournalFrame frame;
+		std::memcpy(&frame, data.data() + offset, sizeof(frame));
+		const std::size_t start = offset + sizeof(frame);
+		if (frame.length > data.size() - start ||
+			checksum(data.data() + start, frame.length) != frame.checksum)
+			break;
+		const std::string payload = data.substr(start, frame.length);
+		Entry			  entry;
+		try {
+			StateReader in(payload);
+			entry.seq	  = in.u64();
+			entry.op	  = in.u8();
+			entry.channel = in.str();
+			entry.text	  = in.str();
+			entry.who	  = in.str();
+			entry.number  = in.u64();
+		} catch (std::exception &) {
+			break;
+		}
+		if (entry.seq > snapshot_.seq() && apply_(entry))
+			++replayed;
+		if (entry.seq > seq_)
+			seq_ = entry.seq;
+		offset = start + frame.length;
+	}
+	if (offset != data.size()) {
+		std::cerr << "[Journal] dropping " << data.size() - offset
+				  << " bytes of a torn entry" << std::endl;
+		if (ftruncate(journalFd_, static_cast<off_t>(offset)) == -1)
+			throw std::runtime_error("[Journal] cannot truncate the journal");
+	}
+	journalBytes_ = offset;
+	return replayed;
+}
+
+void ChannelJournal::encode_(const Entry &entry, std::string &out) {
+	StateWriter payload;
+	payload.u64(entry.seq);
+	payload.u8(entry.op);
+	payload.str(entry.channel);
+	payload.str(entry.text);
+	payload.str(entry.who);
+	payload.u64(entry.number);
+	JournalFrame frame;
+	frame.length   = static_cast<uint32_t>(payload.data().size());
+	frame.checksum = checksum(payload.data().data(), payload.data().size());
+	out.append(reinterpret_cast<const char *>(&frame), sizeof(frame));
+	out.append(payload.data());
+}
+
+void *ChannelJournal::run_(void *self) {
+	ChannelJournal *journal = static_cast<ChannelJournal *>(self);
+	pthread_mutex_lock(&journal->lock_);
+	for (;;) {
+		while (!journal->stopRequested_ && journal->pending_.empty() &&
+			   !journal->compactRequested_)
+			pthread_cond_wait(&journal->wake_, &journal->lock_);
+		if (journal->pending_.empty() && !journal->compactRequested_)
+			break;
+		std::string batch;
+		batch.swap(journal->pending_);
+		const bool		compact = journal->compactRequested_;
+		ChannelStateMap changes;
+		uint64_t		seq	   = 0;
+		std::size_t		before = batch.size();
+		if (compact) {
+			changes.swap(journal->compactChanges_);
+			seq							= journal->compactSeq_;
+			before						= journal->compactOffset_;
+			journal->compactRequested_	= false;
+		}
+		pthread_mutex_unlock(&journal->lock_);
+		journal->write_(batch.data(), before);
+		const bool ok = compact && journal->compact_(changes, seq);
+		journal->write_(batch.data() + before, batch.size() - before);
+		fdatasync(journal->journalFd_);
+		pthread_mutex_lock(&journal->lock_);
+		if (compact) {
+			journal->compactOk_ = ok;
+			journal->compacted_ = true;
+		}
+	}
+	pthread_mutex_unlock(&journal->lock_);
+	return NULL;
+}
+
+void ChannelJournal::write_(const char *data, std::size_t length) {
+	while (length) {
+		const ssize_t n = ::write(journalFd_, data, length);
+		if (n == -1 && errno == EINTR)
+			continue;
+		if (n <= 0) {
+			if (!failed_)
+				std::cerr << "[Journal] write failed: " << std::strerror(errno)
+						  << std::endl;
+			failed_ = true;
+			return;
+		}
+		data += n;
+		length -= static_cast<std::size_t>(n);
+	}
+}
+
+// Runs on the writer; the loop thread leaves snapshot_ alone until tick()
+// sees the result
+bool ChannelJournal::compact_(const ChannelStateMap &changes, uint64_t seq) {
+	fdatasync(journalFd_);
+	if (!ChannelSnapshot::write(dir_ + "/" SNAPSHOT_FILE, snapshot_, changes, seq)) {
+		std::cerr << "[Journal] snapshot failed, keeping the journal" << std::endl;
+		return false;
+	}
+	// the snapshot covers every entry written so far
+	if (ftruncate(journalFd_, 0) == -1)
+		std::cerr << "[Journal] cannot empty the journal" << std::endl;
+	return true;
+}
@@ -0,0 +1,122 @@
+#include "../include/ChannelRegistry.hpp"
+#include "../include/CaseMappedString.hpp"
+#include "../include/Debug.hpp"
+
+ChannelRegistry::ChannelRegistry()
+	: channels_(), buckets_(CHANNELREGISTRY_MIN_BUCKETS) {
+	debug("ChannelRegistry default constructor called");
+}
+
+// Slab copies keep slot indices and generations, so the buckets stay valid
+ChannelRegistry::ChannelRegistry(const ChannelRegistry &other)
+	: channels_(other.channels_), buckets_(other.buckets_) {}
+
+ChannelRegistry &ChannelRegistry::operator=(const ChannelRegistry &other) {
+	if (this != &other) {
+		channels_ = other.channels_;
+		buckets_  = other.buckets_;
+	}
+	return *this;
+}
+
+ChannelRegistry::~ChannelRegistry() {
+	debug("ChannelRegistry destructor called");
+}
+
+std::size_t ChannelRegistry::probe_(const std::string &name,
+									unsigned long	   hash) const {
+	const std::size_t mask = buckets_.size() - 1;
+	std::size_t		  i	   = hash & mask;
+	while (!buckets_[i].channel.isNull()) {
+		if (buckets_[i].hash == hash &&
+			CaseMappedString::equalsCaseMapped(
+				channels_.get(buckets_[i].channel)->getName(), name))
+			return i;
+		i = (i + 1) & mask;
+	}
+	return i;
+}
+
+void ChannelRegistry::rehash_(std::size_t bucketCount) {
+	std::vector<Bucket> old(bucketCount);
+	old.swap(buckets_);
+	const std::size_t mask = buckets_.size() - 1;
+	for (std::size_t b = 0; b < old.size(); ++b) {
+		if (old[b].channel.isNull())
+			continue;
+		std::size_t i = old[b].hash & mask;
+		while (!buckets_[i].channel.isNull())
+			i = (i + 1) & mask;
+		buckets_[i] = old[b];
+	}
+}
+
+Channel *ChannelRegistry::find(const std::string &name) {
+	const Bucket &b =
+		buckets_[probe_(name, CaseMappedString::hashCaseMapped(name))];
+	return channels_.get(b.channel);
+}
+
+const Channel *ChannelRegistry::find(const std::string &name) const {
+	const Bucket &b =
+		buckets_[probe_(name, CaseMappedString::hashCaseMapped(name))];
+	return channels_.get(b.channel);
+}
+
+Channel *ChannelRegistry::insert(const Channel &channel) {
+	if ((channels_.size() + 1) * 2 > buckets_.size())
+		rehash_(buckets_.size() * 2);
+	const unsigned long hash =
+		CaseMappedString::hashCaseMapped(channel.getName());
+	Bucket &b = buckets_[probe_(channel.getName(), hash)];
+	if (!b.channel.isNull())
+		return channels_.get(b.channel);
+	b.hash	  = hash;
+	b.channel = channels_.insert(channel);
+	return channels_.get(b.channel);
+}
+
+void ChannelRegistry::erase(const std::string &name) {
+	const std::size_t mask = buckets_.size() - 1;
+	std::size_t		  hole = probe_(name, CaseMappedString::hashCaseMapped(name));
+	if (buckets_[hole].channel.isNull())
+		return;
+	channels_.erase(buckets_[hole].channel);
+	buckets_[hole] = Bucket();
+	// Backward-shift: pull later entries of the probe run into the hole
+	// unless that would move them before their home bucket.
+	for (std::size_t i = (hole + 1) & mask; !buckets_[i].channel.isNull();
+		 i			   = (i + 1) & mask) {
+		const std::size_t home = buckets_[i].hash & mask;
+		if (((i - home) & mask) >= ((i - hole) & mask)) {
+			buckets_[hole] = buckets_[i];
+			buckets_[i]	   = Bucket();
+			hole		   = i;
+		}
+	}
+	if (buckets_.size() > CHANNELREGISTRY_MIN_BUCKETS &&
+		channels_.size() * 8 < buckets_.size())
+		rehash_(buckets_.size() / 2);
+}
+
+bool ChannelRegistry::eraseIfEmpty(Channel &channel) {
+	if (!channel.isEmpty())
+		return false;
+	debug("destroying empty channel " + channel.getName());
+	// copy: the name is destroyed together with the channel
+	const std::string name = channel.getName();
+	erase(name);
+	return true;
+}
+
+std::size_t ChannelRegistry::size() const { return channels_.size(); }
+
+bool ChannelRegistry::empty() const { return channels_.empty(); }
+
+std::size_t ChannelRegistry::slotCount() const { return channels_.slotCount(); }
+
+Channel *ChannelRegistry::at(std::size_t slot) { return channels_.at(slot); }
+
+const Channel *ChannelRegistry::at(std::size_t slot) const {
+	return channels_.at(slot);
+}
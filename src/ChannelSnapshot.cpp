@@ -0,0 +1,303 @@
+#include "../include/ChannelSnapshot.hpp"
+#include "../include/CaseMappedString.hpp"
+#include "../include/Debug.hpp"
+#include "../include/Handoff.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+ChannelState::ChannelState()
+	: topicTime(0), creationTime(0), limit(0), inviteOnly(false),
+	  topicProtected(false), seq(0), destroyed(false) {}
+
+void ChannelState::save(StateWriter &out) const {
+	out.str(name);
+	out.str(topic);
+	out.str(topicWho);
+	out.u64(static_cast<uint64_t>(topicTime));
+	out.u64(static_cast<uint64_t>(creationTime));
+	out.str(key);
+	out.u32(static_cast<uint32_t>(limit));
+	out.u8(inviteOnly);
+	out.u8(topicProtected);
+	out.u32(static_cast<uint32_t>(operators.size()));
+	for (std::set<std::string>::const_iterator it = operators.begin();
+		 it != operators.end(); ++it)
+		out.str(*it);
+	out.u32(static_cast<uint32_t>(invited.size()));
+	for (std::set<std::string>::const_iterator it = invited.begin();
+		 it != invited.end(); ++it)
+		out.str(*it);
+	bans.saveState(out);
+	exceptions.saveState(out);
+	inviteExceptions.saveState(out);
+	out.str(flood);
+}
+
+void ChannelState::load(StateReader &in) {
+	name		   = in.str();
+	topic		   = in.str();
+	topicWho	   = in.str();
+	topicTime	   = static_cast<time_t>(in.u64());
+	creationTime   = static_cast<time_t>(in.u64());
+	key			   = in.str();
+	limit		   = static_cast<int>(in.u32());
+	inviteOnly	   = in.u8() != 0;
+	topicProtected = in.u8() != 0;
+	operators.clear();
+	for (uint32_t count = in.u32(); count; --count)
+		operators.insert(in.str());
+	invited.clear();
+	for (uint32_t count = in.u32(); count; --count)
+		invited.insert(in.str());
+	bans			 = MaskList();
+	exceptions		 = MaskList();
+	inviteExceptions = MaskList();
+	flood.clear();
+	if (in.atEnd())
+		return;
+	bans.loadState(in);
+	exceptions.loadState(in);
+	inviteExceptions.loadState(in);
+	if (!in.atEnd())
+		flood = in.str();
+}
+
+MaskList *ChannelState::maskList(char mode) {
+	return const_cast<MaskList *>(
+		static_cast<const ChannelState &>(*this).maskList(mode));
+}
+
+const MaskList *ChannelState::maskList(char mode) const {
+	switch (mode) {
+	case 'b':
+		return &bans;
+	case 'e':
+		return &exceptions;
+	case 'I':
+		return &inviteExceptions;
+	default:
+		return NULL;
+	}
+}
+
+ChannelSnapshot::ChannelSnapshot()
+	: data_(NULL), size_(0), index_(NULL), count_(0), seq_(0) {
+	debug("ChannelSnapshot constructor called");
+}
+
+ChannelSnapshot::~ChannelSnapshot() {
+	debug("ChannelSnapshot destructor called");
+	close();
+}
+
+void ChannelSnapshot::open(const std::string &path) {
+	close();
+	const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd == -1) {
+		if (errno == ENOENT)
+			return;
+		throw std::runtime_error("[Snapshot] cannot open " + path);
+	}
+	struct stat info;
+	if (fstat(fd, &info) == -1 ||
+		static_cast<std::size_t>(info.st_size) < sizeof(Header)) {
+		::close(fd);
+		throw std::runtime_error("[Snapshot] " + path + " is truncated");
+	}
+	void *mapped = mmap(NULL, static_cast<std::size_t>(info.st_size), PROT_READ,
+						MAP_PRIVATE, fd, 0);
+	::close(fd);
+	if (mapped == MAP_FAILED)
+		throw std::runtime_error("[Snapshot] cannot map " + path);
+	data_ = static_cast<const char *>(mapped);
+	size_ = static_cast<std::size_t>(info.st_size);
+	Header header;
+	std::memcpy(&header, data_, sizeof(header));
+	if (header.magic != SNAPSHOT_MAGIC || header.version != SNAPSHOT_VERSION ||
+		header.count > (size_ - sizeof(Header)) / sizeof(IndexEntry)) {
+		close();
+		throw std::runtime_error("[Snapshot] " + path + " is not a snapshot");
+	}
+	index_ = reinterpret_cast<const IndexEntry *>(data_ + sizeof(Header));
+	count_ = static_cast<std::size_t>(header.count);
+	seq_   = header.seq;
+}
+
+void ChannelSnapshot::close() {
+	if (data_)
+		munmap(const_cast<char *>(data_), size_);
+	data_  = NULL;
+	size_  = 0;
+	index_ = NULL;
+	count_ = 0;
+	seq_   = 0;
+}
+
+uint64_t ChannelSnapshot::seq() const { return seq_; }
+
+std::size_t ChannelSnapshot::count() const { return count_; }
+
+bool ChannelSnapshot::record_(std::size_t i, std::string &out) const {
+	const IndexEntry &entry = index_[i];
+	if (entry.offset > size_ || entry.length > size_ - entry.offset)
+		return false;
+	out.assign(data_ + entry.offset, entry.length);
+	return true;
+}
+
+bool ChannelSnapshot::find(const std::string &name, ChannelState &out) const {
+	if (!count_)
+		return false;
+	const uint64_t hash = CaseMappedString::hashCaseMapped(name);
+	std::size_t	   lo   = 0;
+	std::size_t	   hi   = count_;
+	while (lo < hi) {
+		const std::size_t mid = lo + (hi - lo) / 2;
+		if (index_[mid].hash < hash)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	std::string record;
+	for (; lo < count_ && index_[lo].hash == hash; ++lo) {
+		if (!record_(lo, record))
+			continue;
+		try {
+			StateReader	 in(record);
+			ChannelState state;
+			state.load(in);
+			if (!CaseMappedString::equalsCaseMapped(state.name, name))
+				continue;
+			out = state;
+			return true;
+		} catch (std::exception &) {
+			// a damaged record reads as a missing channel
+		}
+	}
+	return false;
+}
+
+// One record of the snapshot being written: either bytes of the old
+// snapshot or of the re-encoded changes
+struct SnapshotRecord {
+	uint64_t	hash;
+	const char *data;
+	uint32_t	length;
+	bool operator<(const SnapshotRecord &other) const {
+		return hash < other.hash;
+	}
+};
+
+static bool writeFully(int fd, const char *data, std::size_t length) {
+	while (length) {
+		const ssize_t n = ::write(fd, data, length);
+		if (n == -1 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			return false;
+		data += n;
+		length -= static_cast<std::size_t>(n);
+	}
+	return true;
+}
+
+// The directory entry of a rename only survives a crash once the
+// directory itself is synced
+static void syncDirectory(const std::string &path) {
+	const std::string::size_type slash = path.rfind('/');
+	const std::string dir =
+		slash == std::string::npos ? "." : path.substr(0, slash ? slash : 1);
+	const int fd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if (fd == -1)
+		return;
+	fsync(fd);
+	::close(fd);
+}
+
+bool ChannelSnapshot::write(const std::string &path, const ChannelSnapshot &base,
+							const ChannelStateMap &changes, uint64_t seq) {
+	std::vector<SnapshotRecord> records;
+	records.reserve(base.count_ + changes.size());
+	// base records not superseded by a change are copied as they are; only
+	// their name is decoded
+	for (std::size_t i = 0; i < base.count_; ++i) {
+		const IndexEntry &entry = base.index_[i];
+		if (entry.offset > base.size_ || entry.length > base.size_ - entry.offset ||
+			entry.length < sizeof(uint32_t))
+			continue;
+		const char *data = base.data_ + entry.offset;
+		uint32_t	nameLength;
+		std::memcpy(&nameLength, data, sizeof(nameLength));
+		if (nameLength > entry.length - sizeof(uint32_t))
+			continue;
+		const std::string name(data + sizeof(uint32_t), nameLength);
+		if (changes.count(CaseMappedString::toCaseMappedString(name)))
+			continue;
+		SnapshotRecord record = {entry.hash, data, entry.length};
+		records.push_back(record);
+	}
+	StateWriter encoded;
+	std::vector<std::size_t> offsets;
+	for (ChannelStateMap::const_iterator it = changes.begin();
+		 it != changes.end(); ++it) {
+		offsets.push_back(encoded.data().size());
+		if (!it->second.destroyed)
+			it->second.save(encoded);
+	}
+	offsets.push_back(encoded.data().size());
+	std::size_t changed = 0;
+	for (ChannelStateMap::const_iterator it = changes.begin();
+		 it != changes.end(); ++it, ++changed) {
+		if (it->second.destroyed)
+			continue;
+		SnapshotRecord record = {
+			CaseMappedString::hashCaseMapped(it->second.name),
+			encoded.data().data() + offsets[changed],
+			static_cast<uint32_t>(offsets[changed + 1] - offsets[changed])};
+		records.push_back(record);
+	}
+	std::stable_sort(records.begin(), records.end());
+
+	Header header;
+	header.magic   = SNAPSHOT_MAGIC;
+	header.version = SNAPSHOT_VERSION;
+	header.seq	   = seq;
+	header.count   = records.size();
+	std::vector<IndexEntry> index(records.size());
+	uint64_t offset = sizeof(Header) + sizeof(IndexEntry) * records.size();
+	for (std::size_t i = 0; i < records.size(); ++i) {
+		index[i].hash	  = records[i].hash;
+		index[i].offset	  = offset;
+		index[i].length	  = records[i].length;
+		index[i].reserved = 0;
+		offset += records[i].length;
+	}
+
+	const std::string tmp = path + ".tmp";
+	const int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+	if (fd == -1)
+		return false;
+	bool ok = writeFully(fd, reinterpret_cast<const char *>(&header), sizeof(header)) &&
+			  (index.empty() ||
+			   writeFully(fd, reinterpret_cast<const char *>(&index[0]),
+						  sizeof(IndexEntry) * index.size()));
+	for (std::size_t i = 0; ok && i < records.size(); ++i)
+		ok = writeFully(fd, records[i].data, records[i].length);
+	ok = ok && fsync(fd) == 0;
+	::close(fd);
+	if (!ok || rename(tmp.c_str(), path.c_str()) == -1) {
+		unlink(tmp.c_str());
+		return false;
+	}
+	syncDirectory(path);
+	return true;
+}
@@ -1,19 +1,35 @@
 #include "../include/Client.hpp"
+#include "../include/BufferPool.hpp"
 #include "../include/Channel.hpp"
 #include "../include/Debug.hpp"
+#include "../include/Handoff.hpp"
 #include "../include/Message.hpp"
 #include "../include/MessageQueueManager.hpp"
 #include "../include/MessageType.hpp"
 #include "../include/Server.hpp"
 #include <algorithm>
+#include <arpa/inet.h>
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
 
-Client::Client(MessageQueueManager &queueManager, bool passResolved)
-	: mqr_(queueManager), registrationLevel_(passResolved), socket_(-1), nickname_(""),
-	  username_("*"), realname_(""), rawMessage_("") {}
+// Compile-time guard: the array size turns negative if Client outgrows its
+// per-connection budget.
+typedef char clientSizeBudgetCheck[(sizeof(Client) <= CLIENT_SIZE_BUDGET) ? 1 : -1];
 
-Client::Client(const Client &other) : mqr_(other.mqr_)
+MessageQueueManager	*Client::queueManager_ = NULL;
+BufferPool			*Client::bufferPool_ = NULL;
+
+Client::Client(bool passResolved)
+	: socket_(-1), registrationLevel_(passResolved), closing_(false),
+	  addressFamily_(AF_UNSPEC), nickname_(), rawMessage_(NULL),
+	  lastActivity_(std::time(NULL)), linesReceived_(0), username_("*"),
+	  realname_(), peerUid_(-1)
+{
+	std::memset(&address_, 0, sizeof(address_));
+}
+
+Client::Client(const Client &other) : rawMessage_(NULL)
 {
 	*this = other;
 }
@@ -22,25 +38,55 @@ Client &Client::operator=(const Client &other)
 {
     if (this != &other) {
 		clearMessage();
+		if (other.rawMessage_)
+			setRawMessage(*other.rawMessage_);
+		this->lastActivity_ = other.lastActivity_;
+		this->linesReceived_ = other.linesReceived_;
         this->registrationLevel_ = other.registrationLevel_;
         this->nickname_ = other.nickname_;
         this->username_ = other.username_;
         this->realname_ = other.realname_;
-		this->rawMessage_ = other.rawMessage_;
         this->socket_ = other.socket_;
-		this->IP_ = other.IP_;
+        this->closing_ = other.closing_;
+		this->addressFamily_ = other.addressFamily_;
+		this->address_ = other.address_;
+		this->peerUid_ = other.peerUid_;
     }
     return *this;
 }
 
 Client::~Client()
-{}
+{
+	clearMessage();
+}
+
+void Client::setQueueManager(MessageQueueManager &queueManager)
+{
+	queueManager_ = &queueManager;
+}
+
+void Client::setBufferPool(BufferPool &bufferPool)
+{
+	bufferPool_ = &bufferPool;
+}
+
+std::string *Client::acquireBuffer_() const
+{
+	if (bufferPool_)
+		return (bufferPool_->acquire());
+	return (new std::string());
+}
+
+void Client::releaseBuffer_(std::string *buffer) const
+{
+	if (bufferPool_)
+		return (bufferPool_->release(buffer));
+	delete buffer;
+}
 
 bool	Client::operator==(const std::string nickname)
 {
-	if (getNickname() == nickname)
-		return (true);
-	return (false);
+	return (nickname_ == nickname);
 }
 
 bool	Client::operator==(const Client &client)
@@ -54,22 +100,32 @@ bool	Client::operator==(const Client &client)
 
 bool Client::isAuthenticated() const
 {
-	return ((username_ != "*") && !nickname_.empty());
+	return (!(username_ == "*") && !nickname_.empty());
+}
+
+bool Client::isClosing() const
+{
+	return closing_;
+}
+
+void Client::markClosing()
+{
+	closing_ = true;
 }
 
-const std::string &Client::getNickname() const
+std::string Client::getNickname() const
 {
-    return nickname_;
+    return nickname_.str();
 }
 
-const std::string &Client::getUsername() const
+std::string Client::getUsername() const
 {
-    return username_;
+    return username_.str();
 }
 
-const std::string &Client::getRealname() const
+std::string Client::getRealname() const
 {
-    return realname_;
+    return realname_.str();
 }
 
 int Client::getSocket() const
@@ -79,17 +135,82 @@ int Client::getSocket() const
 
 const std::string &Client::getRawMessage() const
 {
-    return rawMessage_;
+	static const std::string	empty;
+	if (!rawMessage_)
+		return empty;
+    return *rawMessage_;
+}
+
+std::string Client::getIP() const
+{
+	char	buf[INET6_ADDRSTRLEN];
+	if (addressFamily_ == AF_INET) {
+		// IPv4 is stored v4-mapped: the address lives in bytes 12-15
+		if (!inet_ntop(AF_INET, &address_.s6_addr[12], buf, sizeof(buf)))
+			return std::string();
+	} else if (addressFamily_ == AF_INET6) {
+		if (!inet_ntop(AF_INET6, &address_, buf, sizeof(buf)))
+			return std::string();
+	} else if (addressFamily_ == AF_UNIX) {
+		if (peerUid_ < 0)
+			return std::string("localhost");
+		std::snprintf(buf, sizeof(buf), "uid%ld.localhost", peerUid_);
+	} else
+		return std::string();
+	return std::string(buf);
 }
 
-const std::string &Client::getIP() const
+const struct in6_addr &Client::getAddress() const
 {
-    return IP_;
+	return address_;
 }
 
 void Client::clearMessage()
 {
-	rawMessage_.clear();
+	releaseBuffer_(rawMessage_);
+	rawMessage_ = NULL;
+}
+
+void Client::touch(time_t now)
+{
+	lastActivity_ = now;
+}
+
+time_t Client::getLastActivity() const
+{
+	return lastActivity_;
+}
+
+void Client::countLine()
+{
+	++linesReceived_;
+}
+
+uint32_t Client::getLinesReceived() const
+{
+	return linesReceived_;
+}
+
+size_t Client::trimBuffers()
+{
+	if (!rawMessage_)
+		return (0);
+	const size_t before = rawMessage_->capacity();
+	std::string(*rawMessage_).swap(*rawMessage_);
+	const size_t after = rawMessage_->capacity();
+	if (bufferPool_)
+		bufferPool_->resized(before, after);
+	return (before > after ? before - after : 0);
+}
+
+void Client::consumeRawMessage(size_t length)
+{
+	if (!rawMessage_)
+		return;
+	if (length >= rawMessage_->size())
+		clearMessage();
+	else
+		rawMessage_->erase(0, length);
 }
 
 
@@ -104,6 +225,12 @@ int Client::getRegistrationLevel(void) const
 }
 
 // Setters
+std::string Client::getHostmask() const
+{
+	return CaseMappedString::toCaseMappedString(
+		nickname_.str() + "!" + username_.str() + "@" + getIP());
+}
+
 void Client::setNickname(const std::string &nickname)
 {
     nickname_ = nickname;
@@ -127,31 +254,68 @@ void Client::setSocket(int socket)
 
 void Client::setRawMessage(const std::string &rawMessage)
 {
-    rawMessage_ = rawMessage;
+	if (rawMessage.empty())
+		return (clearMessage());
+	if (!rawMessage_)
+		rawMessage_ = acquireBuffer_();
+	const size_t before = rawMessage_->capacity();
+	*rawMessage_ = rawMessage;
+	if (bufferPool_)
+		bufferPool_->resized(before, rawMessage_->capacity());
+}
+
+void Client::setAddress(const struct sockaddr_storage &address)
+{
+	std::memset(&address_, 0, sizeof(address_));
+	addressFamily_ = static_cast<unsigned char>(address.ss_family);
+	if (address.ss_family == AF_INET) {
+		const struct sockaddr_in *sa = reinterpret_cast<const struct sockaddr_in *>(&address);
+		address_.s6_addr[10] = 0xff;
+		address_.s6_addr[11] = 0xff;
+		std::memcpy(&address_.s6_addr[12], &sa->sin_addr, sizeof(sa->sin_addr));
+	} else if (address.ss_family == AF_INET6) {
+		const struct sockaddr_in6 *sa6 = reinterpret_cast<const struct sockaddr_in6 *>(&address);
+		address_ = sa6->sin6_addr;
+		// Normalize IPv4-mapped IPv6 addresses to plain IPv4 for readability
+		if (IN6_IS_ADDR_V4MAPPED(&address_))
+			addressFamily_ = AF_INET;
+	} else if (address.ss_family == AF_UNIX) {
+		// local peer on a Unix-domain listener: counts as loopback
+		address_ = in6addr_loopback;
+	}
+}
+
+void Client::setPeerUid(long uid)
+{
+	peerUid_ = uid;
 }
 
-void Client::setIP(const std::string &IP)
+long Client::getPeerUid() const
 {
-    IP_ = IP;
+	return peerUid_;
 }
 
 void Client::appendRawMessage(const char partialMessage[BUFSIZ], size_t length)
 {
-	rawMessage_ += std::string(partialMessage, length);
+	if (!rawMessage_)
+		rawMessage_ = acquireBuffer_();
+	const size_t before = rawMessage_->capacity();
+	rawMessage_->append(partialMessage, length);
+	if (bufferPool_ && rawMessage_->capacity() != before)
+		bufferPool_->resized(before, rawMessage_->capacity());
 }
 
 void Client::sendMessage(Message toSend) const {
-	mqr_.send(this->getSocket(), toSend.toString());
+	queueManager_->send(this->getSocket(), toSend.toString());
 }
 
 bool	Client::sendMessageTo(Message msg, const std::string recipientNickname, Server &server) const
 {
 	msg.setSource(*this);
-	std::vector<Client> clients = server.getClients();
-	std::vector<Client>::iterator clientIt = std::find(clients.begin(), clients.end(), recipientNickname);
-	if (clientIt != clients.end())
+	const Client *recipient = server.findClientByNick(recipientNickname);
+	if (recipient)
 	{
-		clientIt->sendMessage(msg);
+		recipient->sendMessage(msg);
 		return (true);
 	}
 	return (false);
@@ -223,8 +387,10 @@ void Client::sendCmdValidation(const Message inMessage, const Channel &channel)
 	channel.broadcastMsg(*this, outMessage);
 }
 
-void	Client::welcome(const Server &server)
+void	Client::welcome(Server &server)
 {
+	server.getMetrics().add(METRIC_REGISTRATIONS);
+	server.getMetrics().increment(METRIC_USERS);
 	std::string	nickname = getNickname();
 	std::string	welcome = std::string("Welcome to the ") + HOSTNAME + " Network, " + nickname;
 	std::string yourhost = std::string("Your host is ") + HOSTNAME + ", running version" + VERSION;
@@ -241,4 +407,37 @@ void	Client::welcome(const Server &server)
 	this->sendErrorMessage(RPL_CREATED , vec);
 	vec[1] = myInfo;
 	this->sendErrorMessage(RPL_MYINFO , vec);
+	server.notifyMonitors(nickname, this);
+}
+
+void	Client::saveState(StateWriter &out) const
+{
+	out.u32(static_cast<uint32_t>(socket_));
+	out.u8(registrationLevel_);
+	out.u8(addressFamily_);
+	out.bytes(&address_, sizeof(address_));
+	out.u64(static_cast<uint64_t>(peerUid_));
+	out.str(nickname_.str());
+	out.str(username_.str());
+	out.str(realname_.str());
+	out.u64(static_cast<uint64_t>(lastActivity_));
+	out.u32(linesReceived_);
+	out.str(rawMessage_ ? *rawMessage_ : std::string());
+}
+
+void	Client::loadState(StateReader &in)
+{
+	socket_ = static_cast<int>(in.u32());
+	registrationLevel_ = in.u8();
+	addressFamily_ = in.u8();
+	in.bytes(&address_, sizeof(address_));
+	peerUid_ = static_cast<long>(in.u64());
+	setNickname(in.str());
+	setUsername(in.str());
+	setRealname(in.str());
+	lastActivity_ = static_cast<time_t>(in.u64());
+	linesReceived_ = in.u32();
+	const std::string rawMessage = in.str();
+	if (!rawMessage.empty())
+		setRawMessage(rawMessage);
 }
@@ -7,11 +7,19 @@
 #include "../include/commands/PrivmsgCommand.hpp"
 #include "../include/commands/JoinCommand.hpp"
 #include "../include/commands/KickCommand.hpp"
+#include "../include/commands/PartCommand.hpp"
 #include "../include/commands/QuitCommand.hpp"
 #include "../include/commands/InviteCommand.hpp"
 #include "../include/commands/TopicCommand.hpp"
 #include "../include/commands/ModeCommand.hpp"
 #include "../include/commands/WhoCommand.hpp"
+#include "../include/commands/NamesCommand.hpp"
+#include "../include/commands/StatsCommand.hpp"
+#include "../include/commands/LusersCommand.hpp"
+#include "../include/commands/ChathistoryCommand.hpp"
+#include "../include/commands/MonitorCommand.hpp"
+#include "../include/commands/WhoisCommand.hpp"
+#include "../include/commands/ListCommand.hpp"
 #include "../include/commands/UnknownCommand.hpp"
 
 // Default Constructor
@@ -59,11 +67,19 @@ static void fillCommandMap(std::map<std::string, CommandFactory> &commandMap)
 	commandMap["NOTICE"]	= &PrivmsgCommand::fromMessage;
 	commandMap["JOIN"]		= &JoinCommand::fromMessage;
 	commandMap["KICK"]		= &KickCommand::fromMessage;
+	commandMap["PART"]		= &PartCommand::fromMessage;
 	commandMap["QUIT"]		= &QuitCommand::fromMessage;
 	commandMap["INVITE"]	= &InviteCommand::fromMessage;
 	commandMap["TOPIC"]		= &TopicCommand::fromMessage;
 	commandMap["MODE"]		= &ModeCommand::fromMessage;
 	commandMap["WHO"]		= &WhoCommand::fromMessage;
+	commandMap["WHOIS"]		= &WhoisCommand::fromMessage;
+	commandMap["LIST"]		= &ListCommand::fromMessage;
+	commandMap["NAMES"]		= &NamesCommand::fromMessage;
+	commandMap["STATS"]		= &StatsCommand::fromMessage;
+	commandMap["LUSERS"]	= &LusersCommand::fromMessage;
+	commandMap["CHATHISTORY"]	= &ChathistoryCommand::fromMessage;
+	commandMap["MONITOR"]	= &MonitorCommand::fromMessage;
 	commandMap["UNKNOWN"]	= &UnknownCommand::fromMessage;
 	//...
 }
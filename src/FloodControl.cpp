@@ -0,0 +1,104 @@
+#include "../include/FloodControl.hpp"
+
+#include <cerrno>
+#include <cstdlib>
+#include <sstream>
+
+RateWindow::RateWindow() : start_(0), current_(0), previous_(0) {}
+
+RateWindow::RateWindow(const RateWindow &other)
+	: start_(other.start_), current_(other.current_),
+	  previous_(other.previous_) {}
+
+RateWindow &RateWindow::operator=(const RateWindow &other) {
+	start_	  = other.start_;
+	current_  = other.current_;
+	previous_ = other.previous_;
+	return *this;
+}
+
+RateWindow::~RateWindow() {}
+
+void RateWindow::roll_(time_t now, unsigned seconds) {
+	const uint32_t at = static_cast<uint32_t>(now);
+	// the clock was set back: start over from there
+	if (at < start_)
+		start_ = at;
+	if (at < start_ + seconds)
+		return;
+	// a silent stretch of two windows or more forgets everything
+	previous_ = at < start_ + 2 * seconds ? current_ : 0;
+	current_  = 0;
+	start_	  = at - (at - start_) % seconds;
+}
+
+unsigned RateWindow::rate(time_t now, unsigned seconds) {
+	roll_(now, seconds);
+	const uint32_t elapsed = static_cast<uint32_t>(now) - start_;
+	return current_ + previous_ * (seconds - elapsed) / seconds;
+}
+
+void RateWindow::count(time_t now, unsigned seconds) {
+	roll_(now, seconds);
+	if (current_ < 0xffff)
+		++current_;
+}
+
+FloodLimit::FloodLimit()
+	: memberLines(0), channelLines(0), seconds(0), action(FLOOD_THROTTLE) {}
+
+bool FloodLimit::isSet() const { return memberLines != 0; }
+
+static bool parseNumber(const std::string &text, unsigned max,
+						unsigned &out) {
+	if (text.empty() || text[0] < '0' || text[0] > '9')
+		return false;
+	char *end = NULL;
+	errno	  = 0;
+	const unsigned long value = std::strtoul(text.c_str(), &end, 10);
+	if (errno || *end || value > max)
+		return false;
+	out = static_cast<unsigned>(value);
+	return true;
+}
+
+bool FloodLimit::parse(const std::string &text) {
+	FloodLimit		  limit;
+	std::stringstream stream(text);
+	std::string		  token;
+	if (!std::getline(stream, token, ','))
+		return false;
+	const std::string::size_type colon = token.find(':');
+	if (colon == std::string::npos ||
+		!parseNumber(token.substr(0, colon), FLOOD_MAX_LINES,
+					 limit.memberLines) ||
+		!parseNumber(token.substr(colon + 1), FLOOD_MAX_SECONDS,
+					 limit.seconds) ||
+		!limit.memberLines || !limit.seconds)
+		return false;
+	while (std::getline(stream, token, ',')) {
+		if (token == "drop")
+			limit.action = FLOOD_DROP;
+		else if (token == "throttle")
+			limit.action = FLOOD_THROTTLE;
+		else if (token == "kick")
+			limit.action = FLOOD_KICK;
+		else if (!parseNumber(token, FLOOD_MAX_LINES, limit.channelLines))
+			return false;
+	}
+	*this = limit;
+	return true;
+}
+
+std::string FloodLimit::toString() const {
+	if (!isSet())
+		return std::string();
+	std::ostringstream out;
+	out << memberLines << ":" << seconds;
+	if (channelLines)
+		out << "," << channelLines;
+	out << (action == FLOOD_DROP	 ? ",drop"
+			: action == FLOOD_KICK ? ",kick"
+								   : ",throttle");
+	return out.str();
+}
@@ -0,0 +1,75 @@
+#include "../include/GlobMask.hpp"
+#include "../include/CaseMappedString.hpp"
+
+GlobMask::GlobMask() : pieces_(1), literal_(true) {}
+
+GlobMask::GlobMask(const std::string &pattern)
+	: pattern_(pattern), literal_(true) {
+	std::string piece;
+	for (std::string::size_type i = 0; i < pattern.size(); ++i) {
+		if (pattern[i] == '*') {
+			// "a**b" is "a*b"
+			if (pieces_.empty() || !piece.empty())
+				pieces_.push_back(piece);
+			piece.clear();
+			literal_ = false;
+			continue;
+		}
+		if (pattern[i] == '?')
+			literal_ = false;
+		piece += CaseMappedString::toCaseMapped(pattern[i]);
+	}
+	pieces_.push_back(piece);
+}
+
+GlobMask::GlobMask(const GlobMask &other)
+	: pattern_(other.pattern_), pieces_(other.pieces_),
+	  literal_(other.literal_) {}
+
+GlobMask &GlobMask::operator=(const GlobMask &other) {
+	if (this != &other) {
+		pattern_ = other.pattern_;
+		pieces_	 = other.pieces_;
+		literal_ = other.literal_;
+	}
+	return *this;
+}
+
+GlobMask::~GlobMask() {}
+
+const std::string &GlobMask::pattern() const { return pattern_; }
+
+bool GlobMask::isLiteral() const { return literal_; }
+
+bool GlobMask::pieceAt_(const std::string &piece, const std::string &text,
+						std::string::size_type pos) {
+	for (std::string::size_type i = 0; i < piece.size(); ++i)
+		if (piece[i] != '?' &&
+			piece[i] != CaseMappedString::toCaseMapped(text[pos + i]))
+			return false;
+	return true;
+}
+
+bool GlobMask::matches(const std::string &text) const {
+	const std::string &prefix = pieces_.front();
+	if (pieces_.size() == 1)
+		return text.size() == prefix.size() && pieceAt_(prefix, text, 0);
+	const std::string &suffix = pieces_.back();
+	if (text.size() < prefix.size() + suffix.size() ||
+		!pieceAt_(prefix, text, 0) ||
+		!pieceAt_(suffix, text, text.size() - suffix.size()))
+		return false;
+	// leftmost placement of each middle piece leaves the most room for the
+	// next ones, so the first fit is the right one
+	std::string::size_type		 pos   = prefix.size();
+	const std::string::size_type limit = text.size() - suffix.size();
+	for (std::size_t i = 1; i + 1 < pieces_.size(); ++i) {
+		const std::string &piece = pieces_[i];
+		while (pos + piece.size() <= limit && !pieceAt_(piece, text, pos))
+			++pos;
+		if (pos + piece.size() > limit)
+			return false;
+		pos += piece.size();
+	}
+	return true;
+}
@@ -0,0 +1,220 @@
+#include "../include/Handoff.hpp"
+#include "../include/Debug.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+StateWriter::StateWriter() {}
+
+StateWriter::StateWriter(const StateWriter &other) : data_(other.data_) {}
+
+StateWriter &StateWriter::operator=(const StateWriter &other) {
+	if (this != &other)
+		data_ = other.data_;
+	return *this;
+}
+
+StateWriter::~StateWriter() {}
+
+void StateWriter::u8(uint8_t value) { bytes(&value, sizeof(value)); }
+
+void StateWriter::u32(uint32_t value) { bytes(&value, sizeof(value)); }
+
+void StateWriter::u64(uint64_t value) { bytes(&value, sizeof(value)); }
+
+void StateWriter::str(const std::string &value) {
+	u32(static_cast<uint32_t>(value.size()));
+	data_.append(value);
+}
+
+void StateWriter::bytes(const void *data, std::size_t length) {
+	data_.append(static_cast<const char *>(data), length);
+}
+
+const std::string &StateWriter::data() const { return data_; }
+
+StateReader::StateReader(const std::string &data) : data_(data), offset_(0) {}
+
+StateReader::StateReader(const StateReader &other)
+	: data_(other.data_), offset_(other.offset_) {}
+
+StateReader::~StateReader() {}
+
+uint8_t StateReader::u8() {
+	uint8_t value;
+	bytes(&value, sizeof(value));
+	return value;
+}
+
+uint32_t StateReader::u32() {
+	uint32_t value;
+	bytes(&value, sizeof(value));
+	return value;
+}
+
+uint64_t StateReader::u64() {
+	uint64_t value;
+	bytes(&value, sizeof(value));
+	return value;
+}
+
+std::string StateReader::str() {
+	const uint32_t length = u32();
+	if (length > data_.size() - offset_)
+		throw std::runtime_error("[Handoff] truncated state");
+	const std::string value = data_.substr(offset_, length);
+	offset_ += length;
+	return value;
+}
+
+void StateReader::bytes(void *data, std::size_t length) {
+	if (length > data_.size() - offset_)
+		throw std::runtime_error("[Handoff] truncated state");
+	std::memcpy(data, data_.data() + offset_, length);
+	offset_ += length;
+}
+
+bool StateReader::atEnd() const { return offset_ == data_.size(); }
+
+// Fixed-size preamble of a handoff
+struct HandoffHeader {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t fdCount;
+	uint32_t reserved;
+	uint64_t stateLength;
+};
+
+static bool writeAll(int socket, const char *data, std::size_t length) {
+	while (length) {
+		const ssize_t n = ::send(socket, data, length, MSG_NOSIGNAL);
+		if (n == -1 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			return false;
+		data += n;
+		length -= static_cast<std::size_t>(n);
+	}
+	return true;
+}
+
+static bool readAll(int socket, char *data, std::size_t length) {
+	while (length) {
+		const ssize_t n = ::recv(socket, data, length, 0);
+		if (n == -1 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			return false;
+		data += n;
+		length -= static_cast<std::size_t>(n);
+	}
+	return true;
+}
+
+void Handoff::setTimeouts(int socket) {
+	struct timeval timeout;
+	timeout.tv_sec	= HANDOFF_TIMEOUT_SECONDS;
+	timeout.tv_usec = 0;
+	setsockopt(socket, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+	setsockopt(socket, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+}
+
+bool Handoff::send(int socket, const std::string &state,
+				   const std::vector<int> &fds) {
+	HandoffHeader header;
+	header.magic	   = HANDOFF_MAGIC;
+	header.version	   = HANDOFF_VERSION;
+	header.fdCount	   = static_cast<uint32_t>(fds.size());
+	header.reserved	   = 0;
+	header.stateLength = state.size();
+	if (!writeAll(socket, reinterpret_cast<const char *>(&header), sizeof(header)) ||
+		!writeAll(socket, state.data(), state.size()))
+		return false;
+	char control[CMSG_SPACE(sizeof(int) * HANDOFF_FDS_PER_MESSAGE)];
+	for (std::size_t first = 0; first < fds.size();
+		 first += HANDOFF_FDS_PER_MESSAGE) {
+		const std::size_t count =
+			std::min<std::size_t>(HANDOFF_FDS_PER_MESSAGE, fds.size() - first);
+		char		  filler = 0;
+		struct iovec  iov	 = {&filler, 1};
+		struct msghdr msg;
+		std::memset(&msg, 0, sizeof(msg));
+		std::memset(control, 0, sizeof(control));
+		msg.msg_iov		   = &iov;
+		msg.msg_iovlen	   = 1;
+		msg.msg_control	   = control;
+		msg.msg_controllen = CMSG_SPACE(sizeof(int) * count);
+		struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+		cmsg->cmsg_level	 = SOL_SOCKET;
+		cmsg->cmsg_type		 = SCM_RIGHTS;
+		cmsg->cmsg_len		 = CMSG_LEN(sizeof(int) * count);
+		std::memcpy(CMSG_DATA(cmsg), &fds[first], sizeof(int) * count);
+		ssize_t sent;
+		do
+			sent = sendmsg(socket, &msg, MSG_NOSIGNAL);
+		while (sent == -1 && errno == EINTR);
+		if (sent != 1)
+			return false;
+	}
+	return true;
+}
+
+void Handoff::receive(int socket, std::string &state, std::vector<int> &fds) {
+	HandoffHeader header;
+	if (!readAll(socket, reinterpret_cast<char *>(&header), sizeof(header)))
+		throw std::runtime_error("[Handoff] no header");
+	if (header.magic != HANDOFF_MAGIC || header.version != HANDOFF_VERSION)
+		throw std::runtime_error("[Handoff] incompatible state version");
+	state.resize(header.stateLength);
+	if (header.stateLength && !readAll(socket, &state[0], state.size()))
+		throw std::runtime_error("[Handoff] truncated state");
+	fds.clear();
+	fds.reserve(header.fdCount);
+	char control[CMSG_SPACE(sizeof(int) * HANDOFF_FDS_PER_MESSAGE)];
+	while (fds.size() < header.fdCount) {
+		char		  filler;
+		struct iovec  iov = {&filler, 1};
+		struct msghdr msg;
+		std::memset(&msg, 0, sizeof(msg));
+		msg.msg_iov		   = &iov;
+		msg.msg_iovlen	   = 1;
+		msg.msg_control	   = control;
+		msg.msg_controllen = sizeof(control);
+		ssize_t received;
+		do
+			received = recvmsg(socket, &msg, MSG_CMSG_CLOEXEC);
+		while (received == -1 && errno == EINTR);
+		if (received != 1 || (msg.msg_flags & MSG_CTRUNC))
+			throw std::runtime_error("[Handoff] descriptor transfer failed");
+		for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg;
+			 cmsg				  = CMSG_NXTHDR(&msg, cmsg)) {
+			if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS)
+				continue;
+			const std::size_t count =
+				(cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+			const int *incoming = reinterpret_cast<const int *>(CMSG_DATA(cmsg));
+			fds.insert(fds.end(), incoming, incoming + count);
+		}
+	}
+	if (fds.size() != header.fdCount)
+		throw std::runtime_error("[Handoff] descriptor count mismatch");
+}
+
+void Handoff::acknowledge(int socket) {
+	const char ready = 'R';
+	writeAll(socket, &ready, 1);
+}
+
+bool Handoff::awaitAcknowledge(int socket) {
+	char ready = 0;
+	return readAll(socket, &ready, 1) && ready == 'R';
+}
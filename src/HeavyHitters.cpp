@@ -0,0 +1,130 @@
+#include "../include/HeavyHitters.hpp"
+#include "../include/Debug.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+// C++98 has no 64-bit literals
+static uint64_t constant64(unsigned long high, unsigned long low) {
+	return static_cast<uint64_t>(high) << 32 | low;
+}
+
+// splitmix64 finalizer, seeded per row
+static uint64_t mixRow(uint64_t key, int row) {
+	static const uint64_t golden = constant64(0x9e3779b9ul, 0x7f4a7c15ul);
+	static const uint64_t mulA	 = constant64(0xbf58476dul, 0x1ce4e5b9ul);
+	static const uint64_t mulB	 = constant64(0x94d049bbul, 0x133111ebul);
+	uint64_t			  x = key + (static_cast<uint64_t>(row) + 1) * golden;
+	x						= (x ^ (x >> 30)) * mulA;
+	x						= (x ^ (x >> 27)) * mulB;
+	return x ^ (x >> 31);
+}
+
+static bool largerFirst(const HeavyHitters::Entry &a,
+						const HeavyHitters::Entry &b) {
+	return a.estimate > b.estimate;
+}
+
+HeavyHitters::HeavyHitters() : total_(0) {
+	debug("HeavyHitters default constructor called");
+	std::memset(counters_, 0, sizeof(counters_));
+	heap_.reserve(HEAVY_TOP);
+}
+
+HeavyHitters::HeavyHitters(const HeavyHitters &other)
+	: heap_(other.heap_), total_(other.total_) {
+	std::memcpy(counters_, other.counters_, sizeof(counters_));
+}
+
+HeavyHitters &HeavyHitters::operator=(const HeavyHitters &other) {
+	if (this != &other) {
+		std::memcpy(counters_, other.counters_, sizeof(counters_));
+		heap_  = other.heap_;
+		total_ = other.total_;
+	}
+	return *this;
+}
+
+HeavyHitters::~HeavyHitters() { debug("HeavyHitters destructor called"); }
+
+bool HeavyHitters::add(uint64_t key, uint64_t amount) {
+	total_ += amount;
+	uint64_t estimate = 0;
+	for (int row = 0; row < HEAVY_DEPTH; ++row) {
+		uint64_t &counter = counters_[row][mixRow(key, row) & (HEAVY_WIDTH - 1)];
+		counter += amount;
+		if (row == 0 || counter < estimate)
+			estimate = counter;
+	}
+	const std::size_t index = find_(key);
+	if (index < heap_.size()) {
+		// estimates only grow between decays: restore the order below
+		heap_[index].estimate = estimate;
+		siftDown_(index);
+		return false;
+	}
+	Entry entry;
+	entry.key	   = key;
+	entry.estimate = estimate;
+	if (heap_.size() < HEAVY_TOP) {
+		heap_.push_back(entry);
+		std::push_heap(heap_.begin(), heap_.end(), largerFirst);
+		return true;
+	}
+	if (estimate <= heap_[0].estimate)
+		return false;
+	heap_[0] = entry;
+	siftDown_(0);
+	return true;
+}
+
+void HeavyHitters::setLabel(uint64_t key, const std::string &label) {
+	const std::size_t index = find_(key);
+	if (index < heap_.size())
+		heap_[index].label = label;
+}
+
+void HeavyHitters::decay() {
+	for (int row = 0; row < HEAVY_DEPTH; ++row)
+		for (int column = 0; column < HEAVY_WIDTH; ++column)
+			counters_[row][column] >>= 1;
+	// halving keeps the heap order
+	for (std::size_t i = 0; i < heap_.size(); ++i)
+		heap_[i].estimate >>= 1;
+	total_ >>= 1;
+}
+
+std::vector<HeavyHitters::Entry> HeavyHitters::top() const {
+	std::vector<Entry> sorted(heap_);
+	std::sort(sorted.begin(), sorted.end(), largerFirst);
+	while (!sorted.empty() && sorted.back().estimate == 0)
+		sorted.pop_back();
+	return sorted;
+}
+
+uint64_t HeavyHitters::total() const { return total_; }
+
+void HeavyHitters::siftDown_(std::size_t index) {
+	const std::size_t size = heap_.size();
+	while (true) {
+		const std::size_t left	   = 2 * index + 1;
+		const std::size_t right	   = left + 1;
+		std::size_t		  smallest = index;
+		if (left < size && heap_[left].estimate < heap_[smallest].estimate)
+			smallest = left;
+		if (right < size && heap_[right].estimate < heap_[smallest].estimate)
+			smallest = right;
+		if (smallest == index)
+			return;
+		std::swap(heap_[index], heap_[smallest]);
+		index = smallest;
+	}
+}
+
+// linear scan: HEAVY_TOP is small enough that an index would cost more
+std::size_t HeavyHitters::find_(uint64_t key) const {
+	std::size_t i = 0;
+	while (i < heap_.size() && heap_[i].key != key)
+		++i;
+	return i;
+}
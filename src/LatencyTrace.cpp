@@ -0,0 +1,179 @@
+#include "../include/LatencyTrace.hpp"
+
+#ifdef LATENCY_TRACE
+# include <csignal>
+# include <cstdio>
+# include <cstring>
+# include <ctime>
+
+// Distinct command names tracked; later ones are charged to "(other)"
+# define LATENCY_MAX_COMMANDS 32
+# define LATENCY_NAME_LEN 15
+// 2^3 sub-buckets per power of two: values are kept within 12.5%
+# define LATENCY_SUB_BITS 3
+# define LATENCY_SUB_COUNT (1u << LATENCY_SUB_BITS)
+// Highest power of two tracked (2^39 usec is about six days)
+# define LATENCY_MAX_EXPONENT 39
+# define LATENCY_BUCKETS \
+	((LATENCY_MAX_EXPONENT - LATENCY_SUB_BITS + 2) * LATENCY_SUB_COUNT)
+
+namespace {
+
+struct Histogram {
+	uint32_t	buckets[LATENCY_BUCKETS];
+	uint64_t	count;
+	uint64_t	sum;
+	uint64_t	max;
+};
+
+// Everything is static: tracing never allocates on the hot path.
+char			g_commandNames[LATENCY_MAX_COMMANDS + 2][LATENCY_NAME_LEN + 1] = {
+	"-", "(other)"};
+unsigned		g_commandCount = 2;
+Histogram		g_histograms[LATENCY_MAX_COMMANDS + 2][LATENCY_STAGE_COUNT];
+uint64_t		g_recvUsec = 0;		// recv of the line being processed
+uint64_t		g_lastRecvUsec = 0;	// latest recv(2), start of the next line
+unsigned		g_command = 0;
+volatile sig_atomic_t g_dumpRequested = 0;
+
+const char *const g_stageNames[LATENCY_STAGE_COUNT] = {
+	"parse", "execute", "enqueue", "send", "total"};
+
+// Values below LATENCY_SUB_COUNT are exact; above, the top LATENCY_SUB_BITS
+// bits after the leading one pick the sub-bucket of its power of two.
+unsigned	bucketIndex(uint64_t value) {
+	if (value < LATENCY_SUB_COUNT)
+		return static_cast<unsigned>(value);
+	unsigned exponent = LATENCY_SUB_BITS;
+	while (exponent < LATENCY_MAX_EXPONENT && (value >> (exponent + 1)))
+		++exponent;
+	if (value >> (exponent + 1))
+		return LATENCY_BUCKETS - 1;
+	const unsigned sub = static_cast<unsigned>(
+		(value >> (exponent - LATENCY_SUB_BITS)) & (LATENCY_SUB_COUNT - 1));
+	return (exponent - LATENCY_SUB_BITS + 1) * LATENCY_SUB_COUNT + sub;
+}
+
+// Largest value that lands in bucket index
+uint64_t	bucketUpperBound(unsigned index) {
+	if (index < LATENCY_SUB_COUNT)
+		return index;
+	const unsigned exponent = index / LATENCY_SUB_COUNT + LATENCY_SUB_BITS - 1;
+	const uint64_t sub = index % LATENCY_SUB_COUNT;
+	return ((LATENCY_SUB_COUNT + sub + 1) << (exponent - LATENCY_SUB_BITS)) - 1;
+}
+
+void	record(unsigned command, LatencyStage stage, uint64_t value) {
+	Histogram &histogram = g_histograms[command][stage];
+	++histogram.buckets[bucketIndex(value)];
+	++histogram.count;
+	histogram.sum += value;
+	if (value > histogram.max)
+		histogram.max = value;
+}
+
+uint64_t	percentile(const Histogram &histogram, unsigned perMille) {
+	const uint64_t rank = (histogram.count * perMille + 999) / 1000;
+	uint64_t seen = 0;
+	for (unsigned i = 0; i < LATENCY_BUCKETS; ++i) {
+		seen += histogram.buckets[i];
+		if (seen >= rank)
+			return bucketUpperBound(i) < histogram.max ? bucketUpperBound(i)
+													   : histogram.max;
+	}
+	return histogram.max;
+}
+
+} // namespace
+
+uint64_t	latencyTraceNow() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return static_cast<uint64_t>(ts.tv_sec) * 1000000u +
+		   static_cast<uint64_t>(ts.tv_nsec / 1000);
+}
+
+void	latencyTraceRecv() { g_lastRecvUsec = latencyTraceNow(); }
+
+void	latencyTraceParsed(const char *type) {
+	g_recvUsec = g_lastRecvUsec;
+	g_command = 1;
+	for (unsigned i = 2; i < g_commandCount; ++i) {
+		if (std::strncmp(g_commandNames[i], type, LATENCY_NAME_LEN) == 0) {
+			g_command = i;
+			break;
+		}
+	}
+	if (g_command == 1 && g_commandCount < LATENCY_MAX_COMMANDS + 2) {
+		std::strncpy(g_commandNames[g_commandCount], type, LATENCY_NAME_LEN);
+		g_command = g_commandCount++;
+	}
+	record(g_command, LATENCY_STAGE_PARSE, latencyTraceNow() - g_recvUsec);
+}
+
+void	latencyTraceExecuted() {
+	if (g_recvUsec)
+		record(g_command, LATENCY_STAGE_EXECUTE,
+			   latencyTraceNow() - g_recvUsec);
+}
+
+void	latencyTraceEnd() {
+	g_recvUsec = 0;
+	g_command = 0;
+}
+
+LatencyStamp	latencyTraceEnqueued() {
+	LatencyStamp stamp;
+	stamp.recvUsec = g_recvUsec;
+	stamp.enqueueUsec = latencyTraceNow();
+	stamp.command = g_command;
+	if (stamp.recvUsec)
+		record(stamp.command, LATENCY_STAGE_ENQUEUE,
+			   stamp.enqueueUsec - stamp.recvUsec);
+	return stamp;
+}
+
+void	latencyTraceSent(const LatencyStamp &stamp) {
+	const uint64_t now = latencyTraceNow();
+	record(stamp.command, LATENCY_STAGE_SEND, now - stamp.enqueueUsec);
+	if (stamp.recvUsec)
+		record(stamp.command, LATENCY_STAGE_TOTAL, now - stamp.recvUsec);
+}
+
+void	latencyTraceDump(std::ostream &out) {
+	char line[160];
+	std::snprintf(line, sizeof(line),
+				  "%-16s %-8s %10s %10s %10s %10s %10s %10s %10s\n", "command",
+				  "stage", "count", "mean", "p50", "p90", "p99", "p99.9",
+				  "max");
+	out << "==== latency (usec) ====\n" << line;
+	for (unsigned c = 0; c < g_commandCount; ++c) {
+		for (int s = 0; s < LATENCY_STAGE_COUNT; ++s) {
+			const Histogram &h = g_histograms[c][s];
+			if (!h.count)
+				continue;
+			std::snprintf(line, sizeof(line),
+						  "%-16s %-8s %10lu %10lu %10lu %10lu %10lu %10lu %10lu\n",
+						  g_commandNames[c], g_stageNames[s],
+						  static_cast<unsigned long>(h.count),
+						  static_cast<unsigned long>(h.sum / h.count),
+						  static_cast<unsigned long>(percentile(h, 500)),
+						  static_cast<unsigned long>(percentile(h, 900)),
+						  static_cast<unsigned long>(percentile(h, 990)),
+						  static_cast<unsigned long>(percentile(h, 999)),
+						  static_cast<unsigned long>(h.max));
+			out << line;
+		}
+	}
+	out << std::flush;
+}
+
+void	latencyTraceRequestDump() { g_dumpRequested = 1; }
+
+void	latencyTracePoll(std::ostream &out) {
+	if (!g_dumpRequested)
+		return;
+	g_dumpRequested = 0;
+	latencyTraceDump(out);
+}
+#endif
@@ -0,0 +1,581 @@
+#include "../include/LoadGenerator.hpp"
+#include "../include/Debug.hpp"
+#include "../include/IrcUtils.hpp"
+#include "../include/Message.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+#include <netdb.h>
+#include <sys/un.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+// Give up the ramp-up when no connection made progress for this long
+#define BENCH_STALL_USEC   30000000u
+// After the traffic phase, wait this long for in-flight deliveries
+#define BENCH_SETTLE_USEC  2000000u
+
+volatile sig_atomic_t LoadGenerator::stopRequested_ = 0;
+
+// ---------------------------------------------------------------- BenchConfig
+
+BenchConfig::BenchConfig()
+	: host("127.0.0.1"), port(6667), password("password"), clients(1000),
+	  channels(10), duration(10), rate(5000), inflight(BENCH_DEFAULT_INFLIGHT),
+	  payload(0) {
+	parseMix_("chat");
+}
+
+// Parses a non-negative decimal number that must span the whole string
+static bool parseUnsigned(const std::string &value, unsigned long &out) {
+	if (value.empty() || value[0] == '-' || value[0] == '+')
+		return (false);
+	char *end = NULL;
+	errno	  = 0;
+	out		  = std::strtoul(value.c_str(), &end, 10);
+	return (errno == 0 && *end == '\0');
+}
+
+// Named presets or an explicit "chan:70,priv:20,nick:5,quit:5" list
+bool BenchConfig::parseMix_(const std::string &mix) {
+	if (mix == "chat")
+		return (parseMix_("chan:80,priv:20"));
+	if (mix == "private")
+		return (parseMix_("priv:100"));
+	if (mix == "churn")
+		return (parseMix_("chan:40,priv:10,nick:25,quit:25"));
+	unsigned		  parsed[BENCH_ACTION_COUNT] = {0, 0, 0, 0};
+	std::stringstream stream(mix);
+	std::string		  item;
+	while (std::getline(stream, item, ',')) {
+		std::string::size_type colon = item.find(':');
+		unsigned long		   weight;
+		if (colon == std::string::npos ||
+			!parseUnsigned(item.substr(colon + 1), weight))
+			return (false);
+		const std::string action = item.substr(0, colon);
+		if (action == "chan")
+			parsed[BENCH_CHANNEL_CHAT] = weight;
+		else if (action == "priv")
+			parsed[BENCH_PRIVATE_CHAT] = weight;
+		else if (action == "nick")
+			parsed[BENCH_NICK_CHURN] = weight;
+		else if (action == "quit")
+			parsed[BENCH_QUIT] = weight;
+		else
+			return (false);
+	}
+	unsigned total = 0;
+	for (int i = 0; i < BENCH_ACTION_COUNT; ++i)
+		total += parsed[i];
+	if (total == 0)
+		return (false);
+	std::copy(parsed, parsed + BENCH_ACTION_COUNT, weights);
+	return (true);
+}
+
+bool BenchConfig::parseOption(const std::string &option) {
+	std::string::size_type eq = option.find('=');
+	if (option.compare(0, 2, "--") != 0 || eq == std::string::npos)
+		return (false);
+	const std::string name	= option.substr(2, eq - 2);
+	const std::string value = option.substr(eq + 1);
+	unsigned long	  number;
+
+	if (name == "host")
+		host = value;
+	else if (name == "password")
+		password = value;
+	else if (name == "mix")
+		return (parseMix_(value));
+	else if (!parseUnsigned(value, number))
+		return (false);
+	else if (name == "port" && number > 0 && number < 65536)
+		port = static_cast<unsigned short>(number);
+	else if (name == "clients" && number > 0)
+		clients = static_cast<unsigned>(number);
+	else if (name == "channels" && number > 0)
+		channels = static_cast<unsigned>(number);
+	else if (name == "duration")
+		duration = static_cast<unsigned>(number);
+	else if (name == "rate")
+		rate = static_cast<unsigned>(number);
+	else if (name == "inflight" && number > 0)
+		inflight = static_cast<unsigned>(number);
+	else if (name == "payload" && number <= 400)
+		payload = static_cast<unsigned>(number);
+	else
+		return (false);
+	return (true);
+}
+
+const char *BenchConfig::usage() {
+	return ("  --host=<addr>          server address, or the path of its Unix\n"
+			"                         socket (127.0.0.1)\n"
+			"  --port=<port>          server port (6667)\n"
+			"  --password=<pass>      connection password (password)\n"
+			"  --clients=<n>          concurrent connections (1000)\n"
+			"  --channels=<n>         channels the clients spread over (10)\n"
+			"  --duration=<seconds>   traffic phase after the ramp-up (10)\n"
+			"  --rate=<n>             actions per second, 0 = unthrottled (5000)\n"
+			"  --inflight=<n>         concurrent handshakes (8)\n"
+			"  --payload=<bytes>      padding added to chat messages (0)\n"
+			"  --mix=<mix>            chat | private | churn or a weight list\n"
+			"                         like chan:70,priv:20,nick:5,quit:5\n");
+}
+
+// -------------------------------------------------------------- LoadGenerator
+
+LoadGenerator::LoadGenerator(const BenchConfig &config)
+	: config_(config), addressLen_(0), queues_(), conns_(config.clients),
+	  connByFd_(), samples_(), samplesSeen_(0), scheduled_(0),
+	  random_(0x2545f491ul) {
+	debug("LoadGenerator constructor called");
+	std::memset(&address_, 0, sizeof(address_));
+	std::memset(&stats_, 0, sizeof(stats_));
+	for (unsigned i = 0; i < conns_.size(); ++i) {
+		conns_[i].fd			 = -1;
+		conns_[i].state			 = CONN_CLOSED;
+		conns_[i].channel		 = i % config_.channels;
+		conns_[i].nickGeneration = 0;
+		conns_[i].sentSeq		 = 0;
+		conns_[i].connectStart	 = 0;
+	}
+}
+
+LoadGenerator::~LoadGenerator() {
+	debug("LoadGenerator destructor called");
+	for (unsigned i = 0; i < conns_.size(); ++i) {
+		if (conns_[i].fd != -1)
+			close(conns_[i].fd);
+	}
+}
+
+void LoadGenerator::requestStop() { stopRequested_ = 1; }
+
+uint64_t LoadGenerator::nowUsec() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return static_cast<uint64_t>(ts.tv_sec) * 1000000u +
+		   static_cast<uint64_t>(ts.tv_nsec / 1000);
+}
+
+// xorshift; the mix only needs to be cheap and reproducible
+unsigned long LoadGenerator::nextRandom_() {
+	random_ ^= (random_ << 13) & 0xfffffffful;
+	random_ ^= random_ >> 17;
+	random_ ^= (random_ << 5) & 0xfffffffful;
+	return random_;
+}
+
+bool LoadGenerator::resolve_() {
+	if (!config_.host.empty() && config_.host[0] == '/') {
+		struct sockaddr_un *local = reinterpret_cast<struct sockaddr_un *>(&address_);
+		if (config_.host.size() >= sizeof(local->sun_path)) {
+			std::cerr << "ircbench: socket path too long" << std::endl;
+			return (false);
+		}
+		local->sun_family = AF_UNIX;
+		std::memcpy(local->sun_path, config_.host.c_str(), config_.host.size());
+		addressLen_ = sizeof(*local);
+		return (true);
+	}
+	struct addrinfo hints;
+	struct addrinfo *res = NULL;
+	std::memset(&hints, 0, sizeof(hints));
+	hints.ai_family	  = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	if (getaddrinfo(config_.host.c_str(), toString(config_.port).c_str(),
+					&hints, &res) != 0 ||
+		!res) {
+		std::cerr << "ircbench: cannot resolve " << config_.host << std::endl;
+		return (false);
+	}
+	std::memcpy(&address_, res->ai_addr, res->ai_addrlen);
+	addressLen_ = res->ai_addrlen;
+	freeaddrinfo(res);
+	return (true);
+}
+
+bool LoadGenerator::openConnection_(unsigned index) {
+	Conn &conn = conns_[index];
+	int	  fd   = socket(address_.ss_family, SOCK_STREAM | SOCK_NONBLOCK, 0);
+	if (fd != -1 &&
+		::connect(fd, reinterpret_cast<struct sockaddr *>(&address_),
+				  addressLen_) == -1 &&
+		errno != EINPROGRESS) {
+		close(fd);
+		fd = -1;
+	}
+	if (fd == -1) {
+		++stats_.connectFailures;
+		return (false);
+	}
+	if (static_cast<size_t>(fd) >= connByFd_.size())
+		connByFd_.resize(static_cast<size_t>(fd) + 1, -1);
+	connByFd_[static_cast<size_t>(fd)] = static_cast<int>(index);
+	conn.fd							   = fd;
+	conn.state						   = CONN_CONNECTING;
+	conn.connectStart				   = nowUsec();
+	conn.nick = "b" + toString(index) + "g" + toString(conn.nickGeneration);
+	return (true);
+}
+
+void LoadGenerator::closeConnection_(unsigned index, bool reconnect) {
+	Conn &conn = conns_[index];
+	if (conn.fd != -1) {
+		queues_.discard(conn.fd);
+		close(conn.fd);
+		connByFd_[static_cast<size_t>(conn.fd)] = -1;
+	}
+	conn.fd	   = -1;
+	conn.state = CONN_CLOSED;
+	std::string().swap(conn.rx);
+	conn.lastSeq.clear();
+	if (reconnect)
+		openConnection_(index);
+}
+
+void LoadGenerator::sendLine_(Conn &conn, const std::string &line) {
+	queues_.send(conn.fd, line + "\r\n");
+}
+
+// One poll round over every open connection: finish connects, drain the
+// outbound queues, read and dispatch complete lines.
+void LoadGenerator::pollOnce_(int timeoutMs) {
+	std::vector<struct pollfd> pfds;
+	pfds.reserve(conns_.size());
+	for (unsigned i = 0; i < conns_.size(); ++i) {
+		if (conns_[i].fd == -1)
+			continue;
+		struct pollfd p;
+		p.fd	  = conns_[i].fd;
+		p.events  = (conns_[i].state == CONN_CONNECTING) ? POLLOUT : POLLIN;
+		p.revents = 0;
+		pfds.push_back(p);
+	}
+	queues_.mergePollfds(pfds);
+	if (pfds.empty() || poll(&pfds[0], pfds.size(), timeoutMs) <= 0)
+		return;
+	queues_.drainQueuesForPolled(pfds);
+	for (size_t i = 0; i < pfds.size(); ++i) {
+		if (!pfds[i].revents)
+			continue;
+		const int index = connByFd_[static_cast<size_t>(pfds[i].fd)];
+		if (index < 0)
+			continue;
+		Conn &conn = conns_[static_cast<unsigned>(index)];
+		if (conn.state == CONN_CONNECTING) {
+			int		  error = 0;
+			socklen_t len	= sizeof(error);
+			getsockopt(conn.fd, SOL_SOCKET, SO_ERROR, &error, &len);
+			if (error || (pfds[i].revents & (POLLERR | POLLHUP))) {
+				++stats_.connectFailures;
+				closeConnection_(static_cast<unsigned>(index), false);
+				continue;
+			}
+			conn.state = CONN_REGISTERING;
+			if (!config_.password.empty())
+				sendLine_(conn, "PASS " + config_.password);
+			sendLine_(conn, "NICK " + conn.nick);
+			sendLine_(conn, "USER bench 0 * :ircbench client");
+			continue;
+		}
+		if (pfds[i].revents & (POLLIN | POLLHUP | POLLERR))
+			readFrom_(static_cast<unsigned>(index));
+	}
+	std::vector<int> dead = queues_.takeDeadFds();
+	for (size_t i = 0; i < dead.size(); ++i) {
+		const int index = connByFd_[static_cast<size_t>(dead[i])];
+		if (index >= 0) {
+			++stats_.errors;
+			closeConnection_(static_cast<unsigned>(index), false);
+		}
+	}
+}
+
+void LoadGenerator::readFrom_(unsigned index) {
+	char	buffer[16384];
+	ssize_t bytes = recv(conns_[index].fd, buffer, sizeof(buffer), 0);
+	if (bytes <= 0) {
+		if (bytes == -1 && (errno == EAGAIN || errno == EWOULDBLOCK))
+			return;
+		const bool quitting = (conns_[index].state == CONN_QUITTING);
+		if (!quitting)
+			++stats_.errors;
+		// a scripted QUIT is followed by a reconnect of the same slot
+		closeConnection_(index, quitting);
+		return;
+	}
+	std::string &rx = conns_[index].rx;
+	rx.append(buffer, static_cast<size_t>(bytes));
+	std::string::size_type start = 0;
+	std::string::size_type end;
+	while ((end = rx.find("\r\n", start)) != std::string::npos) {
+		handleLine_(index, rx.substr(start, end - start));
+		// the handler may have closed (and reopened) this slot
+		if (conns_[index].rx.empty())
+			return;
+		start = end + 2;
+	}
+	rx.erase(0, start);
+}
+
+void LoadGenerator::handleLine_(unsigned index, const std::string &line) {
+	Conn &conn = conns_[index];
+	// Timed chat is the bulk of the traffic: skip the generic parser for it
+	static const std::string tag = " :" BENCH_PAYLOAD_TAG " ";
+	if (line.find(" PRIVMSG ") != std::string::npos) {
+		std::string::size_type at = line.find(tag);
+		if (at != std::string::npos) {
+			recordDelivery_(conn, line.substr(at + tag.size()));
+			return;
+		}
+	}
+	Message message;
+	try {
+		message = Message(line);
+	} catch (const std::exception &) {
+		++stats_.errors;
+		return;
+	}
+	const std::string type = message.getType();
+	if (type == "PING") {
+		sendLine_(conn, "PONG" + (message.getParams().empty()
+									  ? std::string()
+									  : " :" + message.getParams()[0]));
+	} else if ((type == "1" || type == "001") &&
+			   conn.state == CONN_REGISTERING) {
+		++stats_.connects;
+		stats_.connectUsecTotal += nowUsec() - conn.connectStart;
+		conn.state = CONN_JOINING;
+		sendLine_(conn, "JOIN #bench" + toString(conn.channel));
+	} else if (type == "366" && conn.state == CONN_JOINING) {
+		conn.state = CONN_READY;
+	} else if (type == "401") {
+		++stats_.noSuchNick;
+	} else if (type.size() == 3 && (type[0] == '4' || type[0] == '5')) {
+		++stats_.errors;
+	}
+}
+
+// payload: "<sender> <seq> <sent-usec>[ padding]"
+void LoadGenerator::recordDelivery_(Conn &receiver, const std::string &payload) {
+	unsigned long sender = 0, seq = 0;
+	uint64_t	  sent	 = 0;
+	char		 *cursor = const_cast<char *>(payload.c_str());
+	sender				 = std::strtoul(cursor, &cursor, 10);
+	seq					 = std::strtoul(cursor, &cursor, 10);
+	sent				 = std::strtoul(cursor, &cursor, 10);
+	const uint64_t now	 = nowUsec();
+	++stats_.delivered;
+
+	std::map<unsigned, unsigned>::iterator last =
+		receiver.lastSeq.find(static_cast<unsigned>(sender));
+	if (last == receiver.lastSeq.end())
+		receiver.lastSeq[static_cast<unsigned>(sender)] =
+			static_cast<unsigned>(seq);
+	else {
+		if (seq <= last->second)
+			++stats_.outOfOrder;
+		last->second = static_cast<unsigned>(seq);
+	}
+
+	const uint32_t latency = static_cast<uint32_t>(
+		now > sent ? std::min<uint64_t>(now - sent, 0xffffffffu) : 0);
+	++samplesSeen_;
+	if (samples_.size() < BENCH_MAX_SAMPLES)
+		samples_.push_back(latency);
+	else {
+		const unsigned long slot = nextRandom_() % samplesSeen_;
+		if (slot < BENCH_MAX_SAMPLES)
+			samples_[slot] = latency;
+	}
+}
+
+void LoadGenerator::performAction_(unsigned index, BenchAction action) {
+	Conn &conn = conns_[index];
+	if (action == BENCH_NICK_CHURN) {
+		conn.nick = "b" + toString(index) + "g" + toString(++conn.nickGeneration);
+		sendLine_(conn, "NICK " + conn.nick);
+	} else if (action == BENCH_QUIT) {
+		conn.state = CONN_QUITTING;
+		sendLine_(conn, "QUIT :ircbench churn");
+	} else {
+		std::string target = "#bench" + toString(conn.channel);
+		if (action == BENCH_PRIVATE_CHAT) {
+			unsigned other = static_cast<unsigned>(nextRandom_() % conns_.size());
+			for (unsigned probe = 0; probe < conns_.size(); ++probe) {
+				if (other != index && conns_[other].state == CONN_READY)
+					break;
+				other = (other + 1) % static_cast<unsigned>(conns_.size());
+			}
+			if (other == index || conns_[other].state != CONN_READY)
+				return;
+			target = conns_[other].nick;
+		}
+		std::string line = "PRIVMSG " + target + " :" BENCH_PAYLOAD_TAG " " +
+						   toString(index) + " " + toString(++conn.sentSeq) +
+						   " " + toString(static_cast<unsigned long>(nowUsec()));
+		if (config_.payload)
+			line += " " + std::string(config_.payload, 'x');
+		sendLine_(conn, line);
+	}
+	++stats_.sent[action];
+}
+
+// Issues the actions due since the start of the traffic phase, each on a
+// random ready connection, following the configured weights.
+void LoadGenerator::scheduleTraffic_(uint64_t now) {
+	unsigned totalWeight = 0;
+	for (int i = 0; i < BENCH_ACTION_COUNT; ++i)
+		totalWeight += config_.weights[i];
+	unsigned long due;
+	if (config_.rate)
+		due = static_cast<unsigned long>((now - stats_.trafficStart) *
+										 config_.rate / 1000000u);
+	else
+		due = scheduled_ + conns_.size(); // one action per connection per round
+	for (; scheduled_ < due; ++scheduled_) {
+		unsigned index = static_cast<unsigned>(nextRandom_() % conns_.size());
+		if (conns_[index].state != CONN_READY)
+			continue;
+		// a sender the server does not keep up with would only grow its
+		// queue towards MAX_BACKLOG_SIZE, where it gets dropped
+		if (queues_.hasBacklog(conns_[index].fd))
+			continue;
+		unsigned   pick	  = static_cast<unsigned>(nextRandom_() % totalWeight);
+		BenchAction action = BENCH_CHANNEL_CHAT;
+		while (pick >= config_.weights[action]) {
+			pick -= config_.weights[action];
+			action = static_cast<BenchAction>(action + 1);
+		}
+		performAction_(index, action);
+	}
+}
+
+unsigned LoadGenerator::countInState_(ConnState state) const {
+	unsigned count = 0;
+	for (unsigned i = 0; i < conns_.size(); ++i)
+		count += (conns_[i].state == state);
+	return count;
+}
+
+// Opens connections with at most config_.inflight handshakes outstanding
+// until every slot is registered and joined.
+bool LoadGenerator::rampUp_() {
+	unsigned next		  = 0;
+	unsigned ready		  = 0;
+	uint64_t lastProgress = nowUsec();
+	stats_.rampStart	  = lastProgress;
+	while (ready < conns_.size() && !stopRequested_) {
+		const unsigned handshaking = countInState_(CONN_CONNECTING) +
+									 countInState_(CONN_REGISTERING) +
+									 countInState_(CONN_JOINING);
+		for (unsigned open = handshaking;
+			 open < config_.inflight && next < conns_.size(); ++open) {
+			if (!openConnection_(next++)) {
+				std::cerr << "ircbench: connect failed at " << next - 1
+						  << " connections: " << std::strerror(errno)
+						  << std::endl;
+				return (false);
+			}
+		}
+		pollOnce_(100);
+		const unsigned nowReady = countInState_(CONN_READY);
+		if (nowReady != ready) {
+			ready		 = nowReady;
+			lastProgress = nowUsec();
+		} else if (nowUsec() - lastProgress > BENCH_STALL_USEC) {
+			std::cerr << "ircbench: ramp-up stalled at " << ready
+					  << " ready connections" << std::endl;
+			return (false);
+		}
+		if (countInState_(CONN_CLOSED) > conns_.size() - next) {
+			std::cerr << "ircbench: connections dropped during ramp-up"
+					  << std::endl;
+			return (false);
+		}
+	}
+	stats_.rampEnd = nowUsec();
+	return (true);
+}
+
+bool LoadGenerator::run() {
+	struct rlimit lim;
+	if (getrlimit(RLIMIT_NOFILE, &lim) == 0 && lim.rlim_cur < lim.rlim_max) {
+		lim.rlim_cur = lim.rlim_max;
+		setrlimit(RLIMIT_NOFILE, &lim);
+	}
+	if (!resolve_() || !rampUp_())
+		return (false);
+
+	stats_.trafficStart = nowUsec();
+	const uint64_t end =
+		stats_.trafficStart + static_cast<uint64_t>(config_.duration) * 1000000u;
+	uint64_t now = stats_.trafficStart;
+	while (now < end && !stopRequested_) {
+		scheduleTraffic_(now);
+		pollOnce_(1);
+		now = nowUsec();
+	}
+	stats_.trafficEnd = now;
+
+	// Let queued and in-flight messages arrive before reporting
+	unsigned long delivered = stats_.delivered;
+	uint64_t	  quietSince = nowUsec();
+	while (nowUsec() - stats_.trafficEnd < BENCH_SETTLE_USEC) {
+		pollOnce_(50);
+		if (stats_.delivered != delivered) {
+			delivered  = stats_.delivered;
+			quietSince = nowUsec();
+		} else if (!queues_.hasBacklog() && nowUsec() - quietSince > 200000u)
+			break;
+	}
+	report_();
+	return (true);
+}
+
+static uint32_t percentile(const std::vector<uint32_t> &sorted, double p) {
+	if (sorted.empty())
+		return 0;
+	size_t rank = static_cast<size_t>(p * static_cast<double>(sorted.size() - 1));
+	return sorted[rank];
+}
+
+void LoadGenerator::report_() const {
+	const double ramp	 = static_cast<double>(stats_.rampEnd - stats_.rampStart) / 1e6;
+	const double traffic = static_cast<double>(stats_.trafficEnd - stats_.trafficStart) / 1e6;
+	unsigned long sent	 = 0;
+	for (int i = 0; i < BENCH_ACTION_COUNT; ++i)
+		sent += stats_.sent[i];
+	std::vector<uint32_t> sorted(samples_);
+	std::sort(sorted.begin(), sorted.end());
+
+	std::printf("connections     %u clients, %lu registrations, %lu failed\n",
+				static_cast<unsigned>(conns_.size()), stats_.connects,
+				stats_.connectFailures);
+	std::printf("connect rate    %.1f/s during ramp-up (%.2f s), mean setup %.2f ms\n",
+				ramp > 0 ? static_cast<double>(conns_.size()) / ramp : 0.0, ramp,
+				stats_.connects ? static_cast<double>(stats_.connectUsecTotal) /
+									  static_cast<double>(stats_.connects) / 1e3
+								: 0.0);
+	std::printf("actions         chan %lu, priv %lu, nick %lu, quit %lu in %.2f s\n",
+				stats_.sent[BENCH_CHANNEL_CHAT], stats_.sent[BENCH_PRIVATE_CHAT],
+				stats_.sent[BENCH_NICK_CHURN], stats_.sent[BENCH_QUIT], traffic);
+	std::printf("messages/sec    %.0f sent, %.0f delivered\n",
+				traffic > 0 ? static_cast<double>(sent) / traffic : 0.0,
+				traffic > 0 ? static_cast<double>(stats_.delivered) / traffic : 0.0);
+	std::printf("latency (us)    p50 %u  p90 %u  p99 %u  p99.9 %u  max %u  (%lu samples)\n",
+				percentile(sorted, 0.50), percentile(sorted, 0.90),
+				percentile(sorted, 0.99), percentile(sorted, 0.999),
+				sorted.empty() ? 0u : sorted.back(), samplesSeen_);
+	std::printf("anomalies       %lu out of order, %lu errors, %lu no such nick\n",
+				stats_.outOfOrder, stats_.errors, stats_.noSuchNick);
+	std::fflush(stdout);
+}
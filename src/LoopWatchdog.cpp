@@ -0,0 +1,168 @@
+#include "../include/LoopWatchdog.hpp"
+#include "../include/Debug.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+#include <unistd.h>
+
+// Shortest sampling interval of the watchdog thread
+#define WATCHDOG_MIN_INTERVAL_USEC 1000
+
+LoopWatchdog::LoopWatchdog(Metrics &metrics)
+	: metrics_(metrics), budgetUsec_(0), thread_(), running_(false),
+	  stopRequested_(false), iterationStart_(0), generation_(0),
+	  phase_(LOOP_PHASE_POLL), fd_(-1), phaseStart_(Metrics::nowUsec()),
+	  slowestPhase_(LOOP_PHASE_POLL), slowestUsec_(0), captureGeneration_(0),
+	  captured_(false) {
+	debug("LoopWatchdog constructor called");
+	command_[0] = '\0';
+	std::memset(&capture_, 0, sizeof(capture_));
+	pthread_mutex_init(&captureLock_, NULL);
+}
+
+LoopWatchdog::~LoopWatchdog() {
+	debug("LoopWatchdog destructor called");
+	stop();
+	pthread_mutex_destroy(&captureLock_);
+}
+
+void LoopWatchdog::start(uint64_t budgetUsec) {
+	if (running_ || budgetUsec == 0)
+		return;
+	budgetUsec_	   = budgetUsec;
+	stopRequested_ = false;
+	running_	   = pthread_create(&thread_, NULL, &LoopWatchdog::run_, this) == 0;
+	if (!running_)
+		std::cerr << "[Watchdog] could not start thread" << std::endl;
+}
+
+void LoopWatchdog::stop() {
+	if (!running_)
+		return;
+	stopRequested_ = true;
+	pthread_join(thread_, NULL);
+	running_ = false;
+}
+
+void LoopWatchdog::enter(LoopPhase phase) {
+	const uint64_t now	   = Metrics::nowUsec();
+	const uint64_t elapsed = now - phaseStart_;
+	metrics_.addPhase(phase_, elapsed);
+	if (!iterationStart_) {
+		// first phase after poll: a new iteration begins
+		iterationStart_ = now;
+		slowestUsec_	= 0;
+		fd_				= -1;
+		command_[0]		= '\0';
+	} else if (elapsed > slowestUsec_) {
+		slowestUsec_  = elapsed;
+		slowestPhase_ = phase_;
+	}
+	phase_		= phase;
+	phaseStart_ = now;
+}
+
+void LoopWatchdog::idle() {
+	if (!iterationStart_)
+		return;
+	const uint64_t now	   = Metrics::nowUsec();
+	const uint64_t elapsed = now - phaseStart_;
+	metrics_.addPhase(phase_, elapsed);
+	if (elapsed > slowestUsec_) {
+		slowestUsec_  = elapsed;
+		slowestPhase_ = phase_;
+	}
+	const uint64_t duration = now - iterationStart_;
+	metrics_.recordLoop(duration);
+	if (budgetUsec_ && duration > budgetUsec_) {
+		LoopStall stall;
+		stall.when		 = std::time(NULL);
+		stall.usec		 = duration;
+		stall.phase		 = slowestPhase_;
+		stall.fd		 = -1;
+		stall.command[0] = '\0';
+		bool caught		 = false;
+		pthread_mutex_lock(&captureLock_);
+		if (captured_ && captureGeneration_ == generation_) {
+			stall.phase = capture_.phase;
+			stall.fd	= capture_.fd;
+			std::memcpy(stall.command, capture_.command, sizeof(stall.command));
+			caught = true;
+		}
+		captured_ = false;
+		pthread_mutex_unlock(&captureLock_);
+		metrics_.recordStall(stall);
+		if (!caught)
+			std::cerr << "[Watchdog] loop iteration took " << duration / 1000
+					  << " ms, slowest phase " << Metrics::name(stall.phase)
+					  << std::endl;
+	}
+	++generation_;
+	iterationStart_ = 0;
+	phase_			= LOOP_PHASE_POLL;
+	phaseStart_		= now;
+}
+
+void LoopWatchdog::setFd(int fd) {
+	fd_			= fd;
+	command_[0] = '\0';
+}
+
+void LoopWatchdog::setCommand(const char *name) {
+	std::size_t i = 0;
+	for (; i < METRICS_COMMAND_LEN && name[i]; ++i)
+		command_[i] = name[i];
+	command_[i] = '\0';
+}
+
+void *LoopWatchdog::run_(void *self) {
+	LoopWatchdog  *watchdog = static_cast<LoopWatchdog *>(self);
+	uint64_t	   interval = watchdog->budgetUsec_ / 2;
+	if (interval < WATCHDOG_MIN_INTERVAL_USEC)
+		interval = WATCHDOG_MIN_INTERVAL_USEC;
+	struct timespec pause;
+	pause.tv_sec  = static_cast<time_t>(interval / 1000000);
+	pause.tv_nsec = static_cast<long>(interval % 1000000) * 1000;
+	while (!watchdog->stopRequested_) {
+		nanosleep(&pause, NULL);
+		watchdog->check_();
+	}
+	return NULL;
+}
+
+// Runs on the watchdog thread: report each over-budget iteration once
+void LoopWatchdog::check_() {
+	const unsigned long generation = generation_;
+	const uint64_t		start	   = iterationStart_;
+	if (!start || generation != generation_)
+		return;
+	const uint64_t elapsed = Metrics::nowUsec() - start;
+	if (elapsed <= budgetUsec_)
+		return;
+	pthread_mutex_lock(&captureLock_);
+	const bool reported = captured_ && captureGeneration_ == generation;
+	if (!reported) {
+		capture_.usec  = elapsed;
+		capture_.phase = phase_;
+		capture_.fd	   = fd_;
+		for (std::size_t i = 0; i <= METRICS_COMMAND_LEN; ++i)
+			capture_.command[i] = command_[i];
+		capture_.command[METRICS_COMMAND_LEN] = '\0';
+		captureGeneration_					  = generation;
+		captured_							  = true;
+	}
+	pthread_mutex_unlock(&captureLock_);
+	if (reported)
+		return;
+	// write(2) keeps the line whole next to the loop's own output
+	char line[160];
+	const int length = std::snprintf(
+		line, sizeof(line),
+		"[Watchdog] loop stalled %lu ms in %s (fd %d, command %s)\n",
+		static_cast<unsigned long>(elapsed / 1000), Metrics::name(capture_.phase),
+		capture_.fd, capture_.command[0] ? capture_.command : "-");
+	if (length > 0)
+		static_cast<void>(write(STDERR_FILENO, line, static_cast<size_t>(length)));
+}
@@ -0,0 +1,229 @@
+#include "../include/MaskList.hpp"
+#include "../include/CaseMappedString.hpp"
+#include "../include/Handoff.hpp"
+
+MaskList::Entry::Entry() : setAt(0) {}
+
+MaskList::Entry::Entry(const std::string &mask, const std::string &setter,
+					   time_t setAt)
+	: mask(mask), setter(setter), setAt(setAt) {}
+
+MaskList::MaskList() {}
+
+MaskList::MaskList(const MaskList &other)
+	: entries_(other.entries_), exact_(other.exact_), byHost_(other.byHost_),
+	  byHostPrefix_(other.byHostPrefix_), byHostSuffix_(other.byHostSuffix_),
+	  byNick_(other.byNick_), wild_(other.wild_) {}
+
+MaskList &MaskList::operator=(const MaskList &other) {
+	if (this != &other) {
+		entries_	  = other.entries_;
+		exact_		  = other.exact_;
+		byHost_		  = other.byHost_;
+		byHostPrefix_ = other.byHostPrefix_;
+		byHostSuffix_ = other.byHostSuffix_;
+		byNick_		  = other.byNick_;
+		wild_		  = other.wild_;
+	}
+	return *this;
+}
+
+MaskList::~MaskList() {}
+
+std::string MaskList::normalize(const std::string &mask) {
+	const std::string::size_type bang = mask.find('!');
+	const std::string::size_type at	  = mask.rfind('@');
+	std::string					 nick, user, host;
+	if (bang == std::string::npos && at == std::string::npos)
+		nick = mask;
+	else if (at == std::string::npos) {
+		nick = mask.substr(0, bang);
+		user = mask.substr(bang + 1);
+	} else if (bang == std::string::npos || bang > at) {
+		user = mask.substr(0, at);
+		host = mask.substr(at + 1);
+	} else {
+		nick = mask.substr(0, bang);
+		user = mask.substr(bang + 1, at - bang - 1);
+		host = mask.substr(at + 1);
+	}
+	return (nick.empty() ? "*" : nick) + "!" + (user.empty() ? "*" : user) +
+		   "@" + (host.empty() ? "*" : host);
+}
+
+static bool hasWildcard(const std::string &text) {
+	return text.find_first_of("*?") != std::string::npos;
+}
+
+MaskList::Kind MaskList::classify_(const std::string &mapped,
+								   std::string &key) {
+	if (!hasWildcard(mapped))
+		return EXACT;
+	const std::string::size_type bang = mapped.find('!');
+	const std::string::size_type at	  = mapped.rfind('@');
+	const std::string			 nick = mapped.substr(0, bang);
+	const std::string			 host = mapped.substr(at + 1);
+	if (!hasWildcard(host)) {
+		key = host;
+		return HOST;
+	}
+	// "10.0.*" and "*.example.org": one star on the side of a separator
+	const std::string::size_type last = host.size() - 1;
+	if (host.size() > 1 && host[last] == '*' &&
+		!hasWildcard(host.substr(0, last)) &&
+		(host[last - 1] == '.' || host[last - 1] == ':')) {
+		key = host.substr(0, last);
+		return HOST_PREFIX;
+	}
+	if (host.size() > 1 && host[0] == '*' && host[1] == '.' &&
+		!hasWildcard(host.substr(1))) {
+		key = host.substr(1);
+		return HOST_SUFFIX;
+	}
+	if (!hasWildcard(nick)) {
+		key = nick;
+		return NICK;
+	}
+	return WILD;
+}
+
+MaskList::Buckets *MaskList::buckets_(Kind kind) {
+	switch (kind) {
+	case HOST:
+		return &byHost_;
+	case HOST_PREFIX:
+		return &byHostPrefix_;
+	case HOST_SUFFIX:
+		return &byHostSuffix_;
+	case NICK:
+		return &byNick_;
+	default:
+		return NULL;
+	}
+}
+
+bool MaskList::add(const std::string &mask, const std::string &setter,
+				   time_t setAt) {
+	const std::string mapped = CaseMappedString::toCaseMappedString(mask);
+	if (entries_.count(mapped) || full())
+		return false;
+	entries_[mapped] = Entry(mask, setter, setAt);
+	std::string key;
+	const Kind	kind = classify_(mapped, key);
+	if (kind == EXACT)
+		exact_.insert(mapped);
+	else if (kind == WILD)
+		wild_.push_back(GlobMask(mask));
+	else
+		(*buckets_(kind))[key].push_back(GlobMask(mask));
+	return true;
+}
+
+static void eraseMask(std::vector<GlobMask> &masks, const std::string &mask) {
+	for (std::size_t i = 0; i < masks.size(); ++i)
+		if (masks[i].pattern() == mask) {
+			masks.erase(masks.begin() + i);
+			return;
+		}
+}
+
+bool MaskList::remove(const std::string &mask) {
+	const std::string mapped = CaseMappedString::toCaseMappedString(mask);
+	Entries::iterator entry	 = entries_.find(mapped);
+	if (entry == entries_.end())
+		return false;
+	std::string key;
+	const Kind	kind = classify_(mapped, key);
+	if (kind == EXACT)
+		exact_.erase(mapped);
+	else if (kind == WILD)
+		eraseMask(wild_, entry->second.mask);
+	else {
+		Buckets			 &buckets = *buckets_(kind);
+		Buckets::iterator bucket  = buckets.find(key);
+		if (bucket != buckets.end()) {
+			eraseMask(bucket->second, entry->second.mask);
+			if (bucket->second.empty())
+				buckets.erase(bucket);
+		}
+	}
+	entries_.erase(entry);
+	return true;
+}
+
+bool MaskList::anyMatch_(const Buckets &buckets, const std::string &key,
+						 const std::string &hostmask) {
+	const Buckets::const_iterator bucket = buckets.find(key);
+	if (bucket == buckets.end())
+		return false;
+	for (std::size_t i = 0; i < bucket->second.size(); ++i)
+		if (bucket->second[i].matches(hostmask))
+			return true;
+	return false;
+}
+
+bool MaskList::matches(const std::string &hostmask) const {
+	if (entries_.empty())
+		return false;
+	if (exact_.count(hostmask))
+		return true;
+	const std::string::size_type bang = hostmask.find('!');
+	const std::string::size_type at	  = hostmask.rfind('@');
+	if (bang != std::string::npos && at != std::string::npos) {
+		const std::string host = hostmask.substr(at + 1);
+		if (!byHost_.empty() && anyMatch_(byHost_, host, hostmask))
+			return true;
+		if (!byNick_.empty() &&
+			anyMatch_(byNick_, hostmask.substr(0, bang), hostmask))
+			return true;
+		for (std::string::size_type i = 0; i < host.size(); ++i) {
+			if (!byHostPrefix_.empty() && (host[i] == '.' || host[i] == ':') &&
+				anyMatch_(byHostPrefix_, host.substr(0, i + 1), hostmask))
+				return true;
+			if (!byHostSuffix_.empty() && host[i] == '.' &&
+				anyMatch_(byHostSuffix_, host.substr(i), hostmask))
+				return true;
+		}
+	}
+	for (std::size_t i = 0; i < wild_.size(); ++i)
+		if (wild_[i].matches(hostmask))
+			return true;
+	return false;
+}
+
+bool MaskList::full() const { return entries_.size() >= MASKLIST_LIMIT; }
+
+std::size_t MaskList::size() const { return entries_.size(); }
+
+bool MaskList::empty() const { return entries_.empty(); }
+
+const MaskList::Entries &MaskList::entries() const { return entries_; }
+
+void MaskList::clear_() {
+	entries_.clear();
+	exact_.clear();
+	byHost_.clear();
+	byHostPrefix_.clear();
+	byHostSuffix_.clear();
+	byNick_.clear();
+	wild_.clear();
+}
+
+void MaskList::saveState(StateWriter &out) const {
+	out.u32(static_cast<uint32_t>(entries_.size()));
+	for (Entries::const_iterator it = entries_.begin(); it != entries_.end();
+		 ++it) {
+		out.str(it->second.mask);
+		out.str(it->second.setter);
+		out.u64(static_cast<uint64_t>(it->second.setAt));
+	}
+}
+
+void MaskList::loadState(StateReader &in) {
+	clear_();
+	for (uint32_t count = in.u32(); count; --count) {
+		const std::string mask	 = in.str();
+		const std::string setter = in.str();
+		add(mask, setter, static_cast<time_t>(in.u64()));
+	}
+}
@@ -1,6 +1,7 @@
 #include "../include/Message.hpp"
 #include "../include/Client.hpp"
 #include "../include/Server.hpp"
+#include "../include/AllocProfile.hpp"
 #include <cctype>
 #include <sstream>
 
@@ -65,6 +66,7 @@ std::ostream &operator<<(std::ostream &os, const Message &message) {
 
 //: nickname!username@host(or IP) type ... ... :back
 std::string Message::toString() const {
+  ALLOC_PROFILE_PHASE(ALLOC_PHASE_SERIALIZE);
   std::string msg;
   const std::vector<std::string> &params = getParams();
   // source prefix
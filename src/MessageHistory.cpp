@@ -0,0 +1,346 @@
+#include "../include/MessageHistory.hpp"
+#include "../include/CaseMappedString.hpp"
+#include "../include/Handoff.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <iostream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+// Longest channel name told apart by a history file; longer names compare
+// by their first HISTORY_NAME_MAX bytes
+#define HISTORY_NAME_MAX 228
+
+// First bytes of a history file, followed by the slots
+struct HistoryFileHeader {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t slotSize;
+	uint32_t slotCount;
+	uint64_t last;
+	uint32_t nameLength;
+	char	 name[HISTORY_NAME_MAX];
+};
+
+// Start of each HISTORY_SLOT_SIZE slot; the line follows
+struct HistorySlot {
+	uint64_t seq;
+	uint64_t timeMs;
+	uint32_t length;
+	uint32_t reserved;
+};
+
+std::size_t MessageHistory::length_		= 0;
+std::string MessageHistory::dir_;
+std::size_t MessageHistory::diskLength_ = 0;
+std::size_t MessageHistory::diskChannels_ = 0;
+std::size_t MessageHistory::mapped_		  = 0;
+
+HistoryLine::HistoryLine() : seq(0), timeMs(0) {}
+
+MessageHistory::MessageHistory()
+	: last_(0), base_(0), map_(NULL), mapSize_(0), diskFailed_(false) {}
+
+MessageHistory::MessageHistory(const std::string &channel)
+	: channel_(channel), last_(0), base_(0), map_(NULL), mapSize_(0),
+	  diskFailed_(false) {
+	readLast_();
+}
+
+// The copy maps the file again when it needs it
+MessageHistory::MessageHistory(const MessageHistory &other)
+	: channel_(other.channel_), ring_(other.ring_), last_(other.last_),
+	  base_(other.base_), map_(NULL), mapSize_(0), diskFailed_(false) {}
+
+MessageHistory &MessageHistory::operator=(const MessageHistory &other) {
+	if (this != &other) {
+		unmap_();
+		channel_	= other.channel_;
+		ring_		= other.ring_;
+		last_		= other.last_;
+		base_		= other.base_;
+		diskFailed_ = false;
+	}
+	return *this;
+}
+
+MessageHistory::~MessageHistory() { unmap_(); }
+
+void MessageHistory::configure(std::size_t length, const std::string &dir,
+							   std::size_t diskLength, std::size_t diskChannels) {
+	length_		  = length;
+	dir_		  = length ? dir : "";
+	diskLength_	  = diskLength;
+	diskChannels_ = diskChannels;
+}
+
+bool MessageHistory::enabled() { return length_ != 0; }
+
+uint64_t MessageHistory::nowMs() {
+	struct timeval now;
+	gettimeofday(&now, NULL);
+	return static_cast<uint64_t>(now.tv_sec) * 1000u +
+		   static_cast<uint64_t>(now.tv_usec / 1000);
+}
+
+void MessageHistory::record(std::string &wire) {
+	if (!length_)
+		return;
+	if (ring_.empty())
+		ring_.resize(length_);
+	const uint64_t seq	  = ++last_;
+	const uint64_t timeMs = nowMs();
+	if (disk_()) {
+		char		*slot = map_ + sizeof(HistoryFileHeader) +
+						(seq % diskLength_) * HISTORY_SLOT_SIZE;
+		HistorySlot	 head;
+		const size_t room = HISTORY_SLOT_SIZE - sizeof(HistorySlot);
+		head.seq		  = seq;
+		head.timeMs		  = timeMs;
+		head.length		  = static_cast<uint32_t>(wire.size() < room ? wire.size() : room);
+		head.reserved	  = 0;
+		std::memcpy(slot + sizeof(head), wire.data(), head.length);
+		if (head.length < wire.size())
+			std::memcpy(slot + sizeof(head) + head.length - 2, "\r\n", 2);
+		std::memcpy(slot, &head, sizeof(head));
+		reinterpret_cast<HistoryFileHeader *>(map_)->last = seq;
+	}
+	HistoryLine &line = ring_[seq % ring_.size()];
+	line.seq		  = seq;
+	line.timeMs		  = timeMs;
+	line.wire.swap(wire);
+}
+
+uint64_t MessageHistory::first() const {
+	if (!last_)
+		return 0;
+	const std::size_t kept	= disk_() ? diskLength_ : length_;
+	uint64_t		  first = last_ > kept ? last_ - kept + 1 : 1;
+	if (first <= base_)
+		first = base_ + 1;
+	return first <= last_ ? first : 0;
+}
+
+uint64_t MessageHistory::last() const { return last_; }
+
+void MessageHistory::keepEarlier() { base_ = 0; }
+
+bool MessageHistory::line(uint64_t seq, HistoryLine &out) const {
+	if (!seq || seq > last_)
+		return false;
+	if (!ring_.empty()) {
+		const HistoryLine &line = ring_[seq % ring_.size()];
+		if (line.seq == seq) {
+			out = line;
+			return true;
+		}
+	}
+	if (!disk_())
+		return false;
+	const char *slot = map_ + sizeof(HistoryFileHeader) +
+					   (seq % diskLength_) * HISTORY_SLOT_SIZE;
+	HistorySlot head;
+	std::memcpy(&head, slot, sizeof(head));
+	if (head.seq != seq || head.length > HISTORY_SLOT_SIZE - sizeof(head))
+		return false;
+	out.seq	   = seq;
+	out.timeMs = head.timeMs;
+	out.wire.assign(slot + sizeof(head), head.length);
+	return true;
+}
+
+uint64_t MessageHistory::time_(uint64_t seq) const {
+	HistoryLine line;
+	return this->line(seq, line) ? line.timeMs : 0;
+}
+
+uint64_t MessageHistory::seqAfter(uint64_t timeMs) const {
+	uint64_t lo = first();
+	uint64_t hi = last_ + 1;
+	if (!lo)
+		return hi;
+	while (lo < hi) {
+		const uint64_t mid = lo + (hi - lo) / 2;
+		if (time_(mid) <= timeMs)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+void MessageHistory::saveState(StateWriter &out) const {
+	out.u64(last_);
+	out.u64(base_);
+	const uint64_t from = ring_.empty() || last_ < ring_.size()
+							  ? 1
+							  : last_ - ring_.size() + 1;
+	uint32_t	   count = 0;
+	for (uint64_t seq = from; seq <= last_ && !ring_.empty(); ++seq)
+		count += ring_[seq % ring_.size()].seq == seq;
+	out.u32(count);
+	for (uint64_t seq = from; seq <= last_ && count; ++seq) {
+		const HistoryLine &line = ring_[seq % ring_.size()];
+		if (line.seq != seq)
+			continue;
+		out.u64(line.seq);
+		out.u64(line.timeMs);
+		out.str(line.wire);
+	}
+}
+
+void MessageHistory::loadState(StateReader &in) {
+	last_ = in.u64();
+	base_ = in.u64();
+	ring_.clear();
+	for (uint32_t count = in.u32(); count; --count) {
+		HistoryLine line;
+		line.seq	= in.u64();
+		line.timeMs = in.u64();
+		line.wire	= in.str();
+		if (!length_)
+			continue;
+		if (ring_.empty())
+			ring_.resize(length_);
+		ring_[line.seq % ring_.size()] = line;
+	}
+}
+
+std::string MessageHistory::path_() const {
+	char name[32];
+	std::snprintf(name, sizeof(name), "/%016lx.history",
+				  CaseMappedString::hashCaseMapped(channel_));
+	return dir_ + name;
+}
+
+static bool sameChannel(const HistoryFileHeader &header, const std::string &channel) {
+	const std::size_t length =
+		channel.size() < HISTORY_NAME_MAX ? channel.size() : HISTORY_NAME_MAX;
+	return header.nameLength == length &&
+		   CaseMappedString::equalsCaseMapped(std::string(header.name, length),
+											  channel.substr(0, length));
+}
+
+static bool validHeader(const HistoryFileHeader &header, std::size_t slotCount,
+						const std::string &channel) {
+	return header.magic == HISTORY_MAGIC && header.version == HISTORY_VERSION &&
+		   header.slotSize == HISTORY_SLOT_SIZE && header.slotCount == slotCount &&
+		   sameChannel(header, channel);
+}
+
+void MessageHistory::readLast_() {
+	if (dir_.empty() || !diskLength_)
+		return;
+	const int fd = ::open(path_().c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd == -1)
+		return;
+	HistoryFileHeader header;
+	if (pread(fd, &header, sizeof(header), 0) == sizeof(header) &&
+		validHeader(header, diskLength_, channel_))
+		last_ = base_ = header.last;
+	::close(fd);
+}
+
+// A file of another channel with the same hash is left alone
+void MessageHistory::discard() {
+	unmap_();
+	if (dir_.empty() || !diskLength_)
+		return;
+	const std::string path = path_();
+	const int		  fd   = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd == -1)
+		return;
+	HistoryFileHeader header;
+	if (pread(fd, &header, sizeof(header), 0) == sizeof(header) &&
+		validHeader(header, diskLength_, channel_))
+		unlink(path.c_str());
+	::close(fd);
+}
+
+void MessageHistory::diskChannels(std::vector<std::string> &out) {
+	if (dir_.empty() || !diskLength_)
+		return;
+	DIR *dir = opendir(dir_.c_str());
+	if (!dir)
+		return;
+	const std::string suffix = ".history";
+	while (const struct dirent *entry = readdir(dir)) {
+		const std::string name = entry->d_name;
+		if (name.size() <= suffix.size() ||
+			name.compare(name.size() - suffix.size(), suffix.size(), suffix) != 0)
+			continue;
+		const int fd = ::open((dir_ + "/" + name).c_str(), O_RDONLY | O_CLOEXEC);
+		if (fd == -1)
+			continue;
+		HistoryFileHeader header;
+		if (pread(fd, &header, sizeof(header), 0) == sizeof(header) &&
+			header.magic == HISTORY_MAGIC && header.nameLength <= HISTORY_NAME_MAX)
+			out.push_back(std::string(header.name, header.nameLength));
+		::close(fd);
+	}
+	closedir(dir);
+}
+
+// A file of another channel with the same hash, or of another layout, is
+// started over
+bool MessageHistory::disk_() const {
+	if (map_)
+		return true;
+	if (dir_.empty() || !diskLength_ || diskFailed_ || mapped_ >= diskChannels_)
+		return false;
+	diskFailed_			   = true;
+	const std::string path = path_();
+	const int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+	if (fd == -1) {
+		std::cerr << "[History] cannot open " << path << std::endl;
+		return false;
+	}
+	const std::size_t size = sizeof(HistoryFileHeader) + diskLength_ * HISTORY_SLOT_SIZE;
+	HistoryFileHeader header;
+	const bool		  valid = pread(fd, &header, sizeof(header), 0) == sizeof(header) &&
+						 validHeader(header, diskLength_, channel_);
+	struct stat		  info;
+	if ((!valid && ftruncate(fd, 0) == -1) ||
+		(fstat(fd, &info) == 0 && static_cast<std::size_t>(info.st_size) != size &&
+		 ftruncate(fd, static_cast<off_t>(size)) == -1)) {
+		::close(fd);
+		return false;
+	}
+	void *mapped = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	::close(fd);
+	if (mapped == MAP_FAILED) {
+		std::cerr << "[History] cannot map " << path << std::endl;
+		return false;
+	}
+	map_		= static_cast<char *>(mapped);
+	mapSize_	= size;
+	diskFailed_ = false;
+	++mapped_;
+	if (!valid) {
+		std::memset(&header, 0, sizeof(header));
+		header.magic	  = HISTORY_MAGIC;
+		header.version	  = HISTORY_VERSION;
+		header.slotSize	  = HISTORY_SLOT_SIZE;
+		header.slotCount  = static_cast<uint32_t>(diskLength_);
+		header.last		  = last_;
+		header.nameLength = static_cast<uint32_t>(
+			channel_.size() < HISTORY_NAME_MAX ? channel_.size() : HISTORY_NAME_MAX);
+		std::memcpy(header.name, channel_.data(), header.nameLength);
+		std::memcpy(map_, &header, sizeof(header));
+	}
+	return true;
+}
+
+void MessageHistory::unmap_() {
+	if (map_) {
+		munmap(map_, mapSize_);
+		--mapped_;
+	}
+	map_	 = NULL;
+	mapSize_ = 0;
+}
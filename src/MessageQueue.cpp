@@ -8,12 +8,18 @@ MessageQueue::MessageQueue() : totalBytes_(0) {
 MessageQueue::MessageQueue(const MessageQueue &other) {
 	parts_		= other.parts_;
 	totalBytes_ = other.totalBytes_;
+#ifdef LATENCY_TRACE
+	stamps_ = other.stamps_;
+#endif
 }
 
 MessageQueue &MessageQueue::operator=(const MessageQueue &other) {
 	if (this != &other) {
 		parts_		= other.parts_;
 		totalBytes_ = other.totalBytes_;
+#ifdef LATENCY_TRACE
+		stamps_ = other.stamps_;
+#endif
 	}
 	return *this;
 }
@@ -33,6 +39,9 @@ const std::string &MessageQueue::front() const { return parts_.front(); }
 void MessageQueue::pushBack(const std::string &part) {
 	parts_.push_back(part);
 	totalBytes_ += part.size();
+#ifdef LATENCY_TRACE
+	stamps_.push_back(latencyTraceEnqueued());
+#endif
 }
 
 void MessageQueue::popFront() {
@@ -40,6 +49,9 @@ void MessageQueue::popFront() {
 		return;
 	totalBytes_ -= parts_.front().size();
 	parts_.pop_front();
+#ifdef LATENCY_TRACE
+	stamps_.pop_front();
+#endif
 }
 
 /**
@@ -59,13 +71,36 @@ void MessageQueue::removeBytesFromFront(size_t n) {
 	if (n >= s.size()) {
 		totalBytes_ -= s.size();
 		parts_.pop_front();
+#ifdef LATENCY_TRACE
+		latencyTraceSent(stamps_.front());
+		stamps_.pop_front();
+#endif
 	} else {
 		s.erase(0, n);
 		totalBytes_ -= n;
 	}
 }
 
+void MessageQueue::shrinkToFit() {
+	if (!parts_.empty())
+		std::string(parts_.front()).swap(parts_.front());
+	std::deque<std::string>(parts_).swap(parts_);
+#ifdef LATENCY_TRACE
+	std::deque<LatencyStamp>(stamps_).swap(stamps_);
+#endif
+}
+
 void MessageQueue::clear() {
 	parts_.clear();
 	totalBytes_ = 0;
+#ifdef LATENCY_TRACE
+	stamps_.clear();
+#endif
+}
+
+void MessageQueue::appendTo(std::string &out) const {
+	out.reserve(out.size() + totalBytes_);
+	for (std::deque<std::string>::const_iterator it = parts_.begin();
+		 it != parts_.end(); ++it)
+		out.append(*it);
 }
@@ -29,9 +29,11 @@ std::pair<bool, std::size_t> MessageQueueManager::findIndexByFd_(int fd) const {
 bool MessageQueueManager::insertMsgAtQueue_(std::size_t index,
                                             const std::string &msg) {
   queues_[index].pushBack(msg);
+  queuedBytes_ += msg.size();
   if (queues_[index].totalBytes() > MAX_BACKLOG_SIZE) {
     debug("Warning: MessageQueue for fd " + toString(pfds_[index].fd) +
           " exceeds maximum backlog size.");
+    ++overflowCount_;
     markDeadAndRemove_(index);
     return false;
   }
@@ -52,6 +54,7 @@ bool MessageQueueManager::insertAt_(std::size_t index, int fd,
 }
 
 void MessageQueueManager::removeAt_(std::size_t index) {
+  queuedBytes_ -= queues_[index].totalBytes();
   pfds_.erase(pfds_.begin() + static_cast<std::ptrdiff_t>(index));
   queues_.erase(queues_.begin() + static_cast<std::ptrdiff_t>(index));
 }
@@ -62,7 +65,8 @@ void MessageQueueManager::markDeadAndRemove_(std::size_t index) {
   removeAt_(index);
 }
 
-MessageQueueManager::MessageQueueManager() {
+MessageQueueManager::MessageQueueManager()
+    : queuedBytes_(0), bytesSent_(0), overflowCount_(0) {
   debug("MessageQueueManager default constructor called");
 }
 
@@ -70,6 +74,9 @@ MessageQueueManager::MessageQueueManager(const MessageQueueManager &other) {
   pfds_ = other.pfds_;
   queues_ = other.queues_;
   deadFds_ = other.deadFds_;
+  queuedBytes_ = other.queuedBytes_;
+  bytesSent_ = other.bytesSent_;
+  overflowCount_ = other.overflowCount_;
 }
 
 MessageQueueManager &
@@ -78,6 +85,9 @@ MessageQueueManager::operator=(const MessageQueueManager &other) {
     pfds_ = other.pfds_;
     queues_ = other.queues_;
     deadFds_ = other.deadFds_;
+    queuedBytes_ = other.queuedBytes_;
+    bytesSent_ = other.bytesSent_;
+    overflowCount_ = other.overflowCount_;
   }
   return *this;
 }
@@ -120,6 +130,8 @@ int MessageQueueManager::drainQueueForFd_(
             sent + "]");
 #endif
       queue.removeBytesFromFront(static_cast<std::size_t>(n));
+      queuedBytes_ -= static_cast<std::size_t>(n);
+      bytesSent_ += static_cast<std::size_t>(n);
       continue; // try to drain more immediately
     }
     if (n == 0)
@@ -322,3 +334,46 @@ std::vector<int> MessageQueueManager::takeDeadFds() {
 }
 
 bool MessageQueueManager::hasDeadFds() const { return !deadFds_.empty(); }
+
+std::size_t MessageQueueManager::queuedBytes() const { return queuedBytes_; }
+
+std::size_t MessageQueueManager::queuedBytes(int fd) const {
+  const std::pair<bool, std::size_t> res = findIndexByFd_(fd);
+  return res.first ? queues_[res.second].totalBytes() : 0;
+}
+
+void MessageQueueManager::trim(int fd) {
+  const std::pair<bool, std::size_t> res = findIndexByFd_(fd);
+  if (res.first)
+    queues_[res.second].shrinkToFit();
+}
+
+std::string MessageQueueManager::pendingData(int fd) const {
+  std::string data;
+  const std::pair<bool, std::size_t> res = findIndexByFd_(fd);
+  if (res.first)
+    queues_[res.second].appendTo(data);
+  return data;
+}
+
+void MessageQueueManager::restore(int fd, const std::string &data) {
+  if (data.empty() || isDead_(fd))
+    return;
+  const std::pair<bool, std::size_t> res = findIndexByFd_(fd);
+  if (!res.first)
+    insertAt_(res.second, fd, data);
+  else
+    insertMsgAtQueue_(res.second, data);
+}
+
+void MessageQueueManager::shrinkToFit() {
+  shrinkVecToFit(pfds_);
+  shrinkVecToFit(queues_);
+  shrinkVecToFit(deadFds_);
+}
+
+std::size_t MessageQueueManager::bytesSent() const { return bytesSent_; }
+
+std::size_t MessageQueueManager::overflowCount() const {
+  return overflowCount_;
+}
@@ -22,12 +22,14 @@ const std::map<MessageType, IrcErrorInfo>& getErrorMap()
 		errorMap[ERR_NOSUCHNICK]		= IrcErrorInfo("401", "No such nick/channel");
 		errorMap[ERR_NOSUCHCHANNEL]		= IrcErrorInfo("403", "No such channel");
 		errorMap[ERR_CANNOTSENDTOCHAN]	= IrcErrorInfo("404", "Cannot send to channel");
+		errorMap[ERR_CANNOTSENDFLOOD]	= IrcErrorInfo("404", "Cannot send to channel (+f), slow down");
 		errorMap[ERR_NORECIPIENT]		= IrcErrorInfo("411", "No recipient given (PRIVMSG)"); // beware to never use this anywhere where outside of PRIVMSG, else we change it so this is empty here
 		errorMap[ERR_NOTEXTTOSEND]		= IrcErrorInfo("412", "No text to send");
 //JOIN
 		errorMap[ERR_BADCHANNELKEY]		= IrcErrorInfo("475", "Cannot join channel (+k)");
 		errorMap[ERR_INVITEONLYCHAN]	= IrcErrorInfo("473", "Cannot join channel (+i)");
 		errorMap[ERR_CHANNELISFULL]		= IrcErrorInfo("471", "Channel is full (+l)");
+		errorMap[ERR_BANNEDFROMCHAN]	= IrcErrorInfo("474", "Cannot join channel (+b)");
 // QUIT
 		errorMap[QUIT]					= IrcErrorInfo("QUIT", "Quit");
 // MODE
@@ -35,6 +37,8 @@ const std::map<MessageType, IrcErrorInfo>& getErrorMap()
 		errorMap[ERR_UMODEUNKNOWNFLAG]	= IrcErrorInfo("501", "Unknown MODE flag");
 		errorMap[ERR_UNKNOWNMODE]			= IrcErrorInfo("472","is unknown mode char to me");  // "<client> <modechar> :is unknown mode char to me"
 		errorMap[ERR_CHANOPRIVSNEEDED]		= IrcErrorInfo("482", "You're not channel operator"); //"<client> <channel> :You're not channel operator"
+		errorMap[ERR_BANLISTFULL]			= IrcErrorInfo("478", "Channel list is full"); // "<client> <channel> <char> :Channel list is full"
+		errorMap[ERR_INVALIDMODEPARAM]		= IrcErrorInfo("696", "Invalid mode parameter"); // "<client> <target> <mode char> <parameter> :<description>"
 // WELCOME
 
 		errorMap[RPL_WELCOME]			= IrcErrorInfo("1","");
@@ -61,6 +65,32 @@ const std::map<MessageType, IrcErrorInfo>& getErrorMap()
 		errorMap[RPL_NOTOPIC]			= IrcErrorInfo("331", "No topic is set");
 		errorMap[RPL_TOPIC]				= IrcErrorInfo("332", "");
 		errorMap[RPL_TOPICWHOTIME]		= IrcErrorInfo("333", "");
+// STATS
+		errorMap[RPL_STATSCOMMANDS]		= IrcErrorInfo("212", ""); // "<client> <command> <count>"
+		errorMap[RPL_ENDOFSTATS]		= IrcErrorInfo("219", "End of /STATS report");
+		errorMap[RPL_STATSUPTIME]		= IrcErrorInfo("242", "");
+		errorMap[RPL_STATSDEBUG]		= IrcErrorInfo("249", ""); // "<client> <stats letter> :<name> <value>"
+// LUSERS
+		errorMap[RPL_LUSERCLIENT]		= IrcErrorInfo("251", "");
+		errorMap[RPL_LUSERUNKNOWN]		= IrcErrorInfo("253", "unknown connection(s)");
+		errorMap[RPL_LUSERCHANNELS]		= IrcErrorInfo("254", "channels formed");
+		errorMap[RPL_LUSERME]			= IrcErrorInfo("255", "");
+		errorMap[RPL_LOCALUSERS]		= IrcErrorInfo("265", "");
+		errorMap[RPL_GLOBALUSERS]		= IrcErrorInfo("266", "");
+// MONITOR
+		errorMap[RPL_MONONLINE]			= IrcErrorInfo("730", ""); // "<client> :target[!user@host][,target[!user@host]]*"
+		errorMap[RPL_MONOFFLINE]		= IrcErrorInfo("731", ""); // "<client> :target[,target2]*"
+		errorMap[RPL_MONLIST]			= IrcErrorInfo("732", ""); // "<client> :target[,target2]*"
+		errorMap[RPL_ENDOFMONLIST]		= IrcErrorInfo("733", "End of MONITOR list");
+		errorMap[ERR_MONLISTFULL]		= IrcErrorInfo("734", "Monitor list is full."); // "<client> <limit> <targets> :Monitor list is full."
+// WHO, WHOIS
+		errorMap[RPL_WHOREPLY]			= IrcErrorInfo("352", ""); // "<client> <channel> <username> <host> <server> <nick> <flags> :<hopcount> <realname>"
+		errorMap[RPL_ENDOFWHO]			= IrcErrorInfo("315", "End of WHO list");
+		errorMap[RPL_WHOISUSER]			= IrcErrorInfo("311", ""); // "<client> <nick> <username> <host> * :<realname>"
+		errorMap[RPL_WHOISSERVER]		= IrcErrorInfo("312", ""); // "<client> <nick> <server> :<server info>"
+		errorMap[RPL_WHOISCHANNELS]		= IrcErrorInfo("319", ""); // "<client> <nick> :[prefix]<channel>{ [prefix]<channel>}"
+		errorMap[RPL_ENDOFWHOIS]		= IrcErrorInfo("318", "End of /WHOIS list");
+		errorMap[RPL_TRYAGAIN]			= IrcErrorInfo("263", "Please wait a while and try again."); // "<client> <command> :Please wait a while and try again."
 		// ...
 	}
 	return errorMap;
@@ -0,0 +1,206 @@
+#include "../include/Metrics.hpp"
+#include "../include/Debug.hpp"
+
+#include <ctime>
+
+static const uint64_t g_loopBounds[METRICS_LOOP_BUCKETS - 1] = {
+	100, 250, 500, 1000, 2500, 5000, 10000, 50000, 200000};
+
+Metrics::Metrics()
+	: stallsTotal_(0), second_(0), secondLines_(0), secondLoopMax_(0),
+	  lastDecay_(0) {
+	debug("Metrics default constructor called");
+	for (int i = 0; i < METRICS_LOOP_BUCKETS; ++i)
+		loopBuckets_[i] = 0;
+	for (int i = 0; i < LOOP_PHASE_COUNT; ++i)
+		phaseUsec_[i] = 0;
+	for (int i = 0; i < METRIC_COUNTER_COUNT; ++i)
+		counters_[i] = 0;
+	for (int i = 0; i < METRIC_GAUGE_COUNT; ++i)
+		gauges_[i] = 0;
+}
+
+Metrics::Metrics(const Metrics &other)
+	: commands_(other.commands_), stallsTotal_(other.stallsTotal_),
+	  second_(other.second_), secondLines_(other.secondLines_),
+	  secondLoopMax_(other.secondLoopMax_), lastDecay_(other.lastDecay_) {
+	for (int i = 0; i < HEAVY_KIND_COUNT; ++i)
+		heavy_[i] = other.heavy_[i];
+	for (int i = 0; i < METRICS_LOOP_BUCKETS; ++i)
+		loopBuckets_[i] = other.loopBuckets_[i];
+	for (int i = 0; i < LOOP_PHASE_COUNT; ++i)
+		phaseUsec_[i] = other.phaseUsec_[i];
+	for (int i = 0; i < METRICS_STALL_HISTORY; ++i)
+		stalls_[i] = other.stalls_[i];
+	for (int i = 0; i < METRIC_COUNTER_COUNT; ++i)
+		counters_[i] = other.counters_[i];
+	for (int i = 0; i < METRIC_GAUGE_COUNT; ++i)
+		gauges_[i] = other.gauges_[i];
+}
+
+Metrics &Metrics::operator=(const Metrics &other) {
+	if (this != &other) {
+		for (int i = 0; i < METRIC_COUNTER_COUNT; ++i)
+			counters_[i] = other.counters_[i];
+		for (int i = 0; i < METRIC_GAUGE_COUNT; ++i)
+			gauges_[i] = other.gauges_[i];
+		for (int i = 0; i < METRICS_LOOP_BUCKETS; ++i)
+			loopBuckets_[i] = other.loopBuckets_[i];
+		for (int i = 0; i < LOOP_PHASE_COUNT; ++i)
+			phaseUsec_[i] = other.phaseUsec_[i];
+		for (int i = 0; i < METRICS_STALL_HISTORY; ++i)
+			stalls_[i] = other.stalls_[i];
+		commands_	   = other.commands_;
+		stallsTotal_   = other.stallsTotal_;
+		second_		   = other.second_;
+		secondLines_   = other.secondLines_;
+		secondLoopMax_ = other.secondLoopMax_;
+		for (int i = 0; i < HEAVY_KIND_COUNT; ++i)
+			heavy_[i] = other.heavy_[i];
+		lastDecay_ = other.lastDecay_;
+	}
+	return *this;
+}
+
+Metrics::~Metrics() { debug("Metrics destructor called"); }
+
+void Metrics::add(MetricCounter counter, uint64_t amount) {
+	counters_[counter] += amount;
+}
+
+void Metrics::set(MetricCounter counter, uint64_t value) {
+	counters_[counter] = value;
+}
+
+uint64_t Metrics::get(MetricCounter counter) const { return counters_[counter]; }
+
+void Metrics::set(MetricGauge gauge, uint64_t value) { gauges_[gauge] = value; }
+
+void Metrics::increment(MetricGauge gauge) {
+	++gauges_[gauge];
+	if (gauge == METRIC_USERS && gauges_[METRIC_USERS] > gauges_[METRIC_USERS_MAX])
+		gauges_[METRIC_USERS_MAX] = gauges_[METRIC_USERS];
+}
+
+void Metrics::decrement(MetricGauge gauge) {
+	if (gauges_[gauge])
+		--gauges_[gauge];
+}
+
+uint64_t Metrics::get(MetricGauge gauge) const { return gauges_[gauge]; }
+
+// Command names come from clients; the table is capped so junk commands
+// cannot grow it without bound.
+void Metrics::countCommand(const std::string &type) {
+	std::map<std::string, uint64_t>::iterator it = commands_.find(type);
+	if (it != commands_.end())
+		++it->second;
+	else if (commands_.size() < METRICS_MAX_COMMAND_TYPES)
+		commands_[type] = 1;
+	else
+		++commands_["(other)"];
+}
+
+const std::map<std::string, uint64_t> &Metrics::commandCounts() const {
+	return commands_;
+}
+
+void Metrics::recordLoop(uint64_t usec) {
+	++counters_[METRIC_LOOP_ITERATIONS];
+	counters_[METRIC_LOOP_USEC] += usec;
+	if (usec > secondLoopMax_)
+		secondLoopMax_ = usec;
+	std::size_t bucket = 0;
+	while (bucket < METRICS_LOOP_BUCKETS - 1 && usec > g_loopBounds[bucket])
+		++bucket;
+	++loopBuckets_[bucket];
+}
+
+void Metrics::addPhase(LoopPhase phase, uint64_t usec) {
+	phaseUsec_[phase] += usec;
+}
+
+uint64_t Metrics::phaseUsec(LoopPhase phase) const { return phaseUsec_[phase]; }
+
+void Metrics::recordStall(const LoopStall &stall) {
+	stalls_[stallsTotal_++ % METRICS_STALL_HISTORY] = stall;
+}
+
+uint64_t Metrics::loopBucket(std::size_t i) const { return loopBuckets_[i]; }
+
+uint64_t Metrics::loopBucketBound(std::size_t i) {
+	return i < METRICS_LOOP_BUCKETS - 1 ? g_loopBounds[i] : 0;
+}
+
+std::size_t Metrics::stallCount() const {
+	return stallsTotal_ < METRICS_STALL_HISTORY ? stallsTotal_
+												: METRICS_STALL_HISTORY;
+}
+
+const LoopStall &Metrics::stall(std::size_t i) const {
+	const std::size_t first =
+		stallsTotal_ < METRICS_STALL_HISTORY ? 0 : stallsTotal_;
+	return stalls_[(first + i) % METRICS_STALL_HISTORY];
+}
+
+void Metrics::tick(time_t now) {
+	if (now == second_)
+		return;
+	// a gap of several seconds means the last one was idle
+	const bool consecutive = (now == second_ + 1);
+	gauges_[METRIC_LINES_PER_SEC] =
+		consecutive ? counters_[METRIC_LINES_IN] - secondLines_ : 0;
+	gauges_[METRIC_LOOP_USEC_MAX] = secondLoopMax_;
+	second_						  = now;
+	secondLines_				  = counters_[METRIC_LINES_IN];
+	secondLoopMax_				  = 0;
+	if (now - lastDecay_ >= METRICS_HEAVY_DECAY_SECONDS) {
+		if (lastDecay_)
+			for (int i = 0; i < HEAVY_KIND_COUNT; ++i)
+				heavy_[i].decay();
+		lastDecay_ = now;
+	}
+}
+
+HeavyHitters &Metrics::heavy(HeavyKind kind) { return heavy_[kind]; }
+
+const HeavyHitters &Metrics::heavy(HeavyKind kind) const {
+	return heavy_[kind];
+}
+
+const char *Metrics::name(MetricCounter counter) {
+	static const char *const names[METRIC_COUNTER_COUNT] = {
+		"connections",	 "registrations", "disconnections",
+		"lines_in",		 "bytes_in",	  "bytes_out",
+		"sendq_kills",	 "admission_refused", "loop_iterations",
+		"loop_usec"};
+	return names[counter];
+}
+
+const char *Metrics::name(MetricGauge gauge) {
+	static const char *const names[METRIC_GAUGE_COUNT] = {
+		"clients",		 "users",		 "users_max",
+		"channels",		 "queued_bytes", "pending_closes",
+		"lines_per_sec", "loop_usec_max"};
+	return names[gauge];
+}
+
+const char *Metrics::name(LoopPhase phase) {
+	static const char *const names[LOOP_PHASE_COUNT] = {
+		"poll",	  "prepare",  "admin",	 "closes", "drain",
+		"pollin", "dead_fds", "accept", "reclaim"};
+	return names[phase];
+}
+
+const char *Metrics::name(HeavyKind kind) {
+	static const char *const names[HEAVY_KIND_COUNT] = {
+		"client_lines", "channel_bytes", "ip_connects"};
+	return names[kind];
+}
+
+uint64_t Metrics::nowUsec() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return static_cast<uint64_t>(ts.tv_sec) * 1000000u +
+		   static_cast<uint64_t>(ts.tv_nsec / 1000);
+}
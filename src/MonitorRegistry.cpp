@@ -0,0 +1,106 @@
+#include "../include/MonitorRegistry.hpp"
+#include "../include/CaseMappedString.hpp"
+#include "../include/Debug.hpp"
+#include "../include/Handoff.hpp"
+
+#include <algorithm>
+
+MonitorRegistry::MonitorRegistry() {
+	debug("MonitorRegistry constructor called");
+}
+
+MonitorRegistry::MonitorRegistry(const MonitorRegistry &other)
+	: lists_(other.lists_), watchers_(other.watchers_) {}
+
+MonitorRegistry &MonitorRegistry::operator=(const MonitorRegistry &other) {
+	if (this != &other) {
+		lists_	  = other.lists_;
+		watchers_ = other.watchers_;
+	}
+	return *this;
+}
+
+MonitorRegistry::~MonitorRegistry() {
+	debug("MonitorRegistry destructor called");
+}
+
+bool MonitorRegistry::watch(int fd, const std::string &nickname) {
+	const std::string mapped = CaseMappedString::toCaseMappedString(nickname);
+	WatchList		 &list	 = lists_[fd];
+	if (list.count(mapped))
+		return true;
+	if (list.size() >= MONITOR_LIMIT)
+		return false;
+	list[mapped] = nickname;
+	watchers_[mapped].push_back(fd);
+	return true;
+}
+
+void MonitorRegistry::unwatchMapped_(int fd, const std::string &mapped) {
+	std::map<std::string, std::vector<int> >::iterator it = watchers_.find(mapped);
+	if (it == watchers_.end())
+		return;
+	std::vector<int>		  &fds	 = it->second;
+	std::vector<int>::iterator found = std::find(fds.begin(), fds.end(), fd);
+	if (found != fds.end()) {
+		*found = fds.back();
+		fds.pop_back();
+	}
+	if (fds.empty())
+		watchers_.erase(it);
+}
+
+void MonitorRegistry::unwatch(int fd, const std::string &nickname) {
+	std::map<int, WatchList>::iterator list = lists_.find(fd);
+	if (list == lists_.end())
+		return;
+	const std::string mapped = CaseMappedString::toCaseMappedString(nickname);
+	if (!list->second.erase(mapped))
+		return;
+	unwatchMapped_(fd, mapped);
+	if (list->second.empty())
+		lists_.erase(list);
+}
+
+void MonitorRegistry::clear(int fd) {
+	std::map<int, WatchList>::iterator list = lists_.find(fd);
+	if (list == lists_.end())
+		return;
+	for (WatchList::const_iterator it = list->second.begin();
+		 it != list->second.end(); ++it)
+		unwatchMapped_(fd, it->first);
+	lists_.erase(list);
+}
+
+const MonitorRegistry::WatchList *MonitorRegistry::list(int fd) const {
+	std::map<int, WatchList>::const_iterator it = lists_.find(fd);
+	return it == lists_.end() ? NULL : &it->second;
+}
+
+const std::vector<int> *MonitorRegistry::watchers(const std::string &nickname) const {
+	std::map<std::string, std::vector<int> >::const_iterator it =
+		watchers_.find(CaseMappedString::toCaseMappedString(nickname));
+	return it == watchers_.end() ? NULL : &it->second;
+}
+
+void MonitorRegistry::saveState(StateWriter &out) const {
+	out.u32(static_cast<uint32_t>(lists_.size()));
+	for (std::map<int, WatchList>::const_iterator it = lists_.begin();
+		 it != lists_.end(); ++it) {
+		out.u32(static_cast<uint32_t>(it->first));
+		out.u32(static_cast<uint32_t>(it->second.size()));
+		for (WatchList::const_iterator nick = it->second.begin();
+			 nick != it->second.end(); ++nick)
+			out.str(nick->second);
+	}
+}
+
+void MonitorRegistry::loadState(StateReader &in) {
+	lists_.clear();
+	watchers_.clear();
+	for (uint32_t count = in.u32(); count; --count) {
+		const int fd = static_cast<int>(in.u32());
+		for (uint32_t nicks = in.u32(); nicks; --nicks)
+			watch(fd, in.str());
+	}
+}
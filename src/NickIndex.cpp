@@ -0,0 +1,100 @@
+#include "../include/NickIndex.hpp"
+#include "../include/CaseMappedString.hpp"
+#include "../include/Debug.hpp"
+
+NickIndex::NickIndex() : buckets_(NICKINDEX_MIN_BUCKETS), size_(0) {
+	debug("NickIndex default constructor called");
+}
+
+NickIndex::NickIndex(const NickIndex &other)
+	: buckets_(other.buckets_), size_(other.size_) {}
+
+NickIndex &NickIndex::operator=(const NickIndex &other) {
+	if (this != &other) {
+		buckets_ = other.buckets_;
+		size_	 = other.size_;
+	}
+	return *this;
+}
+
+NickIndex::~NickIndex() {
+	debug("NickIndex destructor called");
+}
+
+std::size_t NickIndex::probe_(const Slab<Client> &clients,
+							  const std::string &nickname,
+							  unsigned long hash) const {
+	const std::size_t mask = buckets_.size() - 1;
+	std::size_t		  i	   = hash & mask;
+	while (!buckets_[i].client.isNull()) {
+		if (buckets_[i].hash == hash &&
+			CaseMappedString::equalsCaseMapped(
+				clients.get(buckets_[i].client)->getNickname(), nickname))
+			return i;
+		i = (i + 1) & mask;
+	}
+	return i;
+}
+
+void NickIndex::rehash_(std::size_t bucketCount) {
+	std::vector<Bucket> old(bucketCount);
+	old.swap(buckets_);
+	const std::size_t mask = buckets_.size() - 1;
+	for (std::size_t b = 0; b < old.size(); ++b) {
+		if (old[b].client.isNull())
+			continue;
+		std::size_t i = old[b].hash & mask;
+		while (!buckets_[i].client.isNull())
+			i = (i + 1) & mask;
+		buckets_[i] = old[b];
+	}
+}
+
+ClientHandle NickIndex::find(const Slab<Client> &clients,
+							 const std::string	&nickname) const {
+	return buckets_[probe_(clients, nickname,
+						   CaseMappedString::hashCaseMapped(nickname))]
+		.client;
+}
+
+void NickIndex::insert(const Slab<Client> &clients, ClientHandle client) {
+	const std::string nickname = clients.get(client)->getNickname();
+	if (nickname.empty())
+		return;
+	if ((size_ + 1) * 2 > buckets_.size())
+		rehash_(buckets_.size() * 2);
+	const unsigned long hash = CaseMappedString::hashCaseMapped(nickname);
+	Bucket			   &b	 = buckets_[probe_(clients, nickname, hash)];
+	if (!b.client.isNull())
+		return;
+	b.hash	 = hash;
+	b.client = client;
+	++size_;
+}
+
+void NickIndex::erase(const Slab<Client> &clients, ClientHandle client) {
+	const std::string nickname = clients.get(client)->getNickname();
+	if (nickname.empty())
+		return;
+	const std::size_t mask = buckets_.size() - 1;
+	std::size_t		  hole =
+		probe_(clients, nickname, CaseMappedString::hashCaseMapped(nickname));
+	if (buckets_[hole].client != client)
+		return;
+	buckets_[hole] = Bucket();
+	--size_;
+	// Backward-shift, as in ChannelRegistry::erase
+	for (std::size_t i = (hole + 1) & mask; !buckets_[i].client.isNull();
+		 i			   = (i + 1) & mask) {
+		const std::size_t home = buckets_[i].hash & mask;
+		if (((i - home) & mask) >= ((i - hole) & mask)) {
+			buckets_[hole] = buckets_[i];
+			buckets_[i]	   = Bucket();
+			hole		   = i;
+		}
+	}
+	if (buckets_.size() > NICKINDEX_MIN_BUCKETS && size_ * 8 < buckets_.size())
+		rehash_(buckets_.size() / 2);
+}
+
+std::size_t NickIndex::size() const { return size_; }
@@ -0,0 +1,21 @@
+#include "../include/ReplyStream.hpp"
+#include "../include/Debug.hpp"
+#include "../include/Server.hpp"
+
+ReplyStream::ReplyStream(int fd) : fd_(fd) {
+	debug("ReplyStream constructor called");
+}
+
+ReplyStream::~ReplyStream() {
+	debug("ReplyStream destructor called");
+}
+
+int ReplyStream::fd() const { return fd_; }
+
+bool ReplyStream::hasRoom(Server &server) const {
+	return server.getMessageQueueManager().queuedBytes(fd_) < STREAM_QUEUE_BUDGET;
+}
+
+void ReplyStream::send(Server &server, const std::string &line) const {
+	server.getMessageQueueManager().send(fd_, line);
+}
@@ -1,8 +1,11 @@
 #include "../include/Server.hpp"
+#include "../include/AllocProfile.hpp"
+#include "../include/LatencyTrace.hpp"
 #include "../include/Channel.hpp"
 #include "../include/Command.hpp"
 #include "../include/Debug.hpp"
 #include "../include/IrcUtils.hpp"
+#include <algorithm>
 #include <cerrno>
 #include <csignal>
 #include <cstdio>
@@ -12,7 +15,6 @@
 #include <netdb.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
-#include <iomanip>
 #include <sstream>
 #include <ostream>
 #include <poll.h>
@@ -22,64 +24,157 @@
 #include <sys/fcntl.h>
 #include <sys/poll.h>
 #include <sys/socket.h>
+#include <sys/stat.h>
 #include <sys/types.h>
+#include <sys/un.h>
+#include <sys/wait.h>
 #include <unistd.h>
 #include <vector>
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
 
 bool Server::running_ = false;
+volatile sig_atomic_t Server::stopSignals_ = 0;
+volatile sig_atomic_t Server::upgradeRequested_ = 0;
+int Server::wakePipe_[2] = {-1, -1};
 
 void	Server::signalHandler(int signum)
 {
-	static_cast<void>(signum);
-	running_ = false;
-	debug("received a signal");
+#ifdef ALLOC_PROFILE
+	if (signum == SIGUSR1) {
+		ALLOC_PROFILE_REQUEST_DUMP();
+		return;
+	}
+#endif
+#ifdef LATENCY_TRACE
+	if (signum == SIGUSR2) {
+		LATENCY_TRACE_REQUEST_DUMP();
+		return;
+	}
+#endif
+	if (signum == SIGHUP)
+		upgradeRequested_ = 1;
+	else {
+		running_ = false;
+		++stopSignals_;
+	}
+	// only async-signal-safe calls from here on
+	const int savedErrno = errno;
+	if (wakePipe_[1] != -1)
+		static_cast<void>(write(wakePipe_[1], "", 1));
+	errno = savedErrno;
 }
 
 // Default Constructor
-Server::Server(void): name_(HOSTNAME), port_(6667), password_("password"), timeCreated_(std::time(NULL))
+Server::Server(void): name_(HOSTNAME), port_(6667), password_("password"), unixListener_(-1), timeCreated_(std::time(NULL)), reclaimCursor_(0), lastReclaim_(0), watchdog_(metrics_), streamsBusy_(false), draining_(false), drainDeadline_(0)
 {
 	running_ = true;
 	debug("Default Constructor called");
 }
 
 // Parameterized Constructor
-Server::Server(int port, std::string password): name_(HOSTNAME), port_(port), password_(password), serverSocket_(-1), timeCreated_(std::time(NULL))
+Server::Server(int port, std::string password, const ServerConfig &config): config_(config), name_(HOSTNAME), port_(port), password_(password), unixListener_(-1), timeCreated_(std::time(NULL)), reclaimCursor_(0), lastReclaim_(0), watchdog_(metrics_), streamsBusy_(false), draining_(false), drainDeadline_(0)
 {
 	debug("Parameterized Constructor called");
 	std::cout << GREEN << "==== STARTING SERVER ====" << RESET << std::endl;
 	std::cout << BLUE << "port: " << port << ", password: " << password << RESET << std::endl;
 	running_ = true;
+	Client::setQueueManager(messageQueueManager_);
+	Client::setBufferPool(bufferPool_);
+	Channel::setMetrics(metrics_);
+	MessageHistory::configure(config_.historyLength, config_.historyDir,
+							  config_.historyDiskLength, config_.historyDiskChannels);
+	if (config_.historyLength && !config_.historyDir.empty()
+		&& access(config_.historyDir.c_str(), W_OK | X_OK) == -1)
+		throw std::runtime_error("[History] cannot write to " + config_.historyDir);
+	admission_.setLimits(config_.maxPerIp, config_.maxPerSubnet, config_.connectRate);
+	// restored descriptors keep their numbers, so nothing else may be open
+	// before restoreFromHandoff
+	int handoff = -1;
+	if (config_.upgradeFd != -1)
+		handoff = restoreFromHandoff();
+	else
+		serverInit();
+	openWakePipe();
 	signal(SIGINT, signalHandler);
 	signal(SIGQUIT, signalHandler);
-	serverInit();
+	signal(SIGTERM, signalHandler);
+	signal(SIGHUP, signalHandler);
+#ifdef ALLOC_PROFILE
+	signal(SIGUSR1, signalHandler);
+#endif
+#ifdef LATENCY_TRACE
+	signal(SIGUSR2, signalHandler);
+#endif
+	if (!config_.adminSocket.empty()) {
+		admin_.open(config_.adminSocket);
+		std::cout << BLUE << "admin socket: " << config_.adminSocket << RESET << std::endl;
+	}
+	watchdog_.start(static_cast<uint64_t>(config_.stallBudgetMs) * 1000);
+	if (!config_.stateDir.empty())
+		journal_.open(config_.stateDir);
+	if (handoff == -1)
+		expireHistory();
+	if (handoff != -1) {
+		Handoff::acknowledge(handoff);
+		close(handoff);
+		std::cout << GREEN << "[Server] pid " << getpid() << " took over "
+				  << clients_.size() << " clients and " << channels_.size()
+				  << " channels" << RESET << std::endl;
+	}
 }
 
 // Destructor
 Server::~Server()
 {
 	debug("Destructor called");
+	for (size_t i = 0; i < streams_.size(); ++i)
+		delete streams_[i].stream;
 	// serverShutdown();
 }
 
 // Copy Constructor
 Server::Server(const Server &other)
-	: name_(other.name_), port_(other.port_), password_(other.password_),
-	  serverSocket_(other.serverSocket_), pollFds_(other.pollFds_),
-	  clients_(other.clients_), timeCreated_(other.timeCreated_),
+	: config_(other.config_), name_(other.name_), port_(other.port_), password_(other.password_),
+	  listeners_(other.listeners_), unixListener_(other.unixListener_),
+	  pollFds_(other.pollFds_),
+	  clients_(other.clients_), nicks_(other.nicks_), fdTable_(other.fdTable_),
+	  channels_(other.channels_), timeCreated_(other.timeCreated_),
 	  messageQueueManager_(other.messageQueueManager_),
-	  pendingCloseClients_(other.pendingCloseClients_)
-// channels_(other.channels_)
+	  pendingCloseFds_(other.pendingCloseFds_), bufferPool_(other.bufferPool_),
+	  reclaimCursor_(other.reclaimCursor_), lastReclaim_(other.lastReclaim_),
+	  metrics_(other.metrics_), admin_(other.admin_), watchdog_(metrics_),
+	  admission_(other.admission_), streamsBusy_(false),
+	  monitors_(other.monitors_), draining_(other.draining_),
+	  drainDeadline_(other.drainDeadline_)
 {}
 
 // Copy Assignment Operator
 Server &Server::operator=(const Server &other) {
 	if (this != &other) {
-		serverSocket_		 = other.serverSocket_;
+		listeners_			 = other.listeners_;
+		unixListener_		 = other.unixListener_;
 		pollFds_			 = other.pollFds_;
 		clients_			 = other.clients_;
+		nicks_				 = other.nicks_;
+		fdTable_			 = other.fdTable_;
 		channels_			 = other.channels_;
 		messageQueueManager_ = other.messageQueueManager_;
-		pendingCloseClients_ = other.pendingCloseClients_;
+		pendingCloseFds_	 = other.pendingCloseFds_;
+		bufferPool_			 = other.bufferPool_;
+		reclaimCursor_		 = other.reclaimCursor_;
+		lastReclaim_		 = other.lastReclaim_;
+		metrics_			 = other.metrics_;
+		admin_				 = other.admin_;
+		admission_			 = other.admission_;
+		monitors_			 = other.monitors_;
+		draining_			 = other.draining_;
+		drainDeadline_		 = other.drainDeadline_;
 	}
 	return *this;
 }
@@ -105,7 +200,7 @@ const std::string	&Server::getPassword( void ) const
 	return (password_);
 }
 
-std::vector<Client>& Server::getClients( void )
+Slab<Client>& Server::getClients( void )
 {
 	return clients_;
 }
@@ -116,45 +211,99 @@ int	Server::getPort( void ) const
 	return (port_);
 }
 
-int	Server::getServerSocket( void ) const
-{
-	return this->serverSocket_;
-}
-
 void	Server::addPollFd(const int fd, const short events, const short revents)
 {
 	struct pollfd newPollfd = {fd, events, revents};
 	pollFds_.push_back(newPollfd);
+	fdEntry(fd).pollIndex = static_cast<int>(pollFds_.size() - 1);
+}
+
+// swap-removes fd from pollFds_ and fixes the index of the moved entry
+void	Server::removePollFd(int fd)
+{
+	int pfdIdx = pollFdIndexFromFd(fd);
+	if (pfdIdx == -1) {
+		debug("pollFds_ list out of sync; could not find fd to remove");
+		return;
+	}
+	removeAndSwapBack(pollFds_, static_cast<size_t>(pfdIdx));
+	if (static_cast<size_t>(pfdIdx) < pollFds_.size())
+		fdEntry(pollFds_[pfdIdx].fd).pollIndex = pfdIdx;
+	fdEntry(fd).pollIndex = -1;
 }
 
-void	Server::setServerSocket( int serverSocketFd )
+// fds are small dense integers, so the table is indexed by fd directly
+Server::FdEntry	&Server::fdEntry(int fd)
 {
-	this->serverSocket_ = serverSocketFd;
+	if (static_cast<size_t>(fd) >= fdTable_.size())
+		fdTable_.resize(static_cast<size_t>(fd) + 1);
+	return fdTable_[static_cast<size_t>(fd)];
 }
 
-// Simple IPv6 address to string (no RFC 5952 compression).
-// It produces eight hextets separated by ':'.
-static std::string ipv6ToString_(const struct in6_addr &addr) {
-	std::ostringstream oss;
-	oss << std::hex << std::nouppercase;
-	for (int i = 0; i < 8; ++i) {
-		unsigned int hi = static_cast<unsigned int>(addr.s6_addr[i * 2]);
-		unsigned int lo = static_cast<unsigned int>(addr.s6_addr[i * 2 + 1]);
-		unsigned int val = (hi << 8) | lo;
-		if (i > 0)
-			oss << ':';
-		oss << std::setw(4) << std::setfill('0') << val;
+void	Server::addListener(int fd)
+{
+	listeners_.push_back(fd);
+	fdEntry(fd).listening = true;
+	addPollFd(fd, POLLIN, 0);
+}
+
+void	Server::removeListener(int fd)
+{
+	std::vector<int>::iterator it = std::find(listeners_.begin(), listeners_.end(), fd);
+	if (it == listeners_.end())
+		return;
+	removeAndSwapBack(listeners_, static_cast<size_t>(it - listeners_.begin()));
+	removePollFd(fd);
+	fdEntry(fd).listening = false;
+	if (-1 == close(fd))
+		debug("close failed on listening socket; treating as already closed");
+	if (fd == unixListener_) {
+		unlink(config_.unixSocket.c_str());
+		unixListener_ = -1;
 	}
-	return oss.str();
 }
 
-// accepts a connection from client and adds it to pollFds_
-void	Server::acceptConnection( void )
+// Folds the binary address into a heavy-hitter key
+static uint64_t addressKey(const struct in6_addr &address) {
+	uint64_t key = 0;
+	for (size_t i = 0; i < sizeof(address.s6_addr); ++i)
+		key = key * 131 + address.s6_addr[i];
+	return key;
+}
+
+// Kernel-verified uid of the process on the other end of a Unix-domain
+// connection, or -1
+static long peerUid(int fd)
 {
-	while (true) {
+#ifdef SO_PEERCRED
+	struct ucred credentials;
+	socklen_t	 length = sizeof(credentials);
+	if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &credentials, &length) == 0)
+		return (static_cast<long>(credentials.uid));
+#else
+	static_cast<void>(fd);
+#endif
+	return (-1);
+}
+
+// Tells a refused peer why and closes it; best effort, never blocks
+static void refuseConnection(int fd, AdmissionVerdict verdict)
+{
+	const std::string line = std::string("ERROR :Closing link (")
+		+ AdmissionControl::reason(verdict) + ")\r\n";
+	static_cast<void>(send(fd, line.c_str(), line.size(), MSG_NOSIGNAL | MSG_DONTWAIT));
+	close(fd);
+}
+
+// accepts connections from clients and adds them to pollFds_, at most
+// acceptsPerLoop per call: the rest stays in the backlog until the next
+// iteration so a connect storm cannot starve established clients
+void	Server::acceptConnection(int listener)
+{
+	for (unsigned attempts = 0; attempts < config_.acceptsPerLoop; ++attempts) {
 		sockaddr_storage client_addr;
 		socklen_t client_len = sizeof(client_addr);
-		int clientFd = accept(getServerSocket(), (sockaddr *)&client_addr, &client_len);
+		int clientFd = accept(listener, (sockaddr *)&client_addr, &client_len);
 		if (clientFd == -1) {
 			if (errno == EINTR)
 				continue; // retry accept
@@ -165,45 +314,52 @@ void	Server::acceptConnection( void )
 			break;
 		}
 
+		Client newcomer(password_.empty());
+		newcomer.setSocket(clientFd);
+		if (client_addr.ss_family == AF_UNIX) {
+			newcomer.setPeerUid(peerUid(clientFd));
+			if (isTrustedPeer(newcomer) && !password_.empty())
+				newcomer.incrementRegistrationLevel();
+		}
+		// Store only the binary address in the Client (no port)
+		newcomer.setAddress(client_addr);
+		HeavyHitters  &connects = metrics_.heavy(HEAVY_IP_CONNECTS);
+		const uint64_t ipKey	= addressKey(newcomer.getAddress());
+		if (connects.add(ipKey))
+			connects.setLabel(ipKey, newcomer.getIP());
+		const AdmissionVerdict verdict =
+			admission_.admit(newcomer.getAddress(), std::time(NULL));
+		if (verdict != ADMISSION_ADMIT) {
+			debug(std::string("[Server] refused connection: ") + AdmissionControl::reason(verdict));
+			metrics_.add(METRIC_ADMISSION_REFUSED);
+			refuseConnection(clientFd, verdict);
+			continue;
+		}
 		addPollFd(clientFd, POLLIN, 0);
 		debug("[Server] accepted new connection");
-		Client newcomer(messageQueueManager_, password_.empty());
-		newcomer.setSocket(clientFd);
-		std::string ipOnly;
-		std::string hostForLog;
+		fdEntry(clientFd).client = clients_.insert(newcomer);
+		metrics_.add(METRIC_CONNECTIONS);
+		metrics_.increment(METRIC_CLIENTS);
 		unsigned short port = 0;
-		if (client_addr.ss_family == AF_INET) {
-			struct sockaddr_in *sa = (struct sockaddr_in *)&client_addr;
-			// inet_ntoa returns a static buffer; copy to std::string
-			ipOnly = std::string(inet_ntoa(sa->sin_addr));
-			port = ntohs(sa->sin_port);
-			hostForLog = ipOnly;
-		} else if (client_addr.ss_family == AF_INET6) {
-			struct sockaddr_in6 *sa6 = (struct sockaddr_in6 *)&client_addr;
-			// Normalize IPv4-mapped IPv6 addresses to plain IPv4 for readability
-			if (IN6_IS_ADDR_V4MAPPED(&(sa6->sin6_addr))) {
-				struct in_addr v4;
-				// IPv4-mapped IPv6 addresses store the IPv4 portion in bytes 12-15 of the in6_addr structure.
-				std::memcpy(&v4, &sa6->sin6_addr.s6_addr[12], sizeof(v4));
-				ipOnly = std::string(inet_ntoa(v4));
-				hostForLog = ipOnly;
-			} else {
-				ipOnly = ipv6ToString_(sa6->sin6_addr);
-				hostForLog.reserve(ipOnly.size() + 2);
-				hostForLog.push_back('[');
-				hostForLog.append(ipOnly);
-				hostForLog.push_back(']');
-			}
-			port = ntohs(sa6->sin6_port);
-		}
-		// Store only the IP address string in the Client (no port)
-		newcomer.setIP(ipOnly);
-		clients_.push_back(newcomer);
-		std::cout << "[Server] New connection from " << hostForLog << ":" << port
+		if (client_addr.ss_family == AF_INET)
+			port = ntohs(((struct sockaddr_in *)&client_addr)->sin_port);
+		else if (client_addr.ss_family == AF_INET6)
+			port = ntohs(((struct sockaddr_in6 *)&client_addr)->sin6_port);
+		std::string host = newcomer.getIP();
+		if (host.find(':') != std::string::npos)
+			host = "[" + host + "]";
+		std::cout << "[Server] New connection from " << host << ":" << port
 			  << " on socket " << clientFd << std::endl;
 	}
 }
 
+// a local peer running as our own uid is as trusted as we are
+bool	Server::isTrustedPeer(const Client &client)
+{
+	return (client.getPeerUid() != -1
+			&& client.getPeerUid() == static_cast<long>(geteuid()));
+}
+
 Message	Server::buildErrorMessage(MessageType type, std::vector<std::string> messageParams) const
 {
 	static std::map<MessageType, IrcErrorInfo> ErrorMap = getErrorMap();
@@ -233,13 +389,12 @@ void	Server::quitClient(const Client &quitter,  const std::string &reason)
 void	Server::quitClient(const Client &quitter,  const Message &msg)
 {
 	std::string qNickname = quitter.getNickname();
+	const std::vector<std::string> &joined = channelsOf(quitter.getSocket());
 	// Defer the actual close to allow queued data to flush
-	for (std::map<std::string, Channel>::iterator cMapIter = channels_.begin();
-		 cMapIter != channels_.end(); ++cMapIter) {
-		Channel &quittersChannel = cMapIter->second;
-		if (!quittersChannel.isMember(qNickname))
-			continue;
-		quittersChannel.broadcastMsg(qNickname, msg);
+	for (size_t i = 0; i < joined.size(); ++i) {
+		Channel *quittersChannel = channels_.find(joined[i]);
+		if (quittersChannel)
+			quittersChannel->broadcastMsg(qNickname, msg);
 	}
 	schedulePendingClose(quitter.getSocket());
 }
@@ -252,18 +407,11 @@ void Server::removeClient(int fd) {
 	std::cout << "[Server] Client on fd " << fd << " has disconnected."
 			  << std::endl;
 	// Ensure it's no longer scheduled for deferred close
-	// Remove from pendingCloseClients_ if present
-	bool wasPending = false;
-	for (std::vector<Client>::iterator it = pendingCloseClients_.begin();
-		 it != pendingCloseClients_.end(); ++it) {
-		if (it->getSocket() == fd) {
-			removeAndSwapBack(
-				pendingCloseClients_,
-				static_cast<size_t>(it - pendingCloseClients_.begin()));
-			wasPending = true;
-			break;
-		}
-	}
+	std::vector<int>::iterator pending =
+		std::find(pendingCloseFds_.begin(), pendingCloseFds_.end(), fd);
+	if (pending != pendingCloseFds_.end())
+		removeAndSwapBack(pendingCloseFds_,
+						  static_cast<size_t>(pending - pendingCloseFds_.begin()));
 	// Drop any pending outbound data for this fd via MessageQueueManager
 	messageQueueManager_.discard(fd);
 	if (close(fd) == -1) {
@@ -271,29 +419,45 @@ void Server::removeClient(int fd) {
 		debug(std::string("close failed on client fd ") + toString(fd) +
 			  ", treating as already closed");
 	}
-	int cIdx = clientIndexFromFd(fd);
-	if (cIdx != -1) {
-		removeAndSwapBack(clients_, cIdx);
-	} else if (!wasPending) {
-		// Only warn when not previously scheduled for pending close
-		debug("client list out of sync; could not find fd to remove");
-	}
-	int pfdIdx = pollFdIndexFromFd(fd);
-	if (pfdIdx != -1) {
-		removeAndSwapBack(pollFds_, pfdIdx);
+	ClientHandle handle = clientHandleFromFd(fd);
+	if (!handle.isNull()) {
+		// closing clients already left on schedulePendingClose
+		if (!clients_.get(handle)->isClosing()) {
+			leaveMonitors(*clients_.get(handle));
+			nicks_.erase(clients_, handle);
+		}
+		admission_.release(clients_.get(handle)->getAddress());
+		if (clients_.get(handle)->isAuthenticated())
+			metrics_.decrement(METRIC_USERS);
+		metrics_.add(METRIC_DISCONNECTIONS);
+		metrics_.decrement(METRIC_CLIENTS);
+		clients_.erase(handle);
+		fdEntry(fd).client = ClientHandle();
+		fdEntry(fd).channels.clear();
 	} else {
-		debug("pollFds_ list out of sync; could not find fd to remove");
+		debug("client list out of sync; could not find fd to remove");
 	}
+	removePollFd(fd);
 }
 
 void Server::executeIncomingCommandMessage(Client& sender, const std::string& rawMessage)
 {
 	if (rawMessage.empty())
 		return;
+	ALLOC_PROFILE_PHASE(ALLOC_PHASE_PARSE);
 	Message message(rawMessage);
+	ALLOC_PROFILE_COMMAND(message.getType().c_str());
+	LATENCY_TRACE_PARSED(message.getType().c_str());
 	debug("Parsed message: " + message.getType() + " with params: " + toString(message.getParams().size()));
+	metrics_.countCommand(message.getType());
+	watchdog_.setCommand(message.getType().c_str());
 	Command* cmd = convertMessageToCommand(message);
-	cmd->execute(*this, sender);
+	{
+		ALLOC_PROFILE_PHASE(ALLOC_PHASE_EXECUTE);
+		cmd->execute(*this, sender);
+	}
+	LATENCY_TRACE_EXECUTED();
+	LATENCY_TRACE_END();
 	delete cmd;
 }
 
@@ -318,21 +482,21 @@ void Server::broadcastErrorMessage(MessageType type, std::string args[],
 
 void Server::broadcastMsg(const Message &message) {
 	const std::string wire = message.toString();
-	for (std::vector<Client>::const_iterator it = clients_.begin();
-		 it != clients_.end(); ++it) {
-		messageQueueManager_.send(it->getSocket(), wire);
+	for (size_t slot = 0; slot < clients_.slotCount(); ++slot) {
+		const Client *client = clients_.at(slot);
+		if (client && !client->isClosing())
+			messageQueueManager_.send(client->getSocket(), wire);
 	}
 }
 
 bool	Server::clientNickExists(CaseMappedString& toCheck)
 {
-	for (size_t clientIndex = 0; clientIndex < clients_.size(); clientIndex++)
-	{
-		Client	compareTo = clients_[clientIndex];
-		if (toCheck == compareTo.getNickname())
-			return (1);
-	}
-	return (0);
+	return (findClientByNick(toCheck) != NULL);
+}
+
+Client	*Server::findClientByNick(const std::string &nickname)
+{
+	return (clients_.get(nicks_.find(clients_, nickname)));
 }
 
 //attempts to extract a full message from the clients sent input
@@ -340,25 +504,50 @@ bool	Server::clientNickExists(CaseMappedString& toCheck)
 void	Server::makeMessage(Client &client)
 {
 	std::string	command;
-	std::string	raw_message = client.getRawMessage();
+	size_t		consumed = 0;
 	size_t		position;
+	uint64_t	lines = 0;
 
-	while ((position = raw_message.find('\n')) != raw_message.npos)
+	while (!client.isClosing()
+		&& (position = client.getRawMessage().find('\n', consumed)) != std::string::npos)
 	{
-		if (position != 0 && raw_message[position - 1] == '\r')
-			command = raw_message.substr(0, position - 1);
-		else
-			command = raw_message.substr(0, position);
-		raw_message.erase(0, position + 1);
-		client.setRawMessage(raw_message);
+		const std::string	&raw_message = client.getRawMessage();
+		size_t				end = position;
+		if (end > consumed && raw_message[end - 1] == '\r')
+			--end;
+		command.assign(raw_message, consumed, end - consumed);
+		consumed = position + 1;
+		metrics_.add(METRIC_LINES_IN);
+		client.countLine();
+		++lines;
 		std::cout << "[" << client.getSocket() << "] " << RED << "<<< " << RESET << command << std::endl;
 		executeIncomingCommandMessage(client, command);
-		debug(raw_message);
 	}
+	if (lines)
+		countClientLines(client, lines);
+	// drop all complete lines at once; frees the buffer when nothing is left
+	client.consumeRawMessage(consumed);
+	debug(client.getRawMessage());
+}
+
+// Keyed by the slab handle, which a reused fd does not share; the label is
+// built only when the client enters the top list
+void Server::countClientLines(const Client &client, uint64_t lines) {
+	HeavyHitters	 &heavy	 = metrics_.heavy(HEAVY_CLIENT_LINES);
+	const SlabHandle &handle = fdEntry(client.getSocket()).client;
+	const uint64_t	  key	 = static_cast<uint64_t>(handle.index) << 32 |
+						   handle.generation;
+	if (!heavy.add(key, lines))
+		return;
+	const std::string nickname = client.getNickname();
+	heavy.setLabel(key, (nickname.empty() ? "*" : nickname) + " " +
+							client.getIP() + " fd " +
+							toString(client.getSocket()));
 }
 
 // interpret the message and execute it
 void Server::processPollIn(struct pollfd request) {
+	ALLOC_PROFILE_PHASE(ALLOC_PHASE_RECV);
 	char message[BUFSIZ];
 	int	 bytesRead;
 
@@ -374,19 +563,24 @@ void Server::processPollIn(struct pollfd request) {
 			return;
 		throw std::runtime_error("[Server] recv error");
 	} else {
+		LATENCY_TRACE_RECV();
+		metrics_.add(METRIC_BYTES_IN, static_cast<uint64_t>(bytesRead));
 		debug("received a message from client: " + toString(request.fd));
-		int cidx = clientIndexFromFd(request.fd);
-		if (cidx >= 0) {
-			clients_[static_cast<size_t>(cidx)].appendRawMessage(message,
-																 bytesRead);
-			makeMessage(clients_[static_cast<size_t>(cidx)]);
-		} // else Client may have been moved to closing; ignore input
+		Client *sender = tryClientFromFd(request.fd);
+		watchdog_.setFd(request.fd);
+		if (sender && !sender->isClosing()) {
+			sender->touch(std::time(NULL));
+			sender->appendRawMessage(message, bytesRead);
+			makeMessage(*sender);
+		} // else Client is already closing; ignore input
 	}
 }
 
 void Server::handlePollIn(const std::vector<struct pollfd> &polled) {
-	for (std::vector<struct pollfd>::const_iterator it = polled.begin() + 1;
+	for (std::vector<struct pollfd>::const_iterator it = polled.begin();
 		 it != polled.end(); ++it) {
+		if (fdEntry(it->fd).listening)
+			continue; // see handleNewConnection
 		if (it->revents & (POLLHUP | POLLERR | POLLNVAL)) {
 			std::string msg = "Socket error";
 			Client	   *c	= tryClientFromFd(it->fd);
@@ -414,12 +608,25 @@ void Server::handlePollIn(const std::vector<struct pollfd> &polled) {
 
 // pollfd/socket with index 0 is the listening socket that accepts new
 // connections so we only check that one here
-void Server::handleNewConnection(const struct pollfd &polled) {
-	if (polled.revents & (POLLHUP | POLLERR | POLLNVAL)) {
-		debug("[Server] listening socket hangup/error");
-		running_ = false;
-	} else if (polled.revents & POLLIN) {
-		acceptConnection();
+// A failing listener is dropped; the server stops once none is left
+void Server::handleNewConnection(const std::vector<struct pollfd> &polled) {
+	ALLOC_PROFILE_PHASE(ALLOC_PHASE_ACCEPT);
+	// by index: removeListener reorders listeners_
+	for (size_t i = listeners_.size(); i-- > 0;) {
+		const int listener = listeners_[i];
+		const int pollIndex = fdEntry(listener).pollIndex;
+		if (pollIndex < 0 || static_cast<size_t>(pollIndex) >= polled.size())
+			continue; // added after polled was built
+		const short revents = polled[pollIndex].revents;
+		if (revents & (POLLHUP | POLLERR | POLLNVAL)) {
+			std::cerr << "[Server] listening socket " << listener
+					  << " failed, closing it" << std::endl;
+			removeListener(listener);
+			if (listeners_.empty())
+				running_ = false;
+		} else if (revents & POLLIN) {
+			acceptConnection(listener);
+		}
 	}
 }
 
@@ -429,26 +636,66 @@ void Server::handleNewConnection(const struct pollfd &polled) {
 // readFromSocket
 void Server::waitForRequests(void) {
 	try {
-		while (running_) {
+		while (keepServing()) {
+			watchdog_.enter(LOOP_PHASE_PREPARE);
+			ALLOC_PROFILE_POLL(std::cerr);
+			LATENCY_TRACE_POLL(std::cerr);
+			if (upgradeRequested_ && upgrade())
+				break;
+			metrics_.tick(std::time(NULL));
+			admission_.expire(std::time(NULL));
+			journal_.tick();
 			std::vector<struct pollfd> polled = pollFds_;
 			messageQueueManager_.mergePollfds(polled);
 			// polled vec is structurally the same as pollFds_ but with added
 			// POLLOUT events for the fd's that have a non-empty queue, thus it
 			// is safe to use the same indexes for both the polled array and the
-			// pollFds_ array
-			int rdyPollsCount = poll(&(polled[0]), polled.size(), TIMEOUT);
-			if (running_ && rdyPollsCount == -1)
+			// pollFds_ array. The wake pipe and admin sockets follow and are
+			// cut off after poll.
+			const size_t clientPolls = polled.size();
+			struct pollfd wake = {wakePipe_[0], POLLIN, 0};
+			polled.push_back(wake);
+			admin_.appendPollfds(polled);
+			watchdog_.idle();
+			int rdyPollsCount = poll(&(polled[0]), polled.size(),
+									 streamsBusy_ ? 0 : TIMEOUT);
+			// dump requests (SIGUSR1/2) interrupt poll; just go around again
+			if (rdyPollsCount == -1 && errno == EINTR)
+				continue;
+			if (rdyPollsCount == -1)
 				throw std::runtime_error("[Server] poll error");
-			else if (rdyPollsCount == 0) {
+			if (polled[clientPolls].revents & POLLIN)
+				readWakePipe();
+			watchdog_.enter(LOOP_PHASE_ADMIN);
+			admin_.serve(polled, clientPolls + 1, *this);
+			polled.resize(clientPolls);
+			if (rdyPollsCount == 0) {
+				if (streamsBusy_) {
+					watchdog_.enter(LOOP_PHASE_DRAIN);
+					pumpStreams();
+				}
+				watchdog_.enter(LOOP_PHASE_RECLAIM);
+				reclaimIdleBuffers();
 				continue;
 			}
 			// Before draining, check if any pending-close fds are ready to be
 			// closed
-			processPendingCloses(polled);
-			messageQueueManager_.drainQueuesForPolled(polled);
+			{
+				ALLOC_PROFILE_PHASE(ALLOC_PHASE_DRAIN);
+				watchdog_.enter(LOOP_PHASE_CLOSES);
+				processPendingCloses(polled);
+				watchdog_.enter(LOOP_PHASE_DRAIN);
+				messageQueueManager_.drainQueuesForPolled(polled);
+				pumpStreams();
+			}
+			watchdog_.enter(LOOP_PHASE_POLLIN);
 			handlePollIn(polled);
+			watchdog_.enter(LOOP_PHASE_DEAD_FDS);
 			handleDeadFds();
-			handleNewConnection(polled[0]);
+			watchdog_.enter(LOOP_PHASE_ACCEPT);
+			handleNewConnection(polled);
+			watchdog_.enter(LOOP_PHASE_RECLAIM);
+			reclaimIdleBuffers();
 		}
 	} catch (std::exception &e) {
 		std::cerr << e.what() << ": " << (errno) << std::endl;
@@ -459,6 +706,7 @@ void Server::waitForRequests(void) {
 }
 
 void Server::handleDeadFds() {
+	ALLOC_PROFILE_PHASE(ALLOC_PHASE_HOUSEKEEPING);
 	if (!messageQueueManager_.hasDeadFds())
 		return;
 	std::vector<int> deadFds = messageQueueManager_.takeDeadFds();
@@ -474,6 +722,62 @@ void Server::handleDeadFds() {
 	}
 }
 
+size_t Server::bufferedBytes(void) const {
+	return bufferPool_.inUseBytes() + bufferPool_.pooledBytes() +
+		   messageQueueManager_.queuedBytes();
+}
+
+// Returns freed heap pages to the kernel; without it trimmed buffers would
+// only be reusable by this process and RSS would never come back down.
+static void returnFreedMemory(void) {
+#ifdef __GLIBC__
+	malloc_trim(0);
+#endif
+}
+
+// Visits up to RECLAIM_SLICE client slots, resuming where the last call
+// stopped, and trims the receive/send buffers of clients idle for longer than
+// the configured threshold. Relaxed sweeps run at most once per second; above
+// the memory budget every call sweeps, idleness is ignored and the buffer pool
+// is emptied as well.
+void Server::reclaimIdleBuffers(void) {
+	ALLOC_PROFILE_PHASE(ALLOC_PHASE_HOUSEKEEPING);
+	const time_t now		= std::time(NULL);
+	const bool	 overBudget = bufferedBytes() > config_.memoryBudget;
+	if (!overBudget && now == lastReclaim_)
+		return;
+	lastReclaim_ = now;
+
+	const size_t slots = clients_.slotCount();
+	size_t		 freed = 0;
+	bool		 wrapped = false;
+	for (size_t visited = 0; visited < RECLAIM_SLICE && visited < slots;
+		 ++visited) {
+		if (reclaimCursor_ >= slots) {
+			reclaimCursor_ = 0;
+			wrapped		   = true;
+		}
+		Client *client = clients_.at(reclaimCursor_++);
+		if (!client || client->isClosing())
+			continue;
+		if (!overBudget &&
+			now - client->getLastActivity() < config_.idleTrimSeconds)
+			continue;
+		freed += client->trimBuffers();
+		messageQueueManager_.trim(client->getSocket());
+	}
+	if (overBudget) {
+		bufferPool_.shrink(0);
+		messageQueueManager_.shrinkToFit();
+	} else if (wrapped) {
+		// a full sweep finished: let half of the pooled buffers go
+		bufferPool_.shrink(bufferPool_.pooledCount() / 2);
+		messageQueueManager_.shrinkToFit();
+	}
+	if (overBudget || (wrapped && freed))
+		returnFreedMemory();
+}
+
 void Server::schedulePendingClose(int fd) {
 	// If already scheduled, nothing to do
 	if (isPendingCloseFd(fd))
@@ -484,29 +788,26 @@ void Server::schedulePendingClose(int fd) {
 		short &ev = pollFds_[pidx].events;
 		ev		  = static_cast<short>((ev & ~POLLIN) | POLLOUT);
 	}
-	// Move the Client object to closingClients_ and remove from channels
-	int cidx = clientIndexFromFd(fd);
-	if (cidx != -1) {
-		Client		dying	 = clients_[static_cast<size_t>(cidx)];
-		std::string nickname = dying.getNickname();
-		pendingCloseClients_.push_back(dying);
-		removeAndSwapBack(clients_, static_cast<size_t>(cidx));
-		for (std::map<std::string, Channel>::iterator cMapIter =
-				 channels_.begin();
-			 cMapIter != channels_.end(); ++cMapIter) {
-			Channel &ch = cMapIter->second;
-			if (ch.isMember(nickname))
-			{
-				ch.removeMember(nickname);
-				ch.removeFromWhiteList(nickname);
-				ch.removeOperator(nickname);
-			}
+	// Flag the Client as closing in place and remove it from channels
+	Client *dying = tryClientFromFd(fd);
+	if (dying) {
+		std::string nickname = dying->getNickname();
+		leaveMonitors(*dying);
+		nicks_.erase(clients_, clientHandleFromFd(fd));
+		dying->markClosing();
+		pendingCloseFds_.push_back(fd);
+		// a copy: removeFromChannel takes each one off the list
+		const std::vector<std::string> joined = channelsOf(fd);
+		for (size_t i = 0; i < joined.size(); ++i) {
+			Channel *ch = channels_.find(joined[i]);
+			if (ch)
+				removeFromChannel(*ch, nickname);
 		}
 	}
 }
 
 void Server::processPendingCloses(const std::vector<struct pollfd> &polled) {
-	if (pendingCloseClients_.empty())
+	if (pendingCloseFds_.empty())
 		return;
 
 	// Build a quick lookup of fds that reported POLLOUT this cycle so we don't
@@ -519,13 +820,13 @@ void Server::processPendingCloses(const std::vector<struct pollfd> &polled) {
 	}
 
 	// Collect fds that are ready to close. We avoid mutating the
-	// pendingCloseClients_ vector while iterating it which was forcing us to
+	// pendingCloseFds_ vector while iterating it which was forcing us to
 	// restart the loop previously.
 	std::vector<int> readyToClose;
-	readyToClose.reserve(pendingCloseClients_.size());
-	for (std::vector<Client>::const_iterator it = pendingCloseClients_.begin();
-		 it != pendingCloseClients_.end(); ++it) {
-		int fd = it->getSocket();
+	readyToClose.reserve(pendingCloseFds_.size());
+	for (std::vector<int>::const_iterator it = pendingCloseFds_.begin();
+		 it != pendingCloseFds_.end(); ++it) {
+		int fd = *it;
 		// Only eligible when there's no remaining outbound backlog AND the fd
 		// produced a POLLOUT event this cycle (meaning kernel send buffer became
 		// writable and we now know all queued data was flushed).
@@ -538,18 +839,14 @@ void Server::processPendingCloses(const std::vector<struct pollfd> &polled) {
 
 	for (std::vector<int>::const_iterator it = readyToClose.begin();
 		 it != readyToClose.end(); ++it) {
-		removeClient(*it); // also erases from pendingCloseClients_
+		removeClient(*it); // also erases from pendingCloseFds_
 		debug("closed pending-close client " + toString(*it));
 	}
 }
 
 bool Server::isPendingCloseFd(int fd) const {
-	for (std::vector<Client>::const_iterator it = pendingCloseClients_.begin();
-		 it != pendingCloseClients_.end(); ++it) {
-		if (it->getSocket() == fd)
-			return true;
-	}
-	return false;
+	const Client *client = clients_.get(clientHandleFromFd(fd));
+	return client && client->isClosing();
 }
 
 // creates the one listening socket the server has to start out with
@@ -575,8 +872,8 @@ void Server::createListeningSocket(void) {
 			throw std::runtime_error("getaddrinfo error");
 	}
 	//create Socket
-	serverSocket_ = socket(res->ai_family, res->ai_socktype | SOCK_NONBLOCK, res->ai_protocol);
-	if (serverSocket_ == -1)
+	const int listener = socket(res->ai_family, res->ai_socktype | SOCK_NONBLOCK, res->ai_protocol);
+	if (listener == -1)
 	{
 		freeaddrinfo(res);
 		throw std::runtime_error("[Server] socket error");
@@ -585,42 +882,380 @@ void Server::createListeningSocket(void) {
 	if (res->ai_family == AF_INET6)
 	{
 		int v6only = 0;
-		if (setsockopt(serverSocket_, IPPROTO_IPV6, IPV6_V6ONLY, &v6only, sizeof(v6only)) == -1)
+		if (setsockopt(listener, IPPROTO_IPV6, IPV6_V6ONLY, &v6only, sizeof(v6only)) == -1)
 		{
 			// Non-fatal; we can still serve IPv6 clients
 			debug("[Server] Warning: failed to disable IPV6_V6ONLY; IPv4 clients may not connect via mapped addresses");
 		}
 	}
 	//reusing old socket, if still open, to circumvent TIME_WAIT
-	setsockopt(serverSocket_, SOL_SOCKET, SO_REUSEADDR, &optval, sizeof(optval));
+	setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &optval, sizeof(optval));
 	//bind socket
-	if (-1 == bind(getServerSocket(), res->ai_addr, res->ai_addrlen))
+	if (-1 == bind(listener, res->ai_addr, res->ai_addrlen))
 	{
-		close(serverSocket_);
+		close(listener);
 		freeaddrinfo(res);
 		throw std::runtime_error("[Server] bind error");
 	}
 	freeaddrinfo(res);
 	// mark as passive socket listening to incoming connections from clients
-	if (-1 == listen(getServerSocket(), BACKLOG))
+	if (-1 == listen(listener, config_.backlog))
+	{
+		close(listener);
 		throw std::runtime_error("[Server] listen error");
+	}
+	addListener(listener);
 }
 
+// The socket is already bound and listening (and may be held by a
+// supervisor across restarts, which is what keeps connects queued in the
+// kernel meanwhile); only check it and make accept(2) non-blocking.
+void Server::adoptListeningSocket(int fd) {
+	int		  accepting = 0;
+	int		  type		= 0;
+	socklen_t length	= sizeof(accepting);
+	if (getsockopt(fd, SOL_SOCKET, SO_ACCEPTCONN, &accepting, &length) == -1
+		|| !accepting)
+		throw std::runtime_error("[Server] inherited fd " + toString(fd)
+								 + " is not a listening socket");
+	length = sizeof(type);
+	if (getsockopt(fd, SOL_SOCKET, SO_TYPE, &type, &length) == -1
+		|| type != SOCK_STREAM)
+		throw std::runtime_error("[Server] inherited fd " + toString(fd)
+								 + " is not a stream socket");
+	fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+	addListener(fd);
+}
+
+void Server::createUnixListener(void) {
+	struct sockaddr_un address;
+	std::memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	if (config_.unixSocket.size() >= sizeof(address.sun_path))
+		throw std::runtime_error("[Server] unix socket path too long");
+	std::memcpy(address.sun_path, config_.unixSocket.c_str(), config_.unixSocket.size());
+	// a stale socket left by a crash would make bind fail; anything else
+	// at the path, or a socket someone still accepts on, is not ours
+	struct stat st;
+	if (lstat(config_.unixSocket.c_str(), &st) == 0) {
+		if (!S_ISSOCK(st.st_mode))
+			throw std::runtime_error("[Server] " + config_.unixSocket
+									 + " exists and is no socket");
+		const int probe = socket(AF_UNIX, SOCK_STREAM, 0);
+		const bool served = probe != -1 && connect(probe,
+			reinterpret_cast<struct sockaddr *>(&address), sizeof(address)) == 0;
+		if (probe != -1)
+			close(probe);
+		if (served)
+			throw std::runtime_error("[Server] " + config_.unixSocket
+									 + " is served by another process");
+		unlink(config_.unixSocket.c_str());
+	}
+	const int listener = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0);
+	if (listener == -1)
+		throw std::runtime_error("[Server] socket error");
+	if (bind(listener, reinterpret_cast<struct sockaddr *>(&address), sizeof(address)) == -1
+		|| listen(listener, config_.backlog) == -1) {
+		close(listener);
+		throw std::runtime_error("[Server] cannot listen on " + config_.unixSocket);
+	}
+	addListener(listener);
+	unixListener_ = listener;
+}
 
-// makes first listeing socket and adds it to pollFds_
+// opens the listening sockets: the inherited ones if any, else <port>
 void	Server::serverInit(void)
 {
 	pollFds_.reserve(5);
+	for (size_t i = 0; i < config_.listenFds.size(); ++i)
+		adoptListeningSocket(config_.listenFds[i]);
+	if (listeners_.empty())
+		createListeningSocket();
+	if (!config_.unixSocket.empty())
+		createUnixListener();
+	std::cout << BLUE << "listening on " << listeners_.size() << " socket"
+			  << (listeners_.size() == 1 ? "" : "s")
+			  << (config_.listenFds.empty() ? "" : " (inherited)") << RESET
+			  << std::endl;
+}
+
+void Server::openWakePipe(void) {
+	if (wakePipe_[0] != -1)
+		return;
+	if (pipe(wakePipe_) == -1)
+		throw std::runtime_error("[Server] pipe error");
+	for (int i = 0; i < 2; ++i) {
+		fcntl(wakePipe_[i], F_SETFL, fcntl(wakePipe_[i], F_GETFL) | O_NONBLOCK);
+		fcntl(wakePipe_[i], F_SETFD, FD_CLOEXEC);
+	}
+}
+
+void Server::readWakePipe(void) {
+	char buffer[64];
+	while (read(wakePipe_[0], buffer, sizeof(buffer)) > 0)
+		;
+}
+
+bool Server::keepServing(void) {
+	if (running_)
+		return (true);
+	if (stopSignals_ > 1) {
+		if (draining_)
+			std::cout << YEL << "[Server] stop signal repeated, dropping "
+					  << clients_.size() << " clients" << RESET << std::endl;
+		return (false);
+	}
+	if (!draining_) {
+		if (config_.drainSeconds == 0)
+			return (false);
+		startDrain();
+	}
+	if (clients_.empty())
+		return (false);
+	if (std::time(NULL) >= drainDeadline_) {
+		std::cout << YEL << "[Server] drain deadline passed, dropping "
+				  << clients_.size() << " clients" << RESET << std::endl;
+		return (false);
+	}
+	return (true);
+}
+
+// The closing ERROR is rendered once and queued for every client. Channels
+// are dropped first: every member is leaving, so schedulePendingClose has
+// nothing to unlink.
+void Server::startDrain(void) {
+	draining_	   = true;
+	drainDeadline_ = std::time(NULL) + config_.drainSeconds;
+	// refuse new connections right away instead of parking them in the
+	// backlog of a listener that is never accepted from again
+	while (!listeners_.empty())
+		removeListener(listeners_.back());
+	channels_ = ChannelRegistry();
+	for (size_t fd = 0; fd < fdTable_.size(); ++fd)
+		fdTable_[fd].channels.clear();
+	const std::string farewell = "ERROR :Closing link (Server shutting down)\r\n";
+	size_t			  notified = 0;
+	for (size_t slot = 0; slot < clients_.slotCount(); ++slot) {
+		const Client *client = clients_.at(slot);
+		if (!client || client->isClosing())
+			continue;
+		messageQueueManager_.send(client->getSocket(), farewell);
+		schedulePendingClose(client->getSocket());
+		++notified;
+	}
+	std::cout << YEL << "[Server] draining " << clients_.size()
+			  << " clients for up to " << config_.drainSeconds << "s ("
+			  << notified << " notified)" << RESET << std::endl;
+}
+
+// State handed to the new process, in this order: the listeners, every
+// client with its closing flag and unsent output, every channel. fds
+// receives the descriptors in the same order.
+void Server::saveState(StateWriter &out, std::vector<int> &fds) const {
+	out.u32(static_cast<uint32_t>(listeners_.size()));
+	for (size_t i = 0; i < listeners_.size(); ++i) {
+		out.u32(static_cast<uint32_t>(listeners_[i]));
+		fds.push_back(listeners_[i]);
+	}
+	out.u32(static_cast<uint32_t>(clients_.size()));
+	for (size_t slot = 0; slot < clients_.slotCount(); ++slot) {
+		const Client *client = clients_.at(slot);
+		if (!client)
+			continue;
+		client->saveState(out);
+		out.u8(client->isClosing());
+		out.str(messageQueueManager_.pendingData(client->getSocket()));
+		fds.push_back(client->getSocket());
+	}
+	out.u32(static_cast<uint32_t>(channels_.size()));
+	for (size_t slot = 0; slot < channels_.slotCount(); ++slot) {
+		const Channel *channel = channels_.at(slot);
+		if (channel)
+			channel->saveState(out);
+	}
+	monitors_.saveState(out);
+}
+
+// Runs in the forked child: only the handoff socket survives the exec
+static void execUpgrade(std::vector<char *> &argv, int handoff) {
+	fcntl(handoff, F_SETFD, 0);
+	const long maxFd = sysconf(_SC_OPEN_MAX);
+	for (long fd = 3; fd < maxFd; ++fd)
+		if (fd != handoff)
+			close(static_cast<int>(fd));
+	execvp(argv[0], &argv[0]);
+	static const char failed[] = "[Server] upgrade: exec failed\n";
+	static_cast<void>(write(2, failed, sizeof(failed) - 1));
+	_exit(127);
+}
+
+// The old process keeps every descriptor until the new one acknowledged,
+// so any failure before that just resumes serving here.
+bool Server::upgrade(void) {
+	upgradeRequested_ = 0;
+	if (draining_ || config_.arguments.empty())
+		return (false);
+	int handoff[2];
+	if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, handoff) == -1) {
+		std::cerr << "[Server] upgrade: socketpair failed" << std::endl;
+		return (false);
+	}
+	// built before fork: the child only closes descriptors and execs
+	std::vector<std::string> arguments;
+	for (size_t i = 0; i < config_.arguments.size(); ++i)
+		if (config_.arguments[i].compare(0, 13, "--upgrade-fd=") != 0)
+			arguments.push_back(config_.arguments[i]);
+	arguments.push_back("--upgrade-fd=" + toString(handoff[1]));
+	std::vector<char *> argv;
+	for (size_t i = 0; i < arguments.size(); ++i)
+		argv.push_back(const_cast<char *>(arguments[i].c_str()));
+	argv.push_back(NULL);
+	StateWriter		 state;
+	std::vector<int> fds;
+	saveState(state, fds);
+	std::cout << YEL << "[Server] upgrading: handing " << clients_.size()
+			  << " clients and " << state.data().size() << " bytes of state to "
+			  << arguments[0] << RESET << std::endl;
+	// no threads across fork, and the new process binds the admin path and
+	// takes the state directory
+	watchdog_.stop();
+	admin_.close();
+	journal_.close();
+	const pid_t child = fork();
+	if (child == 0)
+		execUpgrade(argv, handoff[1]);
+	close(handoff[1]);
+	bool tookOver = false;
+	if (child != -1) {
+		Handoff::setTimeouts(handoff[0]);
+		tookOver = Handoff::send(handoff[0], state.data(), fds) &&
+				   Handoff::awaitAcknowledge(handoff[0]);
+	}
+	close(handoff[0]);
+	if (tookOver) {
+		// the new process serves the path now
+		unixListener_ = -1;
+		std::cout << GREEN << "[Server] upgrade: pid " << child
+				  << " took over, exiting" << RESET << std::endl;
+		return (true);
+	}
+	std::cerr << "[Server] upgrade failed, still serving" << std::endl;
+	if (child != -1) {
+		kill(child, SIGKILL);
+		waitpid(child, NULL, 0);
+	}
+	if (!config_.adminSocket.empty()) {
+		try {
+			admin_.open(config_.adminSocket);
+		} catch (std::exception &e) {
+			std::cerr << e.what() << std::endl;
+		}
+	}
+	if (!config_.stateDir.empty()) {
+		try {
+			journal_.open(config_.stateDir);
+		} catch (std::exception &e) {
+			std::cerr << e.what() << std::endl;
+		}
+	}
+	watchdog_.start(static_cast<uint64_t>(config_.stallBudgetMs) * 1000);
+	return (false);
+}
+
+// Puts each received descriptor back on the number it had in the old
+// process, so clients, channels and queues need no remapping. Everything is
+// parked above the highest target first, so no dup2 clobbers a descriptor
+// that is still to be placed.
+static void placeDescriptors(const std::vector<int> &received,
+							 const std::vector<int> &targets) {
+	int floor = 3;
+	for (size_t i = 0; i < targets.size(); ++i)
+		floor = std::max(floor, targets[i] + 1);
+	std::vector<int> parked(received.size());
+	for (size_t i = 0; i < received.size(); ++i) {
+		parked[i] = fcntl(received[i], F_DUPFD_CLOEXEC, floor);
+		if (parked[i] == -1)
+			throw std::runtime_error("[Server] upgrade: out of descriptors");
+		close(received[i]);
+	}
+	for (size_t i = 0; i < targets.size(); ++i) {
+		if (fcntl(targets[i], F_GETFD) != -1)
+			throw std::runtime_error("[Server] upgrade: descriptor "
+									 + toString(targets[i]) + " is taken");
+		if (dup2(parked[i], targets[i]) == -1)
+			throw std::runtime_error("[Server] upgrade: dup2 error");
+		close(parked[i]);
+	}
+}
 
-	this->createListeningSocket();
-	this->addPollFd(getServerSocket(), POLLIN, 0);
+int Server::restoreFromHandoff(void) {
+	const int		 handoff = config_.upgradeFd;
+	std::string		 blob;
+	std::vector<int> received;
+	Handoff::setTimeouts(handoff);
+	Handoff::receive(handoff, blob, received);
+	StateReader		 in(blob);
+	std::vector<int> targets(in.u32());
+	const size_t	 listenerCount = targets.size();
+	for (size_t i = 0; i < listenerCount; ++i)
+		targets[i] = static_cast<int>(in.u32());
+	std::vector<Client>		 restored(in.u32(), Client(password_.empty()));
+	std::vector<bool>		 closing;
+	std::vector<std::string> pending;
+	for (size_t i = 0; i < restored.size(); ++i) {
+		restored[i].loadState(in);
+		closing.push_back(in.u8() != 0);
+		pending.push_back(in.str());
+		targets.push_back(restored[i].getSocket());
+	}
+	if (targets.size() != received.size())
+		throw std::runtime_error("[Handoff] descriptor count mismatch");
+	placeDescriptors(received, targets);
+	pollFds_.reserve(targets.size());
+	for (size_t i = 0; i < listenerCount; ++i) {
+		addListener(targets[i]);
+		struct sockaddr_un bound;
+		socklen_t		   length = sizeof(bound);
+		if (!config_.unixSocket.empty()
+			&& getsockname(targets[i], reinterpret_cast<struct sockaddr *>(&bound), &length) == 0
+			&& bound.sun_family == AF_UNIX && config_.unixSocket == bound.sun_path)
+			unixListener_ = targets[i];
+	}
+	for (size_t i = 0; i < restored.size(); ++i) {
+		const int fd = restored[i].getSocket();
+		addPollFd(fd, POLLIN, 0);
+		fdEntry(fd).client = clients_.insert(restored[i]);
+		if (!closing[i])
+			nicks_.insert(clients_, fdEntry(fd).client);
+		admission_.adopt(restored[i].getAddress());
+		metrics_.increment(METRIC_CLIENTS);
+		if (restored[i].isAuthenticated())
+			metrics_.increment(METRIC_USERS);
+		messageQueueManager_.restore(fd, pending[i]);
+		if (closing[i])
+			schedulePendingClose(fd);
+	}
+	for (uint32_t count = in.u32(); count; --count) {
+		const Channel *channel = channels_.insert(Channel(messageQueueManager_, in));
+		const Channel::Members &members = channel->getMembers();
+		for (Channel::Members::const_iterator it = members.begin(); it != members.end(); ++it)
+			fdEntry(it->second.fd).channels.push_back(channel->getName());
+	}
+	monitors_.loadState(in);
+	if (!in.atEnd())
+		throw std::runtime_error("[Handoff] trailing state");
+	return (handoff);
 }
 
 // cleanup
 void Server::serverShutdown(void) {
 	std::cout << BRED << "==== STARTING SERVER SHUTDOWN ====" << RESET
 			  << std::endl;
-	for (size_t pollIndex = 1; pollIndex < pollFds_.size(); pollIndex++) {
+	while (!listeners_.empty())
+		removeListener(listeners_.back());
+	std::cout << "[Server] diconnected listening sockets" << RESET
+			  << std::endl;
+	for (size_t pollIndex = 0; pollIndex < pollFds_.size(); pollIndex++) {
 		if (-1 == close(pollFds_[pollIndex].fd)) {
 			debug(std::string("close failed on fd ") +
 				  toString(pollFds_[pollIndex].fd) +
@@ -629,60 +1264,226 @@ void Server::serverShutdown(void) {
 	}
 	std::cout << "[Server] diconnected all clients sockets" << RESET
 			  << std::endl;
-	if (serverSocket_ != -1) {
-		if (-1 == close(serverSocket_)) {
-			debug("close failed on serverSocket; treating as already closed");
-		}
-		std::cout << "[Server] diconnected listening socket" << RESET
-				  << std::endl;
+	admin_.close();
+	watchdog_.stop();
+	journal_.close();
+	for (int i = 0; i < 2; ++i) {
+		if (wakePipe_[i] != -1)
+			close(wakePipe_[i]);
+		wakePipe_[i] = -1;
 	}
 	std::cout << GREEN << "[Server] Shutdown complete" << RESET << std::endl;
+	ALLOC_PROFILE_DUMP(std::cerr);
+	LATENCY_TRACE_DUMP(std::cerr);
 }
 
 Channel* Server::mapChannel(const std::string& channelName)
 {
-	std::map<std::string, Channel>::iterator it = channels_.find(channelName);
-	if (it != channels_.end())
-		return &(it->second);
-	return NULL;
+	return channels_.find(channelName);
+}
+
+// A history file is only ever served to a channel restored from the journal
+// (see MessageHistory::keepEarlier), so the others are removed on a fresh
+// start; a live upgrade hands their channels over instead
+void Server::expireHistory(void) {
+	std::vector<std::string> names;
+	MessageHistory::diskChannels(names);
+	std::size_t				 removed = 0;
+	for (size_t i = 0; i < names.size(); ++i) {
+		ChannelState saved;
+		if (journal_.find(names[i], saved))
+			continue;
+		MessageHistory(names[i]).discard();
+		++removed;
+	}
+	if (removed)
+		std::cout << BLUE << "[History] removed " << removed
+				  << " files of channels without saved state" << RESET << std::endl;
+}
+
+bool Server::removeFromChannel(Channel &channel, const std::string &nickname)
+{
+	Channel::Members::const_iterator member = channel.getMembers().find(nickname);
+	if (member != channel.getMembers().end()) {
+		std::vector<std::string> &joined = fdEntry(member->second.fd).channels;
+		std::vector<std::string>::iterator name =
+			std::find(joined.begin(), joined.end(), channel.getName());
+		if (name != joined.end())
+			joined.erase(name);
+	}
+	channel.removeMember(nickname);
+	channel.removeFromWhiteList(nickname);
+	channel.removeOperator(nickname);
+	if (!channel.isEmpty())
+		return false;
+	// the channel is gone for good, not just until a restart
+	journal_.destroyed(channel.getName());
+	channel.discardHistory();
+	return channels_.eraseIfEmpty(channel);
+}
+
+void Server::addToChannel(Channel &channel, const Client &client)
+{
+	channel.addMember(&client);
+	fdEntry(client.getSocket()).channels.push_back(channel.getName());
 }
 
-std::map<std::string, Channel>&	Server::getChannels(void)
+const std::vector<std::string> &Server::channelsOf(int fd)
+{
+	return fdEntry(fd).channels;
+}
+
+bool Server::startStream(ReplyStream *stream)
+{
+	const ClientHandle handle = clientHandleFromFd(stream->fd());
+	size_t			   queued = 0;
+	for (size_t i = 0; i < streams_.size(); ++i)
+		queued += streams_[i].client == handle;
+	if (handle.isNull() || queued >= STREAMS_PER_CLIENT)
+	{
+		delete stream;
+		return (false);
+	}
+	// the first chunk goes out with this iteration's replies
+	const StreamState state = queued ? STREAM_MORE : stream->pump(*this);
+	if (state == STREAM_DONE)
+	{
+		delete stream;
+		return (true);
+	}
+	StreamEntry entry;
+	entry.client = handle;
+	entry.stream = stream;
+	streams_.push_back(entry);
+	streamsBusy_ = streamsBusy_ || state == STREAM_MORE;
+	return (true);
+}
+
+void Server::pumpStreams(void)
+{
+	streamsBusy_ = false;
+	if (streams_.empty())
+		return;
+	// clients whose current stream is still going; their next ones wait
+	std::vector<ClientHandle> busy;
+	for (size_t i = 0; i < streams_.size();)
+	{
+		StreamEntry &entry = streams_[i];
+		const Client *client = tryClientFromHandle(entry.client);
+		if (!client || client->isClosing())
+		{
+			delete entry.stream;
+			streams_.erase(streams_.begin() + i);
+			continue;
+		}
+		if (std::find(busy.begin(), busy.end(), entry.client) != busy.end())
+		{
+			++i;
+			continue;
+		}
+		const StreamState state = entry.stream->pump(*this);
+		if (state == STREAM_DONE)
+		{
+			delete entry.stream;
+			streams_.erase(streams_.begin() + i);
+			continue;
+		}
+		streamsBusy_ = streamsBusy_ || state == STREAM_MORE;
+		busy.push_back(entry.client);
+		++i;
+	}
+}
+
+void Server::setNickname(Client &client, const std::string &nickname)
+{
+	const ClientHandle handle = clientHandleFromFd(client.getSocket());
+	if (!client.isClosing())
+		nicks_.erase(clients_, handle);
+	client.setNickname(nickname);
+	if (!client.isClosing())
+		nicks_.insert(clients_, handle);
+}
+
+MonitorRegistry&	Server::getMonitors(void)
+{
+	return (monitors_);
+}
+
+void	Server::notifyMonitors(const std::string &nickname, const Client *client)
+{
+	const std::vector<int> *watching = monitors_.watchers(nickname);
+	if (!watching)
+		return;
+	const std::string target = client
+		? client->getNickname() + "!" + client->getUsername() + "@" + client->getIP()
+		: nickname;
+	for (size_t i = 0; i < watching->size(); ++i)
+	{
+		const Client *watcher = tryClientFromFd((*watching)[i]);
+		if (!watcher || watcher->isClosing())
+			continue;
+		watcher->sendErrorMessage(client ? RPL_MONONLINE : RPL_MONOFFLINE,
+								  watcher->getNickname(), target);
+	}
+}
+
+void	Server::leaveMonitors(const Client &client)
+{
+	monitors_.clear(client.getSocket());
+	if (client.isAuthenticated())
+		notifyMonitors(client.getNickname(), NULL);
+}
+
+time_t	Server::getTimeCreated(void) const
+{
+	return (timeCreated_);
+}
+
+Metrics&	Server::getMetrics(void)
+{
+	metrics_.set(METRIC_CHANNELS, channels_.size());
+	metrics_.set(METRIC_QUEUED_BYTES, messageQueueManager_.queuedBytes());
+	metrics_.set(METRIC_PENDING_CLOSES, pendingCloseFds_.size());
+	metrics_.set(METRIC_BYTES_OUT, messageQueueManager_.bytesSent());
+	metrics_.set(METRIC_SENDQ_KILLS, messageQueueManager_.overflowCount());
+	return (metrics_);
+}
+
+ChannelRegistry&	Server::getChannels(void)
 {
 	return (channels_);
 }
 
+ChannelJournal&	Server::getChannelJournal(void)
+{
+	return (journal_);
+}
+
 // Accessor for outbound message queue manager
 MessageQueueManager &Server::getMessageQueueManager() {
 	return messageQueueManager_;
 }
 
 int Server::pollFdIndexFromFd(int fd) const {
-	for (size_t i = 0; i < pollFds_.size(); ++i) {
-		if (pollFds_[i].fd == fd)
-			return static_cast<int>(i);
-	}
-	return -1;
+	if (fd < 0 || static_cast<size_t>(fd) >= fdTable_.size())
+		return -1;
+	int pidx = fdTable_[static_cast<size_t>(fd)].pollIndex;
+	if (pidx < 0 || static_cast<size_t>(pidx) >= pollFds_.size() ||
+		pollFds_[pidx].fd != fd)
+		return -1;
+	return pidx;
 }
 
-int Server::clientIndexFromFd(int fd) const {
-	int pidx = pollFdIndexFromFd(fd);
-	if (pidx > 0 && static_cast<size_t>(pidx) < pollFds_.size()) {
-		size_t cidx = static_cast<size_t>(pidx - 1);
-		if (cidx < clients_.size() &&
-			clients_[cidx].getSocket() == pollFds_[pidx].fd)
-			return static_cast<int>(cidx);
-		// fall through to linear scan if mismatch
-	}
-	// Fallback: linear scan of clients_ by socket fd
-	for (size_t i = 0; i < clients_.size(); ++i) {
-		if (clients_[i].getSocket() == fd)
-			return static_cast<int>(i);
-	}
-	return -1;
+ClientHandle Server::clientHandleFromFd(int fd) const {
+	if (fd < 0 || static_cast<size_t>(fd) >= fdTable_.size())
+		return ClientHandle();
+	return fdTable_[static_cast<size_t>(fd)].client;
 }
 
 Client *Server::tryClientFromFd(int fd) {
-	int idx = clientIndexFromFd(fd);
-	return (idx >= 0) ? &clients_[static_cast<size_t>(idx)] : NULL;
+	return clients_.get(clientHandleFromFd(fd));
+}
+
+Client *Server::tryClientFromHandle(ClientHandle handle) {
+	return clients_.get(handle);
 }
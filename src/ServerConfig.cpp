@@ -0,0 +1,176 @@
+#include "../include/ServerConfig.hpp"
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
+#include <unistd.h>
+
+ServerConfig::ServerConfig()
+	: idleTrimSeconds(DEFAULT_IDLE_TRIM_SECONDS),
+	  memoryBudget(DEFAULT_MEMORY_BUDGET),
+	  stallBudgetMs(DEFAULT_STALL_BUDGET_MS),
+	  maxPerIp(DEFAULT_MAX_PER_IP),
+	  maxPerSubnet(DEFAULT_MAX_PER_SUBNET),
+	  connectRate(DEFAULT_CONNECT_RATE),
+	  acceptsPerLoop(DEFAULT_ACCEPTS_PER_LOOP),
+	  backlog(DEFAULT_BACKLOG),
+	  drainSeconds(DEFAULT_DRAIN_SECONDS),
+	  historyLength(DEFAULT_HISTORY_LENGTH),
+	  historyDiskLength(DEFAULT_HISTORY_DISK),
+	  historyDiskChannels(DEFAULT_HISTORY_FILES),
+	  upgradeFd(-1)
+{}
+
+// Parses a non-negative decimal number that must span the whole string
+static bool parseUnsigned(const std::string &value, unsigned long &out)
+{
+	if (value.empty() || value[0] == '-' || value[0] == '+')
+		return (false);
+	char	*end = NULL;
+	errno = 0;
+	out = std::strtoul(value.c_str(), &end, 10);
+	return (errno == 0 && *end == '\0');
+}
+
+bool ServerConfig::parseOption(const std::string &option)
+{
+	std::string::size_type eq = option.find('=');
+	if (option.compare(0, 2, "--") != 0 || eq == std::string::npos)
+		return (false);
+	const std::string	name = option.substr(2, eq - 2);
+	const std::string	value = option.substr(eq + 1);
+	unsigned long		number;
+
+	if (name == "idle-trim" && parseUnsigned(value, number)
+		&& number <= INT_MAX) {
+		idleTrimSeconds = static_cast<int>(number);
+		return (true);
+	}
+	if (name == "memory-budget" && parseUnsigned(value, number)) {
+		memoryBudget = number;
+		return (true);
+	}
+	if (name == "stall-budget" && parseUnsigned(value, number)
+		&& number <= UINT_MAX) {
+		stallBudgetMs = static_cast<unsigned>(number);
+		return (true);
+	}
+	if (name == "max-per-ip" && parseUnsigned(value, number)
+		&& number <= UINT_MAX) {
+		maxPerIp = static_cast<unsigned>(number);
+		return (true);
+	}
+	if (name == "max-per-subnet" && parseUnsigned(value, number)
+		&& number <= UINT_MAX) {
+		maxPerSubnet = static_cast<unsigned>(number);
+		return (true);
+	}
+	if (name == "connect-rate" && parseUnsigned(value, number)
+		&& number <= UINT_MAX) {
+		connectRate = static_cast<unsigned>(number);
+		return (true);
+	}
+	if (name == "accepts-per-loop" && parseUnsigned(value, number) && number
+		&& number <= UINT_MAX) {
+		acceptsPerLoop = static_cast<unsigned>(number);
+		return (true);
+	}
+	if (name == "backlog" && parseUnsigned(value, number) && number
+		&& number <= 65535) {
+		backlog = static_cast<int>(number);
+		return (true);
+	}
+	if (name == "drain-timeout" && parseUnsigned(value, number)
+		&& number <= UINT_MAX) {
+		drainSeconds = static_cast<unsigned>(number);
+		return (true);
+	}
+	if (name == "listen-fd" && parseUnsigned(value, number) && number > 2
+		&& number <= 65535) {
+		listenFds.push_back(static_cast<int>(number));
+		return (true);
+	}
+	if (name == "upgrade-fd" && parseUnsigned(value, number) && number > 2
+		&& number <= 65535) {
+		upgradeFd = static_cast<int>(number);
+		return (true);
+	}
+	if (name == "unix-socket" && !value.empty()) {
+		unixSocket = value;
+		return (true);
+	}
+	if (name == "state-dir" && !value.empty()) {
+		stateDir = value;
+		return (true);
+	}
+	if (name == "history-length" && parseUnsigned(value, number)
+		&& number <= 65536) {
+		historyLength = number;
+		return (true);
+	}
+	if (name == "history-dir" && !value.empty()) {
+		historyDir = value;
+		return (true);
+	}
+	if (name == "history-disk-length" && parseUnsigned(value, number) && number
+		&& number <= 1048576) {
+		historyDiskLength = number;
+		return (true);
+	}
+	// each one is a mapping, and vm.max_map_count is 65530 by default
+	if (name == "history-disk-channels" && parseUnsigned(value, number) && number
+		&& number <= 32768) {
+		historyDiskChannels = number;
+		return (true);
+	}
+	if (name == "admin-socket" && !value.empty()) {
+		adminSocket = value;
+		return (true);
+	}
+	return (false);
+}
+
+// First descriptor passed by socket activation (SD_LISTEN_FDS_START)
+#define LISTEN_FDS_START 3
+
+void ServerConfig::inheritListenFds()
+{
+	const char		*pid = std::getenv("LISTEN_PID");
+	const char		*fds = std::getenv("LISTEN_FDS");
+	unsigned long	 owner;
+	unsigned long	 count;
+	if (listenFds.empty() && pid && fds && parseUnsigned(pid, owner)
+		&& owner == static_cast<unsigned long>(getpid())
+		&& parseUnsigned(fds, count))
+	{
+		for (unsigned long i = 0; i < count && i < 65535; ++i)
+			listenFds.push_back(LISTEN_FDS_START + static_cast<int>(i));
+	}
+	unsetenv("LISTEN_PID");
+	unsetenv("LISTEN_FDS");
+	unsetenv("LISTEN_FDNAMES");
+}
+
+const char *ServerConfig::usage()
+{
+	return ("  --idle-trim=<seconds>     trim buffers of clients idle this long\n"
+			"  --memory-budget=<bytes>   trim regardless of idleness above this\n"
+			"  --admin-socket=<path>     serve metrics on this Unix socket\n"
+			"  --stall-budget=<ms>       report slower loop iterations, 0 = off\n"
+			"  --max-per-ip=<n>          open connections per address, 0 = off\n"
+			"  --max-per-subnet=<n>      per IPv4 /24 or IPv6 /64, 0 = off\n"
+			"  --connect-rate=<n>        connects per address per 10 s, 0 = off\n"
+			"  --accepts-per-loop=<n>    accept at most this many per iteration\n"
+			"  --backlog=<n>             listen backlog\n"
+			"  --drain-timeout=<s>       flush clients this long on shutdown\n"
+			"  --unix-socket=<path>      also accept local clients here\n"
+			"  --state-dir=<dir>         keep channel state here across restarts\n"
+			"  --history-length=<n>      lines of history per channel, 0 = off\n"
+			"  --history-dir=<dir>       also keep history on disk here\n"
+			"  --history-disk-length=<n> lines kept on disk per channel\n"
+			"  --history-disk-channels=<n> channels kept on disk at a time\n"
+			"  --listen-fd=<fd>          accept on this inherited listening\n"
+			"                            socket instead of binding <port>;\n"
+			"                            repeatable, LISTEN_FDS works too\n"
+			"  --upgrade-fd=<fd>         internal: take over from the server\n"
+			"                            that re-executed this one on SIGHUP\n");
+}
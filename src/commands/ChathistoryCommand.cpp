@@ -0,0 +1,286 @@
+#include "../../include/commands/ChathistoryCommand.hpp"
+#include "../../include/Debug.hpp"
+#include "../../include/MessageType.hpp"
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <sstream>
+
+// Default Constructor
+ChathistoryCommand::ChathistoryCommand( void ): Command()
+{
+	debug("Default Constructor called");
+}
+
+ChathistoryCommand::ChathistoryCommand(const Message& msg) : Command(msg)
+{}
+
+// Destructor
+ChathistoryCommand::~ChathistoryCommand()
+{
+	debug("Destructor called");
+}
+
+// Copy Constructor
+ChathistoryCommand::ChathistoryCommand(const ChathistoryCommand &copy): Command(copy)
+{}
+
+// Copy Assignment Operator
+ChathistoryCommand& ChathistoryCommand::operator=( const ChathistoryCommand &assign )
+{
+	if (this != &assign)
+	{
+		Command::operator=(assign);
+	}
+	return *this;
+}
+
+Command*	ChathistoryCommand::fromMessage(const Message& message)
+{
+	return new ChathistoryCommand(message);
+}
+
+void	ChathistoryCommand::fail(Client &sender, const std::string &code,
+								 const std::string &argument,
+								 const std::string &reason) const
+{
+	std::vector<std::string> params;
+	params.push_back("CHATHISTORY");
+	params.push_back(code);
+	params.push_back(inMessage_.getParams().empty() ? "*" : inMessage_.getParams()[0]);
+	if (!argument.empty())
+		params.push_back(argument);
+	params.push_back(reason);
+	Message reply("FAIL", params);
+	reply.setSource();
+	sender.sendMessage(reply);
+}
+
+bool	ChathistoryCommand::parseLimit(const std::string &text, uint64_t &out)
+{
+	if (text.empty() || text[0] < '0' || text[0] > '9')
+		return (false);
+	char	*end = NULL;
+	errno = 0;
+	const unsigned long limit = std::strtoul(text.c_str(), &end, 10);
+	if (errno || *end || !limit)
+		return (false);
+	out = limit < CHATHISTORY_LIMIT ? limit : CHATHISTORY_LIMIT;
+	return (true);
+}
+
+// msgid=<seq> as sent in the replay tags, or timestamp=YYYY-MM-DDThh:mm:ss[.sss]Z
+bool	ChathistoryCommand::parseReference(const std::string &text,
+										   const MessageHistory &history,
+										   Reference &out)
+{
+	if (text.compare(0, 6, "msgid=") == 0)
+	{
+		const std::string	number = text.substr(6);
+		char				*end = NULL;
+		if (number.empty() || number[0] < '0' || number[0] > '9')
+			return (false);
+		errno = 0;
+		const unsigned long seq = std::strtoul(number.c_str(), &end, 10);
+		if (errno || *end)
+			return (false);
+		out.before = seq;
+		out.after = static_cast<uint64_t>(seq) + 1;
+		return (true);
+	}
+	if (text.compare(0, 10, "timestamp=") != 0)
+		return (false);
+	struct tm	utc;
+	int			milliseconds = 0;
+	int			consumed = 0;
+	std::memset(&utc, 0, sizeof(utc));
+	const char	*stamp = text.c_str() + 10;
+	if (std::sscanf(stamp, "%4d-%2d-%2dT%2d:%2d:%2d%n", &utc.tm_year, &utc.tm_mon,
+					&utc.tm_mday, &utc.tm_hour, &utc.tm_min, &utc.tm_sec,
+					&consumed) != 6)
+		return (false);
+	stamp += consumed;
+	if (*stamp == '.')
+	{
+		if (std::sscanf(stamp, ".%3d%n", &milliseconds, &consumed) != 1)
+			return (false);
+		stamp += consumed;
+	}
+	if (std::strcmp(stamp, "Z") != 0)
+		return (false);
+	utc.tm_year -= 1900;
+	utc.tm_mon -= 1;
+	const time_t seconds = timegm(&utc);
+	if (seconds < 0)
+		return (false);
+	const uint64_t timeMs = static_cast<uint64_t>(seconds) * 1000u + milliseconds;
+	out.before = timeMs ? history.seqAfter(timeMs - 1) : history.first();
+	out.after = history.seqAfter(timeMs);
+	return (true);
+}
+
+/*
+https://ircv3.net/specs/extensions/chathistory
+	CHATHISTORY LATEST <target> <* | reference> <limit>
+	CHATHISTORY BEFORE <target> <reference> <limit>
+	CHATHISTORY AFTER <target> <reference> <limit>
+	CHATHISTORY AROUND <target> <reference> <limit>
+	CHATHISTORY BETWEEN <target> <reference> <reference> <limit>
+
+Only channels keep history, and only members may read it. Lines come back
+oldest first in a "chathistory" BATCH, each tagged with its time and msgid;
+there is no CAP negotiation, so asking is taken as accepting the tags.
+The batch is a HistoryStream, queued a chunk per loop iteration (see
+ReplyStream), so a large answer never trips the SendQ limit.
+
+    ERR_NOTREGISTERED (451)		=> done
+    ERR_NEEDMOREPARAMS (461)	=> done
+    FAIL UNKNOWN_COMMAND, INVALID_PARAMS, INVALID_TARGET, MESSAGE_ERROR
+*/
+void	ChathistoryCommand::execute(Server& server, Client& sender)
+{
+	const std::vector<std::string>	&inParams = inMessage_.getParams();
+	// 451
+	if (!sender.isAuthenticated())
+		return (sender.sendErrorMessage(ERR_NOTREGISTERED, sender.getNickname()));
+	// 461
+	if (inParams.size() < 4)
+		return (sender.sendErrorMessage(ERR_NEEDMOREPARAMS, sender.getNickname(), inMessage_.getType()));
+
+	const std::string	&subcommand = inParams[0];
+	const std::string	&target = inParams[1];
+	const bool			between = subcommand == "BETWEEN";
+	if (subcommand != "LATEST" && subcommand != "BEFORE" && subcommand != "AFTER"
+		&& subcommand != "AROUND" && !between)
+		return (fail(sender, "UNKNOWN_COMMAND", "", "Unknown command"));
+	if (between && inParams.size() < 5)
+		return (sender.sendErrorMessage(ERR_NEEDMOREPARAMS, sender.getNickname(), inMessage_.getType()));
+
+	const Channel	*channel = server.mapChannel(target);
+	if (!channel || !channel->isMember(sender.getNickname()))
+		return (fail(sender, "INVALID_TARGET", target, "Messages could not be retrieved"));
+	if (!MessageHistory::enabled())
+		return (fail(sender, "MESSAGE_ERROR", target, "History is disabled"));
+
+	const MessageHistory	&history = channel->getHistory();
+	uint64_t				limit;
+	Reference				reference;
+	Reference				other;
+	if (!parseLimit(inParams[between ? 4 : 3], limit)
+		|| (!(subcommand == "LATEST" && inParams[2] == "*")
+			&& !parseReference(inParams[2], history, reference))
+		|| (between && !parseReference(inParams[3], history, other)))
+		return (fail(sender, "INVALID_PARAMS", "", "Invalid parameters"));
+
+	// everything is worked out as [from, to) and clamped to what is kept
+	const uint64_t	first = history.first() ? history.first() : history.last() + 1;
+	const uint64_t	end = history.last() + 1;
+	uint64_t		from;
+	uint64_t		to;
+	if (subcommand == "LATEST")
+	{
+		to = end;
+		from = to > limit ? to - limit : 0;
+		if (inParams[2] != "*" && from < reference.after)
+			from = reference.after;
+	}
+	else if (subcommand == "BEFORE")
+	{
+		to = reference.before;
+		from = to > limit ? to - limit : 0;
+	}
+	else if (subcommand == "AFTER")
+	{
+		from = reference.after;
+		to = from + limit;
+	}
+	else if (subcommand == "AROUND")
+	{
+		from = reference.before > limit / 2 ? reference.before - limit / 2 : 0;
+		if (from < first)
+			from = first;
+		to = from + limit;
+	}
+	else if (reference.after <= other.before)
+	{
+		from = reference.after;
+		to = other.before < from + limit ? other.before : from + limit;
+	}
+	else
+	{
+		to = reference.before;
+		from = to > limit ? to - limit : 0;
+		if (from < other.after)
+			from = other.after;
+	}
+	if (from < first)
+		from = first;
+	if (to > end)
+		to = end;
+	if (to < from)
+		to = from;
+	if (!server.startStream(new HistoryStream(sender.getSocket(), channel->getName(), from, to)))
+		return (fail(sender, "MESSAGE_ERROR", target, "Too many history requests"));
+}
+
+unsigned long	HistoryStream::batches_ = 0;
+
+HistoryStream::HistoryStream(int fd, const std::string &channel, uint64_t from, uint64_t to)
+	: ReplyStream(fd), channel_(channel), next_(from), end_(to), started_(false)
+{
+	std::ostringstream batch;
+	batch << "h" << ++batches_;
+	batch_ = batch.str();
+}
+
+HistoryStream::~HistoryStream()
+{}
+
+// "@batch=<ref>;time=2024-01-31T12:00:00.000Z;msgid=<seq> ", prefixed to a
+// replayed line
+static std::string	replayTags(const std::string &batch, const HistoryLine &line)
+{
+	const time_t	seconds = static_cast<time_t>(line.timeMs / 1000);
+	struct tm		utc;
+	char			stamp[32];
+	gmtime_r(&seconds, &utc);
+	std::strftime(stamp, sizeof(stamp), "%Y-%m-%dT%H:%M:%S", &utc);
+	std::ostringstream tags;
+	tags << "@batch=" << batch << ";time=" << stamp << '.';
+	tags.width(3);
+	tags.fill('0');
+	tags << line.timeMs % 1000;
+	tags << "Z;msgid=" << line.seq << ' ';
+	return (tags.str());
+}
+
+StreamState	HistoryStream::pump(Server &server)
+{
+	if (!started_)
+	{
+		Message open("BATCH", "+" + batch_, std::string("chathistory"));
+		open.getParams().push_back(channel_);
+		open.setSource();
+		send(server, open.toString());
+		started_ = true;
+	}
+	const Channel	*channel = server.mapChannel(channel_);
+	if (channel)
+	{
+		const MessageHistory	&history = channel->getHistory();
+		HistoryLine				line;
+		while (next_ < end_ && hasRoom(server))
+		{
+			if (history.line(next_++, line))
+				send(server, replayTags(batch_, line) + line.wire);
+		}
+		if (next_ < end_)
+			return (STREAM_BLOCKED);
+	}
+	Message close("BATCH", "-" + batch_);
+	close.setSource();
+	send(server, close.toString());
+	return (STREAM_DONE);
+}
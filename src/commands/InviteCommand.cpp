@@ -73,11 +73,12 @@ void	InviteCommand::execute(Server& server, Client& sender)
 	if (channel->isMember(invitedClient))
 		return (sender.sendErrorMessage(ERR_USERONCHANNEL, sender.getNickname(), invitedClient, channelName));
 	// ERR_NOSUCHNICK (401)
-	CaseMappedString tmp(invitedClient);
-	if (!server.clientNickExists(tmp))
+	const Client *invited = server.findClientByNick(invitedClient);
+	if (!invited)
 		return (sender.sendErrorMessage(ERR_NOSUCHNICK, sender.getNickname(), invitedClient));
 	// ===> Success :)
 	channel->addToWhiteList(invitedClient);
+	server.getChannelJournal().invited(channel->getName(), invited->getHostmask(), true);
 	// RPL_INVITING (341)
 	sender.sendErrorMessage(RPL_INVITING, sender.getNickname(), invitedClient, channelName);
 	// sending the invitation !
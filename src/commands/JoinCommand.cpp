@@ -19,7 +19,7 @@ Command* JoinCommand::fromMessage(const Message& message)
     ERR_NOSUCHCHANNEL (403) 	=> done
     ERR_TOOMANYCHANNELS (405)	=> we ignore that...
     ERR_BADCHANNELKEY (475)		=> done
-    x ERR_BANNEDFROMCHAN (474)	=> we don't ban
+    ERR_BANNEDFROMCHAN (474)	=> done, an invitation or +e lets one in
     ERR_CHANNELISFULL (471)		=> done
     ERR_INVITEONLYCHAN (473)	=> done
     ERR_BADCHANMASK (476)		=> ???
@@ -56,15 +56,39 @@ void JoinCommand::execute(Server& server, Client& sender)
 			continue;
 		}
 		Channel *channel = (server.mapChannel(channelName)); 
-		// Creating a new channel
+		// Creating a new channel, or bringing back a saved one
 		if (!channel) {
-			// Insert without requiring default constructor
-			std::map<std::string, Channel> &chs = server.getChannels();
-			std::pair<std::map<std::string, Channel>::iterator, bool> ins =
-				chs.insert(std::make_pair(
-					channelName,
-					Channel(channelName, sender, server.getMessageQueueManager())));
-			channel = &ins.first->second;
+			ChannelState	  saved;
+			const bool		  restored = server.getChannelJournal().find(channelName, saved);
+			const std::string hostmask = sender.getHostmask();
+			const bool		  invited = restored && saved.invited.count(hostmask);
+			if (restored && !saved.key.empty() && key != saved.key)
+			{
+				sender.sendErrorMessage(ERR_BADCHANNELKEY, sender.getNickname(), channelName);
+				continue;
+			}
+			if (restored && !invited && saved.bans.matches(hostmask)
+				&& !saved.exceptions.matches(hostmask))
+			{
+				sender.sendErrorMessage(ERR_BANNEDFROMCHAN, sender.getNickname(), channelName);
+				continue;
+			}
+			if (restored && saved.inviteOnly && !invited
+				&& !saved.inviteExceptions.matches(hostmask))
+			{
+				sender.sendErrorMessage(ERR_INVITEONLYCHAN, sender.getNickname(), channelName);
+				continue;
+			}
+			channel = server.getChannels().insert(
+				Channel(restored ? saved.name : channelName, sender,
+						server.getMessageQueueManager()));
+			server.addToChannel(*channel, sender);
+			if (restored)
+				restoreChannel(*channel, saved, sender);
+			else
+				server.getChannelJournal().created(*channel, hostmask);
+			if (invited)
+				server.getChannelJournal().invited(channel->getName(), hostmask, false);
 			sendValidationMessages(sender, *channel);
 			continue;
 		}
@@ -80,8 +104,15 @@ void JoinCommand::execute(Server& server, Client& sender)
 			sender.sendErrorMessage(ERR_BADCHANNELKEY, sender.getNickname(), channelName);
 			continue;
 		}
+		// ERR_BANNEDFROMCHAN (474)
+		if (!channel->isWhiteListed(sender.getNickname()) && channel->isBanned(sender))
+		{
+			sender.sendErrorMessage(ERR_BANNEDFROMCHAN, sender.getNickname(), channelName);
+			continue;
+		}
 		// ERR_INVITEONLYCHAN (473)
-		if (channel->isInviteOnly() && !channel->isWhiteListed(sender.getNickname()))
+		if (channel->isInviteOnly() && !channel->isWhiteListed(sender.getNickname())
+			&& !channel->isInviteException(sender))
 		{
 			sender.sendErrorMessage(ERR_INVITEONLYCHAN, sender.getNickname(), channelName);
 			continue;
@@ -93,11 +124,43 @@ void JoinCommand::execute(Server& server, Client& sender)
 			continue;
 		}
 		// Success with adding member !
-		channel->addMember(&sender);
+		if (channel->isWhiteListed(sender.getNickname()))
+			server.getChannelJournal().invited(channel->getName(), sender.getHostmask(), false);
+		server.addToChannel(*channel, sender);
 		sendValidationMessages(sender, *channel);
 	}
 }
 
+// Saved operators and invitations are hostmasks, and only the restorer's
+// can be told apart from a stranger on the same nickname: they stay
+// operator if they were one, the others get nothing back.
+void JoinCommand::restoreChannel(Channel& channel, const ChannelState& saved,
+								 const Client& restorer)
+{
+	channel.setTopic(saved.topic);
+	channel.setTopicWho(saved.topicWho);
+	channel.setTopicTime(saved.topicTime);
+	channel.setCreationTime(saved.creationTime);
+	channel.setPassword(saved.key);
+	channel.setUserLimit(saved.limit);
+	channel.setInviteOnly(saved.inviteOnly);
+	channel.setTopicProtected(saved.topicProtected);
+	// its key and +i are back, so the lines they guarded are served again
+	channel.keepEarlierHistory();
+	if (!saved.operators.count(restorer.getHostmask()))
+		channel.removeOperator(restorer.getNickname());
+	const char	listModes[] = "beI";
+	for (size_t i = 0; listModes[i]; ++i)
+	{
+		const MaskList::Entries &entries = saved.maskList(listModes[i])->entries();
+		for (MaskList::Entries::const_iterator it = entries.begin(); it != entries.end(); ++it)
+			channel.addMask(listModes[i], it->second.mask, it->second.setter, it->second.setAt);
+	}
+	FloodLimit	flood;
+	if (flood.parse(saved.flood))
+		channel.setFloodLimit(flood);
+}
+
 void JoinCommand::sendValidationMessages(Client& sender, Channel& channel)
 {
 	sender.sendCmdValidation(inMessage_, channel);
@@ -110,17 +173,6 @@ void JoinCommand::sendValidationMessages(Client& sender, Channel& channel)
 
 void JoinCommand::sendValidationMessages_353_366(Client& sender, Channel& channel)
 {
-	// RPL_NAMREPLY (353) & RPL_ENDOFNAMES (366)
-	std::string memberList;
-	for (std::map<std::string, int>::const_iterator it = channel.getMembers().begin(); it != channel.getMembers().end(); ++it)
-	{
-		if (it->first != sender.getNickname())
-		{
-			if (channel.getOperators().find(it->first) != channel.getOperators().end())
-				memberList += "@";
-			memberList += it->first + " ";
-		}
-	}
-	sender.sendErrorMessage(RPL_NAMREPLY, sender.getNickname(), "=", channel.getName(), memberList);
-	sender.sendErrorMessage(RPL_ENDOFNAMES, sender.getNickname(), channel.getName());
+	// RPL_NAMREPLY (353) & RPL_ENDOFNAMES (366), from the channel's cache
+	channel.sendNames(sender);
 }
@@ -81,10 +81,10 @@ void	KickCommand::execute(Server& server, Client& sender)
 		if (inMessage_.getParams().size() == 2)
 			inMessage_.getParams().push_back("You have been kicked out (No reason provided)");
 		sender.sendCmdValidation(inMessage_, *channel);
-		// actually removing the targetClient
-		channel->removeMember(targetClient);
-		channel->removeFromWhiteList(targetClient);
-		channel->removeOperator(targetClient);
+		// actually removing the targetClient, the channel dies with its
+		// last member (an operator may kick themselves)
+		if (server.removeFromChannel(*channel, targetClient))
+			return ;
 	}
 }
 
@@ -0,0 +1,234 @@
+#include "../../include/commands/ListCommand.hpp"
+#include "../../include/Debug.hpp"
+#include "../../include/MessageType.hpp"
+#include <cerrno>
+#include <cstdlib>
+#include <sstream>
+
+// Default Constructor
+ListCommand::ListCommand( void ): Command()
+{
+	debug("Default Constructor called");
+}
+
+ListCommand::ListCommand(const Message& msg) : Command(msg)
+{}
+
+// Destructor
+ListCommand::~ListCommand()
+{
+	debug("Destructor called");
+}
+
+// Copy Constructor
+ListCommand::ListCommand(const ListCommand &copy): Command(copy)
+{}
+
+// Copy Assignment Operator
+ListCommand& ListCommand::operator=( const ListCommand &assign )
+{
+	if (this != &assign)
+	{
+		Command::operator=(assign);
+	}
+	return *this;
+}
+
+Command*	ListCommand::fromMessage(const Message& message)
+{
+	return new ListCommand(message);
+}
+
+/*
+    https://modern.ircdocs.horse/#list-message
+	LIST [<channel>{,<channel>}]	=> those channels
+	LIST <condition>{,<condition>}	=> ELIST filters, all of them apply:
+		>n, <n			more / fewer than n users
+		C>n, C<n		created more / less than n minutes ago
+		T>n, T<n		topic set more / less than n minutes ago
+		mask			channel name matching one of the masks
+		!mask			channel name matching none of these masks
+	LIST							=> every channel
+
+The answer is streamed (see ListStream), so listing 200k channels is
+spread over many loop iterations and never outgrows the send queue.
+Conditions that do not parse are ignored.
+
+    ERR_NOTREGISTERED (451)		=> done
+    RPL_LISTSTART (321)			=> done
+    RPL_LIST (322)				=> done
+    RPL_LISTEND (323)			=> done
+    RPL_TRYAGAIN (263)			=> too many streamed replies pending
+*/
+void	ListCommand::execute(Server& server, Client& sender)
+{
+	const std::vector<std::string>	&inParams = inMessage_.getParams();
+	// 451
+	if (!sender.isAuthenticated())
+		return (sender.sendErrorMessage(ERR_NOTREGISTERED, sender.getNickname()));
+
+	ListFilter	filter;
+	// with two parameters the second one names a server: this one
+	if (!inParams.empty())
+	{
+		const time_t		now = std::time(NULL);
+		std::stringstream	stream(inParams[0]);
+		std::string			condition;
+		while (std::getline(stream, condition, ','))
+			filter.parse(condition, now);
+	}
+	if (!server.startStream(new ListStream(sender.getSocket(), sender.getNickname(), filter)))
+		sender.sendErrorMessage(RPL_TRYAGAIN, sender.getNickname(), inMessage_.getType());
+}
+
+ListFilter::ListFilter()
+	: moreUsersThan(0), fewerUsersThan(static_cast<size_t>(-1)),
+	  createdAfter(0), createdBefore(0), topicAfter(0), topicBefore(0)
+{}
+
+// A decimal count; anything above max reads as max
+static bool	parseCount(const std::string &text, unsigned long max, unsigned long &out)
+{
+	if (text.empty() || text[0] < '0' || text[0] > '9')
+		return (false);
+	char	*end = NULL;
+	errno = 0;
+	out = std::strtoul(text.c_str(), &end, 10);
+	if (*end)
+		return (false);
+	if (errno == ERANGE || out > max)
+		out = max;
+	return (true);
+}
+
+bool	ListFilter::parse(const std::string &condition, time_t now)
+{
+	if (condition.empty())
+		return (false);
+	unsigned long	value;
+	if (condition[0] == '>' || condition[0] == '<')
+	{
+		if (!parseCount(condition.substr(1), static_cast<size_t>(-1), value))
+			return (false);
+		(condition[0] == '>' ? moreUsersThan : fewerUsersThan) = value;
+		return (true);
+	}
+	const char	kind = condition[0];
+	if (condition.size() > 1 && (condition[1] == '>' || condition[1] == '<')
+		&& (kind == 'C' || kind == 'c' || kind == 'T' || kind == 't'))
+	{
+		// no further back than the epoch, so the bound never goes negative
+		if (!parseCount(condition.substr(2), now / 60, value))
+			return (false);
+		time_t	bound = now - static_cast<time_t>(value) * 60;
+		// a bound at the epoch would read as unset: fine for "less than n
+		// minutes ago", which then lets everything through, but "more than
+		// n minutes ago" must still let nothing through
+		if (condition[1] == '>' && bound == 0)
+			bound = 1;
+		if (kind == 'C' || kind == 'c')
+			(condition[1] == '<' ? createdAfter : createdBefore) = bound;
+		else
+			(condition[1] == '<' ? topicAfter : topicBefore) = bound;
+		return (true);
+	}
+	if (condition[0] == '!')
+	{
+		if (condition.size() == 1)
+			return (false);
+		excluded.push_back(GlobMask(condition.substr(1)));
+		return (true);
+	}
+	masks.push_back(GlobMask(condition));
+	return (true);
+}
+
+// Cheapest conditions first: counts and times before the masks
+bool	ListFilter::matches(const Channel &channel) const
+{
+	const size_t	users = channel.getMembers().size();
+	if (users <= moreUsersThan || users >= fewerUsersThan)
+		return (false);
+	if ((createdAfter && channel.getCreationTime() <= createdAfter)
+		|| (createdBefore && channel.getCreationTime() >= createdBefore))
+		return (false);
+	if (topicAfter || topicBefore)
+	{
+		if (channel.getTopic().empty()
+			|| (topicAfter && channel.getTopicTime() <= topicAfter)
+			|| (topicBefore && channel.getTopicTime() >= topicBefore))
+			return (false);
+	}
+	for (size_t i = 0; i < excluded.size(); ++i)
+		if (excluded[i].matches(channel.getName()))
+			return (false);
+	if (masks.empty())
+		return (true);
+	for (size_t i = 0; i < masks.size(); ++i)
+		if (masks[i].matches(channel.getName()))
+			return (true);
+	return (false);
+}
+
+bool	ListFilter::namesOnly() const
+{
+	if (masks.empty())
+		return (false);
+	for (size_t i = 0; i < masks.size(); ++i)
+		if (!masks[i].isLiteral())
+			return (false);
+	return (true);
+}
+
+ListStream::ListStream(int fd, const std::string &requester, const ListFilter &filter)
+	: ReplyStream(fd), requester_(requester),
+	  prefix_(":" HOSTNAME " 322 " + requester + " "), filter_(filter),
+	  cursor_(0), started_(false)
+{}
+
+ListStream::~ListStream()
+{}
+
+StreamState	ListStream::pump(Server &server)
+{
+	if (!started_)
+	{
+		std::vector<std::string> params;
+		params.push_back(requester_);
+		params.push_back("Channel");
+		params.push_back("Users  Name");
+		Message start("321", params);
+		start.setSource();
+		send(server, start.toString());
+		started_ = true;
+	}
+	ChannelRegistry	&channels = server.getChannels();
+	if (filter_.namesOnly())
+	{
+		// a few names: look them up instead of walking the registry
+		for (size_t i = 0; i < filter_.masks.size(); ++i)
+		{
+			const Channel *channel = channels.find(filter_.masks[i].pattern());
+			if (channel && filter_.matches(*channel))
+				send(server, prefix_ + channel->getListEntry() + "\r\n");
+		}
+	}
+	else
+	{
+		for (size_t budget = LIST_SLICE; cursor_ < channels.slotCount(); ++cursor_, --budget)
+		{
+			if (!budget || !hasRoom(server))
+				return (hasRoom(server) ? STREAM_MORE : STREAM_BLOCKED);
+			const Channel *channel = channels.at(cursor_);
+			if (channel && filter_.matches(*channel))
+				send(server, prefix_ + channel->getListEntry() + "\r\n");
+		}
+	}
+	std::vector<std::string> params;
+	params.push_back(requester_);
+	params.push_back("End of /LIST");
+	Message end("323", params);
+	end.setSource();
+	send(server, end.toString());
+	return (STREAM_DONE);
+}
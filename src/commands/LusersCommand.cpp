@@ -0,0 +1,79 @@
+#include "../../include/commands/LusersCommand.hpp"
+#include "../../include/Debug.hpp"
+#include "../../include/IrcUtils.hpp"
+#include "../../include/Metrics.hpp"
+
+// Default Constructor
+LusersCommand::LusersCommand( void ): Command()
+{
+	debug("Default Constructor called");
+}
+
+LusersCommand::LusersCommand(const Message& msg) : Command(msg)
+{}
+
+// Destructor
+LusersCommand::~LusersCommand()
+{
+	debug("Destructor called");
+}
+
+// Copy Constructor
+LusersCommand::LusersCommand(const LusersCommand &copy): Command(copy)
+{}
+
+// Copy Assignment Operator
+LusersCommand& LusersCommand::operator=( const LusersCommand &assign )
+{
+	if (this != &assign)
+	{
+		Command::operator=(assign);
+	}
+	return *this;
+}
+
+Command*	LusersCommand::fromMessage(const Message& message)
+{
+	return new LusersCommand(message);
+}
+
+/*
+https://modern.ircdocs.horse/#lusers-message
+All numbers come from the metrics gauges; nothing is counted here.
+
+    ERR_NOTREGISTERED (451)		=> done
+    RPL_LUSERCLIENT (251)		=> done
+    RPL_LUSEROP (252)			=> never, there is no OPER
+    RPL_LUSERUNKNOWN (253)		=> done, when non-zero
+    RPL_LUSERCHANNELS (254)		=> done, when non-zero
+    RPL_LUSERME (255)			=> done
+    RPL_LOCALUSERS (265)		=> done
+    RPL_GLOBALUSERS (266)		=> done, same as local (single server)
+*/
+void	LusersCommand::execute(Server& server, Client& sender)
+{
+	const std::string	nickname = sender.getNickname();
+	// 451
+	if (!sender.isAuthenticated())
+		return (sender.sendErrorMessage(ERR_NOTREGISTERED, nickname));
+
+	const Metrics		&metrics = server.getMetrics();
+	const uint64_t		clients = metrics.get(METRIC_CLIENTS);
+	const std::string	users = toString(metrics.get(METRIC_USERS));
+	const std::string	maxUsers = toString(metrics.get(METRIC_USERS_MAX));
+	const uint64_t		unknown = clients - metrics.get(METRIC_USERS);
+	const uint64_t		channels = metrics.get(METRIC_CHANNELS);
+
+	sender.sendErrorMessage(RPL_LUSERCLIENT, nickname,
+		"There are " + users + " users and 0 invisible on 1 servers");
+	if (unknown)
+		sender.sendErrorMessage(RPL_LUSERUNKNOWN, nickname, toString(unknown));
+	if (channels)
+		sender.sendErrorMessage(RPL_LUSERCHANNELS, nickname, toString(channels));
+	sender.sendErrorMessage(RPL_LUSERME, nickname,
+		"I have " + toString(clients) + " clients and 0 servers");
+	sender.sendErrorMessage(RPL_LOCALUSERS, nickname, users, maxUsers,
+		"Current local users " + users + ", max " + maxUsers);
+	sender.sendErrorMessage(RPL_GLOBALUSERS, nickname, users, maxUsers,
+		"Current global users " + users + ", max " + maxUsers);
+}
@@ -1,6 +1,9 @@
 #include "../../include/commands/ModeCommand.hpp"
 #include "../../include/Debug.hpp"
+#include <cctype>
+#include <climits>
 #include <cstdlib>
+#include <ctime>
 #include <vector>
 #include "../../include/IrcUtils.hpp"
 // Default Constructor
@@ -64,10 +67,11 @@ void	ModeCommand::userMode(Server& server, Client& sender)
 	{
 		parameters.push_back(senderNick);
 		//RPL_UMODEIS
-		std::map<std::string, Channel> allChannels = server.getChannels();
-		for (std::map<std::string, Channel>::iterator channelIt = allChannels.begin(); channelIt != allChannels.end(); channelIt++)
+		const ChannelRegistry &allChannels = server.getChannels();
+		for (size_t slot = 0; slot < allChannels.slotCount(); ++slot)
 		{
-			if (channelIt->second.isOperator(senderNick))
+			const Channel *channel = allChannels.at(slot);
+			if (channel && channel->isOperator(senderNick))
 			{
 				parameters.push_back("+o");
 				break;
@@ -79,13 +83,30 @@ void	ModeCommand::userMode(Server& server, Client& sender)
 	return (sender.sendErrorMessage(ERR_UMODEUNKNOWNFLAG, NULL, 0));
 }
 
-void ModeCommand::processChannelModes(Client &sender, const std::string& modestring, 
+// Appends a change to applied: the mode string (applied[0], a sign only when
+// it flips) and its argument, if any
+static void	recordMode(std::vector<std::string> &applied, bool addMode, char mode,
+					   const std::string &argument = std::string())
+{
+	std::string	&modes = applied[0];
+	const char	sign = addMode ? '+' : '-';
+	const std::string::size_type lastSign = modes.find_last_of("+-");
+	if (lastSign == std::string::npos || modes[lastSign] != sign)
+		modes += sign;
+	modes += mode;
+	if (!argument.empty())
+		applied.push_back(argument);
+}
+
+void ModeCommand::processChannelModes(Server &server, Client &sender,
+						 const std::string& modestring,
 						 const std::vector<std::string>& parameters,
-						 Channel* channel)
+						 Channel* channel, std::vector<std::string> &applied)
 {
 	bool addMode = true;
 	size_t	paramIndex = 2;
 	std::string	senderNick = sender.getNickname();
+	ChannelJournal	&journal = server.getChannelJournal();
 	for (std::string::const_iterator cIt = modestring.begin(); cIt != modestring.end(); cIt++) {
 		switch (*cIt) {
 			case '+':
@@ -95,10 +116,18 @@ void ModeCommand::processChannelModes(Client &sender, const std::string& modestr
 				addMode = false;
 				break;
 			case 'i': // Invite-only flag
+				if (channel->isInviteOnly() == addMode)
+					break;
 				channel->setInviteOnly(addMode);
+				journal.modeChanged(channel->getName(), 'i', addMode, "");
+				recordMode(applied, addMode, 'i');
 				break;
 			case 't': // Topic protection flag
+				if (channel->isTopicProtected() == addMode)
+					break;
 				channel->setTopicProtected(addMode);
+				journal.modeChanged(channel->getName(), 't', addMode, "");
+				recordMode(applied, addMode, 't');
 				break;
 			case 'k': // Channel key (password)
 				if (addMode) {
@@ -109,36 +138,94 @@ void ModeCommand::processChannelModes(Client &sender, const std::string& modestr
 					else // ERR_NEEDMOREPARAMS (461)
 						return (sender.sendErrorMessage(ERR_NEEDMOREPARAMS, sender.getNickname(), inMessage_.getType()));
 				}
+				else if (channel->getPassword().empty())
+					break;
 				else
 					channel->setPassword("");
+				journal.modeChanged(channel->getName(), 'k', addMode, channel->getPassword());
+				recordMode(applied, addMode, 'k', addMode ? channel->getPassword() : "*");
 				break;
 				
 			case 'l': // User limit
 				if (addMode) {
-					if (paramIndex < parameters.size()) {
-						char * endptr;
-						channel->setUserLimit(std::strtol(parameters[paramIndex++].c_str(), &endptr, 10));
-					}
-					else // ERR_NEEDMOREPARAMS (461)
+					if (paramIndex >= parameters.size()) // ERR_NEEDMOREPARAMS (461)
 						return (sender.sendErrorMessage(ERR_NEEDMOREPARAMS, sender.getNickname(), inMessage_.getType()));
+					const std::string	&value = parameters[paramIndex++];
+					char				*endptr;
+					const long			limit = std::strtol(value.c_str(), &endptr, 10);
+					if (value.empty() || !std::isdigit(static_cast<unsigned char>(value[0]))
+						|| *endptr || limit <= 0 || limit > INT_MAX) // ERR_INVALIDMODEPARAM (696)
+						return (sender.sendErrorMessage(ERR_INVALIDMODEPARAM, sender.getNickname(), channel->getName(), "l", value));
+					if (channel->getUserLimit() == limit)
+						break;
+					channel->setUserLimit(static_cast<int>(limit));
+				} else if (!channel->getUserLimit()) {
+					break;
 				} else {
 					channel->setUserLimit(0); // Disable user limit
 				}
+				journal.modeChanged(channel->getName(), 'l', addMode, toString(channel->getUserLimit()));
+				recordMode(applied, addMode, 'l', addMode ? toString(channel->getUserLimit()) : "");
 				break;
 				
 			case 'o': // Channel operator status
 				if (paramIndex < parameters.size()) {
+					const std::string	&target = parameters[paramIndex++];
+					// ERR_USERNOTINCHANNEL (441)
+					if (!channel->isMember(target)) {
+						sender.sendErrorMessage(ERR_USERNOTINCHANNEL, sender.getNickname(), target, channel->getName());
+						break;
+					}
+					if (channel->isOperator(target) == addMode)
+						break;
+					// journaled by hostmask, so that taking the nickname
+					// after a restart does not take the status with it
+					const Client		*targetClient = server.findClientByNick(target);
+					if (targetClient)
+						journal.modeChanged(channel->getName(), 'o', addMode, targetClient->getHostmask());
+					recordMode(applied, addMode, 'o', target);
 					if (addMode) {
-						channel->addOperator(parameters[paramIndex++]);
+						channel->addOperator(target);
 					} else {
-						channel->removeOperator(parameters[paramIndex++]);
+						channel->removeOperator(target);
 					}
-					paramIndex++;
 				}
 				else // ERR_NEEDMOREPARAMS (461)
 					return (sender.sendErrorMessage(ERR_NEEDMOREPARAMS, sender.getNickname(), inMessage_.getType()));
 				break;
 				
+			case 'f': // Flood protection, see FloodLimit
+				if (addMode) {
+					if (paramIndex >= parameters.size()) // ERR_NEEDMOREPARAMS (461)
+						return (sender.sendErrorMessage(ERR_NEEDMOREPARAMS, sender.getNickname(), inMessage_.getType()));
+					FloodLimit	limit;
+					if (!limit.parse(parameters[paramIndex])) // ERR_INVALIDMODEPARAM (696)
+						return (sender.sendErrorMessage(ERR_INVALIDMODEPARAM, sender.getNickname(), channel->getName(), "f", parameters[paramIndex]));
+					++paramIndex;
+					channel->setFloodLimit(limit);
+				}
+				else if (!channel->getFloodLimit().isSet())
+					break;
+				else
+					channel->setFloodLimit(FloodLimit());
+				journal.modeChanged(channel->getName(), 'f', addMode, channel->getFloodLimit().toString());
+				recordMode(applied, addMode, 'f', channel->getFloodLimit().toString());
+				break;
+
+			case 'b': // Ban
+			case 'e': // Ban exception
+			case 'I': // Invite exception
+				// a list mode without a mask asks for the list
+				if (paramIndex < parameters.size())
+				{
+					const std::string	mask = MaskList::normalize(parameters[paramIndex++]);
+					if (updateMask(server, sender, *channel, *cIt, addMode, mask))
+						recordMode(applied, addMode, *cIt, mask);
+				}
+				else
+					listMasks(server, sender, *channel, *cIt);
+				break;
+
 			default: // unkwown modes
 				sender.sendErrorMessage(ERR_UNKNOWNMODE, sender.getNickname(), inMessage_.getType(), std::string(1, *cIt));
 				return;
@@ -146,6 +233,38 @@ void ModeCommand::processChannelModes(Client &sender, const std::string& modestr
 	}
 }
 
+bool	ModeCommand::updateMask(Server &server, Client &sender, Channel &channel,
+								char mode, bool addMode, const std::string &mask)
+{
+	if (addMode)
+	{
+		// ERR_BANLISTFULL (478)
+		if (channel.getMaskList(mode)->full())
+		{
+			sender.sendErrorMessage(ERR_BANLISTFULL, sender.getNickname(), channel.getName(), std::string(1, mode));
+			return (false);
+		}
+		const MaskList::Entry	entry(mask, sender.getNickname(), std::time(NULL));
+		if (!channel.addMask(mode, entry.mask, entry.setter, entry.setAt))
+			return (false);
+		server.getChannelJournal().maskChanged(channel.getName(), mode, true, entry);
+		return (true);
+	}
+	if (!channel.removeMask(mode, mask))
+		return (false);
+	server.getChannelJournal().maskChanged(channel.getName(), mode, false, MaskList::Entry(mask, "", 0));
+	return (true);
+}
+
+// Lists run to MASKLIST_LIMIT lines, more than a send queue holds
+void	ModeCommand::listMasks(Server &server, Client &sender, const Channel &channel,
+							   char mode)
+{
+	if (!server.startStream(new MaskListStream(sender.getSocket(), sender.getNickname(),
+											   channel.getName(), mode)))
+		sender.sendErrorMessage(RPL_TRYAGAIN, sender.getNickname(), inMessage_.getType());
+}
+
 /*
 If <target> is a channel that does not exist on the network, the
 ERR_NOSUCHCHANNEL (403) numeric is returned.
@@ -168,6 +287,14 @@ server is done processing the modes, a MODE command is sent to all members of
 the channel containing the mode changes. Servers MAY choose to hide sensitive
 information when sending the mode changes.
  */
+// "b", "+e" and the like only read a list, so anyone may send them
+static bool	isListQuery(const std::string &modestring)
+{
+	const std::string	mode = (!modestring.empty() && modestring[0] == '+')
+		? modestring.substr(1) : modestring;
+	return (mode == "b" || mode == "e" || mode == "I");
+}
+
 void	ModeCommand::channelMode(Server& server, Client& sender)
 {
 	std::vector<std::string>	parameters = inMessage_.getParams();
@@ -200,6 +327,9 @@ void	ModeCommand::channelMode(Server& server, Client& sender)
 		int	channelLimit = channel->getUserLimit();
 		if (channelLimit)
 			modetypes += "l";
+		const std::string	flood = channel->getFloodLimit().toString();
+		if (!flood.empty())
+			modetypes += "f";
 		if (modetypes.size() > 1)
 		{
 			parameters.push_back(modetypes);
@@ -207,17 +337,26 @@ void	ModeCommand::channelMode(Server& server, Client& sender)
 				parameters.push_back(channelPassword);
 			if (channelLimit)
 				parameters.push_back(toString(channelLimit));
+			if (!flood.empty())
+				parameters.push_back(flood);
 		}
 		sender.sendErrorMessage(RPL_CHANNELMODEIS, parameters);
 		sender.sendErrorMessage(RPL_CREATIONTIME, sender.getNickname(), channel->getName(), toString(channel->getCreationTime()));
 	}
+	else if (parameters.size() == 2 && isListQuery(parameters[1]))
+		listMasks(server, sender, *channel, parameters[1][parameters[1].size() - 1]);
 	else
 	{
 		if (!channel->isOperator(nickname))
-			sender.sendErrorMessage(ERR_CHANOPRIVSNEEDED, sender.getNickname(), channelName);
-		// set Channel Modes, may ERR_NEEDMOREPARAMS
-		processChannelModes(sender, parameters[1], parameters, channel);
-		sender.sendCmdValidation(inMessage_, *channel); // TODO: make it robust to wrong input ?
+			return (sender.sendErrorMessage(ERR_CHANOPRIVSNEEDED, sender.getNickname(), channelName));
+		// set Channel Modes, may ERR_NEEDMOREPARAMS; what was applied up to
+		// there goes to the channel, with masks as they were stored
+		std::vector<std::string>	applied(1, std::string());
+		processChannelModes(server, sender, parameters[1], parameters, channel, applied);
+		if (applied[0].empty())
+			return ;
+		applied.insert(applied.begin(), channel->getName());
+		sender.sendCmdValidation(Message("MODE", applied), *channel);
 	}
 }
 
@@ -225,7 +364,7 @@ void	ModeCommand::channelMode(Server& server, Client& sender)
 https://modern.ircdocs.horse/#mode-message
  Parameters: <target> [<modestring> [<mode arguments>...]]
  target is nickname of self of #channel
- modestring are  [-+] followed by [itkol]
+ modestring are  [-+] followed by [itkolbeIf]
 */
 void	ModeCommand::execute(Server& server, Client& sender)
 {
@@ -240,3 +379,52 @@ void	ModeCommand::execute(Server& server, Client& sender)
 	return (userMode(server, sender));
 }
 
+
+MaskListStream::MaskListStream(int fd, const std::string &requester,
+							   const std::string &channel, char mode)
+	: ReplyStream(fd), requester_(requester), channel_(channel), mode_(mode),
+	  started_(false)
+{}
+
+MaskListStream::~MaskListStream()
+{}
+
+StreamState	MaskListStream::pump(Server &server)
+{
+	// entry and end numerics of RPL_BANLIST, RPL_EXCEPTLIST, RPL_INVITELIST
+	const char	*entryType = mode_ == 'b' ? "367" : mode_ == 'e' ? "348" : "346";
+	const char	*endType = mode_ == 'b' ? "368" : mode_ == 'e' ? "349" : "347";
+	const char	*endText = mode_ == 'b' ? "End of channel ban list"
+		: mode_ == 'e' ? "End of channel exception list" : "End of channel invite list";
+	const Channel	*channel = server.mapChannel(channel_);
+	if (channel)
+	{
+		const MaskList::Entries				&entries = channel->getMaskList(mode_)->entries();
+		MaskList::Entries::const_iterator	it = started_
+			? entries.upper_bound(last_) : entries.begin();
+		started_ = true;
+		for (; it != entries.end(); ++it)
+		{
+			if (!hasRoom(server))
+				return (STREAM_BLOCKED);
+			last_ = it->first;
+			std::vector<std::string> params;
+			params.push_back(requester_);
+			params.push_back(channel->getName());
+			params.push_back(it->second.mask);
+			params.push_back(it->second.setter);
+			params.push_back(toString(it->second.setAt));
+			Message line(entryType, params);
+			line.setSource();
+			send(server, line.toString());
+		}
+	}
+	std::vector<std::string> params;
+	params.push_back(requester_);
+	params.push_back(channel_);
+	params.push_back(endText);
+	Message end(endType, params);
+	end.setSource();
+	send(server, end.toString());
+	return (STREAM_DONE);
+}
@@ -0,0 +1,183 @@
+#include "../../include/commands/MonitorCommand.hpp"
+#include "../../include/Debug.hpp"
+#include "../../include/MonitorRegistry.hpp"
+#include <sstream>
+
+// Default Constructor
+MonitorCommand::MonitorCommand( void ): Command()
+{
+	debug("Default Constructor called");
+}
+
+MonitorCommand::MonitorCommand(const Message& msg) : Command(msg)
+{}
+
+// Destructor
+MonitorCommand::~MonitorCommand()
+{
+	debug("Destructor called");
+}
+
+// Copy Constructor
+MonitorCommand::MonitorCommand(const MonitorCommand &copy): Command(copy)
+{}
+
+// Copy Assignment Operator
+MonitorCommand& MonitorCommand::operator=( const MonitorCommand &assign )
+{
+	if (this != &assign)
+	{
+		Command::operator=(assign);
+	}
+	return *this;
+}
+
+Command*	MonitorCommand::fromMessage(const Message& message)
+{
+	return new MonitorCommand(message);
+}
+
+void	MonitorCommand::sendTargets(Client& sender, MessageType type,
+									const std::vector<std::string> &targets)
+{
+	std::string	line;
+	for (size_t i = 0; i < targets.size(); ++i)
+	{
+		if (!line.empty() && line.size() + 1 + targets[i].size() > MONITOR_REPLY_TARGETS)
+		{
+			sender.sendErrorMessage(type, sender.getNickname(), line);
+			line.clear();
+		}
+		if (!line.empty())
+			line += ",";
+		line += targets[i];
+	}
+	if (!line.empty())
+		sender.sendErrorMessage(type, sender.getNickname(), line);
+}
+
+// Online targets as nick!user@host, the others as given
+static void	splitByPresence(Server& server, const std::vector<std::string> &targets,
+							std::vector<std::string> &online,
+							std::vector<std::string> &offline)
+{
+	for (size_t i = 0; i < targets.size(); ++i)
+	{
+		const Client *client = server.findClientByNick(targets[i]);
+		if (client && client->isAuthenticated())
+			online.push_back(client->getNickname() + "!" + client->getUsername()
+							 + "@" + client->getIP());
+		else
+			offline.push_back(targets[i]);
+	}
+}
+
+void	MonitorCommand::add(Server& server, Client& sender, const std::string &targets)
+{
+	MonitorRegistry				&monitors = server.getMonitors();
+	std::vector<std::string>	added;
+	std::stringstream			stream(targets);
+	std::string					target;
+	while (std::getline(stream, target, ','))
+	{
+		if (target.empty())
+			continue;
+		if (!monitors.watch(sender.getSocket(), target))
+		{
+			std::string	rest = target;
+			while (std::getline(stream, target, ','))
+				if (!target.empty())
+					rest += "," + target;
+			std::ostringstream limit;
+			limit << MONITOR_LIMIT;
+			sender.sendErrorMessage(ERR_MONLISTFULL, sender.getNickname(), limit.str(), rest);
+			break;
+		}
+		added.push_back(target);
+	}
+	std::vector<std::string>	online;
+	std::vector<std::string>	offline;
+	splitByPresence(server, added, online, offline);
+	sendTargets(sender, RPL_MONONLINE, online);
+	sendTargets(sender, RPL_MONOFFLINE, offline);
+}
+
+void	MonitorCommand::remove(Server& server, Client& sender, const std::string &targets)
+{
+	std::stringstream	stream(targets);
+	std::string			target;
+	while (std::getline(stream, target, ','))
+		server.getMonitors().unwatch(sender.getSocket(), target);
+}
+
+void	MonitorCommand::list(Server& server, Client& sender)
+{
+	const MonitorRegistry::WatchList	*watched = server.getMonitors().list(sender.getSocket());
+	std::vector<std::string>			targets;
+	if (watched)
+		for (MonitorRegistry::WatchList::const_iterator it = watched->begin();
+			 it != watched->end(); ++it)
+			targets.push_back(it->second);
+	sendTargets(sender, RPL_MONLIST, targets);
+	sender.sendErrorMessage(RPL_ENDOFMONLIST, sender.getNickname());
+}
+
+void	MonitorCommand::status(Server& server, Client& sender)
+{
+	const MonitorRegistry::WatchList	*watched = server.getMonitors().list(sender.getSocket());
+	if (!watched)
+		return;
+	std::vector<std::string>	targets;
+	for (MonitorRegistry::WatchList::const_iterator it = watched->begin();
+		 it != watched->end(); ++it)
+		targets.push_back(it->second);
+	std::vector<std::string>	online;
+	std::vector<std::string>	offline;
+	splitByPresence(server, targets, online, offline);
+	sendTargets(sender, RPL_MONONLINE, online);
+	sendTargets(sender, RPL_MONOFFLINE, offline);
+}
+
+/*
+https://ircv3.net/specs/extensions/monitor
+	MONITOR + target[,target2]*		=> watch, answered with 730/731
+	MONITOR - target[,target2]*		=> stop watching, no answer
+	MONITOR C						=> clear the list
+	MONITOR L						=> 732 lines, then 733
+	MONITOR S						=> 730/731 for the whole list
+
+Watchers are then told of registrations, NICK changes and quits as they
+happen (see Server::notifyMonitors), so nobody has to poll.
+
+    ERR_NOTREGISTERED (451)		=> done
+    ERR_NEEDMOREPARAMS (461)	=> done
+    RPL_MONONLINE (730)			=> done
+    RPL_MONOFFLINE (731)		=> done
+    RPL_MONLIST (732)			=> done
+    RPL_ENDOFMONLIST (733)		=> done
+    ERR_MONLISTFULL (734)		=> done, MONITOR_LIMIT targets per client
+*/
+void	MonitorCommand::execute(Server& server, Client& sender)
+{
+	const std::vector<std::string>	&inParams = inMessage_.getParams();
+	// 451
+	if (!sender.isAuthenticated())
+		return (sender.sendErrorMessage(ERR_NOTREGISTERED, sender.getNickname()));
+	// 461
+	if (inParams.empty() || inParams[0].empty())
+		return (sender.sendErrorMessage(ERR_NEEDMOREPARAMS, sender.getNickname(), inMessage_.getType()));
+
+	const std::string	&modifier = inParams[0];
+	if ((modifier == "+" || modifier == "-") && inParams.size() < 2)
+		return (sender.sendErrorMessage(ERR_NEEDMOREPARAMS, sender.getNickname(), inMessage_.getType()));
+	if (modifier == "+")
+		add(server, sender, inParams[1]);
+	else if (modifier == "-")
+		remove(server, sender, inParams[1]);
+	else if (modifier == "C" || modifier == "c")
+		server.getMonitors().clear(sender.getSocket());
+	else if (modifier == "L" || modifier == "l")
+		list(server, sender);
+	else if (modifier == "S" || modifier == "s")
+		status(server, sender);
+}
@@ -0,0 +1,42 @@
+#include "../../include/commands/NamesCommand.hpp"
+#include "../../include/MessageType.hpp"
+
+#include <sstream>
+
+NamesCommand::NamesCommand(const Message& msg) : JoinCommand(msg)
+{}
+
+Command* NamesCommand::fromMessage(const Message& message)
+{
+	return new NamesCommand(message);
+}
+/*
+    https://modern.ircdocs.horse/#names-message
+
+    ERR_NOTREGISTERED (451)		=> done
+    RPL_NAMREPLY (353)			=> done
+    RPL_ENDOFNAMES (366)		=> done, alone for unknown channels
+	NAMES without channels		=> only RPL_ENDOFNAMES for "*"
+*/
+void NamesCommand::execute(Server& server, Client& sender)
+{
+	std::vector<std::string> inParams = inMessage_.getParams();
+	// 451
+	if (!sender.isAuthenticated())
+		return (sender.sendErrorMessage(ERR_NOTREGISTERED, sender.getNickname()));
+	if (inParams.empty())
+		return (sender.sendErrorMessage(RPL_ENDOFNAMES, sender.getNickname(), "*"));
+
+	std::stringstream	channelStream(inParams[0]);
+	std::string			channelName;
+	while (std::getline(channelStream, channelName, ','))
+	{
+		Channel *channel = server.mapChannel(channelName);
+		if (!channel)
+		{
+			sender.sendErrorMessage(RPL_ENDOFNAMES, sender.getNickname(), channelName);
+			continue;
+		}
+		sendValidationMessages_353_366(sender, *channel);
+	}
+}
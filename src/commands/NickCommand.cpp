@@ -48,27 +48,33 @@ void NickCommand::execute(Server& server, Client& sender)
 	std::string oldNick = sender.getNickname();
 	if (!isRegistration)
 	{
-		// loop through all channels
-		std::map<std::string, Channel> &channels_ = server.getChannels();
-		for (std::map<std::string, Channel>::iterator cMapIter =
-				 channels_.begin(); cMapIter != channels_.end(); ++cMapIter) {
-			Channel &ch = cMapIter->second;
-			if (ch.isMember(oldNick))
+		// loop through the sender's channels
+		const std::vector<std::string> &joined = server.channelsOf(sender.getSocket());
+		for (size_t i = 0; i < joined.size(); ++i) {
+			Channel *ch = server.mapChannel(joined[i]);
+			if (ch)
 			{
 				//broadcast to the channel the nick change
-				sender.sendCmdValidation(inMessage_, ch);
+				sender.sendCmdValidation(inMessage_, *ch);
 				// changes the nick in the channel's internal data structure
-				ch.changeNick(oldNick, inParams[0]);
+				ch->changeNick(oldNick, inParams[0]);
 			}
 		}
 	}
-	sender.setNickname(inParams[0]);
+	server.setNickname(sender, inParams[0]);
 	if (isRegistration && sender.isAuthenticated())
 		sender.welcome(server);
+	else if (!isRegistration && sender.isAuthenticated())
+	{
+		server.notifyMonitors(oldNick, NULL);
+		server.notifyMonitors(inParams[0], &sender);
+	}
 	return;
 }
 bool	NickCommand::checkNickFormat(std::string nickname)
 {
+	if (nickname.empty() || nickname.size() > NICKLEN) // stored inline, see Client.hpp
+		return (true);
 	if (nickname[0] == '#' //handling only public channels in general
 	|| nickname[0] == ':')
 		return (true);
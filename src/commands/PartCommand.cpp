@@ -0,0 +1,80 @@
+#include "../../include/commands/PartCommand.hpp"
+#include "../../include/Debug.hpp"
+#include <sstream>
+// Default Constructor
+PartCommand::PartCommand( void ): Command()
+{
+	debug("Default Constructor called");
+}
+
+PartCommand::PartCommand(const Message& msg) : Command(msg)
+{}
+
+// Destructor
+PartCommand::~PartCommand()
+{
+	debug("Destructor called");
+}
+
+// Copy Constructor
+PartCommand::PartCommand(const PartCommand &copy): Command(copy)
+{}
+
+// Copy Assignment Operator
+PartCommand& PartCommand::operator=( const PartCommand &assign )
+{
+	if (this != &assign)
+	{
+		Command::operator=(assign);
+	}
+	return *this;
+}
+
+Command*	PartCommand::fromMessage(const Message& message)
+{
+	return new PartCommand(message);
+}
+
+/*
+https://modern.ircdocs.horse/#part-message
+ERR_NEEDMOREPARAMS (461)	=> done
+ERR_NOSUCHCHANNEL (403)		=> done
+ERR_NOTONCHANNEL (442)		=> done
+the last member leaving destroys the channel
+*/
+void	PartCommand::execute(Server& server, Client& sender)
+{
+	std::vector<std::string> inParams = inMessage_.getParams();
+
+	// 451
+	if (!sender.isAuthenticated())
+		return (sender.sendErrorMessage(ERR_NOTREGISTERED, sender.getNickname()));
+	// 461
+	if (inParams.size() < 1)
+		return (sender.sendErrorMessage(ERR_NEEDMOREPARAMS, sender.getNickname(), inMessage_.getType()));
+
+	std::stringstream	channelStream(inParams[0]);
+	std::string			channelName;
+	while (std::getline(channelStream, channelName, ','))
+	{
+		Channel *channel = server.mapChannel(channelName);
+		// 403
+		if (!channel)
+		{
+			sender.sendErrorMessage(ERR_NOSUCHCHANNEL, sender.getNickname(), channelName);
+			continue;
+		}
+		// 442
+		if (!channel->isMember(sender.getNickname()))
+		{
+			sender.sendErrorMessage(ERR_NOTONCHANNEL, sender.getNickname(), channelName);
+			continue;
+		}
+		// ===> Success :)
+		// one PART per channel, so the echo names only that channel
+		Message	partMessage(inMessage_);
+		partMessage.getParams()[0] = channel->getName();
+		sender.sendCmdValidation(partMessage, *channel);
+		server.removeFromChannel(*channel, sender.getNickname());
+	}
+}
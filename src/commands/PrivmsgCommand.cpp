@@ -2,6 +2,7 @@
 #include "../../include/MessageType.hpp"
 #include "../../include/Channel.hpp"
 #include <cstdlib>
+#include <ctime>
 #include <sstream>
 
 PrivmsgCommand::PrivmsgCommand(const Message& msg) : Command(msg)
@@ -12,19 +13,47 @@ Command* PrivmsgCommand::fromMessage(const Message& message)
 	return new PrivmsgCommand(message);
 }
 
+// The server kicks, so no operator has to be around
+void	PrivmsgCommand::floodKick(Server& server, Channel& channel, const Client& sender)
+{
+	std::vector<std::string> params;
+	params.push_back(channel.getName());
+	params.push_back(sender.getNickname());
+	params.push_back("Flooding (+f)");
+	Message kick("KICK", params);
+	kick.setSource();
+	channel.broadcastMsg(std::string(), kick);
+	server.removeFromChannel(channel, sender.getNickname());
+}
+
 void	PrivmsgCommand::privmsgRecipient(std::string recipient, Server& server, Client& sender)
 {
 	bool	messageSentSuccessfully = false;
 	if (recipient[0] == '#')
 	{
-		const Channel *recipientChannel = server.mapChannel(recipient); 
+		Channel *recipientChannel = server.mapChannel(recipient); 
 		if (recipientChannel)
 		{
 			if (!recipientChannel->isMember(sender.getNickname()))
 				return (sender.sendErrorMessage(ERR_CANNOTSENDTOCHAN, sender.getNickname(), recipient));
+			// banned members stay but are muted; operators never are
+			if (recipientChannel->isBannedMember(sender) && !recipientChannel->isOperator(sender.getNickname()))
+				return (sender.sendErrorMessage(ERR_CANNOTSENDTOCHAN, sender.getNickname(), recipient));
+			// +f, before anything is built for the members
+			switch (recipientChannel->admitLine(sender, std::time(NULL)))
+			{
+				case FLOOD_DROPPED:
+					return ;
+				case FLOOD_REFUSED:
+					return (sender.sendErrorMessage(ERR_CANNOTSENDFLOOD, sender.getNickname(), recipient));
+				case FLOOD_KICKED:
+					return (floodKick(server, *recipientChannel, sender));
+				default:
+					break;
+			}
 			inMessage_.setSource(sender);
 			messageSentSuccessfully = true;
-			recipientChannel->broadcastMsg(sender, inMessage_);
+			recipientChannel->broadcastAndRecord(sender, inMessage_);
 		}
 		else
 			return (sender.sendErrorMessage(ERR_NOSUCHCHANNEL, sender.getNickname(), recipient));
@@ -38,7 +67,7 @@ void	PrivmsgCommand::privmsgRecipient(std::string recipient, Server& server, Cli
 /*
     https://modern.ircdocs.horse/#privmsg-message
 	ERR_NOSUCHNICK = 401, x
-	ERR_CANNOTSENDTOCHAN = 404, TODO:
+	ERR_CANNOTSENDTOCHAN = 404, x not a member, banned (+b) or flooding (+f)
 	ERR_NORECIPIENT = 411, x
 	ERR_NOTEXTTOSEND = 412, x
 	RPL_AWAY = 301 // not doing that one anymore, doesn't make sense, as we don't register users
@@ -0,0 +1,109 @@
+#include "../../include/commands/StatsCommand.hpp"
+#include "../../include/Debug.hpp"
+#include "../../include/IrcUtils.hpp"
+#include "../../include/Metrics.hpp"
+#include <cstdio>
+#include <ctime>
+
+// Default Constructor
+StatsCommand::StatsCommand( void ): Command()
+{
+	debug("Default Constructor called");
+}
+
+StatsCommand::StatsCommand(const Message& msg) : Command(msg)
+{}
+
+// Destructor
+StatsCommand::~StatsCommand()
+{
+	debug("Destructor called");
+}
+
+// Copy Constructor
+StatsCommand::StatsCommand(const StatsCommand &copy): Command(copy)
+{}
+
+// Copy Assignment Operator
+StatsCommand& StatsCommand::operator=( const StatsCommand &assign )
+{
+	if (this != &assign)
+	{
+		Command::operator=(assign);
+	}
+	return *this;
+}
+
+Command*	StatsCommand::fromMessage(const Message& message)
+{
+	return new StatsCommand(message);
+}
+
+/*
+https://modern.ircdocs.horse/#stats-message
+There is no OPER, so every registered user may query.
+
+    ERR_NOTREGISTERED (451)		=> done
+    ERR_NEEDMOREPARAMS (461)	=> done
+    RPL_STATSCOMMANDS (212)		=> "m": lines executed per command
+    RPL_STATSUPTIME (242)		=> "u"
+    RPL_STATSDEBUG (249)		=> "z": every counter and gauge, "name value"
+								   "h": heavy hitters, "list estimate label"
+    RPL_ENDOFSTATS (219)		=> done, also for unknown letters
+*/
+void	StatsCommand::execute(Server& server, Client& sender)
+{
+	const std::vector<std::string>	&inParams = inMessage_.getParams();
+	const std::string				nickname = sender.getNickname();
+	// 451
+	if (!sender.isAuthenticated())
+		return (sender.sendErrorMessage(ERR_NOTREGISTERED, nickname));
+	// 461
+	if (inParams.empty() || inParams[0].empty())
+		return (sender.sendErrorMessage(ERR_NEEDMOREPARAMS, nickname, inMessage_.getType()));
+
+	const std::string	query = inParams[0].substr(0, 1);
+	Metrics				&metrics = server.getMetrics();
+	if (query == "m")
+	{
+		const std::map<std::string, uint64_t>	&commands = metrics.commandCounts();
+		for (std::map<std::string, uint64_t>::const_iterator it = commands.begin();
+			 it != commands.end(); ++it)
+			sender.sendErrorMessage(RPL_STATSCOMMANDS, nickname, it->first, toString(it->second));
+	}
+	else if (query == "u")
+	{
+		const long	up = static_cast<long>(std::time(NULL) - server.getTimeCreated());
+		char		uptime[64];
+		std::snprintf(uptime, sizeof(uptime), "Server Up %ld days %ld:%02ld:%02ld",
+					  up / 86400, up / 3600 % 24, up / 60 % 60, up % 60);
+		sender.sendErrorMessage(RPL_STATSUPTIME, nickname, uptime);
+	}
+	else if (query == "z")
+	{
+		for (int i = 0; i < METRIC_COUNTER_COUNT; ++i)
+		{
+			const MetricCounter	counter = static_cast<MetricCounter>(i);
+			sender.sendErrorMessage(RPL_STATSDEBUG, nickname, query,
+				std::string(Metrics::name(counter)) + " " + toString(metrics.get(counter)));
+		}
+		for (int i = 0; i < METRIC_GAUGE_COUNT; ++i)
+		{
+			const MetricGauge	gauge = static_cast<MetricGauge>(i);
+			sender.sendErrorMessage(RPL_STATSDEBUG, nickname, query,
+				std::string(Metrics::name(gauge)) + " " + toString(metrics.get(gauge)));
+		}
+	}
+	else if (query == "h")
+	{
+		for (int i = 0; i < HEAVY_KIND_COUNT; ++i)
+		{
+			const HeavyKind							kind = static_cast<HeavyKind>(i);
+			const std::vector<HeavyHitters::Entry>	top = metrics.heavy(kind).top();
+			for (std::size_t j = 0; j < top.size(); ++j)
+				sender.sendErrorMessage(RPL_STATSDEBUG, nickname, query,
+					std::string(Metrics::name(kind)) + " " + toString(top[j].estimate) + " " + top[j].label);
+		}
+	}
+	sender.sendErrorMessage(RPL_ENDOFSTATS, nickname, query);
+}
@@ -88,6 +88,7 @@ void	TopicCommand::execute(Server& server, Client& sender)
 		sender.sendCmdValidation(inMessage_, *channel);
 		channel->setTopicWho(sender.getNickname());
 		channel->setTopicTime();
+		server.getChannelJournal().topicChanged(*channel);
 	}
 }
 
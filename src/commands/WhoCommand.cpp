@@ -1,37 +1,184 @@
 #include "../../include/commands/WhoCommand.hpp"
+#include "../../include/Debug.hpp"
 #include "../../include/MessageType.hpp"
 
+// Default Constructor
+WhoCommand::WhoCommand( void ): Command()
+{
+	debug("Default Constructor called");
+}
+
+WhoCommand::WhoCommand(const Message& msg) : Command(msg)
+{}
 
-WhoCommand::WhoCommand(const Message& msg) : JoinCommand(msg)
+// Destructor
+WhoCommand::~WhoCommand()
+{
+	debug("Destructor called");
+}
+
+// Copy Constructor
+WhoCommand::WhoCommand(const WhoCommand &copy): Command(copy)
 {}
 
+// Copy Assignment Operator
+WhoCommand& WhoCommand::operator=( const WhoCommand &assign )
+{
+	if (this != &assign)
+	{
+		Command::operator=(assign);
+	}
+	return *this;
+}
+
 Command* WhoCommand::fromMessage(const Message& message)
 {
 	return new WhoCommand(message);
 }
+
+// There is no away status and no server operator, so the flags are H and
+// the channel operator prefix
+Message	WhoCommand::whoReply(const std::string &requester, const std::string &channel,
+							 const Client &client, bool isOperator)
+{
+	std::vector<std::string> params;
+	params.reserve(8);
+	params.push_back(requester);
+	params.push_back(channel);
+	params.push_back(client.getUsername());
+	params.push_back(client.getIP());
+	params.push_back(HOSTNAME);
+	params.push_back(client.getNickname());
+	params.push_back(isOperator ? "H@" : "H");
+	params.push_back("0 " + client.getRealname());
+	Message reply("352", params);
+	reply.setSource();
+	return (reply);
+}
+
 /*
-    https://modern.ircdocs.horse/#join-message
+    https://modern.ircdocs.horse/#who-message
+	WHO #channel	=> every member of the channel
+	WHO nick		=> that client, straight from the nick index
+	WHO mask		=> registered clients whose nickname, username or host
+					   matches the glob mask, WHO_MAX_RESULTS at most
+
+Channel and mask answers are streamed (see WhoStream), so a WHO * over
+100k users is spread over many loop iterations instead of stalling one.
 
     ERR_NOTREGISTERED (451)		=> done
 	ERR_NEEDMOREPARAMS (461)	=> done
-    ERR_NOSUCHCHANNEL (403) 	=> done
-    RPL_NAMREPLY (353)			=> done
-    RPL_ENDOFNAMES (366)		=> done
+    RPL_WHOREPLY (352)			=> done
+    RPL_ENDOFWHO (315)			=> done
+    RPL_TRYAGAIN (263)			=> too many streamed replies pending
 */
 void WhoCommand::execute(Server& server, Client& sender)
 {
-	std::vector<std::string> inParams = inMessage_.getParams();
+	const std::vector<std::string>	&inParams = inMessage_.getParams();
 	// 451
 	if (!sender.isAuthenticated())
 		return (sender.sendErrorMessage(ERR_NOTREGISTERED, sender.getNickname()));
 	// 461
-	if (inParams.size() < 1)
+	if (inParams.empty() || inParams[0].empty())
 		return (sender.sendErrorMessage(ERR_NEEDMOREPARAMS, sender.getNickname(), inMessage_.getType()));
 
-	std::string	channelName = inParams[0];
-	Channel *channel = (server.mapChannel(channelName));
-	// 403
-	if (channelName[0] != '#' || !channel)
-		return(sender.sendErrorMessage(ERR_NOSUCHCHANNEL, sender.getNickname(), channelName));
-	sendValidationMessages_353_366(sender, *channel);
+	// "WHO 0" is the RFC 1459 spelling of everyone
+	const std::string	mask = inParams[0] == "0" ? "*" : inParams[0];
+	ReplyStream			*stream;
+	if (mask[0] == '#')
+	{
+		if (!server.mapChannel(mask))
+			return (sender.sendErrorMessage(RPL_ENDOFWHO, sender.getNickname(), mask));
+		stream = new WhoStream(sender.getSocket(), sender.getNickname(), mask);
+	}
+	else
+	{
+		const GlobMask	compiled(mask);
+		const Client	*client = compiled.isLiteral() ? server.findClientByNick(mask) : NULL;
+		if (client && client->isAuthenticated())
+		{
+			sender.sendMessage(whoReply(sender.getNickname(), "*", *client, false));
+			return (sender.sendErrorMessage(RPL_ENDOFWHO, sender.getNickname(), mask));
+		}
+		// a literal that is no nickname may still be a username or host
+		stream = new WhoStream(sender.getSocket(), sender.getNickname(), compiled);
+	}
+	if (!server.startStream(stream))
+		sender.sendErrorMessage(RPL_TRYAGAIN, sender.getNickname(), inMessage_.getType());
+}
+
+WhoStream::WhoStream(int fd, const std::string &requester, const std::string &channel)
+	: ReplyStream(fd), requester_(requester), channel_(channel), cursor_(0),
+	  found_(0), started_(false)
+{}
+
+WhoStream::WhoStream(int fd, const std::string &requester, const GlobMask &mask)
+	: ReplyStream(fd), requester_(requester), mask_(mask), cursor_(0),
+	  found_(0), started_(false)
+{}
+
+WhoStream::~WhoStream()
+{}
+
+bool	WhoStream::pumpChannel_(Server &server, size_t &budget)
+{
+	const Channel	*channel = server.mapChannel(channel_);
+	if (!channel)
+		return (false);
+	const Channel::Members				&members = channel->getMembers();
+	Channel::Members::const_iterator	it = started_
+		? members.upper_bound(lastMember_) : members.begin();
+	started_ = true;
+	for (; it != members.end(); ++it)
+	{
+		if (!budget || !hasRoom(server))
+			return (true);
+		--budget;
+		lastMember_ = it->first;
+		const Client *client = server.tryClientFromFd(it->second.fd);
+		if (!client || client->isClosing())
+			continue;
+		send(server, WhoCommand::whoReply(requester_, channel->getName(), *client,
+										  channel->isOperator(it->first)).toString());
+	}
+	return (false);
+}
+
+bool	WhoStream::pumpMask_(Server &server, size_t &budget)
+{
+	Slab<Client>	&clients = server.getClients();
+	for (; cursor_ < clients.slotCount(); ++cursor_)
+	{
+		if (found_ >= WHO_MAX_RESULTS)
+			return (false);
+		if (!budget || !hasRoom(server))
+			return (true);
+		--budget;
+		const Client *client = clients.at(cursor_);
+		if (!client || client->isClosing() || !client->isAuthenticated())
+			continue;
+		if (!mask_.matches(client->getNickname()) && !mask_.matches(client->getUsername())
+			&& !mask_.matches(client->getIP()))
+			continue;
+		++found_;
+		send(server, WhoCommand::whoReply(requester_, "*", *client, false).toString());
+	}
+	return (false);
+}
+
+StreamState	WhoStream::pump(Server &server)
+{
+	size_t		budget = WHO_SLICE;
+	const bool	more = channel_.empty() ? pumpMask_(server, budget)
+										: pumpChannel_(server, budget);
+	if (more)
+		return (hasRoom(server) ? STREAM_MORE : STREAM_BLOCKED);
+	std::vector<std::string> params;
+	params.push_back(requester_);
+	params.push_back(channel_.empty() ? mask_.pattern() : channel_);
+	params.push_back("End of WHO list");
+	Message end("315", params);
+	end.setSource();
+	send(server, end.toString());
+	return (STREAM_DONE);
 }
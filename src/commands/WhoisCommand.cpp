@@ -0,0 +1,162 @@
+#include "../../include/commands/WhoisCommand.hpp"
+#include "../../include/Channel.hpp"
+#include "../../include/Debug.hpp"
+#include <sstream>
+
+// Default Constructor
+WhoisCommand::WhoisCommand( void ): Command()
+{
+	debug("Default Constructor called");
+}
+
+WhoisCommand::WhoisCommand(const Message& msg) : Command(msg)
+{}
+
+// Destructor
+WhoisCommand::~WhoisCommand()
+{
+	debug("Destructor called");
+}
+
+// Copy Constructor
+WhoisCommand::WhoisCommand(const WhoisCommand &copy): Command(copy)
+{}
+
+// Copy Assignment Operator
+WhoisCommand& WhoisCommand::operator=( const WhoisCommand &assign )
+{
+	if (this != &assign)
+	{
+		Command::operator=(assign);
+	}
+	return *this;
+}
+
+Command*	WhoisCommand::fromMessage(const Message& message)
+{
+	return new WhoisCommand(message);
+}
+
+/*
+    https://modern.ircdocs.horse/#whois-message
+	WHOIS [<server>] <nick>{,<nick>}
+
+Each nickname is one nick index lookup; masks are not expanded (WHO does
+that). At most WHOIS_TARGETS nicknames are answered. 319 comes from the
+channel list the server keeps per client; the answer is streamed (see
+WhoisStream) so a client in thousands of channels never stalls the loop.
+
+    ERR_NOTREGISTERED (451)		=> done
+    ERR_NONICKNAMEGIVEN (431)	=> done
+    ERR_NOSUCHNICK (401)		=> done
+    RPL_WHOISUSER (311)			=> done
+    RPL_WHOISCHANNELS (319)		=> done
+    RPL_WHOISSERVER (312)		=> done
+    RPL_WHOISIDLE (317)			=> never, the sign-on time is not kept
+    RPL_ENDOFWHOIS (318)		=> done
+    RPL_TRYAGAIN (263)			=> too many streamed replies pending
+*/
+void	WhoisCommand::execute(Server& server, Client& sender)
+{
+	const std::vector<std::string>	&inParams = inMessage_.getParams();
+	// 451
+	if (!sender.isAuthenticated())
+		return (sender.sendErrorMessage(ERR_NOTREGISTERED, sender.getNickname()));
+	// 431
+	if (inParams.empty() || inParams.back().empty())
+		return (sender.sendErrorMessage(ERR_NONICKNAMEGIVEN, sender.getNickname()));
+
+	// with two parameters the first one names a server: this one
+	std::stringstream			stream(inParams.back());
+	std::string					nickname;
+	std::vector<std::string>	nicknames;
+	while (nicknames.size() < WHOIS_TARGETS && std::getline(stream, nickname, ','))
+	{
+		if (!nickname.empty())
+			nicknames.push_back(nickname);
+	}
+	if (nicknames.empty())
+		return (sender.sendErrorMessage(ERR_NONICKNAMEGIVEN, sender.getNickname()));
+	if (!server.startStream(new WhoisStream(sender.getSocket(), nicknames)))
+		sender.sendErrorMessage(RPL_TRYAGAIN, sender.getNickname(), inMessage_.getType());
+}
+
+WhoisStream::WhoisStream(int fd, const std::vector<std::string> &nicknames)
+	: ReplyStream(fd), nicknames_(nicknames), current_(0), cursor_(0)
+{}
+
+WhoisStream::~WhoisStream()
+{}
+
+bool	WhoisStream::pumpTarget_(Server &server, const Client &sender, size_t &budget)
+{
+	const std::string	requester = sender.getNickname();
+	if (name_.empty())
+	{
+		const std::string	&nickname = nicknames_[current_];
+		const Client		*target = server.findClientByNick(nickname);
+		// 401
+		if (!target || !target->isAuthenticated())
+		{
+			sender.sendErrorMessage(ERR_NOSUCHNICK, requester, nickname);
+			sender.sendErrorMessage(RPL_ENDOFWHOIS, requester, nickname);
+			return (false);
+		}
+		name_ = target->getNickname();
+		// 311
+		std::vector<std::string> params;
+		params.push_back(requester);
+		params.push_back(name_);
+		params.push_back(target->getUsername());
+		params.push_back(target->getIP());
+		params.push_back("*");
+		params.push_back(target->getRealname());
+		sender.sendErrorMessage(RPL_WHOISUSER, params);
+	}
+	// 319, from the target's own channel list; one that left or changed
+	// nickname meanwhile gets what was gathered so far
+	const Client	*target = server.findClientByNick(name_);
+	const std::vector<std::string> *joined = target ? &server.channelsOf(target->getSocket()) : NULL;
+	for (; joined && cursor_ < joined->size(); ++cursor_)
+	{
+		if (!budget || !hasRoom(server))
+			return (true);
+		--budget;
+		const Channel *channel = server.mapChannel((*joined)[cursor_]);
+		if (!channel)
+			continue;
+		if (!channels_.empty() && channels_.size() + channel->getName().size() + 2 > WHOIS_CHANNELS_LINE)
+		{
+			sender.sendErrorMessage(RPL_WHOISCHANNELS, requester, name_, channels_);
+			channels_.clear();
+		}
+		if (!channels_.empty())
+			channels_ += " ";
+		if (channel->isOperator(name_))
+			channels_ += "@";
+		channels_ += channel->getName();
+	}
+	if (!channels_.empty())
+		sender.sendErrorMessage(RPL_WHOISCHANNELS, requester, name_, channels_);
+	// 312
+	sender.sendErrorMessage(RPL_WHOISSERVER, requester, name_, HOSTNAME, VERSION " IRC server");
+	// 318
+	sender.sendErrorMessage(RPL_ENDOFWHOIS, requester, name_);
+	return (false);
+}
+
+StreamState	WhoisStream::pump(Server &server)
+{
+	// the server drops the streams of clients that left
+	const Client	*sender = server.tryClientFromFd(fd_);
+	size_t			budget = WHOIS_SLICE;
+	for (; sender && current_ < nicknames_.size(); ++current_)
+	{
+		if (pumpTarget_(server, *sender, budget))
+			return (hasRoom(server) ? STREAM_MORE : STREAM_BLOCKED);
+		name_.clear();
+		channels_.clear();
+		cursor_ = 0;
+	}
+	return (STREAM_DONE);
+}
@@ -9,16 +9,33 @@
 //check canonical form
 
 int bot_main(int argc, char *argv[]);
+int bench_main(int argc, char *argv[]);
 
 int main(int argc, char *argv[]) {
 	#ifdef BOT_MAIN
 	return (bot_main(argc, argv));
 	#endif
-	if (argc != 3)
+	#ifdef BENCH_MAIN
+	return (bench_main(argc, argv));
+	#endif
+	if (argc < 3)
 	{
-		std::cout << "Usage: ./ircserv <port> <password>" << std::endl;
+		std::cout << "Usage: ./ircserv <port> <password> [options]" << std::endl
+				  << ServerConfig::usage();
 		return (1);
 	}
+	ServerConfig	config;
+	config.arguments.assign(argv, argv + argc);
+	for (int i = 3; i < argc; ++i)
+	{
+		if (!config.parseOption(argv[i]))
+		{
+			std::cerr << "Invalid option: " << argv[i] << std::endl
+					  << ServerConfig::usage();
+			return (1);
+		}
+	}
+	config.inheritListenFds();
 	int port;
 	std::stringstream portStream(argv[1]);
 	if (!(portStream >> port))
@@ -31,7 +48,7 @@ int main(int argc, char *argv[]) {
 		std::cerr << "Invalid port number: extra characters after number" << std::endl;
 	std::string password = argv[2];
 	try {
-	Server	serv(port, static_cast<std::string>(argv[2]));
+	Server	serv(port, static_cast<std::string>(argv[2]), config);
 	serv.waitForRequests();
 	serv.serverShutdown();
 	} catch (std::exception &e) {
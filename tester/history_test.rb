@@ -0,0 +1,137 @@
+#!/usr/bin/env ruby
+# The on-disk history of a channel outlives it: check that whoever creates
+# the channel again does not get to page the old conversation, in the same
+# process or after a restart, while a channel whose key came back from the
+# journal after a restart still serves it. Also checks that the files go
+# with their channels and that --history-disk-channels bounds them.
+#
+#   ruby tester/history_test.rb [port]
+require 'socket'
+require 'fileutils'
+require 'timeout'
+require 'tmpdir'
+
+PORT     = (ARGV[0] || 6692).to_i
+PASSWORD = "pw"
+ROOT     = File.expand_path("..", __dir__)
+HISTORY  = Dir.mktmpdir("irchistory")
+STATE    = Dir.mktmpdir("ircstate")
+
+def fail!(why)
+  puts "FAIL: #{why}"
+  system("pkill", "-INT", "-x", "ircserv")
+  exit 1
+end
+
+def start(*options)
+  pid = spawn("#{ROOT}/ircserv", PORT.to_s, PASSWORD, "--history-dir=#{HISTORY}",
+              "--max-per-ip=0", "--connect-rate=0", "--drain-timeout=0", *options,
+              out: File::NULL)
+  sleep 0.5
+  pid
+end
+
+def stop(pid)
+  Process.kill("INT", pid)
+  Process.wait(pid)
+end
+
+def connect(nick)
+  sock = TCPSocket.new("127.0.0.1", PORT)
+  sock.write("PASS #{PASSWORD}\r\nNICK #{nick}\r\nUSER #{nick} 0 * :#{nick}\r\n")
+  expect(sock, / 0*1 /)
+  sock
+end
+
+# Reads lines until one matches pattern; returns it
+def expect(sock, pattern, timeout = 10)
+  Timeout.timeout(timeout) do
+    while (line = sock.gets)
+      return line if line =~ pattern
+    end
+  end
+  fail!("connection closed while waiting for #{pattern.inspect}")
+rescue Timeout::Error
+  fail!("timed out waiting for #{pattern.inspect}")
+end
+
+# Texts of the lines CHATHISTORY LATEST serves sock for channel
+def history(sock, channel)
+  sock.write("CHATHISTORY LATEST #{channel} * 50\r\n")
+  expect(sock, /BATCH \+\S+ chathistory/)
+  texts = []
+  while (line = expect(sock, / PRIVMSG |BATCH -/)) !~ /BATCH -/
+    texts << line[/ PRIVMSG \S+ :?(.*)\r$/, 1]
+  end
+  texts
+end
+
+def files
+  Dir.children(HISTORY).grep(/\.history$/).size
+end
+
+# Opens channel with key and posts text; returns the socket, still in
+def talk(nick, channel, key, text)
+  sock = connect(nick)
+  sock.write("JOIN #{channel}\r\nMODE #{channel} +k #{key}\r\n")
+  expect(sock, / MODE #{channel} \+k /)
+  sock.write("PRIVMSG #{channel} :#{text}\r\n")
+  fail!("#{text} not kept") unless history(sock, channel).include?(text)
+  sock
+end
+
+# Same, then leaves, which destroys channel
+def talk_and_leave(nick, channel, key, text)
+  sock = talk(nick, channel, key, text)
+  sock.write("PART #{channel}\r\n")
+  expect(sock, / PART #{channel}/)
+  sock.close
+end
+
+server = start
+talk_and_leave("alice", "#old", "sesame", "before")
+fail!("#old left #{files} history files behind") unless files.zero?
+bob = connect("bob")
+bob.write("JOIN #old\r\n")
+expect(bob, / 366 /)
+seen = history(bob, "#old")
+fail!("re-created #old served #{seen.inspect}") unless seen.empty?
+bob.write("PRIVMSG #old :after\r\n")
+seen = history(bob, "#old")
+fail!("#old served #{seen.inspect} instead of its own line") unless seen == ["after"]
+stop(server)
+bob.close
+
+# #old was still open at the stop, but nothing saved it
+server = start
+fail!("#{files} history files outlived the restart") unless files.zero?
+carol = connect("carol")
+carol.write("JOIN #old\r\n")
+expect(carol, / 366 /)
+seen = history(carol, "#old")
+fail!("#old served #{seen.inspect} after a restart") unless seen.empty?
+carol.close
+stop(server)
+
+server = start("--history-disk-channels=2")
+socks = (1..3).map { |i| talk("dave#{i}", "#d#{i}", "k", "line") }
+fail!("#{files} history files for 2 allowed") unless files == 2
+socks.each(&:close)
+stop(server)
+
+# stopped with alice still in, so the journal keeps #kept
+server = start("--state-dir=#{STATE}")
+alice = talk("alice", "#kept", "sesame", "guarded")
+stop(server)
+alice.close
+server = start("--state-dir=#{STATE}")
+bob = connect("bob")
+bob.write("JOIN #kept sesame\r\n")
+expect(bob, / 366 /)
+seen = history(bob, "#kept")
+fail!("restored #kept served #{seen.inspect}") unless seen == ["guarded"]
+bob.close
+stop(server)
+FileUtils.remove_entry(HISTORY)
+FileUtils.remove_entry(STATE)
+puts "PASS: re-created channels start with an empty history"
@@ -0,0 +1,219 @@
+// Measures resident memory per idle registered connection of a running
+// ircserv. Opens N connections, registers each one (PASS/NICK/USER), waits
+// for the welcome burst to finish and samples the server's VmRSS.
+//
+// Usage:
+//   ./idle_footprint <server-pid> <port> <password> [--budget=<bytes>]
+//                    [--inflight=<n>] [count ...]
+//
+// Counts default to 10000 50000 100000 and are reached incrementally on the
+// same set of connections. With --budget the exit status is 1 when any step
+// exceeds the given bytes per connection. --inflight bounds how many
+// connections handshake at once; keep it below the server's listen backlog.
+//
+// Both processes need a file descriptor limit above the largest count
+// (ulimit -n). Connections are spread over several 127.0.0.x source
+// addresses to stay clear of the ephemeral port range per address.
+
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sstream>
+#include <string>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <vector>
+
+#define CONNECTIONS_PER_SOURCE_IP 20000
+#define DEFAULT_INFLIGHT		  8
+
+struct Connection {
+	int			fd;
+	bool		registered;
+	std::string rx;
+};
+
+static long readRssKb(long pid) {
+	std::ostringstream path;
+	path << "/proc/" << pid << "/status";
+	std::ifstream status(path.str().c_str());
+	std::string	  line;
+	while (std::getline(status, line)) {
+		if (line.compare(0, 6, "VmRSS:") == 0)
+			return std::strtol(line.c_str() + 6, NULL, 10);
+	}
+	return -1;
+}
+
+static void raiseFdLimit() {
+	struct rlimit lim;
+	if (getrlimit(RLIMIT_NOFILE, &lim) == 0 && lim.rlim_cur < lim.rlim_max) {
+		lim.rlim_cur = lim.rlim_max;
+		setrlimit(RLIMIT_NOFILE, &lim);
+	}
+}
+
+static int openConnection(size_t index, unsigned short port) {
+	int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+	if (fd == -1)
+		return -1;
+	struct sockaddr_in src;
+	std::memset(&src, 0, sizeof(src));
+	src.sin_family		= AF_INET;
+	src.sin_addr.s_addr = htonl(
+		0x7f000001u + static_cast<unsigned int>(index / CONNECTIONS_PER_SOURCE_IP));
+	if (bind(fd, reinterpret_cast<struct sockaddr *>(&src), sizeof(src)) == -1) {
+		close(fd);
+		return -1;
+	}
+	struct sockaddr_in dst;
+	std::memset(&dst, 0, sizeof(dst));
+	dst.sin_family		= AF_INET;
+	dst.sin_port		= htons(port);
+	dst.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	if (connect(fd, reinterpret_cast<struct sockaddr *>(&dst), sizeof(dst)) ==
+			-1 &&
+		errno != EINPROGRESS) {
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+// RPL_MYINFO (004, sent as "4" by ircserv) ends the welcome burst
+static bool sawMyInfo(const std::string &rx) {
+	return rx.find(" 4 ") != std::string::npos ||
+		   rx.find(" 004 ") != std::string::npos;
+}
+
+// Opens and registers connections until conns holds target entries. At most
+// inflight connections are handshaking at once so the SYN burst stays within
+// the server's listen backlog.
+static bool growTo(std::vector<Connection> &conns, size_t target,
+				   unsigned short port, const std::string &password,
+				   size_t inflightMax) {
+	std::vector<struct pollfd> pfds;
+	std::vector<size_t>		   inflight;
+	while (conns.size() < target || !inflight.empty()) {
+		while (inflight.size() < inflightMax && conns.size() < target) {
+			Connection c;
+			c.fd		 = openConnection(conns.size(), port);
+			c.registered = false;
+			if (c.fd == -1) {
+				std::cerr << "connect failed at " << conns.size()
+						  << " connections: " << std::strerror(errno)
+						  << std::endl;
+				return false;
+			}
+			inflight.push_back(conns.size());
+			conns.push_back(c);
+		}
+		pfds.clear();
+		for (size_t i = 0; i < inflight.size(); ++i) {
+			const Connection &c = conns[inflight[i]];
+			// POLLOUT until the registration burst went out
+			struct pollfd p = {c.fd, static_cast<short>(c.rx.empty() ? POLLOUT : POLLIN), 0};
+			pfds.push_back(p);
+		}
+		if (poll(&pfds[0], pfds.size(), 30000) <= 0)
+			return false;
+		for (size_t i = inflight.size(); i > 0; --i) {
+			const short re = pfds[i - 1].revents;
+			Connection &c  = conns[inflight[i - 1]];
+			if (re & (POLLHUP | POLLERR))
+				return false;
+			if ((re & POLLOUT) && c.rx.empty()) {
+				std::ostringstream reg;
+				reg << "PASS " << password << "\r\nNICK idle" << inflight[i - 1]
+					<< "\r\nUSER idle 0 * :idle client\r\n";
+				const std::string line = reg.str();
+				if (send(c.fd, line.c_str(), line.size(), MSG_NOSIGNAL) !=
+					static_cast<ssize_t>(line.size()))
+					return false;
+				c.rx = " "; // marks the registration as sent
+				continue;
+			}
+			if (!(re & POLLIN))
+				continue;
+			char	buf[4096];
+			ssize_t n = recv(c.fd, buf, sizeof(buf), 0);
+			if (n <= 0)
+				return false;
+			c.rx.append(buf, static_cast<size_t>(n));
+			if (sawMyInfo(c.rx)) {
+				c.registered = true;
+				std::string().swap(c.rx);
+				inflight.erase(inflight.begin() +
+							   static_cast<std::ptrdiff_t>(i - 1));
+			}
+		}
+	}
+	return true;
+}
+
+int main(int argc, char **argv) {
+	if (argc < 4) {
+		std::cerr << "Usage: " << argv[0]
+				  << " <server-pid> <port> <password> [--budget=<bytes>] "
+					 "[--inflight=<n>] [count ...]"
+				  << std::endl;
+		return 2;
+	}
+	long				pid		 = std::strtol(argv[1], NULL, 10);
+	unsigned short		port	 = static_cast<unsigned short>(std::atoi(argv[2]));
+	std::string			password = argv[3];
+	long				budget	 = 0;
+	size_t				inflight = DEFAULT_INFLIGHT;
+	std::vector<size_t> counts;
+	for (int i = 4; i < argc; ++i) {
+		std::string arg = argv[i];
+		if (arg.compare(0, 9, "--budget=") == 0)
+			budget = std::strtol(arg.c_str() + 9, NULL, 10);
+		else if (arg.compare(0, 11, "--inflight=") == 0)
+			inflight = std::strtoul(arg.c_str() + 11, NULL, 10);
+		else
+			counts.push_back(static_cast<size_t>(std::strtoul(argv[i], NULL, 10)));
+	}
+	if (counts.empty()) {
+		counts.push_back(10000);
+		counts.push_back(50000);
+		counts.push_back(100000);
+	}
+	raiseFdLimit();
+
+	const long baselineKb = readRssKb(pid);
+	if (baselineKb < 0) {
+		std::cerr << "cannot read /proc/" << pid << "/status" << std::endl;
+		return 2;
+	}
+	std::cout << "baseline rss: " << baselineKb << " kB" << std::endl;
+	std::cout << "clients\trss_kB\tbytes_per_client" << std::endl;
+
+	std::vector<Connection> conns;
+	bool					overBudget = false;
+	for (size_t step = 0; step < counts.size(); ++step) {
+		if (!growTo(conns, counts[step], port, password, inflight)) {
+			std::cerr << "registration stalled or was refused" << std::endl;
+			return 1;
+		}
+		sleep(1); // let the server drain and settle
+		const long	 rssKb	  = readRssKb(pid);
+		const double perConn = static_cast<double>(rssKb - baselineKb) *
+							   1024.0 / static_cast<double>(conns.size());
+		std::printf("%lu\t%ld\t%.0f\n", static_cast<unsigned long>(conns.size()),
+					rssKb, perConn);
+		std::fflush(stdout);
+		if (budget > 0 && perConn > static_cast<double>(budget))
+			overBudget = true;
+	}
+	for (size_t i = 0; i < conns.size(); ++i)
+		close(conns[i].fd);
+	return overBudget ? 1 : 0;
+}
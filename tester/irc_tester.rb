@@ -308,6 +308,23 @@ class IrcservTester
     return false
   end
 
+  # sees that nothing matching pattern arrived, after giving it time to
+  def client_not_received?(client_id, pattern, wait = 0.5)
+    client = @clients[client_id]
+    return false unless client
+    sleep(wait)
+    client[:response_mutex].synchronize do
+      client[:responses].each do |response|
+        if response.match?(pattern)
+          puts "Client #{client_id} received unexpected pattern: #{pattern}"
+          return false
+        end
+      end
+    end
+    puts "Client #{client_id} did not receive: #{pattern}"
+    return true
+  end
+
   def substitute_variables(text, variables)
     return text unless text && variables
     result = text.dup
@@ -332,6 +349,8 @@ class IrcservTester
     client_id = step[:client]
 
     send_command(client_id, command)
+    # reject: a pattern the client must not have received
+    return false if step[:reject] && !client_not_received?(client_id, step[:reject])
     return true unless expected
     if expected.is_a?(Array)
       return expected.all? do |pattern|
@@ -609,7 +628,8 @@ test_cases = [
       { procedure: :register_client, client_map: { client: :alice }, variables: { nickname: "alice" } },
       # Send and verify message
       { client: :alice, command: "PRIVMSG #test :Hi there!", expect: nil },
-      { client: :alice, command: "", expect: /404/ }
+      # the last member leaving destroyed #test
+      { client: :alice, command: "", expect: /403 alice #test/ }
     ]
   },
   {
@@ -677,6 +697,296 @@ test_cases = [
       # After QUIT we expect a numeric 5 (error-message) response before disconnect.
       { client: :alice, command: "QUIT :Client exiting", expect: /ERROR/, timeout: 1.5 }
     ]
+  },
+  #--------------------------------------------------
+  # BAN, EXCEPTION AND INVITE EXCEPTION LISTS
+  {
+    name: "Banned client gets 474 on JOIN",
+    clients: [:alice, :bob],
+    steps: [
+      { procedure: :register_client, client_map: { client: :alice }, variables: { nickname: "alice" } },
+      { procedure: :register_client, client_map: { client: :bob }, variables: { nickname: "bob" } },
+      { procedure: :join_channel, client_map: { client: :alice }, variables: { channel: "#bans" } },
+      # the mask goes out as it was stored
+      { client: :alice, command: "MODE #bans +b bob", expect: /alice!.+@.+ MODE #bans \+b bob!\*@\*$/ },
+      { client: :bob, command: "JOIN #bans", expect: /474 bob #bans/, reject: /bob!.+@.+ JOIN #bans/ }
+    ]
+  },
+  {
+    name: "Ban exception lets a banned client join",
+    clients: [:alice, :bob, :carol],
+    steps: [
+      { procedure: :register_client, client_map: { client: :alice }, variables: { nickname: "alice" } },
+      { procedure: :register_client, client_map: { client: :bob }, variables: { nickname: "bob" } },
+      { procedure: :register_client, client_map: { client: :carol }, variables: { nickname: "carol" } },
+      { procedure: :join_channel, client_map: { client: :alice }, variables: { channel: "#exc" } },
+      { client: :alice, command: "MODE #exc +be *!*@* bob", expect: /MODE #exc \+be \*!\*@\* bob!\*@\*$/ },
+      { client: :bob, command: "JOIN #exc", expect: /bob!.+@.+ JOIN #exc/ },
+      { client: :carol, command: "JOIN #exc", expect: /474 carol #exc/ }
+    ]
+  },
+  {
+    name: "Invite exception lets a client past +i",
+    clients: [:alice, :bob, :carol],
+    steps: [
+      { procedure: :register_client, client_map: { client: :alice }, variables: { nickname: "alice" } },
+      { procedure: :register_client, client_map: { client: :bob }, variables: { nickname: "bob" } },
+      { procedure: :register_client, client_map: { client: :carol }, variables: { nickname: "carol" } },
+      { procedure: :join_channel, client_map: { client: :alice }, variables: { channel: "#inv" } },
+      { client: :alice, command: "MODE #inv +iI bob", expect: /MODE #inv \+iI bob!\*@\*$/ },
+      { client: :bob, command: "JOIN #inv", expect: /bob!.+@.+ JOIN #inv/ },
+      { client: :carol, command: "JOIN #inv", expect: /473 carol #inv/ }
+    ]
+  },
+  {
+    name: "Banned member gets 404 on PRIVMSG",
+    clients: [:alice, :bob],
+    steps: [
+      { procedure: :register_client, client_map: { client: :alice }, variables: { nickname: "alice" } },
+      { procedure: :register_client, client_map: { client: :bob }, variables: { nickname: "bob" } },
+      { procedure: :join_channel, client_map: { client: :alice }, variables: { channel: "#b404" } },
+      { procedure: :join_channel, client_map: { client: :bob }, variables: { channel: "#b404" } },
+      { client: :alice, command: "MODE #b404 +b bob!*@*", expect: /MODE #b404 \+b bob!\*@\*$/ },
+      { client: :bob, command: "PRIVMSG #b404 :banned words", expect: /404 bob #b404/ },
+      { client: :alice, command: "", reject: /banned words/ }
+    ]
+  },
+  {
+    name: "MODE from a non-operator gets 482 and changes nothing",
+    clients: [:alice, :bob],
+    steps: [
+      { procedure: :register_client, client_map: { client: :alice }, variables: { nickname: "alice" } },
+      { procedure: :register_client, client_map: { client: :bob }, variables: { nickname: "bob" } },
+      { procedure: :join_channel, client_map: { client: :alice }, variables: { channel: "#ops" } },
+      { procedure: :join_channel, client_map: { client: :bob }, variables: { channel: "#ops" } },
+      { client: :bob, command: "MODE #ops +t", expect: /482 bob #ops/, reject: /MODE #ops \+t/ },
+      { client: :alice, command: "MODE #ops", expect: /324 alice #ops$/ }
+    ]
+  },
+  {
+    name: "MODE +ob takes one argument each",
+    clients: [:alice, :bob, :carol],
+    steps: [
+      { procedure: :register_client, client_map: { client: :alice }, variables: { nickname: "alice" } },
+      { procedure: :register_client, client_map: { client: :bob }, variables: { nickname: "bob" } },
+      { procedure: :register_client, client_map: { client: :carol }, variables: { nickname: "carol" } },
+      { procedure: :join_channel, client_map: { client: :alice }, variables: { channel: "#ob" } },
+      { procedure: :join_channel, client_map: { client: :bob }, variables: { channel: "#ob" } },
+      { client: :alice, command: "MODE #ob +ob bob carol", expect: /MODE #ob \+ob bob carol!\*@\*$/ },
+      # bob is operator now, and carol banned
+      { client: :bob, command: "MODE #ob +t", expect: /bob!.+@.+ MODE #ob \+t$/ },
+      { client: :carol, command: "JOIN #ob", expect: /474 carol #ob/ }
+    ]
+  },
+  {
+    name: "MODE +o and +l refuse bad arguments",
+    clients: [:alice, :bob, :carol],
+    steps: [
+      { procedure: :register_client, client_map: { client: :alice }, variables: { nickname: "alice" } },
+      { procedure: :register_client, client_map: { client: :bob }, variables: { nickname: "bob" } },
+      { procedure: :register_client, client_map: { client: :carol }, variables: { nickname: "carol" } },
+      { procedure: :join_channel, client_map: { client: :alice }, variables: { channel: "#args" } },
+      { procedure: :join_channel, client_map: { client: :bob }, variables: { channel: "#args" } },
+      { client: :alice, command: "MODE #args +o carol", expect: /441 alice carol #args/, reject: /MODE #args \+o carol/ },
+      # already operator: nothing to say
+      { client: :alice, command: "MODE #args +o alice", reject: /MODE #args \+o alice/ },
+      { client: :alice, command: "MODE #args +l abc", expect: /696 alice #args l abc/ },
+      { client: :alice, command: "MODE #args +l -5", expect: /696 alice #args l -5/ },
+      { client: :bob, command: "MODE #args", expect: /324 bob #args$/, reject: /MODE #args \+l/ }
+    ]
+  },
+  #--------------------------------------------------
+  # FLOOD PROTECTION (+f)
+  {
+    name: "Flood throttle refuses lines past the limit with 404",
+    clients: [:alice, :bob],
+    steps: [
+      { procedure: :register_client, client_map: { client: :alice }, variables: { nickname: "alice" } },
+      { procedure: :register_client, client_map: { client: :bob }, variables: { nickname: "bob" } },
+      { procedure: :join_channel, client_map: { client: :alice }, variables: { channel: "#ft" } },
+      { procedure: :join_channel, client_map: { client: :bob }, variables: { channel: "#ft" } },
+      { client: :alice, command: "MODE #ft +f 2:60", expect: /MODE #ft \+f 2:60,throttle$/ },
+      { client: :bob, command: "PRIVMSG #ft :line one", expect: nil },
+      { client: :bob, command: "PRIVMSG #ft :line two", expect: nil },
+      { client: :bob, command: "PRIVMSG #ft :line three", expect: /404 bob #ft/ },
+      { client: :alice, command: "", expect: [/PRIVMSG #ft :line one/, /PRIVMSG #ft :line two/], reject: /line three/ }
+    ]
+  },
+  {
+    name: "Flood drop discards lines silently",
+    clients: [:alice, :bob],
+    steps: [
+      { procedure: :register_client, client_map: { client: :alice }, variables: { nickname: "alice" } },
+      { procedure: :register_client, client_map: { client: :bob }, variables: { nickname: "bob" } },
+      { procedure: :join_channel, client_map: { client: :alice }, variables: { channel: "#fd" } },
+      { procedure: :join_channel, client_map: { client: :bob }, variables: { channel: "#fd" } },
+      { client: :alice, command: "MODE #fd +f 2:60,drop", expect: /MODE #fd \+f 2:60,drop$/ },
+      { client: :bob, command: "PRIVMSG #fd :line one", expect: nil },
+      { client: :bob, command: "PRIVMSG #fd :line two", expect: nil },
+      { client: :bob, command: "PRIVMSG #fd :line three", reject: /404/ },
+      { client: :alice, command: "", expect: /PRIVMSG #fd :line two/, reject: /line three/ }
+    ]
+  },
+  {
+    name: "Flood kick removes the member",
+    clients: [:alice, :bob],
+    steps: [
+      { procedure: :register_client, client_map: { client: :alice }, variables: { nickname: "alice" } },
+      { procedure: :register_client, client_map: { client: :bob }, variables: { nickname: "bob" } },
+      { procedure: :join_channel, client_map: { client: :alice }, variables: { channel: "#fk" } },
+      { procedure: :join_channel, client_map: { client: :bob }, variables: { channel: "#fk" } },
+      { client: :alice, command: "MODE #fk +f 1:60,kick", expect: /MODE #fk \+f 1:60,kick$/ },
+      { client: :bob, command: "PRIVMSG #fk :line one", expect: nil },
+      { client: :bob, command: "PRIVMSG #fk :line two", expect: /KICK #fk bob/ },
+      { client: :alice, command: "NAMES #fk", expect: [/KICK #fk bob/, /353 alice = #fk :@alice$/], reject: /line two/ }
+    ]
+  },
+  {
+    name: "Flood protection exempts operators",
+    clients: [:alice, :bob],
+    steps: [
+      { procedure: :register_client, client_map: { client: :alice }, variables: { nickname: "alice" } },
+      { procedure: :register_client, client_map: { client: :bob }, variables: { nickname: "bob" } },
+      { procedure: :join_channel, client_map: { client: :alice }, variables: { channel: "#fo" } },
+      { procedure: :join_channel, client_map: { client: :bob }, variables: { channel: "#fo" } },
+      { client: :alice, command: "MODE #fo +f 1:60", expect: /MODE #fo \+f 1:60,throttle$/ },
+      { client: :alice, command: "PRIVMSG #fo :line one", expect: nil },
+      { client: :alice, command: "PRIVMSG #fo :line two", expect: nil },
+      { client: :alice, command: "PRIVMSG #fo :line three", reject: /404/ },
+      { client: :bob, command: "", expect: /PRIVMSG #fo :line three/ }
+    ]
+  },
+  {
+    name: "Invalid +f parameter gets 696",
+    clients: [:alice],
+    steps: [
+      { procedure: :register_client, client_map: { client: :alice }, variables: { nickname: "alice" } },
+      { procedure: :join_channel, client_map: { client: :alice }, variables: { channel: "#fx" } },
+      { client: :alice, command: "MODE #fx +f 0:10", expect: /696 alice #fx f 0:10/ },
+      { client: :alice, command: "MODE #fx +f 5:10,explode", expect: /696 alice #fx f 5:10,explode/ },
+      { client: :alice, command: "MODE #fx", expect: /324 alice #fx$/ }
+    ]
+  },
+  #--------------------------------------------------
+  # MONITOR
+  {
+    name: "MONITOR +, -, C, L and S",
+    clients: [:alice, :bob],
+    steps: [
+      { procedure: :register_client, client_map: { client: :alice }, variables: { nickname: "alice" } },
+      { procedure: :register_client, client_map: { client: :bob }, variables: { nickname: "bob" } },
+      { client: :alice, command: "MONITOR + bob", expect: /730 alice :?bob!bob@127\.0\.0\.1$/ },
+      { client: :alice, command: "MONITOR + carol", expect: /731 alice :?carol$/ },
+      { client: :alice, command: "MONITOR + dave", expect: /731 alice :?dave$/ },
+      # S answers for the whole list at once
+      { client: :alice, command: "MONITOR S", expect: /731 alice :?(carol,dave|dave,carol)$/ },
+      { client: :alice, command: "MONITOR L", expect: [/732 alice :?(?=.*bob)(?=.*carol)(?=.*dave)/, /733 alice :End of MONITOR list/] },
+      { client: :alice, command: "MONITOR - bob,dave", expect: nil },
+      { client: :alice, command: "MONITOR L", expect: /732 alice :?carol$/ },
+      { client: :alice, command: "MONITOR C", expect: nil },
+      { client: :alice, command: "MONITOR + erin", expect: /731 alice :?erin$/ },
+      { client: :alice, command: "MONITOR L", expect: /732 alice :?erin$/ }
+    ]
+  },
+  {
+    name: "MONITOR pushes 730/731 on register, NICK and QUIT",
+    clients: [:alice, :bob],
+    steps: [
+      { procedure: :register_client, client_map: { client: :alice }, variables: { nickname: "alice" } },
+      { client: :alice, command: "MONITOR + bob,bobby", expect: /731 alice :?bob,bobby$/ },
+      { procedure: :register_client, client_map: { client: :bob }, variables: { nickname: "bob" } },
+      { client: :alice, command: "", expect: /730 alice :?bob!bob@127\.0\.0\.1$/ },
+      { client: :bob, command: "NICK bobby", expect: nil },
+      { client: :alice, command: "", expect: [/731 alice :?bob$/, /730 alice :?bobby!bob@127\.0\.0\.1$/] },
+      { client: :bob, command: "QUIT :gone", expect: nil },
+      { client: :alice, command: "", expect: /731 alice :?bobby$/ }
+    ]
+  },
+  {
+    name: "MONITOR + past the limit gets 734",
+    clients: [:alice],
+    steps: [
+      { procedure: :register_client, client_map: { client: :alice }, variables: { nickname: "alice" } },
+      { client: :alice, command: "MONITOR + " + (1..101).map { |i| "m#{i}" }.join(","), expect: /734 alice 100 m101 :Monitor list is full/ },
+      { client: :alice, command: "MONITOR + extra", expect: /734 alice 100 extra :Monitor list is full/ },
+      { client: :alice, command: "MONITOR - m1", expect: nil },
+      { client: :alice, command: "MONITOR + extra2", expect: /731 alice :?extra2$/ }
+    ]
+  },
+  #--------------------------------------------------
+  # WHO and WHOIS
+  {
+    name: "WHO for a channel, a mask and a nickname",
+    clients: [:alice, :bob, :carol],
+    steps: [
+      { procedure: :register_client, client_map: { client: :alice }, variables: { nickname: "alice" } },
+      { procedure: :register_client, client_map: { client: :bob }, variables: { nickname: "bob" } },
+      { procedure: :register_client, client_map: { client: :carol }, variables: { nickname: "carol" } },
+      { procedure: :join_channel, client_map: { client: :alice }, variables: { channel: "#who" } },
+      { procedure: :join_channel, client_map: { client: :bob }, variables: { channel: "#who" } },
+      { client: :carol, command: "WHO #who", expect: [
+        /352 carol #who alice 127\.0\.0\.1 AspenWood alice H@ :0 Test User$/,
+        /352 carol #who bob 127\.0\.0\.1 AspenWood bob H :0 Test User$/,
+        /315 carol #who :End of WHO list$/
+      ] },
+      # matches alice only, by nickname and username
+      { client: :carol, command: "WHO *li*", expect: [
+        /352 carol \* alice 127\.0\.0\.1 AspenWood alice H :0 Test User$/,
+        /315 carol \*li\* :End of WHO list$/
+      ], reject: /352 carol \* (bob|carol) / },
+      { client: :carol, command: "WHO bob", expect: [
+        /352 carol \* bob 127\.0\.0\.1 AspenWood bob H :0 Test User$/,
+        /315 carol bob :End of WHO list$/
+      ] }
+    ]
+  },
+  {
+    name: "WHOIS answers 311/319/312/318, and 401 for a stranger",
+    clients: [:alice, :bob],
+    steps: [
+      { procedure: :register_client, client_map: { client: :alice }, variables: { nickname: "alice" } },
+      { procedure: :register_client, client_map: { client: :bob }, variables: { nickname: "bob" } },
+      { procedure: :join_channel, client_map: { client: :alice }, variables: { channel: "#whois1" } },
+      { procedure: :join_channel, client_map: { client: :alice }, variables: { channel: "#whois2" } },
+      { procedure: :join_channel, client_map: { client: :bob }, variables: { channel: "#whois2" } },
+      { client: :alice, command: "PART #whois1", expect: /PART #whois1/ },
+      { client: :bob, command: "WHOIS alice", expect: [
+        /311 bob alice alice 127\.0\.0\.1 \* :Test User$/,
+        /319 bob alice :?@#whois2$/,
+        /312 bob alice AspenWood :/,
+        /318 bob alice :End of \/WHOIS list$/
+      ] },
+      { client: :bob, command: "WHOIS nobody", expect: [/401 bob nobody /, /318 bob nobody :End of \/WHOIS list$/] }
+    ]
+  },
+  #--------------------------------------------------
+  # LIST
+  {
+    name: "LIST, its filters and a literal name",
+    clients: [:alice, :bob, :carol, :dave, :erin],
+    steps: [
+      { procedure: :register_client, client_map: { client: :alice }, variables: { nickname: "alice" } },
+      { procedure: :register_client, client_map: { client: :bob }, variables: { nickname: "bob" } },
+      { procedure: :register_client, client_map: { client: :carol }, variables: { nickname: "carol" } },
+      { procedure: :register_client, client_map: { client: :dave }, variables: { nickname: "dave" } },
+      { procedure: :register_client, client_map: { client: :erin }, variables: { nickname: "erin" } },
+      { procedure: :join_channel, client_map: { client: :alice }, variables: { channel: "#l1" } },
+      { procedure: :join_channel, client_map: { client: :alice }, variables: { channel: "#l3" } },
+      { procedure: :join_channel, client_map: { client: :bob }, variables: { channel: "#l3" } },
+      { procedure: :join_channel, client_map: { client: :carol }, variables: { channel: "#l3" } },
+      { client: :alice, command: "TOPIC #l3 :three of us", expect: /TOPIC #l3 :three of us/ },
+      { client: :alice, command: "LIST", expect: [
+        /321 alice Channel :Users  Name$/,
+        /322 alice #l1 1 :$/,
+        /322 alice #l3 3 :three of us$/,
+        /323 alice :End of \/LIST$/
+      ] },
+      # each query on its own client, so earlier answers cannot match
+      { client: :bob, command: "LIST >2", expect: [/322 bob #l3 3 /, /323 bob /], reject: /322 bob #l1 / },
+      { client: :carol, command: "LIST <2", expect: [/322 carol #l1 1 /, /323 carol /], reject: /322 carol #l3 / },
+      { client: :dave, command: "LIST !#l3", expect: [/322 dave #l1 1 /, /323 dave /], reject: /322 dave #l3 / },
+      { client: :erin, command: "LIST #L3", expect: [/321 erin /, /322 erin #l3 3 /, /323 erin /], reject: /322 erin #l1 / }
+    ]
   }
 ]
 
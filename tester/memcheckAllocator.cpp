@@ -1,11 +1,133 @@
 #include "memcheckAllocator.hpp"
 
+// GCC sees through the replacement pair and flags malloc/free behind new
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 11
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+#ifdef ALLOC_PROFILE
+# include "../include/AllocProfile.hpp"
+# include <csignal>
+# include <cstdio>
+# include <cstring>
+# include <pthread.h>
+
+// Distinct command names tracked; later ones are charged to "(other)"
+# define PROFILE_MAX_COMMANDS 64
+# define PROFILE_NAME_LEN 15
+
+// Everything lives in static storage: operator new must not allocate.
+static char g_commandNames[PROFILE_MAX_COMMANDS + 2][PROFILE_NAME_LEN + 1] = {
+    "-", "(other)"};
+static size_t g_commandCount = 2;
+static size_t g_currentCommand = 0;
+static AllocPhase g_currentPhase = ALLOC_PHASE_LOOP;
+static unsigned long g_allocs[PROFILE_MAX_COMMANDS + 2][ALLOC_PHASE_COUNT];
+static unsigned long g_bytes[PROFILE_MAX_COMMANDS + 2][ALLOC_PHASE_COUNT];
+static volatile sig_atomic_t g_dumpRequested = 0;
+// The thread that allocated first, i.e. the one running static init and
+// then the event loop. The journal writer and the watchdog allocate too,
+// but the phase and command are the loop's: their allocations are left
+// out rather than racing on the counters and being charged to it.
+static pthread_t g_mainThread;
+static bool g_mainThreadKnown = false;
+
+static bool onMainThread() {
+    if (!g_mainThreadKnown) {
+        g_mainThread = pthread_self();
+        g_mainThreadKnown = true;
+    }
+    return pthread_equal(g_mainThread, pthread_self());
+}
+
+static const char *const g_phaseNames[ALLOC_PHASE_COUNT] = {
+    "loop", "accept", "recv", "parse",
+    "execute", "serialize", "drain", "housekeeping"};
+
+AllocPhase allocProfilePhase() { return g_currentPhase; }
+
+void allocProfileSetPhase(AllocPhase phase) { g_currentPhase = phase; }
+
+const char *allocProfileCommand() { return g_commandNames[g_currentCommand]; }
+
+void allocProfileSetCommand(const char *name) {
+    if (!name) {
+        g_currentCommand = 0;
+        return;
+    }
+    for (size_t i = 0; i < g_commandCount; ++i) {
+        if (std::strncmp(g_commandNames[i], name, PROFILE_NAME_LEN) == 0) {
+            g_currentCommand = i;
+            return;
+        }
+    }
+    if (g_commandCount == PROFILE_MAX_COMMANDS + 2) {
+        g_currentCommand = 1;
+        return;
+    }
+    std::strncpy(g_commandNames[g_commandCount], name, PROFILE_NAME_LEN);
+    g_currentCommand = g_commandCount++;
+}
+
+void allocProfileDump(std::ostream &out) {
+    // rows are (command << 8 | phase), sorted by bytes with an insertion sort
+    static unsigned rows[(PROFILE_MAX_COMMANDS + 2) * ALLOC_PHASE_COUNT];
+    size_t rowCount = 0;
+    unsigned long totalAllocs = 0, totalBytes = 0;
+    for (size_t c = 0; c < g_commandCount; ++c) {
+        for (int p = 0; p < ALLOC_PHASE_COUNT; ++p) {
+            if (!g_allocs[c][p])
+                continue;
+            totalAllocs += g_allocs[c][p];
+            totalBytes += g_bytes[c][p];
+            const unsigned row = static_cast<unsigned>(c << 8 | p);
+            size_t at = rowCount++;
+            while (at > 0 && g_bytes[rows[at - 1] >> 8][rows[at - 1] & 0xff] <
+                                 g_bytes[c][p]) {
+                rows[at] = rows[at - 1];
+                --at;
+            }
+            rows[at] = row;
+        }
+    }
+    char line[128];
+    std::snprintf(line, sizeof(line), "%-13s %-16s %12s %14s %10s\n", "phase",
+                  "command", "allocs", "bytes", "bytes/op");
+    out << "==== allocation profile ====\n" << line;
+    for (size_t i = 0; i < rowCount; ++i) {
+        const unsigned c = rows[i] >> 8, p = rows[i] & 0xff;
+        std::snprintf(line, sizeof(line), "%-13s %-16s %12lu %14lu %10lu\n",
+                      g_phaseNames[p], g_commandNames[c], g_allocs[c][p],
+                      g_bytes[c][p], g_bytes[c][p] / g_allocs[c][p]);
+        out << line;
+    }
+    std::snprintf(line, sizeof(line), "%-13s %-16s %12lu %14lu\n", "total", "",
+                  totalAllocs, totalBytes);
+    out << line << std::flush;
+}
+
+void allocProfileRequestDump() { g_dumpRequested = 1; }
+
+void allocProfilePoll(std::ostream &out) {
+    if (!g_dumpRequested)
+        return;
+    g_dumpRequested = 0;
+    allocProfileDump(out);
+}
+#endif
+
 void* operator new(size_t size) throw(std::bad_alloc) {
     if (TESTMEM) {
         if (++g_allocationCount == TESTMEM)
             throw std::bad_alloc();
     }
-    void* ptr = malloc(size);
+#ifdef ALLOC_PROFILE
+    if (onMainThread()) {
+        ++g_allocs[g_currentCommand][g_currentPhase];
+        g_bytes[g_currentCommand][g_currentPhase] += size;
+    }
+#endif
+    void* ptr = malloc(size ? size : 1);
     if (!ptr) throw std::bad_alloc();
     return ptr;
 }
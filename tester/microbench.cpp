@@ -0,0 +1,466 @@
+// Microbenchmarks for the building blocks of the server: message parsing and
+// serialization, case mapping, the outbound queues and command dispatch.
+//
+// Usage (normally through `make bench`):
+//   ./microbench [--filter=<substr>] [--min-time=<ms>] [--out=<file.json>]
+//                [--compare=<baseline.json>] [--max-regression=<percent>]
+//
+// Every benchmark is run with a growing iteration count until it lasts at
+// least --min-time, then reported as ns/op, allocs/op and bytes/op (counted
+// by the operator new override below). Results are written as JSON, one
+// benchmark object per line, so a saved run can serve as the baseline of a
+// later --compare. With --max-regression the exit status is 1 when any
+// benchmark got slower than the baseline by more than that percentage.
+
+#include "../include/CaseMappedString.hpp"
+#include "../include/Command.hpp"
+#include "../include/Message.hpp"
+#include "../include/MessageQueue.hpp"
+#include "../include/MessageQueueManager.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <new>
+#include <poll.h>
+#include <sstream>
+#include <stdint.h>
+#include <string>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <vector>
+
+#define DEFAULT_MIN_TIME_MS 200
+#define MAX_ITERATIONS		100000000ul
+
+// ------------------------------------------------------- allocation counting
+
+// GCC sees through the replacement pair and flags malloc/free behind new
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 11
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+static unsigned long g_allocs = 0;
+static unsigned long g_allocBytes = 0;
+
+void *operator new(size_t size) throw(std::bad_alloc) {
+	++g_allocs;
+	g_allocBytes += size;
+	void *ptr = malloc(size ? size : 1);
+	if (!ptr)
+		throw std::bad_alloc();
+	return ptr;
+}
+
+void *operator new[](size_t size) throw(std::bad_alloc) {
+	return operator new(size);
+}
+
+void operator delete(void *ptr) throw() { free(ptr); }
+
+void operator delete[](void *ptr) throw() { operator delete(ptr); }
+
+// ------------------------------------------------------------------ harness
+
+static uint64_t nowNs() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return static_cast<uint64_t>(ts.tv_sec) * 1000000000u +
+		   static_cast<uint64_t>(ts.tv_nsec);
+}
+
+// Timer and allocation counters of one run; setup work inside a benchmark
+// can be excluded with pause()/resume().
+class BenchState {
+  public:
+	explicit BenchState(unsigned long iterations)
+		: iterations(iterations), elapsed_(0), allocs_(0), bytes_(0),
+		  start_(0), allocStart_(0), bytesStart_(0) {}
+
+	void resume() {
+		allocStart_ = g_allocs;
+		bytesStart_ = g_allocBytes;
+		start_		= nowNs();
+	}
+	void pause() {
+		elapsed_ += nowNs() - start_;
+		allocs_ += g_allocs - allocStart_;
+		bytes_ += g_allocBytes - bytesStart_;
+	}
+
+	const unsigned long iterations;
+	uint64_t			elapsed() const { return elapsed_; }
+	unsigned long		allocs() const { return allocs_; }
+	unsigned long		bytes() const { return bytes_; }
+
+  private:
+	uint64_t	  elapsed_;
+	unsigned long allocs_;
+	unsigned long bytes_;
+	uint64_t	  start_;
+	unsigned long allocStart_;
+	unsigned long bytesStart_;
+};
+
+typedef void (*BenchFunction)(BenchState &);
+
+struct BenchResult {
+	std::string	  name;
+	unsigned long iterations;
+	double		  nsPerOp;
+	double		  allocsPerOp;
+	double		  bytesPerOp;
+};
+
+// Keeps the optimizer from discarding results
+static volatile size_t g_sink;
+
+// ---------------------------------------------------------------- benchmarks
+
+static const char *const kPrivmsgLine =
+	":alice!alice@127.0.0.1 PRIVMSG #channel :hello there, this is a test";
+
+static void benchMessageParse(BenchState &state) {
+	const std::string raw(kPrivmsgLine);
+	state.resume();
+	for (unsigned long i = 0; i < state.iterations; ++i) {
+		Message message(raw);
+		g_sink += message.getParams().size();
+	}
+	state.pause();
+}
+
+static void benchMessageParseShort(BenchState &state) {
+	const std::string raw("NICK alice");
+	state.resume();
+	for (unsigned long i = 0; i < state.iterations; ++i) {
+		Message message(raw);
+		g_sink += message.getParams().size();
+	}
+	state.pause();
+}
+
+static void benchMessageToString(BenchState &state) {
+	const Message message(kPrivmsgLine);
+	state.resume();
+	for (unsigned long i = 0; i < state.iterations; ++i)
+		g_sink += message.toString().size();
+	state.pause();
+}
+
+static void benchCaseMappedConstruct(BenchState &state) {
+	const std::string nick("Alice[Away]^");
+	state.resume();
+	for (unsigned long i = 0; i < state.iterations; ++i) {
+		CaseMappedString mapped(nick);
+		g_sink += mapped.size();
+	}
+	state.pause();
+}
+
+static void benchCaseMappedEquals(BenchState &state) {
+	const CaseMappedString a("Alice[Away]^");
+	const CaseMappedString b("alice{away}~");
+	state.resume();
+	for (unsigned long i = 0; i < state.iterations; ++i)
+		g_sink += (a == b);
+	state.pause();
+}
+
+static void benchCaseMappedLess(BenchState &state) {
+	const CaseMappedString a("Alice[Away]^");
+	const CaseMappedString b("alice{away}z");
+	state.resume();
+	for (unsigned long i = 0; i < state.iterations; ++i)
+		g_sink += (a < b);
+	state.pause();
+}
+
+// One line queued, then sent in two partial writes
+static void benchMessageQueuePushConsume(BenchState &state) {
+	const std::string line = std::string(kPrivmsgLine) + "\r\n";
+	MessageQueue	  queue;
+	state.resume();
+	for (unsigned long i = 0; i < state.iterations; ++i) {
+		queue.pushBack(line);
+		queue.removeBytesFromFront(line.size() / 2);
+		queue.removeBytesFromFront(queue.front().size());
+		queue.popFront();
+	}
+	state.pause();
+	g_sink += queue.size();
+}
+
+static bool makeSocketPair(int fds[2]) {
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == -1)
+		return false;
+	fcntl(fds[0], F_SETFL, O_NONBLOCK);
+	fcntl(fds[1], F_SETFL, O_NONBLOCK);
+	return true;
+}
+
+static void drainPeer(int fd) {
+	char buffer[65536];
+	while (recv(fd, buffer, sizeof(buffer), 0) > 0)
+		;
+}
+
+// send() only queues; the line goes out on the next POLLOUT drain, as in
+// the server loop. One line per round trip.
+static void benchMqmSendDrain(BenchState &state) {
+	int fds[2];
+	if (!makeSocketPair(fds))
+		return;
+	const std::string		   line = std::string(kPrivmsgLine) + "\r\n";
+	MessageQueueManager		   manager;
+	std::vector<struct pollfd> polled(1);
+	polled[0].fd	  = fds[0];
+	polled[0].events  = POLLOUT;
+	polled[0].revents = POLLOUT;
+	state.resume();
+	for (unsigned long i = 0; i < state.iterations; ++i) {
+		manager.send(fds[0], line);
+		manager.drainQueuesForPolled(polled);
+		if ((i & 63) == 63) {
+			state.pause();
+			drainPeer(fds[1]);
+			state.resume();
+		}
+	}
+	state.pause();
+	g_sink += manager.hasDeadFds();
+	close(fds[0]);
+	close(fds[1]);
+}
+
+// A broadcast-like burst: 64 lines queued, then drained in one pass
+static void benchMqmBatchDrain(BenchState &state) {
+	int fds[2];
+	if (!makeSocketPair(fds))
+		return;
+	const std::string		   line = std::string(kPrivmsgLine) + "\r\n";
+	MessageQueueManager		   manager;
+	std::vector<struct pollfd> polled(1);
+	polled[0].fd	  = fds[0];
+	polled[0].events  = POLLOUT;
+	polled[0].revents = POLLOUT;
+	for (unsigned long done = 0; done < state.iterations;) {
+		const unsigned long batch =
+			std::min<unsigned long>(64, state.iterations - done);
+		state.resume();
+		for (unsigned long i = 0; i < batch; ++i)
+			manager.send(fds[0], line);
+		manager.drainQueuesForPolled(polled);
+		state.pause();
+		drainPeer(fds[1]);
+		done += batch;
+	}
+	g_sink += manager.hasDeadFds();
+	close(fds[0]);
+	close(fds[1]);
+}
+
+static void benchCommandDispatch(BenchState &state) {
+	const Message message(kPrivmsgLine);
+	state.resume();
+	for (unsigned long i = 0; i < state.iterations; ++i) {
+		Command *command = convertMessageToCommand(message);
+		g_sink += (command != NULL);
+		delete command;
+	}
+	state.pause();
+}
+
+struct BenchEntry {
+	const char	 *name;
+	BenchFunction function;
+};
+
+static const BenchEntry kBenchmarks[] = {
+	{"message_parse_privmsg", &benchMessageParse},
+	{"message_parse_short", &benchMessageParseShort},
+	{"message_tostring", &benchMessageToString},
+	{"casemapped_construct", &benchCaseMappedConstruct},
+	{"casemapped_equals", &benchCaseMappedEquals},
+	{"casemapped_less", &benchCaseMappedLess},
+	{"messagequeue_push_consume", &benchMessageQueuePushConsume},
+	{"mqm_send_drain", &benchMqmSendDrain},
+	{"mqm_batch64_drain", &benchMqmBatchDrain},
+	{"command_dispatch", &benchCommandDispatch},
+};
+
+// Grows the iteration count until one run lasts at least minTimeNs
+static BenchResult runBenchmark(const BenchEntry &entry, uint64_t minTimeNs) {
+	unsigned long iterations = 1;
+	for (;;) {
+		BenchState state(iterations);
+		entry.function(state);
+		const uint64_t elapsed = state.elapsed() ? state.elapsed() : 1;
+		if (elapsed >= minTimeNs || iterations >= MAX_ITERATIONS) {
+			BenchResult result;
+			result.name		   = entry.name;
+			result.iterations  = iterations;
+			result.nsPerOp	   = static_cast<double>(elapsed) / iterations;
+			result.allocsPerOp = static_cast<double>(state.allocs()) / iterations;
+			result.bytesPerOp  = static_cast<double>(state.bytes()) / iterations;
+			return result;
+		}
+		// aim 20% past the target, growing at most 100x per round
+		double next = static_cast<double>(iterations) * 1.2 *
+					  static_cast<double>(minTimeNs) / static_cast<double>(elapsed);
+		if (next > static_cast<double>(iterations) * 100.0)
+			next = static_cast<double>(iterations) * 100.0;
+		iterations = static_cast<unsigned long>(next) + 1;
+		if (iterations > MAX_ITERATIONS)
+			iterations = MAX_ITERATIONS;
+	}
+}
+
+// ------------------------------------------------------------- JSON in/out
+
+static void writeJson(std::ostream &out, const std::vector<BenchResult> &results) {
+	out << "{\"benchmarks\": [\n";
+	for (size_t i = 0; i < results.size(); ++i) {
+		char line[256];
+		std::snprintf(line, sizeof(line),
+					  "  {\"name\": \"%s\", \"iterations\": %lu, "
+					  "\"ns_per_op\": %.2f, \"allocs_per_op\": %.2f, "
+					  "\"bytes_per_op\": %.2f}%s\n",
+					  results[i].name.c_str(), results[i].iterations,
+					  results[i].nsPerOp, results[i].allocsPerOp,
+					  results[i].bytesPerOp, i + 1 < results.size() ? "," : "");
+		out << line;
+	}
+	out << "]}\n";
+}
+
+static bool jsonNumber(const std::string &line, const char *key, double &out) {
+	const std::string	   needle = std::string("\"") + key + "\": ";
+	std::string::size_type at	  = line.find(needle);
+	if (at == std::string::npos)
+		return false;
+	out = std::strtod(line.c_str() + at + needle.size(), NULL);
+	return true;
+}
+
+// Reads what writeJson() wrote: one benchmark object per line
+static bool readJson(const std::string &path, std::map<std::string, BenchResult> &out) {
+	std::ifstream in(path.c_str());
+	if (!in)
+		return false;
+	std::string line;
+	while (std::getline(in, line)) {
+		const std::string	   key = "\"name\": \"";
+		std::string::size_type at  = line.find(key);
+		if (at == std::string::npos)
+			continue;
+		std::string::size_type end = line.find('"', at + key.size());
+		BenchResult			   r;
+		double				   iterations = 0;
+		r.name = line.substr(at + key.size(), end - at - key.size());
+		if (!jsonNumber(line, "ns_per_op", r.nsPerOp) ||
+			!jsonNumber(line, "allocs_per_op", r.allocsPerOp) ||
+			!jsonNumber(line, "bytes_per_op", r.bytesPerOp))
+			continue;
+		jsonNumber(line, "iterations", iterations);
+		r.iterations = static_cast<unsigned long>(iterations);
+		out[r.name]	 = r;
+	}
+	return true;
+}
+
+// Prints the comparison table; returns false if a benchmark slowed down by
+// more than maxRegression percent (negative: never fail)
+static bool compare(const std::vector<BenchResult>			   &results,
+					const std::map<std::string, BenchResult> &baseline,
+					double maxRegression) {
+	bool ok = true;
+	std::fprintf(stderr, "%-28s %12s %12s %8s %14s\n", "benchmark", "base ns/op",
+				 "ns/op", "delta", "allocs/op");
+	for (size_t i = 0; i < results.size(); ++i) {
+		const BenchResult &r = results[i];
+		std::map<std::string, BenchResult>::const_iterator base =
+			baseline.find(r.name);
+		if (base == baseline.end()) {
+			std::fprintf(stderr, "%-28s %12s %12.2f %8s %14.2f\n", r.name.c_str(),
+						 "-", r.nsPerOp, "new", r.allocsPerOp);
+			continue;
+		}
+		const double delta =
+			base->second.nsPerOp > 0
+				? (r.nsPerOp - base->second.nsPerOp) * 100.0 / base->second.nsPerOp
+				: 0.0;
+		char allocs[32];
+		std::snprintf(allocs, sizeof(allocs), "%.2f -> %.2f",
+					  base->second.allocsPerOp, r.allocsPerOp);
+		std::fprintf(stderr, "%-28s %12.2f %12.2f %+7.1f%% %14s\n", r.name.c_str(),
+					 base->second.nsPerOp, r.nsPerOp, delta, allocs);
+		if (maxRegression >= 0 && delta > maxRegression)
+			ok = false;
+	}
+	return ok;
+}
+
+int main(int argc, char **argv) {
+	std::string filter, outPath, baselinePath;
+	uint64_t	minTimeMs	  = DEFAULT_MIN_TIME_MS;
+	double		maxRegression = -1;
+	for (int i = 1; i < argc; ++i) {
+		const std::string arg = argv[i];
+		if (arg.compare(0, 9, "--filter=") == 0)
+			filter = arg.substr(9);
+		else if (arg.compare(0, 11, "--min-time=") == 0)
+			minTimeMs = std::strtoul(arg.c_str() + 11, NULL, 10);
+		else if (arg.compare(0, 6, "--out=") == 0)
+			outPath = arg.substr(6);
+		else if (arg.compare(0, 10, "--compare=") == 0)
+			baselinePath = arg.substr(10);
+		else if (arg.compare(0, 17, "--max-regression=") == 0)
+			maxRegression = std::strtod(arg.c_str() + 17, NULL);
+		else {
+			std::cerr << "Usage: " << argv[0]
+					  << " [--filter=<substr>] [--min-time=<ms>] [--out=<file>]"
+						 " [--compare=<baseline>] [--max-regression=<percent>]"
+					  << std::endl;
+			return 2;
+		}
+	}
+	std::map<std::string, BenchResult> baseline;
+	if (!baselinePath.empty() && !readJson(baselinePath, baseline)) {
+		std::cerr << "cannot read baseline " << baselinePath << std::endl;
+		return 2;
+	}
+	// The queue manager echoes every line it sends; keep the output clean
+	std::cout.setstate(std::ios::failbit);
+
+	std::vector<BenchResult> results;
+	const size_t			 count = sizeof(kBenchmarks) / sizeof(kBenchmarks[0]);
+	for (size_t i = 0; i < count; ++i) {
+		if (!filter.empty() &&
+			std::string(kBenchmarks[i].name).find(filter) == std::string::npos)
+			continue;
+		results.push_back(runBenchmark(kBenchmarks[i], minTimeMs * 1000000u));
+		std::fprintf(stderr, "%-28s %12.2f ns/op %8.2f allocs/op %10.2f B/op\n",
+					 results.back().name.c_str(), results.back().nsPerOp,
+					 results.back().allocsPerOp, results.back().bytesPerOp);
+	}
+
+	if (outPath.empty()) {
+		std::ostringstream json;
+		writeJson(json, results);
+		std::fputs(json.str().c_str(), stdout);
+	} else {
+		std::ofstream out(outPath.c_str());
+		writeJson(out, results);
+	}
+	if (!baseline.empty() && !compare(results, baseline, maxRegression))
+		return 1;
+	return 0;
+}
@@ -0,0 +1,132 @@
+#!/usr/bin/env ruby
+# Channel state across a restart: set topics and modes with --state-dir,
+# stop the server, tear the last journal entry and start it again. Only
+# shutdown keeps a channel: one its last member left is gone for good.
+#
+#   ruby tester/state_test.rb [port] [channels]
+#
+# Enough channels make the journal compact into a snapshot on the way.
+require 'socket'
+require 'fileutils'
+require 'timeout'
+require 'tmpdir'
+
+PORT     = (ARGV[0] || 6691).to_i
+CHANNELS = (ARGV[1] || 20000).to_i
+PASSWORD = "pw"
+ROOT     = File.expand_path("..", __dir__)
+STATE    = Dir.mktmpdir("ircstate")
+
+def fail!(why)
+  puts "FAIL: #{why}"
+  system("pkill", "-INT", "-x", "ircserv")
+  exit 1
+end
+
+def start
+  pid = spawn("#{ROOT}/ircserv", PORT.to_s, PASSWORD, "--state-dir=#{STATE}",
+              "--max-per-ip=0", "--connect-rate=0", "--drain-timeout=0",
+              out: File::NULL)
+  sleep 0.5
+  pid
+end
+
+def stop(pid)
+  Process.kill("INT", pid)
+  Process.wait(pid)
+end
+
+def connect(nick, user = nick)
+  sock = TCPSocket.new("127.0.0.1", PORT)
+  sock.write("PASS #{PASSWORD}\r\nNICK #{nick}\r\nUSER #{user} 0 * :#{nick}\r\n")
+  expect(sock, / 0*1 /)
+  sock
+end
+
+# Reads lines until one matches pattern; returns it
+def expect(sock, pattern, timeout = 10)
+  Timeout.timeout(timeout) do
+    while (line = sock.gets)
+      return line if line =~ pattern
+    end
+  end
+  fail!("connection closed while waiting for #{pattern.inspect}")
+rescue Timeout::Error
+  fail!("timed out waiting for #{pattern.inspect}")
+end
+
+server = start
+alice = connect("alice")
+bob = connect("bob")
+alice.write("JOIN #kept\r\nTOPIC #kept :survives restarts\r\nMODE #kept +k sesame\r\n")
+expect(alice, / MODE #kept \+k /)
+bob.write("JOIN #kept sesame\r\n")
+expect(alice, / JOIN #kept/)
+alice.write("MODE #kept +o bob\r\n")
+expect(bob, / MODE #kept \+o bob/)
+bob.write("PART #kept\r\n")
+expect(alice, / PART #kept/)
+alice.write("MODE #kept +i\r\nINVITE bob #kept\r\nJOIN #open\r\n")
+expect(alice, / 341 /)
+CHANNELS.times do |i|
+  alice.write("JOIN #c#{i}\r\nTOPIC #c#{i} :topic #{i}\r\n")
+  next unless (i % 50).zero?
+  alice.write("MODE #kept\r\n")
+  expect(alice, / 324 /)
+end
+alice.write("MODE #kept\r\n")
+expect(alice, / 324 /)
+# emptied before the restart, so forgotten
+alice.write("JOIN #gone\r\nMODE #gone +k lock\r\nPART #gone\r\n")
+expect(alice, / PART #gone/)
+sleep 1
+# stopped with everyone still in: the channels were not emptied
+stop(server)
+alice.close
+bob.close
+files = Dir.children(STATE).sort
+puts "state: " + files.map { |f| "#{f} #{File.size(File.join(STATE, f))} bytes" }.join(", ")
+File.open(File.join(STATE, "channels.journal"), "ab") { |f| f.write("\x40\0\0\0torn") }
+
+server = start
+bob = connect("bob")
+bob.write("JOIN #kept\r\n")
+expect(bob, / 475 /)
+bob.write("JOIN #kept sesame\r\n")
+expect(bob, / 332 .*:survives restarts/)
+names = expect(bob, / 353 /)
+fail!("operator not restored: #{names}") unless names =~ /@bob/
+carol = connect("carol")
+carol.write("JOIN #kept sesame\r\n")
+expect(carol, / 473 /)
+last = CHANNELS - 1
+carol.write("JOIN #c#{last}\r\n")
+expect(carol, / 332 .*:topic #{last}/) if CHANNELS > 0
+carol.write("JOIN #gone\r\n")
+names = expect(carol, / 353 carol = #gone | 475 /)
+fail!("#gone came back after its last member left: #{names}") unless names =~ /@carol/
+# same nickname, another user: operators come back by nick!user@host
+impostor = connect("alice", "mallory")
+impostor.write("JOIN #open\r\n")
+names = expect(impostor, / 353 /)
+fail!("operator restored by nickname: #{names}") if names =~ /@alice/
+# a channel emptied while running is forgotten right away, so whoever
+# locked it cannot keep it from the next creator
+mallory = connect("mallory")
+mallory.write("JOIN #help\r\nMODE #help +k lock\r\nPART #help\r\n")
+expect(mallory, / PART #help/)
+carol.write("JOIN #help\r\n")
+names = expect(carol, / 353 carol = #help | 475 /)
+fail!("#help kept its key after its last member left: #{names}") unless names =~ /@carol/
+stop(server)
+[bob, carol, impostor, mallory].each(&:close)
+
+# bob's invitation got him into #kept, and is used up now
+server = start
+bob = connect("bob")
+bob.write("JOIN #kept sesame\r\n")
+expect(bob, / 473 /)
+stop(server)
+bob.close
+FileUtils.remove_entry(STATE)
+puts "PASS: #kept and #{CHANNELS} channels came back"
@@ -0,0 +1,87 @@
+#!/usr/bin/env ruby
+# Live upgrade under load: start ircserv, put ircbench traffic on it, send
+# SIGHUP halfway through and check that no connection noticed.
+#
+#   ruby tester/upgrade_test.rb [port] [clients] [seconds]
+#
+# Besides the bench totals, two resident clients check what the new process
+# inherited: channel membership, topic, and a line that was half sent when
+# the upgrade happened.
+require 'socket'
+require 'timeout'
+
+PORT     = (ARGV[0] || 6690).to_i
+CLIENTS  = (ARGV[1] || 200).to_i
+SECONDS  = (ARGV[2] || 6).to_i
+PASSWORD = "pw"
+ROOT     = File.expand_path("..", __dir__)
+
+def fail!(why)
+  puts "FAIL: #{why}"
+  system("pkill", "-INT", "-x", "ircserv")
+  exit 1
+end
+
+def connect(nick)
+  sock = TCPSocket.new("127.0.0.1", PORT)
+  sock.write("PASS #{PASSWORD}\r\nNICK #{nick}\r\nUSER #{nick} 0 * :#{nick}\r\n")
+  expect(sock, / 0*1 /)
+  sock
+end
+
+# Reads lines until one matches pattern; returns it
+def expect(sock, pattern, timeout = 5)
+  Timeout.timeout(timeout) do
+    while (line = sock.gets)
+      return line if line =~ pattern
+    end
+  end
+  fail!("connection closed while waiting for #{pattern.inspect}")
+rescue Timeout::Error
+  fail!("timed out waiting for #{pattern.inspect}")
+end
+
+server = spawn("#{ROOT}/ircserv", PORT.to_s, PASSWORD, "--max-per-ip=0",
+               "--connect-rate=0", out: File::NULL)
+sleep 0.5
+
+alice = connect("alice")
+bob = connect("bob")
+alice.write("JOIN #up\r\nTOPIC #up :before the upgrade\r\n")
+expect(alice, / 332 | TOPIC /)
+bob.write("JOIN #up\r\n")
+expect(bob, / 366 /)
+
+bench = IO.popen(["#{ROOT}/ircbench", "--port=#{PORT}", "--password=#{PASSWORD}",
+                  "--clients=#{CLIENTS}", "--duration=#{SECONDS}"],
+                 err: [:child, :out])
+sleep SECONDS / 2.0
+
+# half a line now, the rest after the handover
+alice.write("PRIVMSG #up :sp")
+alice.flush
+Process.kill("HUP", server)
+Process.wait(server)
+puts "old server exited with #{$?.exitstatus}"
+alice.write("anning the upgrade\r\n")
+expect(bob, /PRIVMSG #up :spanning the upgrade/)
+bob.write("TOPIC #up\r\nNAMES #up\r\n")
+expect(bob, / 332 .*:before the upgrade/)
+names = expect(bob, / 353 /)
+fail!("NAMES lost a member: #{names}") unless names =~ /@alice/ && names =~ /bob/
+# the channel lists of the clients are rebuilt from the members handed over
+bob.write("WHOIS alice\r\n")
+expect(bob, / 319 bob alice :?@#up/)
+
+report = bench.read
+bench.close
+puts report
+fail!("ircbench did not finish") unless report =~ /anomalies/
+fail!("connections failed") unless report =~ /, 0 failed/
+fail!("connections dropped") unless report =~ /, 0 errors/
+fail!("messages out of order") unless report =~ / 0 out of order/
+
+alice.close
+bob.close
+system("pkill", "-INT", "-x", "ircserv")
+puts "PASS: #{CLIENTS} bench clients and 2 residents survived the upgrade"